@@ -0,0 +1,75 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "CatalogGenerator.h"
+#include "PluginList.h"
+#include "libinstall/md5.h"
+
+using namespace std;
+
+
+/* Compares parsing the XML (cold - no cache, or the XML has changed) with loading
+ * the compiled catalog cache (warm - the XML hash still matches the cache) */
+void benchCatalogCache(const tstring& workDir, int pluginCount)
+{
+	tstring xmlFilename(workDir);
+	xmlFilename.append(_T("\\PluginManagerPlugins.xml"));
+	tstring cacheFilename(workDir);
+	cacheFilename.append(_T("\\PluginManagerPlugins.cache"));
+
+	if (!generateCatalog(xmlFilename.c_str(), pluginCount))
+	{
+		_tprintf(_T("Unable to write %s\n"), xmlFilename.c_str());
+		return;
+	}
+
+	::DeleteFile(cacheFilename.c_str());
+
+	TCHAR hashBuffer[(MD5LEN * 2) + 1];
+	hashBuffer[0] = _T('\0');
+	MD5::hash(xmlFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1);
+	tstring xmlHash(hashBuffer);
+
+	// Cold - the cache doesn't exist, so this is the XML parse plus writing the cache
+	{
+		PluginList pluginList;
+		BenchmarkTimer timer;
+		pluginList.parsePluginFile(xmlFilename.c_str(), cacheFilename.c_str(), xmlHash);
+		reportResult(_T("catalog.cold.parseXml"), pluginCount, timer.elapsedMilliseconds());
+	}
+
+	// Warm - the cache was written by the cold run
+	{
+		PluginList pluginList;
+		BenchmarkTimer timer;
+		BOOL loaded = pluginList.loadCatalogCache(cacheFilename.c_str(), xmlHash);
+		double milliseconds = timer.elapsedMilliseconds();
+
+		if (loaded)
+			reportResult(_T("catalog.warm.loadCache"), pluginCount, milliseconds);
+		else
+			_tprintf(_T("Catalog cache was not loaded for %d plugins\n"), pluginCount);
+	}
+
+	::DeleteFile(cacheFilename.c_str());
+	::DeleteFile(xmlFilename.c_str());
+}
@@ -0,0 +1,68 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/FileSink.h"
+
+#include <vector>
+
+using namespace std;
+
+// The size of each part of a download, as InternetDownload reads it
+#define BENCH_PART_SIZE  16384
+
+
+/* Writes megabytes of data to filename in download sized parts, with fwrite as downloads and
+ * extraction used to, and with a FileSink that knows the size up front */
+void benchFileSink(const tstring& workDir, int megabytes)
+{
+	tstring filename(workDir);
+	filename.append(_T("\\filesink.dat"));
+
+	vector<BYTE> part(BENCH_PART_SIZE);
+	for (size_t index = 0; index < part.size(); ++index)
+		part[index] = static_cast<BYTE>(index);
+
+	int partCount = megabytes * (1024 * 1024 / BENCH_PART_SIZE);
+
+	BenchmarkTimer timer;
+	FILE* fp = NULL;
+	if (_tfopen_s(&fp, filename.c_str(), _T("wb")) == 0)
+	{
+		for (int index = 0; index < partCount; ++index)
+			fwrite(&part[0], BENCH_PART_SIZE, 1, fp);
+		fclose(fp);
+	}
+	reportResult(_T("filesink.fwrite"), megabytes, timer.elapsedMilliseconds());
+	::DeleteFile(filename.c_str());
+
+	timer.start();
+	FileSink sink;
+	if (sink.create(filename))
+	{
+		sink.reserve(static_cast<UINT64>(partCount) * BENCH_PART_SIZE);
+		for (int index = 0; index < partCount; ++index)
+			sink.write(&part[0], BENCH_PART_SIZE);
+		sink.close();
+	}
+	reportResult(_T("filesink.overlapped"), megabytes, timer.elapsedMilliseconds());
+	::DeleteFile(filename.c_str());
+}
@@ -0,0 +1,109 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/FingerprintCache.h"
+
+#include <vector>
+
+using namespace std;
+
+
+/* Times the fingerprint cache over one dll for every 10 plugins in the list - the first
+ * refresh, where every dll misses, then saving and loading the cache, and a refresh where
+ * every dll hits.  The dlls are empty files, so this is the cost of the cache alone. */
+void benchFingerprintCache(const tstring& workDir, int pluginCount)
+{
+	tstring dllDir(workDir);
+	dllDir.append(_T("\\plugins"));
+	::CreateDirectory(dllDir.c_str(), NULL);
+
+	vector<tstring> dllFilenames;
+	for (int index = 0; index < pluginCount; index += 10)
+	{
+		TCHAR filename[60];
+		_stprintf_s(filename, 60, _T("\\GeneratedPlugin%d.dll"), index);
+		tstring dllFilename(dllDir);
+		dllFilename.append(filename);
+
+		HANDLE hFile = ::CreateFile(dllFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (INVALID_HANDLE_VALUE != hFile)
+		{
+			::CloseHandle(hFile);
+			dllFilenames.push_back(dllFilename);
+		}
+	}
+
+	tstring cacheFilename(workDir);
+	cacheFilename.append(_T("\\PluginManagerInstalled.cache"));
+
+	Win32FileSystem fileSystem;
+	Fingerprint readFingerprint;
+	readFingerprint.isPlugin = TRUE;
+	readFingerprint.name = _T("Generated Plugin");
+	readFingerprint.hash = _T("0123456789abcdef0123456789abcdef");
+	readFingerprint.hasVersion = TRUE;
+
+	{
+		FingerprintCache fingerprintCache(fileSystem);
+
+		BenchmarkTimer timer;
+		for (vector<tstring>::iterator it = dllFilenames.begin(); it != dllFilenames.end(); ++it)
+		{
+			FileStat fileStat;
+			Fingerprint fingerprint;
+			if (!fingerprintCache.lookup(*it, fileStat, fingerprint))
+				fingerprintCache.add(*it, fileStat, readFingerprint);
+		}
+		reportResult(_T("installed.fingerprints.cold"), pluginCount, timer.elapsedMilliseconds());
+
+		timer.start();
+		fingerprintCache.save(cacheFilename);
+		reportResult(_T("installed.fingerprints.save"), pluginCount, timer.elapsedMilliseconds());
+	}
+
+	{
+		FingerprintCache fingerprintCache(fileSystem);
+
+		BenchmarkTimer timer;
+		fingerprintCache.load(cacheFilename);
+		reportResult(_T("installed.fingerprints.load"), pluginCount, timer.elapsedMilliseconds());
+
+		timer.start();
+		for (vector<tstring>::iterator it = dllFilenames.begin(); it != dllFilenames.end(); ++it)
+		{
+			FileStat fileStat;
+			Fingerprint fingerprint;
+			fingerprintCache.lookup(*it, fileStat, fingerprint);
+		}
+		fingerprintCache.removeUnused();
+		reportResult(_T("installed.fingerprints.warm"), pluginCount, timer.elapsedMilliseconds());
+
+		if (fingerprintCache.getMissCount())
+			_tprintf(_T("%Iu fingerprints missed the cache\n"), fingerprintCache.getMissCount());
+	}
+
+	for (vector<tstring>::iterator it = dllFilenames.begin(); it != dllFilenames.end(); ++it)
+		::DeleteFile(it->c_str());
+
+	::DeleteFile(cacheFilename.c_str());
+	::RemoveDirectory(dllDir.c_str());
+}
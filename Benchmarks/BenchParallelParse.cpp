@@ -0,0 +1,71 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "CatalogGenerator.h"
+#include "PluginList.h"
+
+using namespace std;
+
+
+/* Parses the same catalog with the streaming parse, then with the parallel parse
+ * on 1 thread up to one thread per processor, to show how the parse scales */
+void benchParallelParse(const tstring& workDir, int pluginCount)
+{
+	tstring xmlFilename(workDir);
+	xmlFilename.append(_T("\\PluginManagerPlugins.xml"));
+
+	if (!generateCatalog(xmlFilename.c_str(), pluginCount))
+	{
+		_tprintf(_T("Unable to write %s\n"), xmlFilename.c_str());
+		return;
+	}
+
+	SYSTEM_INFO systemInfo;
+	::GetSystemInfo(&systemInfo);
+	int maxThreads = static_cast<int>(systemInfo.dwNumberOfProcessors);
+
+	// Benchmarks.cpp sets ParseThreads to 1, so this is the streaming parse
+	{
+		PluginList pluginList;
+		BenchmarkTimer timer;
+		pluginList.parsePluginFile(xmlFilename.c_str());
+		reportResult(_T("catalog.parse.streaming"), pluginCount, timer.elapsedMilliseconds());
+	}
+
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		PluginList pluginList;
+		BenchmarkTimer timer;
+		BOOL parsed = pluginList.parsePluginFileParallel(xmlFilename.c_str(), threads);
+		double milliseconds = timer.elapsedMilliseconds();
+
+		TCHAR name[40];
+		_stprintf_s(name, 40, _T("catalog.parse.threads.%d"), threads);
+
+		if (parsed)
+			reportResult(name, pluginCount, milliseconds);
+		else
+			_tprintf(_T("Parallel parse failed on %d threads for %d plugins\n"), threads, pluginCount);
+	}
+
+	::DeleteFile(xmlFilename.c_str());
+}
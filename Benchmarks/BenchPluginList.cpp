@@ -0,0 +1,136 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "CatalogGenerator.h"
+#include "PluginList.h"
+
+using namespace std;
+
+
+/* Makes the installed plugins for the benchmark - every 10th plugin in the list is installed,
+ * cycling through the ways an installed dll is matched to the list */
+static void makeInstalledPlugins(int pluginCount, list<InstalledPluginFile>& installedPlugins)
+{
+	for (int index = 0; index < pluginCount; index += 10)
+	{
+		InstalledPluginFile pluginFile;
+
+		TCHAR filename[40];
+		_stprintf_s(filename, 40, _T("GeneratedPlugin%d.dll"), index);
+		pluginFile.filename = filename;
+		pluginFile.name = generatedPluginName(index);
+		pluginFile.version = PluginVersion(1, 0, 0, 0);
+		pluginFile.hasVersion = TRUE;
+
+		switch ((index / 10) % 5)
+		{
+			case 0:
+				// Known name, and a known version
+				pluginFile.hash = generatedVersionHash(index, 3);
+				break;
+
+			case 1:
+				// Known name, with the version that is marked bad in some plugins
+				pluginFile.hash = generatedVersionHash(index, 1);
+				break;
+
+			case 2:
+				// Known name, but a build that isn't in the list
+				pluginFile.hash = generatedVersionHash(index, 99);
+				break;
+
+			case 3:
+				// Old name - only known if the plugin has an alias
+				pluginFile.name = generatedAliasName(index);
+				pluginFile.hash = generatedVersionHash(index, 99);
+				break;
+
+			case 4:
+				// Not in the list at all
+				_stprintf_s(filename, 40, _T("Unlisted Plugin %d"), index);
+				pluginFile.name = filename;
+				pluginFile.hash = generatedVersionHash(index, 99);
+				break;
+		}
+
+		installedPlugins.push_back(pluginFile);
+	}
+}
+
+
+/* Times each stage of getting the plugin list ready to show - parsing the list, matching the
+ * installed plugins, building the available list, then resolving the dependencies of a
+ * selection of the available plugins */
+void benchPluginList(const tstring& workDir, int pluginCount, const CatalogShape& shape)
+{
+	tstring xmlFilename(workDir);
+	xmlFilename.append(_T("\\PluginManagerPlugins.xml"));
+
+	if (!generateCatalog(xmlFilename.c_str(), pluginCount, shape))
+	{
+		_tprintf(_T("Unable to write %s\n"), xmlFilename.c_str());
+		return;
+	}
+
+	list<InstalledPluginFile> installedPlugins;
+	makeInstalledPlugins(pluginCount, installedPlugins);
+
+	{
+		PluginList pluginList;
+
+		BenchmarkTimer timer;
+		BOOL parsed = pluginList.parsePluginFile(xmlFilename.c_str());
+		reportResult(_T("pluginlist.parse"), pluginCount, timer.elapsedMilliseconds());
+
+		if (parsed)
+		{
+			timer.start();
+			for (list<InstalledPluginFile>::iterator it = installedPlugins.begin(); it != installedPlugins.end(); ++it)
+				pluginList.classifyInstalledPlugin(*it, TRUE);
+			reportResult(_T("pluginlist.classifyinstalled"), pluginCount, timer.elapsedMilliseconds());
+
+			timer.start();
+			pluginList.addAvailablePlugins();
+			reportResult(_T("pluginlist.addavailable"), pluginCount, timer.elapsedMilliseconds());
+
+			// Select every 100th available plugin, as if the user had ticked them
+			std::shared_ptr< list<Plugin*> > selectedPlugins(new list<Plugin*>);
+			PluginListContainer& availablePlugins = pluginList.getAvailablePlugins();
+			int position = 0;
+			for (PluginListContainer::iterator it = availablePlugins.begin(); it != availablePlugins.end(); ++it, ++position)
+			{
+				if (position % 100 == 0)
+					selectedPlugins->push_back(*it);
+			}
+
+			timer.start();
+			std::shared_ptr< list<tstring> > dependencies = pluginList.calculateDependencies(selectedPlugins);
+			reportResult(_T("pluginlist.dependencies"), pluginCount, timer.elapsedMilliseconds());
+		}
+		else
+		{
+			_tprintf(_T("Unable to parse %s\n"), xmlFilename.c_str());
+		}
+	}
+
+	::DeleteFile(xmlFilename.c_str());
+}
@@ -0,0 +1,128 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/DownloadPrefetcher.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "../Tests/TestServer.h"
+
+#include <vector>
+
+using namespace std;
+
+#define BENCH_PREFETCH_LATENCY		100		// ms the stand-in server waits before each response
+#define BENCH_PREFETCH_FILESIZE		65536
+#define BENCH_PREFETCH_STEPTIME		10		// ms of copying / unzipping after each download
+
+
+/* Downloads each file when its step gets to it, as the install did before the prefetcher */
+static void timeSequential(const TCHAR* name, const vector<tstring>& urls, const tstring& downloadDir)
+{
+	CancelToken cancelToken;
+	ModuleInfo moduleInfo(NULL, NULL);
+
+	BenchmarkTimer timer;
+	for (vector<tstring>::const_iterator it = urls.begin(); it != urls.end(); ++it)
+	{
+		TCHAR downloadFilename[MAX_PATH];
+		::GetTempFileName(downloadDir.c_str(), _T("seq"), 0, downloadFilename);
+		tstring filename(downloadFilename);
+		tstring contentType;
+
+		DownloadManager downloadManager(cancelToken);
+		downloadManager.getUrl(it->c_str(), filename, contentType, &moduleInfo);
+		::Sleep(BENCH_PREFETCH_STEPTIME);
+		::DeleteFile(downloadFilename);
+	}
+
+	reportResult(name, static_cast<int>(urls.size()), timer.elapsedMilliseconds());
+}
+
+/* Queues every file up front, then takes them in step order */
+static void timePrefetched(const TCHAR* name, const vector<tstring>& urls, const tstring& downloadDir, int threadCount)
+{
+	CancelToken cancelToken;
+	ModuleInfo moduleInfo(NULL, NULL);
+
+	BenchmarkTimer timer;
+	DownloadPrefetcher prefetcher(downloadDir, threadCount, &moduleInfo, cancelToken);
+	for (vector<tstring>::const_iterator it = urls.begin(); it != urls.end(); ++it)
+		prefetcher.add(MirrorList(*it), tstring());
+	prefetcher.start();
+
+	for (vector<tstring>::const_iterator it = urls.begin(); it != urls.end(); ++it)
+	{
+		tstring filename, contentType;
+		if (prefetcher.take(*it, filename, contentType))
+		{
+			::Sleep(BENCH_PREFETCH_STEPTIME);
+			::DeleteFile(filename.c_str());
+		}
+	}
+
+	reportResult(name, static_cast<int>(urls.size()), timer.elapsedMilliseconds());
+}
+
+/* Times downloading the files of an install of fileCount plugins from a local stand-in server
+ * with BENCH_PREFETCH_LATENCY ms of latency on every request - downloading each as its step
+ * comes up, and prefetching them with 1 and 4 download threads.  Each run uses its own paths,
+ * so none are answered from the WinINet cache. */
+void benchPrefetch(const tstring& workDir, int fileCount)
+{
+	TestServer server;
+	if (!server.start())
+	{
+		_tprintf(_T("prefetch: unable to start the stand-in server\n"));
+		return;
+	}
+	server.setResponseDelay(BENCH_PREFETCH_LATENCY);
+
+	string content(BENCH_PREFETCH_FILESIZE, 'x');
+
+	const TCHAR* runNames[] = { _T("sequential"), _T("prefetch1"), _T("prefetch4") };
+	vector<tstring> runUrls[3];
+	for (int run = 0; run < 3; ++run)
+	{
+		for (int index = 0; index < fileCount; ++index)
+		{
+			char path[60];
+			sprintf_s(path, 60, "/%S/plugin%d.zip", runNames[run], index);
+			server.addFile(path, content);
+
+			TCHAR urlPath[60];
+			_stprintf_s(urlPath, 60, _T("/%s/plugin%d.zip"), runNames[run], index);
+			runUrls[run].push_back(server.getBaseUrl() + urlPath);
+		}
+	}
+
+	tstring downloadDir(workDir);
+	downloadDir.append(_T("\\prefetch"));
+	::CreateDirectory(downloadDir.c_str(), NULL);
+
+	timeSequential(_T("prefetch.sequential"), runUrls[0], downloadDir);
+	timePrefetched(_T("prefetch.threads.1"), runUrls[1], downloadDir, 1);
+	timePrefetched(_T("prefetch.threads.4"), runUrls[2], downloadDir, 4);
+
+	::RemoveDirectory(downloadDir.c_str());
+	server.stop();
+}
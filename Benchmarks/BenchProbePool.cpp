@@ -0,0 +1,111 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/ProbePool.h"
+
+#include <vector>
+
+using namespace std;
+
+#define BENCH_PROBE_WORKERS		4
+#define BENCH_PROBE_TIMEOUT		5000
+#define BENCH_PROBE_BATCH		8
+
+
+/* Stands in for loading a plugin that takes a millisecond in its DllMain */
+class SleepingPluginLoader : public PluginLoader
+{
+public:
+	ProbeResult probe(const tstring& /*filename*/)
+	{
+		::Sleep(1);
+
+		ProbeResult result;
+		result.status = PROBE_PLUGIN;
+		result.isUnicode = TRUE;
+		result.name = _T("Generated Plugin");
+		return result;
+	}
+};
+
+static void timeProbe(const TCHAR* name, int pluginCount, ProbeWorkerFactory& workerFactory, size_t workerCount, const vector<tstring>& filenames)
+{
+	ProbePool probePool(workerFactory, workerCount, BENCH_PROBE_TIMEOUT, BENCH_PROBE_BATCH);
+	vector<ProbeResult> results;
+
+	BenchmarkTimer timer;
+	BOOL probed = probePool.probe(filenames, results);
+	double milliseconds = timer.elapsedMilliseconds();
+
+	if (probed)
+		reportResult(name, pluginCount, milliseconds);
+	else
+		_tprintf(_T("%s: no probe workers could be started\n"), name);
+}
+
+/* Times probing one dll for every 10 plugins in the list, on one worker and across a pool.
+ * The in-process runs show how the pool spreads slow plugins across workers.  If gpupprobe.exe
+ * is next to the benchmark, it also probes empty dlls through gpupprobe.exe processes,
+ * which is the cost of starting the hosts and of the protocol. */
+void benchProbePool(const tstring& workDir, int pluginCount)
+{
+	tstring dllDir(workDir);
+	dllDir.append(_T("\\probe"));
+	::CreateDirectory(dllDir.c_str(), NULL);
+
+	vector<tstring> dllFilenames;
+	for (int index = 0; index < pluginCount; index += 10)
+	{
+		TCHAR filename[60];
+		_stprintf_s(filename, 60, _T("\\GeneratedPlugin%d.dll"), index);
+		tstring dllFilename(dllDir);
+		dllFilename.append(filename);
+
+		HANDLE hFile = ::CreateFile(dllFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (INVALID_HANDLE_VALUE != hFile)
+		{
+			::CloseHandle(hFile);
+			dllFilenames.push_back(dllFilename);
+		}
+	}
+
+	SleepingPluginLoader loader;
+	InProcessProbeWorkerFactory inProcessFactory(loader);
+	timeProbe(_T("probe.inprocess.1"), pluginCount, inProcessFactory, 1, dllFilenames);
+	timeProbe(_T("probe.inprocess.pool"), pluginCount, inProcessFactory, BENCH_PROBE_WORKERS, dllFilenames);
+
+	TCHAR probeExe[MAX_PATH];
+	::GetModuleFileName(NULL, probeExe, MAX_PATH);
+	::PathRemoveFileSpec(probeExe);
+	::PathAppend(probeExe, _T("gpupprobe.exe"));
+	if (::PathFileExists(probeExe))
+	{
+		ProcessProbeWorkerFactory processFactory(probeExe);
+		timeProbe(_T("probe.process.1"), pluginCount, processFactory, 1, dllFilenames);
+		timeProbe(_T("probe.process.pool"), pluginCount, processFactory, BENCH_PROBE_WORKERS, dllFilenames);
+	}
+
+	for (vector<tstring>::iterator it = dllFilenames.begin(); it != dllFilenames.end(); ++it)
+		::DeleteFile(it->c_str());
+
+	::RemoveDirectory(dllDir.c_str());
+}
@@ -0,0 +1,60 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "CatalogGenerator.h"
+#include "PluginList.h"
+#include "StringPool.h"
+
+using namespace std;
+
+
+/* Reports the memory used by the plugin metadata strings, as it would be with a
+ * copy in each plugin, and as it is with the string pool */
+void benchStringPool(const tstring& workDir, int pluginCount)
+{
+	tstring xmlFilename(workDir);
+	xmlFilename.append(_T("\\PluginManagerPlugins.xml"));
+
+	if (!generateCatalog(xmlFilename.c_str(), pluginCount))
+	{
+		_tprintf(_T("Unable to write %s\n"), xmlFilename.c_str());
+		return;
+	}
+
+	{
+		PluginList pluginList;
+		if (pluginList.parsePluginFile(xmlFilename.c_str()))
+		{
+			StringPool& stringPool = pluginList.getStringPool();
+			reportMemory(_T("catalog.strings.unpooled"), pluginCount, stringPool.getUnpooledBytes());
+			reportMemory(_T("catalog.strings.pooled"), pluginCount, stringPool.getPooledBytes());
+			_tprintf(_T("%-32s %8d %12Iu strings from %Iu\n"), _T("catalog.strings.count"), pluginCount,
+				stringPool.getStringCount(), stringPool.getInternCount());
+		}
+		else
+		{
+			_tprintf(_T("Unable to parse %s\n"), xmlFilename.c_str());
+		}
+	}
+
+	::DeleteFile(xmlFilename.c_str());
+}
@@ -0,0 +1,74 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/WinInetTransport.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "../Tests/TestServer.h"
+
+using namespace std;
+
+
+/* Fetches the validation-sized file requestCount times, each with a DownloadManager of its own */
+static void timeRequests(const TCHAR* name, const tstring& url, int requestCount)
+{
+	CancelToken cancelToken;
+	ModuleInfo moduleInfo(NULL, NULL);
+
+	BenchmarkTimer timer;
+	for (int index = 0; index < requestCount; ++index)
+	{
+		DownloadManager downloadManager(cancelToken);
+		downloadManager.disableCache();
+		string result;
+		downloadManager.getUrl(url.c_str(), result, &moduleInfo);
+	}
+
+	reportResult(name, requestCount, timer.elapsedMilliseconds());
+}
+
+/* Times requestCount small requests (like the validation of each file of an install) to a
+ * local stand-in server that keeps connections alive - with a WinINet session for each
+ * request, as before, and with one shared WinInetTransport.  Over plain HTTP on loopback
+ * this is mostly the cost of the sessions and connections; a TLS handshake adds to each. */
+void benchTransport(int requestCount)
+{
+	TestServer server;
+	server.setKeepAlive(TRUE);
+	if (!server.start())
+	{
+		_tprintf(_T("transport: unable to start the stand-in server\n"));
+		return;
+	}
+
+	server.addFile("/validate.php", "ok");
+	tstring url(server.getBaseUrl() + _T("/validate.php"));
+
+	timeRequests(_T("transport.session_per_request"), url, requestCount);
+
+	DownloadManager::setTransport(std::shared_ptr<HttpTransport>(new WinInetTransport(_T("Benchmarks"))));
+	timeRequests(_T("transport.shared"), url, requestCount);
+	DownloadManager::setTransport(std::shared_ptr<HttpTransport>());
+
+	server.stop();
+}
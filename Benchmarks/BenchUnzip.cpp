@@ -0,0 +1,222 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "libinstall/Decompress.h"
+
+#include "zlib.h"
+
+#include <vector>
+
+using namespace std;
+
+// Each file is about the size of a help page or a language file
+#define BENCH_UNZIP_FILE_SIZE	(48 * 1024)
+#define BENCH_UNZIP_DIRECTORIES	8
+
+
+static void appendWord(string& zip, WORD value)
+{
+	zip.push_back(static_cast<char>(value & 0xFF));
+	zip.push_back(static_cast<char>(value >> 8));
+}
+
+static void appendDword(string& zip, DWORD value)
+{
+	appendWord(zip, static_cast<WORD>(value & 0xFFFF));
+	appendWord(zip, static_cast<WORD>(value >> 16));
+}
+
+/* Text that compresses about as well as the resources in a plugin zip */
+static string makeContents(int fileIndex)
+{
+	static const char* words[] = { "plugin ", "notepad ", "manager ", "install ", "the ", "of ", "version ", "file\r\n" };
+
+	string contents;
+	DWORD seed = static_cast<DWORD>(fileIndex) * 2654435761u + 1;
+	while (contents.size() < BENCH_UNZIP_FILE_SIZE)
+	{
+		seed = seed * 1103515245 + 12345;
+		contents.append(words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))]);
+	}
+	return contents;
+}
+
+/* Adds an entry, deflated unless it's a directory, and its record to centralDirectory */
+static void addEntry(string& zip, string& centralDirectory, const string& name, const string& contents)
+{
+	string data;
+	WORD method = 0;
+	if (!contents.empty())
+	{
+		// Zip entries are raw deflate data, with no zlib header
+		z_stream deflater;
+		memset(&deflater, 0, sizeof(deflater));
+		deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+		data.resize(deflateBound(&deflater, static_cast<uLong>(contents.size())));
+		deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(contents.c_str()));
+		deflater.avail_in = static_cast<uInt>(contents.size());
+		deflater.next_out = reinterpret_cast<Bytef*>(&data[0]);
+		deflater.avail_out = static_cast<uInt>(data.size());
+		deflate(&deflater, Z_FINISH);
+		data.resize(deflater.total_out);
+		deflateEnd(&deflater);
+		method = Z_DEFLATED;
+	}
+
+	DWORD offset = static_cast<DWORD>(zip.size());
+	DWORD crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(contents.c_str()), static_cast<uInt>(contents.size()));
+
+	appendDword(zip, 0x04034b50);
+	appendWord(zip, 20);
+	appendWord(zip, 0);
+	appendWord(zip, method);
+	appendDword(zip, 0);
+	appendDword(zip, crc);
+	appendDword(zip, static_cast<DWORD>(data.size()));
+	appendDword(zip, static_cast<DWORD>(contents.size()));
+	appendWord(zip, static_cast<WORD>(name.size()));
+	appendWord(zip, 0);
+	zip.append(name);
+	zip.append(data);
+
+	appendDword(centralDirectory, 0x02014b50);
+	appendWord(centralDirectory, 20);
+	appendWord(centralDirectory, 20);
+	appendWord(centralDirectory, 0);
+	appendWord(centralDirectory, method);
+	appendDword(centralDirectory, 0);
+	appendDword(centralDirectory, crc);
+	appendDword(centralDirectory, static_cast<DWORD>(data.size()));
+	appendDword(centralDirectory, static_cast<DWORD>(contents.size()));
+	appendWord(centralDirectory, static_cast<WORD>(name.size()));
+	appendWord(centralDirectory, 0);
+	appendWord(centralDirectory, 0);
+	appendWord(centralDirectory, 0);
+	appendWord(centralDirectory, 0);
+	appendDword(centralDirectory, 0);
+	appendDword(centralDirectory, offset);
+	centralDirectory.append(name);
+}
+
+/* Writes a zip of fileCount files, spread over a few directories, like a plugin with
+ * its language packs and help.  Fills filenames with where they extract to in destDir. */
+static BOOL writeZip(const tstring& zipFilename, const tstring& destDir, int fileCount, vector<tstring>& filenames)
+{
+	string zip, centralDirectory;
+	int entryCount = 0;
+
+	for (int directory = 0; directory < BENCH_UNZIP_DIRECTORIES; ++directory)
+	{
+		char name[40];
+		sprintf_s(name, 40, "resources%d/", directory);
+		addEntry(zip, centralDirectory, name, string());
+		++entryCount;
+	}
+
+	for (int index = 0; index < fileCount; ++index)
+	{
+		char name[60];
+		sprintf_s(name, 60, "resources%d/file%d.txt", index % BENCH_UNZIP_DIRECTORIES, index);
+		addEntry(zip, centralDirectory, name, makeContents(index));
+		++entryCount;
+
+		TCHAR filename[60];
+		_stprintf_s(filename, 60, _T("resources%d\\file%d.txt"), index % BENCH_UNZIP_DIRECTORIES, index);
+		filenames.push_back(destDir + filename);
+	}
+
+	DWORD centralDirectoryOffset = static_cast<DWORD>(zip.size());
+	zip.append(centralDirectory);
+
+	appendDword(zip, 0x06054b50);
+	appendWord(zip, 0);
+	appendWord(zip, 0);
+	appendWord(zip, static_cast<WORD>(entryCount));
+	appendWord(zip, static_cast<WORD>(entryCount));
+	appendDword(zip, static_cast<DWORD>(centralDirectory.size()));
+	appendDword(zip, centralDirectoryOffset);
+	appendWord(zip, 0);
+
+	FILE* fp = NULL;
+	if (_tfopen_s(&fp, zipFilename.c_str(), _T("wb")) != 0)
+		return FALSE;
+
+	BOOL written = (fwrite(zip.c_str(), 1, zip.size(), fp) == zip.size());
+	fclose(fp);
+	return written;
+}
+
+static void removeExtracted(const tstring& destDir, const vector<tstring>& filenames)
+{
+	for (vector<tstring>::const_iterator it = filenames.begin(); it != filenames.end(); ++it)
+		::DeleteFile(it->c_str());
+
+	for (int directory = 0; directory < BENCH_UNZIP_DIRECTORIES; ++directory)
+	{
+		TCHAR name[40];
+		_stprintf_s(name, 40, _T("resources%d"), directory);
+		::RemoveDirectory((destDir + name).c_str());
+	}
+}
+
+/* Extracts a zip of fileCount files on 1 thread up to one thread per processor, to show how
+ * the extraction scales.  The files are removed between runs, so each run creates them. */
+void benchUnzip(const tstring& workDir, int fileCount)
+{
+	tstring zipFilename(workDir);
+	zipFilename.append(_T("\\unzip.zip"));
+	tstring destDir(workDir);
+	destDir.append(_T("\\unzip\\"));
+	::CreateDirectory(destDir.c_str(), NULL);
+
+	vector<tstring> filenames;
+	if (!writeZip(zipFilename, destDir, fileCount, filenames))
+	{
+		_tprintf(_T("Unable to write %s\n"), zipFilename.c_str());
+		return;
+	}
+
+	SYSTEM_INFO systemInfo;
+	::GetSystemInfo(&systemInfo);
+	int maxThreads = static_cast<int>(systemInfo.dwNumberOfProcessors);
+
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		BenchmarkTimer timer;
+		BOOL extracted = Decompress::unzip(zipFilename, destDir, threads);
+		double milliseconds = timer.elapsedMilliseconds();
+
+		TCHAR name[40];
+		_stprintf_s(name, 40, _T("unzip.threads.%d"), threads);
+
+		if (extracted)
+			reportResult(name, fileCount, milliseconds);
+		else
+			_tprintf(_T("Unzip failed on %d threads for %d files\n"), threads, fileCount);
+
+		removeExtracted(destDir, filenames);
+	}
+
+	::DeleteFile(zipFilename.c_str());
+	::RemoveDirectory(destDir.c_str());
+}
@@ -0,0 +1,79 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+/* Simple wall clock timer, using the performance counter */
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer()
+	{
+		::QueryPerformanceFrequency(&_frequency);
+		start();
+	}
+
+	void start()
+	{
+		::QueryPerformanceCounter(&_start);
+	}
+
+	double elapsedMilliseconds() const
+	{
+		LARGE_INTEGER now;
+		::QueryPerformanceCounter(&now);
+		return (static_cast<double>(now.QuadPart - _start.QuadPart) * 1000.0) / static_cast<double>(_frequency.QuadPart);
+	}
+
+private:
+	LARGE_INTEGER _frequency;
+	LARGE_INTEGER _start;
+};
+
+
+struct CatalogShape;
+
+/* Prints one result line - name, catalog size (number of plugins) and the time taken */
+void reportResult(const TCHAR* name, int pluginCount, double milliseconds);
+
+/* Prints one memory result line - name, catalog size and the number of bytes */
+void reportMemory(const TCHAR* name, int pluginCount, size_t bytes);
+
+/* Benchmarks - each one runs for a single catalog size, using workDir for any files it needs */
+void benchCatalogCache(const tstring& workDir, int pluginCount);
+void benchParallelParse(const tstring& workDir, int pluginCount);
+void benchStringPool(const tstring& workDir, int pluginCount);
+void benchFingerprintCache(const tstring& workDir, int pluginCount);
+void benchProbePool(const tstring& workDir, int pluginCount);
+void benchPluginList(const tstring& workDir, int pluginCount, const CatalogShape& shape);
+
+/* Runs once, for an install of fileCount plugins rather than a catalog size */
+void benchPrefetch(const tstring& workDir, int fileCount);
+
+/* Runs once, for requestCount requests to the same server */
+void benchTransport(int requestCount);
+
+/* Runs once, writing a file of the given size */
+void benchFileSink(const tstring& workDir, int megabytes);
+
+/* Runs once, extracting a zip of fileCount files */
+void benchUnzip(const tstring& workDir, int fileCount);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* The globals that PluginManager.cpp normally defines, for the parts of the
+ * plugin that are compiled into the benchmarks */
+
+#include "precompiled_headers.h"
+#include "PluginManager.h"
+
+HANDLE				g_hModule			= NULL;
+
+#ifdef _UNICODE
+BOOL				g_isUnicode			= TRUE;
+#else
+BOOL				g_isUnicode			= FALSE;
+#endif
+
+#ifdef _WIN64
+BOOL				g_isX64 = TRUE;
+#else
+BOOL				g_isX64 = FALSE;
+#endif
+
+Options				g_options;
+winVer				g_winVer			= WV_WIN7;
@@ -0,0 +1,215 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/* Benchmarks for the plugin list processing.
+ *
+ * Usage: Benchmarks [options] [pluginCount ...]
+ *   With no plugin counts, runs each benchmark with catalogs of 1000, 10000 and 100000 plugins.
+ *   Results are printed one per line as  name  pluginCount  milliseconds (or bytes)
+ *
+ * Options:
+ *   -json <filename>    Also writes the results to filename as JSON, for comparing releases
+ *   -fanout <n>         Number of dependencies of each plugin (default 2)
+ *   -aliases <n>        Every nth plugin has an alias (default 20)
+ *   -badversions <n>    Every nth plugin has a bad version (default 50)
+ *   -installsize <n>    Number of plugins in the install for the download benchmarks (default 12)
+ *   -writesize <n>      MB written by the file sink benchmark (default 64)
+ *   -zipfiles <n>       Number of files in the zip for the unzip benchmark (default 400)
+ */
+
+#include "precompiled_headers.h"
+#include "Benchmark.h"
+#include "CatalogGenerator.h"
+#include "PluginManager.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+// Requests made for each plugin of an install - its download, and the validation of its files
+#define BENCH_REQUESTS_PER_PLUGIN  5
+
+
+struct BenchmarkResult
+{
+	tstring name;
+	int		pluginCount;
+	double	value;
+	BOOL	isBytes;
+};
+
+/* All the results, for the JSON file */
+static vector<BenchmarkResult> s_results;
+
+
+static void addResult(const TCHAR* name, int pluginCount, double value, BOOL isBytes)
+{
+	BenchmarkResult result;
+	result.name = name;
+	result.pluginCount = pluginCount;
+	result.value = value;
+	result.isBytes = isBytes;
+	s_results.push_back(result);
+}
+
+void reportResult(const TCHAR* name, int pluginCount, double milliseconds)
+{
+	_tprintf(_T("%-32s %8d %12.3f ms\n"), name, pluginCount, milliseconds);
+	addResult(name, pluginCount, milliseconds, FALSE);
+}
+
+void reportMemory(const TCHAR* name, int pluginCount, size_t bytes)
+{
+	_tprintf(_T("%-32s %8d %12Iu bytes\n"), name, pluginCount, bytes);
+	addResult(name, pluginCount, static_cast<double>(bytes), TRUE);
+}
+
+
+/* Writes the results as
+ *   { "results": [ { "name": "...", "plugins": 1000, "value": 12.345, "unit": "ms" }, ... ] }
+ * The names are plain ASCII, so need no escaping */
+static BOOL writeJsonResults(const TCHAR* filename)
+{
+	FILE* file = NULL;
+	if (_tfopen_s(&file, filename, _T("w")) || !file)
+		return FALSE;
+
+	fprintf(file, "{\n  \"results\": [\n");
+	for (size_t index = 0; index < s_results.size(); ++index)
+	{
+		const BenchmarkResult& result = s_results[index];
+		fprintf(file, "    { \"name\": \"%S\", \"plugins\": %d, \"value\": %.3f, \"unit\": \"%s\" }%s\n",
+			result.name.c_str(), result.pluginCount, result.value,
+			result.isBytes ? "bytes" : "ms",
+			(index + 1 < s_results.size()) ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	BOOL success = !ferror(file);
+	fclose(file);
+	return success;
+}
+
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	vector<int> pluginCounts;
+	const TCHAR* jsonFilename = NULL;
+
+	CatalogShape shape;
+	shape.dependencyFanOut = 2;
+	shape.aliasEvery = 20;
+	shape.badVersionEvery = 50;
+
+	int installSize = 12;
+	int writeSize = 64;
+	int zipFiles = 400;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (!_tcscmp(argv[arg], _T("-json")) && arg + 1 < argc)
+		{
+			jsonFilename = argv[++arg];
+		}
+		else if (!_tcscmp(argv[arg], _T("-fanout")) && arg + 1 < argc)
+		{
+			shape.dependencyFanOut = _ttoi(argv[++arg]);
+		}
+		else if (!_tcscmp(argv[arg], _T("-aliases")) && arg + 1 < argc)
+		{
+			shape.aliasEvery = _ttoi(argv[++arg]);
+		}
+		else if (!_tcscmp(argv[arg], _T("-badversions")) && arg + 1 < argc)
+		{
+			shape.badVersionEvery = _ttoi(argv[++arg]);
+		}
+		else if (!_tcscmp(argv[arg], _T("-installsize")) && arg + 1 < argc)
+		{
+			installSize = _ttoi(argv[++arg]);
+		}
+		else if (!_tcscmp(argv[arg], _T("-writesize")) && arg + 1 < argc)
+		{
+			writeSize = _ttoi(argv[++arg]);
+		}
+		else if (!_tcscmp(argv[arg], _T("-zipfiles")) && arg + 1 < argc)
+		{
+			zipFiles = _ttoi(argv[++arg]);
+		}
+		else
+		{
+			int pluginCount = _ttoi(argv[arg]);
+			if (pluginCount > 0)
+				pluginCounts.push_back(pluginCount);
+		}
+	}
+
+	if (pluginCounts.empty())
+	{
+		pluginCounts.push_back(1000);
+		pluginCounts.push_back(10000);
+		pluginCounts.push_back(100000);
+	}
+
+	// Parse sequentially unless a benchmark asks for threads, so the timings are comparable
+	g_options.parseThreads = 1;
+
+	TCHAR tempPath[MAX_PATH];
+	::GetTempPath(MAX_PATH, tempPath);
+	tstring workDir(tempPath);
+	workDir.append(_T("PluginManagerBenchmarks"));
+	::CreateDirectory(workDir.c_str(), NULL);
+
+	for (vector<int>::iterator it = pluginCounts.begin(); it != pluginCounts.end(); ++it)
+	{
+		benchCatalogCache(workDir, *it);
+		benchParallelParse(workDir, *it);
+		benchStringPool(workDir, *it);
+		benchPluginList(workDir, *it, shape);
+		benchFingerprintCache(workDir, *it);
+		benchProbePool(workDir, *it);
+	}
+
+	if (installSize > 0)
+	{
+		benchPrefetch(workDir, installSize);
+		benchTransport(installSize * BENCH_REQUESTS_PER_PLUGIN);
+	}
+
+	if (writeSize > 0)
+	{
+		benchFileSink(workDir, writeSize);
+	}
+
+	if (zipFiles > 0)
+	{
+		benchUnzip(workDir, zipFiles);
+	}
+
+	::RemoveDirectory(workDir.c_str());
+
+	if (jsonFilename && !writeJsonResults(jsonFilename))
+	{
+		_tprintf(_T("Unable to write %s\n"), jsonFilename);
+		return 1;
+	}
+
+	return 0;
+}
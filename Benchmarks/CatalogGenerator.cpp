@@ -0,0 +1,166 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "CatalogGenerator.h"
+
+#include <stdio.h>
+
+using namespace std;
+
+
+tstring generatedPluginName(int index)
+{
+	TCHAR name[40];
+	_stprintf_s(name, 40, _T("Generated Plugin %d"), index);
+	return tstring(name);
+}
+
+tstring generatedAliasName(int index)
+{
+	TCHAR name[40];
+	_stprintf_s(name, 40, _T("Old Generated Plugin %d"), index);
+	return tstring(name);
+}
+
+tstring generatedVersionHash(int index, int version)
+{
+	TCHAR hash[40];
+	_stprintf_s(hash, 40, _T("%08x%08x%08x%08x"), index, version, index ^ 0x5A5A5A5A, version * 7919);
+	return tstring(hash);
+}
+
+
+/* Authors and categories repeat across the catalog, as they do in the real list */
+static void appendPlugin(string& xml, int index, int pluginCount, const CatalogShape& shape)
+{
+	char buffer[1024];
+
+	_snprintf_s(buffer, _TRUNCATE,
+		"  <plugin name=\"Generated Plugin %d\">\n"
+		"    <unicodeVersion>1.%d.%d</unicodeVersion>\n"
+		"    <x64Version>1.%d.%d</x64Version>\n"
+		"    <ansiVersion>1.%d.%d</ansiVersion>\n"
+		"    <description>Generated plugin number %d, for benchmarking the plugin list.\\nIt has a second line.</description>\n"
+		"    <author>Benchmark Author %d</author>\n"
+		"    <homepage>http://example.com/plugins/%d</homepage>\n"
+		"    <sourceUrl>http://example.com/plugins/%d/source</sourceUrl>\n"
+		"    <category>Category %d</category>\n"
+		"    <latestUpdate>Fixed bug number %d</latestUpdate>\n",
+		index,
+		index / 100, index % 100,
+		index / 100, index % 100,
+		index / 100, index % 100,
+		index, index % 250, index, index, index % 20, index);
+	xml.append(buffer);
+
+	xml.append("    <versions>\n");
+	for (int version = 0; version < 4; ++version)
+	{
+		_snprintf_s(buffer, _TRUNCATE,
+			"      <version number=\"1.%d.%d\" md5=\"%08x%08x%08x%08x\" comment=\"\" />\n",
+			index / 100, version, index, version, index ^ 0x5A5A5A5A, version * 7919);
+		xml.append(buffer);
+	}
+	xml.append("    </versions>\n");
+
+	if (shape.badVersionEvery && (index % shape.badVersionEvery) == 0)
+	{
+		_snprintf_s(buffer, _TRUNCATE,
+			"    <badVersions>\n"
+			"      <version number=\"1.%d.1\" report=\"Crashes on startup - please update\" />\n"
+			"    </badVersions>\n",
+			index / 100);
+		xml.append(buffer);
+	}
+
+	if (shape.aliasEvery && (index % shape.aliasEvery) == 0)
+	{
+		_snprintf_s(buffer, _TRUNCATE,
+			"    <aliases>\n"
+			"      <alias name=\"Old Generated Plugin %d\" />\n"
+			"    </aliases>\n",
+			index);
+		xml.append(buffer);
+	}
+
+	// Dependencies are spread across the list, so resolving them chains through many plugins
+	if (shape.dependencyFanOut && pluginCount > 1)
+	{
+		xml.append("    <dependencies>\n");
+		for (int dependency = 0; dependency < shape.dependencyFanOut; ++dependency)
+		{
+			int dependsOn = static_cast<int>((static_cast<unsigned int>(index) * 31 + dependency * 7919 + 1) % pluginCount);
+			if (dependsOn == index)
+				dependsOn = (index + 1) % pluginCount;
+
+			_snprintf_s(buffer, _TRUNCATE, "      <plugin name=\"Generated Plugin %d\" />\n", dependsOn);
+			xml.append(buffer);
+		}
+		xml.append("    </dependencies>\n");
+	}
+
+	_snprintf_s(buffer, _TRUNCATE,
+		"    <install>\n"
+		"      <unicode>\n"
+		"        <download>http://example.com/plugins/%d/GeneratedPlugin%d_unicode.zip</download>\n"
+		"        <copy from=\"GeneratedPlugin%d.dll\" to=\"$PLUGINDIR$\\\" validate=\"true\" />\n"
+		"      </unicode>\n"
+		"      <x64>\n"
+		"        <download>http://example.com/plugins/%d/GeneratedPlugin%d_x64.zip</download>\n"
+		"        <copy from=\"GeneratedPlugin%d.dll\" to=\"$PLUGINDIR$\\\" validate=\"true\" />\n"
+		"      </x64>\n"
+		"    </install>\n"
+		"    <remove>\n"
+		"      <delete file=\"$PLUGINDIR$\\GeneratedPlugin%d.ini\" />\n"
+		"    </remove>\n"
+		"  </plugin>\n",
+		index, index, index, index, index, index, index);
+	xml.append(buffer);
+}
+
+
+BOOL generateCatalog(const TCHAR* filename, int pluginCount)
+{
+	return generateCatalog(filename, pluginCount, CatalogShape());
+}
+
+BOOL generateCatalog(const TCHAR* filename, int pluginCount, const CatalogShape& shape)
+{
+	string xml;
+	xml.reserve(static_cast<size_t>(pluginCount) * 2048);
+
+	xml.append("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n");
+	xml.append("<plugins>\n");
+
+	for (int index = 0; index < pluginCount; ++index)
+		appendPlugin(xml, index, pluginCount, shape);
+
+	xml.append("</plugins>\n");
+
+	FILE* file = NULL;
+	if (_tfopen_s(&file, filename, _T("wb")) || !file)
+		return FALSE;
+
+	size_t written = fwrite(xml.c_str(), 1, xml.size(), file);
+	fclose(file);
+
+	return written == xml.size() ? TRUE : FALSE;
+}
@@ -0,0 +1,45 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _CATALOGGENERATOR_H
+#define _CATALOGGENERATOR_H
+
+/* Optional parts of the generated plugins.  A value of 0 leaves that part out */
+struct CatalogShape
+{
+	int dependencyFanOut;		// number of dependencies each plugin has on other plugins
+	int aliasEvery;				// every Nth plugin has an alias (an old name)
+	int badVersionEvery;		// every Nth plugin has a bad version
+
+	CatalogShape() : dependencyFanOut(0), aliasEvery(0), badVersionEvery(0) {}
+};
+
+/* Writes a synthetic PluginManagerPlugins.xml with pluginCount plugins.
+ * Each plugin has the same shape as a typical entry in the real list - a handful of
+ * known versions, a download and copy install step, and a delete remove step.
+ */
+BOOL generateCatalog(const TCHAR* filename, int pluginCount);
+BOOL generateCatalog(const TCHAR* filename, int pluginCount, const CatalogShape& shape);
+
+/* Names and hashes the generator uses, so the benchmarks can refer to the generated plugins */
+tstring generatedPluginName(int index);
+tstring generatedAliasName(int index);
+tstring generatedVersionHash(int index, int version);
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "libinstall/FileSystem.h"
+
+/* A FileSystem held in memory, for testing the caches without touching the disk */
+class MemoryFileSystem : public FileSystem
+{
+public:
+    MemoryFileSystem() : _writeCount(0) {}
+
+    /* Sets the size and time of a file, without any contents - enough for getFileStat */
+    void setFile(const tstring& filename, UINT64 size, UINT64 lastWriteTime)
+    {
+        MemoryFile& file = _files[filename];
+        file.fileStat.size = size;
+        file.fileStat.lastWriteTime = lastWriteTime;
+    }
+
+    BOOL getFileStat(const tstring& filename, FileStat& fileStat)
+    {
+        std::map<tstring, MemoryFile>::const_iterator it = _files.find(filename);
+        if (it == _files.end())
+            return FALSE;
+
+        fileStat = it->second.fileStat;
+        return TRUE;
+    }
+
+    BOOL readFile(const tstring& filename, std::string& contents)
+    {
+        std::map<tstring, MemoryFile>::const_iterator it = _files.find(filename);
+        if (it == _files.end())
+            return FALSE;
+
+        contents = it->second.contents;
+        return TRUE;
+    }
+
+    BOOL writeFile(const tstring& filename, const std::string& contents)
+    {
+        MemoryFile& file = _files[filename];
+        file.contents = contents;
+        file.fileStat.size = contents.size();
+        file.fileStat.lastWriteTime = ++_writeCount;
+        return TRUE;
+    }
+
+    int getWriteCount() const { return _writeCount; }
+
+private:
+    struct MemoryFile
+    {
+        FileStat    fileStat;
+        std::string contents;
+    };
+
+    std::map<tstring, MemoryFile> _files;
+    int _writeCount;
+};
@@ -0,0 +1,56 @@
+#include "precompiled_headers.h"
+
+#include "TempDirectory.h"
+
+
+TempDirectory::TempDirectory(const TCHAR* prefix)
+{
+    TCHAR tempPath[MAX_PATH];
+    TCHAR tempFilename[MAX_PATH];
+    ::GetTempPath(MAX_PATH, tempPath);
+    ::GetTempFileName(tempPath, prefix, 0, tempFilename);
+
+    // GetTempFileName creates the file, to reserve the name
+    ::DeleteFile(tempFilename);
+    ::CreateDirectory(tempFilename, NULL);
+    _path = tempFilename;
+}
+
+TempDirectory::~TempDirectory()
+{
+    removeTree(_path);
+}
+
+tstring TempDirectory::getFile(const TCHAR* filename) const
+{
+    return _path + _T("\\") + filename;
+}
+
+void TempDirectory::removeTree(const tstring& directory)
+{
+    WIN32_FIND_DATA foundData;
+    HANDLE hFindFile = ::FindFirstFile((directory + _T("\\*")).c_str(), &foundData);
+    if (hFindFile != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            tstring foundName(foundData.cFileName);
+            if (foundName == _T(".") || foundName == _T(".."))
+                continue;
+
+            tstring path(directory + _T("\\") + foundName);
+            if (foundData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                removeTree(path);
+            }
+            else
+            {
+                ::SetFileAttributes(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+                ::DeleteFile(path.c_str());
+            }
+        } while (::FindNextFile(hFindFile, &foundData));
+        ::FindClose(hFindFile);
+    }
+
+    ::RemoveDirectory(directory.c_str());
+}
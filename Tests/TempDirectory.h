@@ -0,0 +1,23 @@
+#pragma once
+
+/* A new, empty directory under the temp directory for a test to work in.  It's removed, with
+ * everything in it, when this is destroyed - so nothing is left behind, even by a test that
+ * fails part way through.
+ */
+class TempDirectory
+{
+public:
+    explicit TempDirectory(const TCHAR* prefix);
+    ~TempDirectory();
+
+    /* The directory, without a trailing backslash */
+    const tstring& getPath() const { return _path; }
+
+    /* The path of filename in the directory */
+    tstring getFile(const TCHAR* filename) const;
+
+    static void removeTree(const tstring& directory);
+
+private:
+    tstring _path;
+};
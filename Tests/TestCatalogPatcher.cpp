@@ -0,0 +1,225 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "tinyxml/tinyxml.h"
+#include "libinstall/CatalogPatcher.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/ModuleInfo.h"
+#include "libinstall/md5.h"
+#include "libinstall/WcharMbcsConverter.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+#include <vector>
+
+
+class CatalogPatcherTest : public ::testing::Test {
+protected:
+    CatalogPatcherTest()
+        : _directory(_T("cpt")),
+          _catalogFilename(_directory.getFile(_T("PluginManagerPlugins.xml"))),
+          _versionFilename(_directory.getFile(_T("PluginManagerPlugins.ver")))
+    {
+    }
+
+    virtual void SetUp()
+    {
+        ASSERT_TRUE(_server.start());
+        _patchBaseUrl = _server.getBaseUrl() + _T("/patches/");
+    }
+
+    virtual void TearDown()
+    {
+        _server.stop();
+    }
+
+    void writeCatalog(const std::string& contents)
+    {
+        FILE* file = _tfopen(_catalogFilename.c_str(), _T("wb"));
+        fwrite(contents.c_str(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    std::string readCatalog()
+    {
+        std::string contents;
+        char buffer[1024];
+        FILE* file = _tfopen(_catalogFilename.c_str(), _T("rb"));
+        size_t bytesRead;
+        while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            contents.append(buffer, bytesRead);
+        fclose(file);
+        return contents;
+    }
+
+    tstring catalogHash()
+    {
+        TCHAR hashBuffer[(MD5LEN * 2) + 1];
+        MD5::hash(_catalogFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1);
+        return tstring(hashBuffer);
+    }
+
+    BOOL update(const tstring& serverHash)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        CatalogPatcher patcher(downloadManager, &moduleInfo);
+        return patcher.update(_catalogFilename.c_str(), _versionFilename.c_str(), catalogHash(), _patchBaseUrl, serverHash);
+    }
+
+    // The MD5 of the list once the patches are applied, from the steps of update()
+    std::string resultHash(const std::vector<std::string>& patches)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        ModuleInfo moduleInfo(NULL, NULL);
+        CatalogPatcher patcher(downloadManager, &moduleInfo);
+
+        tstring patchedFilename(_directory.getFile(_T("patched.xml")));
+
+        TCHAR hashBuffer[(MD5LEN * 2) + 1] = { 0 };
+        tstring version(catalogHash());
+        if (patcher.load(_catalogFilename.c_str()))
+        {
+            for (std::vector<std::string>::const_iterator patch = patches.begin(); patch != patches.end(); ++patch)
+                patcher.apply(*patch, version);
+
+            if (patcher.save(patchedFilename.c_str()))
+                MD5::hash(patchedFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1);
+        }
+
+        ::DeleteFile(patchedFilename.c_str());
+        std::shared_ptr<char> hash = WcharMbcsConverter::tchar2char(hashBuffer);
+        return std::string(hash.get());
+    }
+
+    TestServer _server;
+    tstring    _patchBaseUrl;
+    TempDirectory _directory;
+    tstring    _catalogFilename;
+    tstring    _versionFilename;
+};
+
+static const char* CATALOG =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\r\n"
+    "<plugins>\r\n"
+    "  <plugin name=\"First\"><version>1.0</version></plugin>\r\n"
+    "  <plugin name=\"Second\"><version>1.0</version></plugin>\r\n"
+    "  <pluginNames><name md5=\"abc\" name=\"First\" /></pluginNames>\r\n"
+    "</plugins>\r\n";
+
+
+TEST_F(CatalogPatcherTest, test_applies_chain_of_patches)
+{
+    writeCatalog(CATALOG);
+    std::shared_ptr<char> originalHash = WcharMbcsConverter::tchar2char(catalogHash().c_str());
+
+    std::vector<std::string> patches;
+    patches.push_back(std::string("<patch from=\"") + originalHash.get() + "\" to=\"11111111111111111111111111111111\">"
+        "<plugin name=\"Second\"><version>2.0</version></plugin>"
+        "<plugin name=\"Third\"><version>1.0</version></plugin>"
+        "</patch>");
+    std::string secondPatchContent("<remove name=\"First\" />"
+        "<pluginNames><name md5=\"def\" name=\"Third\" /></pluginNames>"
+        "</patch>");
+    patches.push_back("\xEF\xBB\xBF<patch from=\"11111111111111111111111111111111\" to=\"22222222222222222222222222222222\">" + secondPatchContent);
+
+    // Only the last patch needs a result
+    _server.addFile(std::string("/patches/") + originalHash.get() + ".xml", patches[0]);
+    _server.addFile("/patches/11111111111111111111111111111111.xml",
+        "\xEF\xBB\xBF<patch from=\"11111111111111111111111111111111\" to=\"22222222222222222222222222222222\" result=\""
+        + resultHash(patches) + "\">" + secondPatchContent);
+
+    EXPECT_TRUE(update(_T("22222222222222222222222222222222")));
+
+    TiXmlDocument document;
+    ASSERT_TRUE(document.LoadFile(_catalogFilename.c_str()));
+
+    TiXmlElement* child = document.RootElement()->FirstChildElement();
+    ASSERT_TRUE(child != NULL);
+    EXPECT_STREQ(_T("Second"), child->Attribute(_T("name")));
+    EXPECT_STREQ(_T("2.0"), child->FirstChildElement(_T("version"))->FirstChild()->Value());
+
+    child = child->NextSiblingElement();
+    ASSERT_TRUE(child != NULL);
+    EXPECT_STREQ(_T("pluginNames"), child->Value());
+    EXPECT_STREQ(_T("def"), child->FirstChildElement()->Attribute(_T("md5")));
+
+    child = child->NextSiblingElement();
+    ASSERT_TRUE(child != NULL);
+    EXPECT_STREQ(_T("Third"), child->Attribute(_T("name")));
+    EXPECT_TRUE(child->NextSiblingElement() == NULL);
+
+    // The patched list is now known as the server version
+    EXPECT_EQ(tstring(_T("22222222222222222222222222222222")),
+              CatalogPatcher::getCatalogVersion(_versionFilename.c_str(), catalogHash()));
+}
+
+TEST_F(CatalogPatcherTest, test_wrong_result_leaves_list_unchanged)
+{
+    writeCatalog(CATALOG);
+    std::shared_ptr<char> originalHash = WcharMbcsConverter::tchar2char(catalogHash().c_str());
+
+    _server.addFile(std::string("/patches/") + originalHash.get() + ".xml",
+        std::string("<patch from=\"") + originalHash.get() + "\" to=\"22222222222222222222222222222222\""
+        " result=\"55555555555555555555555555555555\">"
+        "<remove name=\"First\" />"
+        "</patch>");
+
+    // The local list isn't what the server patched, so the full list has to be downloaded
+    EXPECT_FALSE(update(_T("22222222222222222222222222222222")));
+    EXPECT_EQ(std::string(CATALOG), readCatalog());
+    EXPECT_EQ(catalogHash(), CatalogPatcher::getCatalogVersion(_versionFilename.c_str(), catalogHash()));
+}
+
+TEST_F(CatalogPatcherTest, test_missing_patch_leaves_list_unchanged)
+{
+    writeCatalog(CATALOG);
+    std::shared_ptr<char> originalHash = WcharMbcsConverter::tchar2char(catalogHash().c_str());
+
+    _server.addFile(std::string("/patches/") + originalHash.get() + ".xml",
+        std::string("<patch from=\"") + originalHash.get() + "\" to=\"11111111111111111111111111111111\">"
+        "<remove name=\"First\" />"
+        "</patch>");
+
+    // No patch from 1111..., so the full list has to be downloaded
+    EXPECT_FALSE(update(_T("22222222222222222222222222222222")));
+    EXPECT_EQ(std::string(CATALOG), readCatalog());
+    EXPECT_EQ(1, _server.getRequestCount("/patches/11111111111111111111111111111111.xml"));
+}
+
+TEST_F(CatalogPatcherTest, test_patch_from_another_version_is_rejected)
+{
+    writeCatalog(CATALOG);
+    std::shared_ptr<char> originalHash = WcharMbcsConverter::tchar2char(catalogHash().c_str());
+
+    _server.addFile(std::string("/patches/") + originalHash.get() + ".xml",
+        "<patch from=\"33333333333333333333333333333333\" to=\"22222222222222222222222222222222\">"
+        "<remove name=\"First\" />"
+        "</patch>");
+
+    EXPECT_FALSE(update(_T("22222222222222222222222222222222")));
+    EXPECT_EQ(std::string(CATALOG), readCatalog());
+}
+
+TEST_F(CatalogPatcherTest, test_current_list_is_not_patched)
+{
+    writeCatalog(CATALOG);
+    CatalogPatcher::setCatalogVersion(_versionFilename.c_str(), _T("22222222222222222222222222222222"), catalogHash());
+
+    EXPECT_TRUE(update(_T("22222222222222222222222222222222")));
+    EXPECT_EQ(std::string(CATALOG), readCatalog());
+    EXPECT_EQ(0, _server.getRequestCount("/patches/22222222222222222222222222222222.xml"));
+}
+
+TEST_F(CatalogPatcherTest, test_version_is_ignored_when_list_is_replaced)
+{
+    writeCatalog(CATALOG);
+    CatalogPatcher::setCatalogVersion(_versionFilename.c_str(), _T("22222222222222222222222222222222"), _T("44444444444444444444444444444444"));
+
+    EXPECT_EQ(catalogHash(), CatalogPatcher::getCatalogVersion(_versionFilename.c_str(), catalogHash()));
+}
@@ -0,0 +1,200 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/Decompress.h"
+#include "TempDirectory.h"
+
+// Enough files, and enough in them, that the zip is extracted on more than one thread
+#define TEST_FILE_COUNT  12
+#define TEST_FILE_SIZE   (64 * 1024)
+
+
+class DecompressTest : public ::testing::Test {
+protected:
+    DecompressTest()
+        : _directory(_T("dct")),
+          _destDir(_directory.getPath() + _T("\\")),
+          _zipFilename(_directory.getFile(_T("test.zip")))
+    {
+    }
+
+    static tstring fileName(int index)
+    {
+        TCHAR name[40];
+        _stprintf_s(name, 40, _T("sub\\deeper\\file%d.bin"), index);
+        return tstring(name);
+    }
+
+    // A different pattern in each file
+    static std::string fileContents(int index)
+    {
+        std::string contents;
+        for (int position = 0; position < TEST_FILE_SIZE; ++position)
+            contents.push_back(static_cast<char>((position * (index + 1)) % 253));
+        return contents;
+    }
+
+    static DWORD crc32(const std::string& data)
+    {
+        DWORD crc = 0xFFFFFFFF;
+        for (size_t index = 0; index < data.size(); ++index)
+        {
+            crc ^= static_cast<BYTE>(data[index]);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    static void appendWord(std::string& zip, WORD value)
+    {
+        zip.push_back(static_cast<char>(value & 0xFF));
+        zip.push_back(static_cast<char>(value >> 8));
+    }
+
+    static void appendDword(std::string& zip, DWORD value)
+    {
+        appendWord(zip, static_cast<WORD>(value & 0xFFFF));
+        appendWord(zip, static_cast<WORD>(value >> 16));
+    }
+
+    // Adds a stored entry, and its central directory record to centralDirectory
+    static void addEntry(std::string& zip, std::string& centralDirectory, int& entryCount, const std::string& name, const std::string& data)
+    {
+        DWORD offset = static_cast<DWORD>(zip.size());
+        DWORD crc = crc32(data);
+
+        appendDword(zip, 0x04034b50);
+        appendWord(zip, 20);
+        appendWord(zip, 0);
+        appendWord(zip, 0);
+        appendDword(zip, 0);
+        appendDword(zip, crc);
+        appendDword(zip, static_cast<DWORD>(data.size()));
+        appendDword(zip, static_cast<DWORD>(data.size()));
+        appendWord(zip, static_cast<WORD>(name.size()));
+        appendWord(zip, 0);
+        zip.append(name);
+        zip.append(data);
+
+        appendDword(centralDirectory, 0x02014b50);
+        appendWord(centralDirectory, 20);
+        appendWord(centralDirectory, 20);
+        appendWord(centralDirectory, 0);
+        appendWord(centralDirectory, 0);
+        appendDword(centralDirectory, 0);
+        appendDword(centralDirectory, crc);
+        appendDword(centralDirectory, static_cast<DWORD>(data.size()));
+        appendDword(centralDirectory, static_cast<DWORD>(data.size()));
+        appendWord(centralDirectory, static_cast<WORD>(name.size()));
+        appendWord(centralDirectory, 0);
+        appendWord(centralDirectory, 0);
+        appendWord(centralDirectory, 0);
+        appendWord(centralDirectory, 0);
+        appendDword(centralDirectory, 0);
+        appendDword(centralDirectory, offset);
+        centralDirectory.append(name);
+
+        ++entryCount;
+    }
+
+    // The directories are listed before the files in them, as zip tools write them
+    void writeZip()
+    {
+        std::string zip, centralDirectory;
+        int entryCount = 0;
+        addEntry(zip, centralDirectory, entryCount, "top.txt", "hello");
+        addEntry(zip, centralDirectory, entryCount, "empty/", std::string());
+        addEntry(zip, centralDirectory, entryCount, "sub/", std::string());
+        addEntry(zip, centralDirectory, entryCount, "sub/deeper/", std::string());
+        for (int index = 0; index < TEST_FILE_COUNT; ++index)
+        {
+            char name[40];
+            sprintf_s(name, 40, "sub/deeper/file%d.bin", index);
+            addEntry(zip, centralDirectory, entryCount, name, fileContents(index));
+        }
+
+        writeZipFile(zip, centralDirectory, entryCount);
+    }
+
+    void writeZipFile(std::string& zip, const std::string& centralDirectory, int entryCount)
+    {
+        DWORD centralDirectoryOffset = static_cast<DWORD>(zip.size());
+        zip.append(centralDirectory);
+
+        appendDword(zip, 0x06054b50);
+        appendWord(zip, 0);
+        appendWord(zip, 0);
+        appendWord(zip, static_cast<WORD>(entryCount));
+        appendWord(zip, static_cast<WORD>(entryCount));
+        appendDword(zip, static_cast<DWORD>(centralDirectory.size()));
+        appendDword(zip, centralDirectoryOffset);
+        appendWord(zip, 0);
+
+        FILE* file = _tfopen(_zipFilename.c_str(), _T("wb"));
+        fwrite(zip.c_str(), 1, zip.size(), file);
+        fclose(file);
+    }
+
+    std::string readFile(const tstring& filename)
+    {
+        std::string contents;
+        char buffer[16384];
+        FILE* file = _tfopen(filename.c_str(), _T("rb"));
+        if (file)
+        {
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.append(buffer, bytesRead);
+            fclose(file);
+        }
+        return contents;
+    }
+
+    void expectExtracted()
+    {
+        EXPECT_EQ(std::string("hello"), readFile(_destDir + _T("top.txt")));
+        DWORD attributes = ::GetFileAttributes((_destDir + _T("empty")).c_str());
+        EXPECT_TRUE(INVALID_FILE_ATTRIBUTES != attributes && (attributes & FILE_ATTRIBUTE_DIRECTORY));
+        for (int index = 0; index < TEST_FILE_COUNT; ++index)
+            EXPECT_TRUE(fileContents(index) == readFile(_destDir + fileName(index)));
+    }
+
+    TempDirectory _directory;
+    tstring _destDir;
+    tstring _zipFilename;
+};
+
+
+TEST_F(DecompressTest, test_extracts_on_one_thread)
+{
+    writeZip();
+    ASSERT_TRUE(Decompress::unzip(_zipFilename, _destDir, 1));
+    expectExtracted();
+}
+
+TEST_F(DecompressTest, test_extracts_on_many_threads)
+{
+    writeZip();
+    ASSERT_TRUE(Decompress::unzip(_zipFilename, _destDir, 4));
+    expectExtracted();
+}
+
+TEST_F(DecompressTest, test_last_of_duplicate_entries_is_extracted)
+{
+    std::string zip, centralDirectory;
+    int entryCount = 0;
+    addEntry(zip, centralDirectory, entryCount, "dup.txt", "first");
+    addEntry(zip, centralDirectory, entryCount, "top.txt", "hello");
+    addEntry(zip, centralDirectory, entryCount, "DUP.TXT", "second");
+    writeZipFile(zip, centralDirectory, entryCount);
+
+    ASSERT_TRUE(Decompress::unzip(_zipFilename, _destDir, 4));
+    EXPECT_EQ(std::string("second"), readFile(_destDir + _T("dup.txt")));
+    EXPECT_EQ(std::string("hello"), readFile(_destDir + _T("top.txt")));
+}
+
+TEST_F(DecompressTest, test_missing_zip_fails)
+{
+    EXPECT_FALSE(Decompress::unzip(_destDir + _T("missing.zip"), _destDir, 4));
+}
@@ -0,0 +1,97 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/DirectoryWatcher.h"
+#include "TempDirectory.h"
+
+#include <set>
+
+
+class DirectoryWatcherTest : public ::testing::Test {
+protected:
+    DirectoryWatcherTest()
+        : _tempDirectory(_T("dwt")),
+          _directory(_tempDirectory.getPath())
+    {
+    }
+
+    void writeFile(const TCHAR* filename, const char* contents)
+    {
+        FILE* file = _tfopen((_directory + _T("\\") + filename).c_str(), _T("wb"));
+        fwrite(contents, 1, strlen(contents), file);
+        fclose(file);
+    }
+
+    /* Changes arrive asynchronously, so collect them until the expected file turns up */
+    BOOL waitForChange(DirectoryWatcher& watcher, std::set<tstring>& changedFilenames, const TCHAR* expectedFilename)
+    {
+        for (int attempt = 0; attempt < 20 && !changedFilenames.count(expectedFilename); ++attempt)
+        {
+            if (!watcher.getChanges(changedFilenames, 100))
+                return FALSE;
+        }
+        return changedFilenames.count(expectedFilename) > 0;
+    }
+
+    TempDirectory _tempDirectory;
+    tstring _directory;
+};
+
+
+TEST_F(DirectoryWatcherTest, test_no_changes)
+{
+    writeFile(_T("Existing.dll"), "existing");
+
+    Win32DirectoryWatcher watcher;
+    ASSERT_TRUE(watcher.start(_directory));
+
+    std::set<tstring> changedFilenames;
+    EXPECT_TRUE(watcher.getChanges(changedFilenames, 0));
+    EXPECT_TRUE(changedFilenames.empty());
+}
+
+TEST_F(DirectoryWatcherTest, test_added_and_changed_files_are_reported)
+{
+    writeFile(_T("Existing.dll"), "existing");
+
+    Win32DirectoryWatcher watcher;
+    ASSERT_TRUE(watcher.start(_directory));
+
+    writeFile(_T("Added.dll"), "added");
+    writeFile(_T("Existing.dll"), "changed contents");
+
+    std::set<tstring> changedFilenames;
+    EXPECT_TRUE(waitForChange(watcher, changedFilenames, _T("Added.dll")));
+    EXPECT_TRUE(waitForChange(watcher, changedFilenames, _T("Existing.dll")));
+
+    // Once collected, they aren't reported again
+    changedFilenames.clear();
+    EXPECT_TRUE(watcher.getChanges(changedFilenames, 0));
+    EXPECT_TRUE(changedFilenames.empty());
+}
+
+TEST_F(DirectoryWatcherTest, test_removed_and_renamed_files_are_reported)
+{
+    writeFile(_T("Removed.dll"), "removed");
+    writeFile(_T("Old.dll"), "renamed");
+
+    Win32DirectoryWatcher watcher;
+    ASSERT_TRUE(watcher.start(_directory));
+
+    ::DeleteFile((_directory + _T("\\Removed.dll")).c_str());
+    ::MoveFile((_directory + _T("\\Old.dll")).c_str(), (_directory + _T("\\New.dll")).c_str());
+
+    std::set<tstring> changedFilenames;
+    EXPECT_TRUE(waitForChange(watcher, changedFilenames, _T("Removed.dll")));
+    EXPECT_TRUE(waitForChange(watcher, changedFilenames, _T("Old.dll")));
+    EXPECT_TRUE(waitForChange(watcher, changedFilenames, _T("New.dll")));
+}
+
+TEST_F(DirectoryWatcherTest, test_missing_directory_cannot_be_watched)
+{
+    Win32DirectoryWatcher watcher;
+    EXPECT_FALSE(watcher.start(_directory + _T("\\missing")));
+
+    std::set<tstring> changedFilenames;
+    EXPECT_FALSE(watcher.getChanges(changedFilenames, 0));
+}
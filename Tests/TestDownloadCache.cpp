@@ -0,0 +1,175 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/DownloadCache.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "libinstall/md5.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+
+class DownloadCacheTest : public ::testing::Test {
+protected:
+    // The cache creates its own directory, next to the downloaded file
+    DownloadCacheTest()
+        : _tempDirectory(_T("dct")),
+          _directory(_tempDirectory.getFile(_T("cache"))),
+          _downloadFilename(_tempDirectory.getFile(_T("plugin.zip")))
+    {
+    }
+
+    virtual void SetUp()
+    {
+        ASSERT_TRUE(_server.start());
+        _server.addFile("/plugin.zip", "first version of the plugin");
+
+        DownloadManager::setCacheDirectory(_directory, DOWNLOADCACHE_DEFAULT_SIZE);
+    }
+
+    virtual void TearDown()
+    {
+        DownloadManager::setCacheDirectory(tstring(), DOWNLOADCACHE_DEFAULT_SIZE);
+        _server.stop();
+    }
+
+    BOOL download(const TCHAR* path, const tstring& expectedHash = tstring())
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        downloadManager.setExpectedHash(expectedHash);
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        ::DeleteFile(_downloadFilename.c_str());
+        tstring contentType;
+        return downloadManager.getUrl((_server.getBaseUrl() + path).c_str(), _downloadFilename, contentType, &moduleInfo);
+    }
+
+    BOOL downloadFromMirrors(const MirrorList& mirrors)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        ::DeleteFile(_downloadFilename.c_str());
+        tstring contentType;
+        return downloadManager.getUrl(mirrors, _downloadFilename, contentType, &moduleInfo);
+    }
+
+    std::string readFile(const tstring& filename)
+    {
+        std::string contents;
+        char buffer[1024];
+        FILE* file = _tfopen(filename.c_str(), _T("rb"));
+        if (file)
+        {
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.append(buffer, bytesRead);
+            fclose(file);
+        }
+        return contents;
+    }
+
+    void writeFile(const tstring& filename, const std::string& contents)
+    {
+        FILE* file = _tfopen(filename.c_str(), _T("wb"));
+        fwrite(contents.c_str(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    tstring hash(const std::string& contents)
+    {
+        TCHAR hashBuffer[(MD5LEN * 2) + 1];
+        MD5::hash(reinterpret_cast<const unsigned char*>(contents.c_str()), contents.size(), hashBuffer, (MD5LEN * 2) + 1);
+        return tstring(hashBuffer);
+    }
+
+    TempDirectory _tempDirectory;
+    TestServer _server;
+    tstring    _directory;
+    tstring    _downloadFilename;
+};
+
+
+TEST_F(DownloadCacheTest, test_unchanged_file_is_revalidated)
+{
+    ASSERT_TRUE(download(_T("/plugin.zip")));
+    ASSERT_TRUE(download(_T("/plugin.zip")));
+
+    EXPECT_EQ(2, _server.getRequestCount("/plugin.zip"));
+    EXPECT_EQ(1, _server.getNotModifiedCount("/plugin.zip"));
+    EXPECT_EQ(std::string("first version of the plugin"), readFile(_downloadFilename));
+}
+
+TEST_F(DownloadCacheTest, test_changed_file_is_downloaded)
+{
+    ASSERT_TRUE(download(_T("/plugin.zip")));
+
+    // A new ETag, so the cached file is out of date
+    _server.addFile("/plugin.zip", "second version of the plugin");
+    ASSERT_TRUE(download(_T("/plugin.zip")));
+
+    EXPECT_EQ(0, _server.getNotModifiedCount("/plugin.zip"));
+    EXPECT_EQ(std::string("second version of the plugin"), readFile(_downloadFilename));
+}
+
+TEST_F(DownloadCacheTest, test_expected_hash_is_not_downloaded)
+{
+    ASSERT_TRUE(download(_T("/plugin.zip")));
+
+    // The same file from another URL, which the server doesn't have
+    EXPECT_TRUE(download(_T("/mirror/plugin.zip"), hash("first version of the plugin")));
+    EXPECT_EQ(0, _server.getRequestCount("/mirror/plugin.zip"));
+    EXPECT_EQ(std::string("first version of the plugin"), readFile(_downloadFilename));
+}
+
+TEST_F(DownloadCacheTest, test_mirrored_file_is_revalidated)
+{
+    // The first URL is missing, so the file comes from the second, but is cached under the first
+    MirrorList mirrors(_server.getBaseUrl() + _T("/missing/plugin.zip"));
+    mirrors.add(_server.getBaseUrl() + _T("/plugin.zip"));
+    ASSERT_TRUE(downloadFromMirrors(mirrors));
+    ASSERT_TRUE(downloadFromMirrors(mirrors));
+
+    EXPECT_EQ(1, _server.getNotModifiedCount("/plugin.zip"));
+    EXPECT_EQ(std::string("first version of the plugin"), readFile(_downloadFilename));
+
+    DownloadCacheEntry entry;
+    DownloadCache cache(_directory, DOWNLOADCACHE_DEFAULT_SIZE);
+    EXPECT_TRUE(cache.lookup(_server.getBaseUrl() + _T("/missing/plugin.zip"), entry));
+    EXPECT_FALSE(cache.lookup(_server.getBaseUrl() + _T("/plugin.zip"), entry));
+}
+
+TEST_F(DownloadCacheTest, test_least_recently_used_is_trimmed)
+{
+    // Room for two of the three files
+    DownloadCache cache(_directory, 250);
+    std::string contents[3] = { std::string(100, 'a'), std::string(100, 'b'), std::string(100, 'c') };
+    const TCHAR* urls[3] = { _T("http://a/"), _T("http://b/"), _T("http://c/") };
+
+    for (int index = 0; index < 2; ++index)
+    {
+        writeFile(_downloadFilename, contents[index]);
+        DownloadCacheEntry entry;
+        ASSERT_TRUE(cache.add(urls[index], _downloadFilename, entry));
+        ::Sleep(20);
+    }
+
+    // Using the first file makes the second the least recently used
+    ASSERT_TRUE(cache.copyTo(hash(contents[0]), _downloadFilename));
+    ::Sleep(20);
+
+    writeFile(_downloadFilename, contents[2]);
+    DownloadCacheEntry entry;
+    ASSERT_TRUE(cache.add(urls[2], _downloadFilename, entry));
+
+    EXPECT_TRUE(cache.contains(hash(contents[0])));
+    EXPECT_FALSE(cache.contains(hash(contents[1])));
+    EXPECT_TRUE(cache.contains(hash(contents[2])));
+    EXPECT_FALSE(cache.lookup(urls[1], entry));
+}
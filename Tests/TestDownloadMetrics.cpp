@@ -0,0 +1,111 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/DownloadMetrics.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/WinInetTransport.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "TestServer.h"
+
+#include <vector>
+
+
+class CollectingSink : public DownloadMetricsSink
+{
+public:
+    virtual void downloadFinished(const DownloadMetrics& metrics)
+    {
+        downloads.push_back(metrics);
+    }
+
+    std::vector<DownloadMetrics> downloads;
+};
+
+
+class DownloadMetricsTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        _server.setKeepAlive(TRUE);
+        ASSERT_TRUE(_server.start());
+        _server.addFile("/plugins.xml", std::string(10000, 'x'));
+
+        _sink.reset(new CollectingSink);
+        DownloadManager::setMetricsSink(_sink);
+    }
+
+    virtual void TearDown()
+    {
+        DownloadManager::setMetricsSink(std::shared_ptr<DownloadMetricsSink>());
+        DownloadManager::setTransport(std::shared_ptr<HttpTransport>());
+        _server.stop();
+    }
+
+    BOOL download(const TCHAR* path)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        std::string result;
+        return downloadManager.getUrl((_server.getBaseUrl() + path).c_str(), result, &moduleInfo);
+    }
+
+    TestServer _server;
+    std::shared_ptr<CollectingSink> _sink;
+};
+
+
+TEST_F(DownloadMetricsTest, test_download_is_recorded)
+{
+    ASSERT_TRUE(download(_T("/plugins.xml")));
+
+    ASSERT_EQ(1u, _sink->downloads.size());
+    const DownloadMetrics& metrics = _sink->downloads[0];
+    EXPECT_TRUE(metrics.success);
+    EXPECT_FALSE(metrics.fromCache);
+    EXPECT_EQ(200u, metrics.statusCode);
+    EXPECT_EQ(10000u, metrics.bytesReceived);
+    EXPECT_EQ(0, metrics.retries);
+    EXPECT_EQ(0, metrics.proxyAuthRequests);
+
+    EXPECT_GE(metrics.connected, metrics.connecting);
+    EXPECT_GE(metrics.requestSent, 0.0);
+    EXPECT_GE(metrics.firstByte, metrics.requestSent);
+    EXPECT_GE(metrics.finished, metrics.firstByte);
+}
+
+TEST_F(DownloadMetricsTest, test_kept_alive_connection_has_no_connect)
+{
+    DownloadManager::setTransport(std::shared_ptr<HttpTransport>(new WinInetTransport(_T("Tests"))));
+
+    ASSERT_TRUE(download(_T("/plugins.xml")));
+    ASSERT_TRUE(download(_T("/plugins.xml")));
+
+    ASSERT_EQ(2u, _sink->downloads.size());
+    EXPECT_GE(_sink->downloads[0].connecting, 0.0);
+    EXPECT_EQ(-1.0, _sink->downloads[1].connecting);
+    EXPECT_EQ(-1.0, _sink->downloads[1].connected);
+}
+
+TEST_F(DownloadMetricsTest, test_status_is_recorded)
+{
+    download(_T("/missing.xml"));
+
+    ASSERT_EQ(1u, _sink->downloads.size());
+    EXPECT_EQ(404u, _sink->downloads[0].statusCode);
+}
+
+TEST_F(DownloadMetricsTest, test_json_is_escaped)
+{
+    DownloadMetrics metrics;
+    metrics.url = _T("http://example.com/a\"b\\c");
+    metrics.success = TRUE;
+
+    std::string json = DownloadMetricsFile::formatJson(metrics);
+    EXPECT_NE(std::string::npos, json.find("\"url\":\"http://example.com/a\\\"b\\\\c\""));
+    EXPECT_NE(std::string::npos, json.find("\"success\":true"));
+    EXPECT_EQ('}', json[json.size() - 1]);
+}
@@ -0,0 +1,162 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/DownloadPrefetcher.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+
+class DownloadPrefetcherTest : public ::testing::Test {
+protected:
+    // The prefetcher creates the directory itself
+    DownloadPrefetcherTest()
+        : _tempDirectory(_T("dpt")),
+          _moduleInfo(NULL, NULL),
+          _directory(_tempDirectory.getFile(_T("prefetch")))
+    {
+    }
+
+    virtual void SetUp()
+    {
+        ASSERT_TRUE(_server.start());
+        _server.addFile("/first.zip", "first file");
+        _server.addFile("/second.zip", "second file");
+        _server.addFile("/third.zip", "third file");
+    }
+
+    virtual void TearDown()
+    {
+        _server.stop();
+    }
+
+    tstring url(const TCHAR* path)
+    {
+        return _server.getBaseUrl() + path;
+    }
+
+    std::string readAndDelete(const tstring& filename)
+    {
+        std::string contents;
+        char buffer[1024];
+        FILE* file = _tfopen(filename.c_str(), _T("rb"));
+        if (file)
+        {
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.append(buffer, bytesRead);
+            fclose(file);
+        }
+        ::DeleteFile(filename.c_str());
+        return contents;
+    }
+
+    // Every download has to have started before it's taken, or take() hands it back
+    BOOL waitForDownloads(DownloadPrefetcher& prefetcher)
+    {
+        for (int attempt = 0; attempt < 200 && prefetcher.getFinishedCount() < prefetcher.getDownloadCount(); ++attempt)
+            ::Sleep(50);
+        return prefetcher.getFinishedCount() == prefetcher.getDownloadCount();
+    }
+
+    BOOL directoryIsEmpty()
+    {
+        WIN32_FIND_DATA foundData;
+        HANDLE hFindFile = ::FindFirstFile((_directory + _T("\\*.tmp")).c_str(), &foundData);
+        if (hFindFile == INVALID_HANDLE_VALUE)
+            return TRUE;
+        ::FindClose(hFindFile);
+        return FALSE;
+    }
+
+    TempDirectory _tempDirectory;
+    TestServer  _server;
+    ModuleInfo  _moduleInfo;
+    CancelToken _cancelToken;
+    tstring     _directory;
+};
+
+
+TEST_F(DownloadPrefetcherTest, test_takes_downloaded_files)
+{
+    DownloadPrefetcher prefetcher(_directory, 2, &_moduleInfo, _cancelToken);
+    prefetcher.add(MirrorList(url(_T("/first.zip"))), tstring());
+    prefetcher.add(MirrorList(url(_T("/second.zip"))), tstring());
+    prefetcher.add(MirrorList(url(_T("/third.zip"))), tstring());
+    prefetcher.start();
+    ASSERT_TRUE(waitForDownloads(prefetcher));
+
+    tstring filename, contentType;
+    ASSERT_TRUE(prefetcher.take(url(_T("/second.zip")), filename, contentType));
+    EXPECT_EQ(std::string("second file"), readAndDelete(filename));
+
+    filename.clear();
+    ASSERT_TRUE(prefetcher.take(url(_T("/first.zip")), filename, contentType));
+    EXPECT_EQ(std::string("first file"), readAndDelete(filename));
+
+    filename.clear();
+    ASSERT_TRUE(prefetcher.take(url(_T("/third.zip")), filename, contentType));
+    EXPECT_EQ(std::string("third file"), readAndDelete(filename));
+}
+
+TEST_F(DownloadPrefetcherTest, test_unknown_url_is_not_taken)
+{
+    DownloadPrefetcher prefetcher(_directory, 2, &_moduleInfo, _cancelToken);
+    prefetcher.add(MirrorList(url(_T("/first.zip"))), tstring());
+    prefetcher.start();
+
+    tstring filename, contentType;
+    EXPECT_FALSE(prefetcher.take(url(_T("/second.zip")), filename, contentType));
+    EXPECT_TRUE(filename.empty());
+}
+
+TEST_F(DownloadPrefetcherTest, test_duplicate_url_is_downloaded_once)
+{
+    {
+        DownloadPrefetcher prefetcher(_directory, 4, &_moduleInfo, _cancelToken);
+        prefetcher.add(MirrorList(url(_T("/first.zip"))), tstring());
+        prefetcher.add(MirrorList(url(_T("/first.zip"))), tstring());
+        EXPECT_EQ(1, prefetcher.getDownloadCount());
+        prefetcher.start();
+        ASSERT_TRUE(waitForDownloads(prefetcher));
+
+        tstring filename, contentType;
+        ASSERT_TRUE(prefetcher.take(url(_T("/first.zip")), filename, contentType));
+        readAndDelete(filename);
+
+        // The second step using the same file downloads its own copy
+        EXPECT_FALSE(prefetcher.take(url(_T("/first.zip")), filename, contentType));
+    }
+
+    EXPECT_EQ(1, _server.getRequestCount("/first.zip"));
+}
+
+TEST_F(DownloadPrefetcherTest, test_files_not_taken_are_deleted)
+{
+    {
+        DownloadPrefetcher prefetcher(_directory, 2, &_moduleInfo, _cancelToken);
+        prefetcher.add(MirrorList(url(_T("/first.zip"))), tstring());
+        prefetcher.add(MirrorList(url(_T("/second.zip"))), tstring());
+        prefetcher.start();
+        ASSERT_TRUE(waitForDownloads(prefetcher));
+        EXPECT_FALSE(directoryIsEmpty());
+    }
+
+    EXPECT_TRUE(directoryIsEmpty());
+}
+
+TEST_F(DownloadPrefetcherTest, test_downloads_from_mirror)
+{
+    DownloadPrefetcher prefetcher(_directory, 2, &_moduleInfo, _cancelToken);
+    MirrorList mirrors(url(_T("/missing.zip")));
+    mirrors.add(url(_T("/first.zip")));
+    prefetcher.add(mirrors, tstring());
+    prefetcher.start();
+    ASSERT_TRUE(waitForDownloads(prefetcher));
+
+    // Taken by the first URL, though it came from the mirror
+    tstring filename, contentType;
+    ASSERT_TRUE(prefetcher.take(url(_T("/missing.zip")), filename, contentType));
+    EXPECT_EQ(std::string("first file"), readAndDelete(filename));
+}
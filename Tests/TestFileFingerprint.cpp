@@ -0,0 +1,131 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/PeVersionReader.h"
+#include "libinstall/FileFingerprint.h"
+
+#include <vector>
+
+/* The fixtures are minimal PE files, with just the headers and a resource section:
+ *   version_x86.dll   - 32 bit, file version 1.2.3.4
+ *   version_x64.dll   - 64 bit, file version 10.20.30.40, with a named resource type and
+ *                       an RT_ICON before the RT_VERSION
+ *   no_resources.dll  - 32 bit, without a resource directory
+ */
+class FileFingerprintTest : public ::testing::Test {
+protected:
+    tstring fixturePath(const TCHAR* fixtureName)
+    {
+        // The fixtures are next to this source file
+        tstring path(_T(__FILE__));
+        tstring::size_type lastSlash = path.find_last_of(_T("\\/"));
+        path.erase(lastSlash == tstring::npos ? 0 : lastSlash + 1);
+        path.append(_T("fixtures\\"));
+        path.append(fixtureName);
+        return path;
+    }
+
+    std::vector<BYTE> readFixture(const TCHAR* fixtureName)
+    {
+        std::vector<BYTE> contents;
+        FILE* file = _tfopen(fixturePath(fixtureName).c_str(), _T("rb"));
+        if (file)
+        {
+            BYTE buffer[1024];
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.insert(contents.end(), buffer, buffer + bytesRead);
+            fclose(file);
+        }
+        return contents;
+    }
+};
+
+
+TEST_F(FileFingerprintTest, test_reads_version_from_32bit_file)
+{
+    std::vector<BYTE> file = readFixture(_T("version_x86.dll"));
+    ASSERT_FALSE(file.empty());
+
+    PeVersionReader reader(&file[0], file.size());
+    UINT32 versionMS, versionLS;
+    ASSERT_TRUE(reader.getFileVersion(versionMS, versionLS));
+    EXPECT_EQ(0x00010002u, versionMS);
+    EXPECT_EQ(0x00030004u, versionLS);
+}
+
+TEST_F(FileFingerprintTest, test_reads_version_from_64bit_file)
+{
+    std::vector<BYTE> file = readFixture(_T("version_x64.dll"));
+    ASSERT_FALSE(file.empty());
+
+    PeVersionReader reader(&file[0], file.size());
+    UINT32 versionMS, versionLS;
+    ASSERT_TRUE(reader.getFileVersion(versionMS, versionLS));
+    EXPECT_EQ(0x000A0014u, versionMS);
+    EXPECT_EQ(0x001E0028u, versionLS);
+}
+
+TEST_F(FileFingerprintTest, test_file_without_resources_has_no_version)
+{
+    std::vector<BYTE> file = readFixture(_T("no_resources.dll"));
+    ASSERT_FALSE(file.empty());
+
+    PeVersionReader reader(&file[0], file.size());
+    UINT32 versionMS, versionLS;
+    EXPECT_FALSE(reader.getFileVersion(versionMS, versionLS));
+}
+
+TEST_F(FileFingerprintTest, test_truncated_or_damaged_file_has_no_version)
+{
+    std::vector<BYTE> file = readFixture(_T("version_x86.dll"));
+    ASSERT_FALSE(file.empty());
+
+    UINT32 versionMS, versionLS;
+
+    // A truncated file either has no version, or (once the version resource is complete)
+    // the right one - it must never read past the end
+    for (size_t size = 0; size < file.size(); ++size)
+    {
+        std::vector<BYTE> truncated(file.begin(), file.begin() + size);
+        PeVersionReader reader(truncated.empty() ? NULL : &truncated[0], truncated.size());
+        if (reader.getFileVersion(versionMS, versionLS))
+        {
+            EXPECT_EQ(0x00010002u, versionMS) << "size " << size;
+            EXPECT_EQ(0x00030004u, versionLS) << "size " << size;
+        }
+    }
+
+    // Point the PE header offset past the end of the file
+    std::vector<BYTE> damaged(file);
+    damaged[0x3C] = 0xFF;
+    damaged[0x3D] = 0xFF;
+    PeVersionReader reader(&damaged[0], damaged.size());
+    EXPECT_FALSE(reader.getFileVersion(versionMS, versionLS));
+
+    // Not a PE file at all
+    const BYTE text[] = "<plugins></plugins>";
+    PeVersionReader textReader(text, sizeof(text));
+    EXPECT_FALSE(textReader.getFileVersion(versionMS, versionLS));
+}
+
+TEST_F(FileFingerprintTest, test_fingerprint_reads_size_hash_and_version)
+{
+    FileFingerprint fingerprint;
+    ASSERT_TRUE(fingerprint.read(fixturePath(_T("version_x64.dll")).c_str()));
+
+    EXPECT_EQ(1024u, fingerprint.getSize());
+    EXPECT_EQ(tstring(_T("482a6a4b11d588625eaa7c18baa67b65")), fingerprint.getHash());
+    EXPECT_TRUE(fingerprint.hasVersion());
+    EXPECT_EQ(0x000A0014u, fingerprint.getFileVersionMS());
+    EXPECT_EQ(0x001E0028u, fingerprint.getFileVersionLS());
+}
+
+TEST_F(FileFingerprintTest, test_fingerprint_of_file_without_version)
+{
+    FileFingerprint fingerprint;
+    ASSERT_TRUE(fingerprint.read(fixturePath(_T("no_resources.dll")).c_str()));
+
+    EXPECT_EQ(tstring(_T("717bd04171ad1585136ebd89a0e4901c")), fingerprint.getHash());
+    EXPECT_FALSE(fingerprint.hasVersion());
+}
@@ -0,0 +1,97 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/md5.h"
+#include "libinstall/FileHashes.h"
+#include "libinstall/FileFingerprint.h"
+#include "TempDirectory.h"
+
+#include <algorithm>
+
+
+class FileHashesTest : public ::testing::Test {
+protected:
+    FileHashesTest()
+        : _directory(_T("fht")),
+          _filename(_directory.getFile(_T("download.zip")))
+    {
+    }
+
+    virtual void SetUp()
+    {
+        FileHashes::clear();
+    }
+
+    virtual void TearDown()
+    {
+        FileHashes::clear();
+    }
+
+    void writeFile(const std::string& contents)
+    {
+        FILE* file = _tfopen(_filename.c_str(), _T("wb"));
+        fwrite(contents.c_str(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    TempDirectory _directory;
+    tstring _filename;
+};
+
+
+TEST_F(FileHashesTest, test_hash_in_parts_matches_hash_of_whole)
+{
+    std::string contents;
+    for (int index = 0; index < 100000; ++index)
+        contents.push_back(static_cast<char>(index % 251));
+
+    TCHAR wholeHash[(MD5LEN * 2) + 1];
+    ASSERT_TRUE(MD5::hash(reinterpret_cast<const BYTE*>(contents.c_str()), contents.size(), wholeHash, (MD5LEN * 2) + 1));
+
+    // Parts of uneven sizes, as they come off the network
+    MD5 md5;
+    ASSERT_TRUE(md5.init());
+    for (size_t position = 0, partSize = 1; position < contents.size(); position += partSize, partSize = partSize * 3 + 7)
+    {
+        size_t length = min(partSize, contents.size() - position);
+        ASSERT_TRUE(md5.update(reinterpret_cast<const BYTE*>(contents.c_str()) + position, length));
+    }
+
+    TCHAR partsHash[(MD5LEN * 2) + 1];
+    ASSERT_TRUE(md5.final(partsHash, (MD5LEN * 2) + 1));
+    EXPECT_STREQ(wholeHash, partsHash);
+}
+
+TEST_F(FileHashesTest, test_recorded_hash_is_used_until_file_changes)
+{
+    writeFile("the downloaded file");
+    FileHashes::record(_filename, _T("0123456789abcdef0123456789abcdef"));
+
+    // Either slash, and any case
+    tstring otherName(_filename);
+    std::replace(otherName.begin(), otherName.end(), _T('\\'), _T('/'));
+    ::CharUpperBuff(&otherName[0], static_cast<DWORD>(otherName.size()));
+
+    tstring md5;
+    ASSERT_TRUE(FileHashes::lookup(otherName, md5));
+    EXPECT_EQ(tstring(_T("0123456789abcdef0123456789abcdef")), md5);
+
+    FileFingerprint fingerprint;
+    ASSERT_TRUE(fingerprint.read(_filename.c_str()));
+    EXPECT_EQ(tstring(_T("0123456789abcdef0123456789abcdef")), fingerprint.getHash());
+
+    writeFile("the downloaded file, since changed");
+    EXPECT_FALSE(FileHashes::lookup(_filename, md5));
+
+    // So it's hashed again
+    ASSERT_TRUE(fingerprint.read(_filename.c_str()));
+    EXPECT_NE(tstring(_T("0123456789abcdef0123456789abcdef")), fingerprint.getHash());
+}
+
+TEST_F(FileHashesTest, test_unrecorded_file_has_no_hash)
+{
+    writeFile("never recorded");
+
+    tstring md5;
+    EXPECT_FALSE(FileHashes::lookup(_filename, md5));
+}
@@ -0,0 +1,121 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/FileSink.h"
+#include "TempDirectory.h"
+
+#include <vector>
+
+
+class FileSinkTest : public ::testing::Test {
+protected:
+    FileSinkTest()
+        : _directory(_T("fst")),
+          _filename(_directory.getFile(_T("download.zip")))
+    {
+    }
+
+    // Writes length bytes of a pattern that depends on where they go in the file
+    BOOL writePattern(FileSink& sink, UINT64 start, size_t length, DWORD partSize)
+    {
+        std::vector<BYTE> part;
+        for (size_t written = 0; written < length; written += part.size())
+        {
+            part.clear();
+            for (size_t index = written; index < length && part.size() < partSize; ++index)
+                part.push_back(static_cast<BYTE>((start + index) % 251));
+
+            if (!sink.write(&part[0], static_cast<DWORD>(part.size())))
+                return FALSE;
+        }
+        return TRUE;
+    }
+
+    std::string readFile()
+    {
+        std::string contents;
+        char buffer[16384];
+        FILE* file = _tfopen(_filename.c_str(), _T("rb"));
+        size_t bytesRead;
+        while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            contents.append(buffer, bytesRead);
+        fclose(file);
+        return contents;
+    }
+
+    UINT64 fileSize()
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        ::GetFileAttributesEx(_filename.c_str(), GetFileExInfoStandard, &attributes);
+        return (static_cast<UINT64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    }
+
+    void expectPattern(const std::string& contents, size_t start)
+    {
+        for (size_t index = start; index < contents.size(); ++index)
+        {
+            if (static_cast<BYTE>(contents[index]) != index % 251)
+            {
+                ADD_FAILURE() << "Wrong byte at " << index;
+                return;
+            }
+        }
+    }
+
+    TempDirectory _directory;
+    tstring _filename;
+};
+
+
+TEST_F(FileSinkTest, test_writes_across_buffers)
+{
+    size_t length = (FILESINK_BUFFER_COUNT + 2) * FILESINK_BUFFER_SIZE + 123;
+
+    FileSink sink;
+    ASSERT_TRUE(sink.create(_filename));
+    EXPECT_TRUE(writePattern(sink, 0, length, 16384));
+    EXPECT_TRUE(sink.close());
+    EXPECT_EQ(static_cast<UINT64>(length), sink.getWrittenLength());
+
+    std::string contents = readFile();
+    ASSERT_EQ(length, contents.size());
+    expectPattern(contents, 0);
+}
+
+TEST_F(FileSinkTest, test_reserved_space_is_given_back)
+{
+    FileSink sink;
+    ASSERT_TRUE(sink.create(_filename));
+    EXPECT_TRUE(sink.reserve(4 * FILESINK_BUFFER_SIZE));
+    EXPECT_EQ(static_cast<UINT64>(4 * FILESINK_BUFFER_SIZE), fileSize());
+
+    EXPECT_TRUE(writePattern(sink, 0, 1000, 300));
+    EXPECT_TRUE(sink.close());
+
+    EXPECT_EQ(1000u, fileSize());
+    expectPattern(readFile(), 0);
+}
+
+TEST_F(FileSinkTest, test_append_continues_file)
+{
+    {
+        FileSink sink;
+        ASSERT_TRUE(sink.create(_filename));
+        EXPECT_TRUE(writePattern(sink, 0, 1000, 1000));
+        EXPECT_TRUE(sink.close());
+    }
+
+    // Starts part way through a buffer, so the first write only goes up to the next boundary
+    size_t length = 2 * FILESINK_BUFFER_SIZE;
+    FileSink sink;
+    ASSERT_TRUE(sink.append(_filename));
+    EXPECT_EQ(1000u, sink.getWrittenLength());
+    EXPECT_TRUE(sink.reserve(1000 + length));
+    EXPECT_TRUE(writePattern(sink, 1000, length, 16384));
+    EXPECT_TRUE(sink.close());
+    EXPECT_EQ(static_cast<UINT64>(1000 + length), sink.getWrittenLength());
+
+    std::string contents = readFile();
+    ASSERT_EQ(1000 + length, contents.size());
+    expectPattern(contents, 0);
+}
@@ -0,0 +1,135 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/FingerprintCache.h"
+#include "MemoryFileSystem.h"
+
+
+class FingerprintCacheTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        _fileSystem.setFile(_T("C:\\plugins\\First.dll"), 1000, 1);
+        _fileSystem.setFile(_T("C:\\plugins\\Second.dll"), 2000, 2);
+    }
+
+    Fingerprint makeFingerprint(const TCHAR* name)
+    {
+        Fingerprint fingerprint;
+        fingerprint.isPlugin = TRUE;
+        fingerprint.name = name;
+        fingerprint.hash = _T("0123456789abcdef0123456789abcdef");
+        fingerprint.hasVersion = TRUE;
+        fingerprint.fileVersionMS = 0x00010002;
+        fingerprint.fileVersionLS = 0x00030004;
+        return fingerprint;
+    }
+
+    /* Adds the files as a refresh would, after missing the cache */
+    void addFiles(FingerprintCache& cache)
+    {
+        FileStat fileStat;
+        Fingerprint fingerprint;
+
+        cache.lookup(_T("C:\\plugins\\First.dll"), fileStat, fingerprint);
+        cache.add(_T("C:\\plugins\\First.dll"), fileStat, makeFingerprint(_T("First")));
+
+        cache.lookup(_T("C:\\plugins\\Second.dll"), fileStat, fingerprint);
+        cache.add(_T("C:\\plugins\\Second.dll"), fileStat, makeFingerprint(_T("Second")));
+    }
+
+    MemoryFileSystem _fileSystem;
+};
+
+
+TEST_F(FingerprintCacheTest, test_unchanged_file_is_a_hit)
+{
+    FingerprintCache cache(_fileSystem);
+    addFiles(cache);
+    ASSERT_TRUE(cache.save(_T("fingerprints.cache")));
+
+    FingerprintCache loadedCache(_fileSystem);
+    ASSERT_TRUE(loadedCache.load(_T("fingerprints.cache")));
+
+    FileStat fileStat;
+    Fingerprint fingerprint;
+    EXPECT_TRUE(loadedCache.lookup(_T("C:\\plugins\\Second.dll"), fileStat, fingerprint));
+    EXPECT_EQ(TRUE, fingerprint.isPlugin);
+    EXPECT_EQ(tstring(_T("Second")), fingerprint.name);
+    EXPECT_EQ(tstring(_T("0123456789abcdef0123456789abcdef")), fingerprint.hash);
+    EXPECT_EQ(0x00010002u, fingerprint.fileVersionMS);
+    EXPECT_EQ(0x00030004u, fingerprint.fileVersionLS);
+
+    EXPECT_EQ(1u, loadedCache.getHitCount());
+    EXPECT_EQ(0u, loadedCache.getMissCount());
+}
+
+TEST_F(FingerprintCacheTest, test_changed_size_or_time_is_a_miss)
+{
+    FingerprintCache cache(_fileSystem);
+    addFiles(cache);
+
+    _fileSystem.setFile(_T("C:\\plugins\\First.dll"), 1001, 1);
+    _fileSystem.setFile(_T("C:\\plugins\\Second.dll"), 2000, 3);
+
+    FileStat fileStat;
+    Fingerprint fingerprint;
+    EXPECT_FALSE(cache.lookup(_T("C:\\plugins\\First.dll"), fileStat, fingerprint));
+    EXPECT_EQ(1001u, fileStat.size);
+    EXPECT_FALSE(cache.lookup(_T("C:\\plugins\\Second.dll"), fileStat, fingerprint));
+    EXPECT_EQ(3u, fileStat.lastWriteTime);
+}
+
+TEST_F(FingerprintCacheTest, test_removed_files_are_dropped)
+{
+    FingerprintCache cache(_fileSystem);
+    addFiles(cache);
+    ASSERT_TRUE(cache.save(_T("fingerprints.cache")));
+
+    FingerprintCache loadedCache(_fileSystem);
+    ASSERT_TRUE(loadedCache.load(_T("fingerprints.cache")));
+
+    // Only First.dll is still there
+    FileStat fileStat;
+    Fingerprint fingerprint;
+    EXPECT_TRUE(loadedCache.lookup(_T("C:\\plugins\\First.dll"), fileStat, fingerprint));
+    loadedCache.removeUnused();
+
+    EXPECT_EQ(1u, loadedCache.getEntryCount());
+}
+
+TEST_F(FingerprintCacheTest, test_unchanged_cache_is_not_written)
+{
+    FingerprintCache cache(_fileSystem);
+    addFiles(cache);
+    ASSERT_TRUE(cache.save(_T("fingerprints.cache")));
+    EXPECT_EQ(1, _fileSystem.getWriteCount());
+
+    FingerprintCache loadedCache(_fileSystem);
+    ASSERT_TRUE(loadedCache.load(_T("fingerprints.cache")));
+
+    FileStat fileStat;
+    Fingerprint fingerprint;
+    loadedCache.lookup(_T("C:\\plugins\\First.dll"), fileStat, fingerprint);
+    loadedCache.lookup(_T("C:\\plugins\\Second.dll"), fileStat, fingerprint);
+    loadedCache.removeUnused();
+
+    EXPECT_TRUE(loadedCache.save(_T("fingerprints.cache")));
+    EXPECT_EQ(1, _fileSystem.getWriteCount());
+}
+
+TEST_F(FingerprintCacheTest, test_damaged_cache_is_discarded)
+{
+    FingerprintCache cache(_fileSystem);
+    addFiles(cache);
+    ASSERT_TRUE(cache.save(_T("fingerprints.cache")));
+
+    std::string contents;
+    ASSERT_TRUE(_fileSystem.readFile(_T("fingerprints.cache"), contents));
+    contents.resize(contents.size() - 6);
+    _fileSystem.writeFile(_T("fingerprints.cache"), contents);
+
+    FingerprintCache loadedCache(_fileSystem);
+    EXPECT_FALSE(loadedCache.load(_T("fingerprints.cache")));
+    EXPECT_EQ(0u, loadedCache.getEntryCount());
+}
@@ -0,0 +1,96 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/WinInetTransport.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "TestServer.h"
+
+
+class HttpTransportTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        _server.setKeepAlive(TRUE);
+        ASSERT_TRUE(_server.start());
+        _server.addFile("/one.xml", "<one />");
+        _server.addFile("/two.xml", "<two />");
+    }
+
+    virtual void TearDown()
+    {
+        DownloadManager::setTransport(std::shared_ptr<HttpTransport>());
+        _server.stop();
+    }
+
+    std::string download(const TCHAR* path)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        std::string result;
+        downloadManager.getUrl((_server.getBaseUrl() + path).c_str(), result, &moduleInfo);
+        return result;
+    }
+
+    std::string readBody(HttpRequest& request)
+    {
+        std::string body;
+        BYTE buffer[1024];
+        DWORD bytesRead;
+        while (request.read(buffer, sizeof(buffer), bytesRead) && bytesRead > 0)
+            body.append(reinterpret_cast<char*>(buffer), bytesRead);
+        return body;
+    }
+
+    TestServer _server;
+};
+
+
+TEST_F(HttpTransportTest, test_shared_transport_reuses_connection)
+{
+    DownloadManager::setTransport(std::shared_ptr<HttpTransport>(new WinInetTransport(_T("Tests"))));
+
+    EXPECT_EQ(std::string("<one />"), download(_T("/one.xml")));
+    EXPECT_EQ(std::string("<two />"), download(_T("/two.xml")));
+    EXPECT_EQ(std::string("<one />"), download(_T("/one.xml")));
+
+    EXPECT_EQ(1, _server.getConnectionCount());
+}
+
+TEST_F(HttpTransportTest, test_request_headers_and_response)
+{
+    WinInetTransport transport(_T("Tests"));
+    CancelToken cancelToken;
+
+    std::shared_ptr<HttpRequest> request = transport.openRequest(_server.getBaseUrl() + _T("/one.xml"), _T("Range: bytes=1-\r\n"), 0, cancelToken);
+    ASSERT_TRUE(request != NULL);
+    ASSERT_TRUE(request->waitForResponse());
+
+    EXPECT_EQ(206u, request->getStatusCode());
+    EXPECT_EQ(tstring(_T("bytes 1-6/7")), request->getHeader(_T("Content-Range")));
+    EXPECT_EQ(tstring(), request->getHeader(_T("X-Not-Sent")));
+    EXPECT_EQ(std::string("one />"), readBody(*request));
+}
+
+TEST_F(HttpTransportTest, test_missing_file_status)
+{
+    WinInetTransport transport(_T("Tests"));
+    CancelToken cancelToken;
+
+    std::shared_ptr<HttpRequest> request = transport.openRequest(_server.getBaseUrl() + _T("/three.xml"), tstring(), 0, cancelToken);
+    ASSERT_TRUE(request != NULL);
+    ASSERT_TRUE(request->waitForResponse());
+    EXPECT_EQ(404u, request->getStatusCode());
+}
+
+TEST_F(HttpTransportTest, test_unsupported_url_is_not_opened)
+{
+    WinInetTransport transport(_T("Tests"));
+    CancelToken cancelToken;
+
+    EXPECT_TRUE(transport.openRequest(_T("ftp://127.0.0.1/one.xml"), tstring(), 0, cancelToken) == NULL);
+}
@@ -0,0 +1,147 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+
+TEST(MirrorList, test_reads_lists_and_servers)
+{
+    MirrorList mirrors(_T("https://primary.example.org/pm/xml/plugins.zip"));
+    mirrors.addServers(mirrors.getUrl(0), _T(" https://one.example.org\r\n\thttp://two.example.org:8080/ "));
+
+    ASSERT_EQ(3u, mirrors.size());
+    EXPECT_EQ(tstring(_T("https://one.example.org/pm/xml/plugins.zip")), mirrors.getUrl(1));
+    EXPECT_EQ(tstring(_T("http://two.example.org:8080/pm/xml/plugins.zip")), mirrors.getUrl(2));
+    EXPECT_EQ(tstring(_T("http://two.example.org:8080")), MirrorList::getServer(mirrors.getUrl(2)));
+
+    // The written form reads back the same, without repeats
+    MirrorList copy;
+    copy.addList(mirrors.toString().c_str());
+    copy.addList(mirrors.getUrl(0).c_str());
+    EXPECT_EQ(mirrors.getUrls(), copy.getUrls());
+
+    MirrorList validate;
+    validate.addList(_T("http://one.example.org/validate?md5= http://two.example.org/validate?md5="));
+    EXPECT_EQ(tstring(_T("http://two.example.org/validate?md5=abc")), validate.append(_T("abc")).getUrl(1));
+}
+
+TEST(MirrorList, test_scores_are_kept_in_file)
+{
+    TempDirectory directory(_T("mls"));
+    tstring scoresFilename(directory.getFile(MIRRORSCORES_FILENAME));
+
+    {
+        MirrorScores scores(scoresFilename);
+        scores.recordResponse(_T("http://slow.example.org/a.zip"), 800);
+        scores.recordResponse(_T("http://fast.example.org/b.zip"), 100);
+        scores.recordFailure(_T("http://fast.example.org/b.zip"));
+    }
+
+    // Scores are by server, so every URL on it has the same one
+    MirrorScores scores(scoresFilename);
+    EXPECT_EQ(800, scores.getScore(_T("http://slow.example.org/other.zip")));
+    EXPECT_EQ(100 + (MIRROR_FAILURE_LATENCY - 100) / 4, scores.getScore(_T("http://fast.example.org/b.zip")));
+    EXPECT_EQ(-1, scores.getScore(_T("http://new.example.org/b.zip")));
+
+    // Servers that haven't been tried go first
+    std::vector<tstring> urls;
+    urls.push_back(_T("http://fast.example.org/b.zip"));
+    urls.push_back(_T("http://slow.example.org/b.zip"));
+    urls.push_back(_T("http://new.example.org/b.zip"));
+    scores.order(urls);
+
+    EXPECT_EQ(tstring(_T("http://new.example.org/b.zip")), urls[0]);
+    EXPECT_EQ(tstring(_T("http://slow.example.org/b.zip")), urls[1]);
+    EXPECT_EQ(tstring(_T("http://fast.example.org/b.zip")), urls[2]);
+}
+
+
+class MirrorDownloadTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        for (int server = 0; server < 3; ++server)
+            ASSERT_TRUE(_servers[server].start());
+
+        _scores.reset(new MirrorScores(tstring()));
+        DownloadManager::setMirrorScores(_scores);
+    }
+
+    virtual void TearDown()
+    {
+        DownloadManager::setMirrorScores(std::shared_ptr<MirrorScores>());
+        for (int server = 0; server < 3; ++server)
+            _servers[server].stop();
+    }
+
+    std::string download(const MirrorList& mirrors)
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        std::string result;
+        downloadManager.getUrl(mirrors, result, &moduleInfo);
+        return result;
+    }
+
+    tstring getUrl(int server)
+    {
+        return _servers[server].getBaseUrl() + _T("/plugins.xml");
+    }
+
+    TestServer _servers[3];
+    std::shared_ptr<MirrorScores> _scores;
+};
+
+
+TEST_F(MirrorDownloadTest, test_fastest_mirror_wins_race)
+{
+    _servers[0].setResponseDelay(2000);
+    _servers[0].addFile("/plugins.xml", "<slow />");
+    _servers[1].addFile("/plugins.xml", "<fast />");
+
+    MirrorList mirrors(getUrl(0));
+    mirrors.add(getUrl(1));
+
+    EXPECT_EQ(std::string("<fast />"), download(mirrors));
+
+    // The slow one was given up on, but still scored
+    EXPECT_LT(_scores->getScore(getUrl(1)), _scores->getScore(getUrl(0)));
+
+    // So the fast one is first next time
+    std::vector<tstring> urls = mirrors.getUrls();
+    _scores->order(urls);
+    EXPECT_EQ(getUrl(1), urls[0]);
+}
+
+TEST_F(MirrorDownloadTest, test_fails_over_to_next_mirror)
+{
+    // The first is missing the file, and the second drops the connection part way through
+    _servers[1].setDropAfter(10);
+    _servers[1].addFile("/plugins.xml", std::string(1000, 'x'));
+    _servers[2].addFile("/plugins.xml", "<plugins />");
+
+    MirrorList mirrors(getUrl(0));
+    mirrors.add(getUrl(1));
+    mirrors.add(getUrl(2));
+
+    EXPECT_EQ(std::string("<plugins />"), download(mirrors));
+    EXPECT_EQ(1, _servers[2].getRequestCount("/plugins.xml"));
+    EXPECT_LT(_scores->getScore(getUrl(2)), _scores->getScore(getUrl(0)));
+    EXPECT_LT(_scores->getScore(getUrl(2)), _scores->getScore(getUrl(1)));
+}
+
+TEST_F(MirrorDownloadTest, test_fails_when_no_mirror_has_file)
+{
+    MirrorList mirrors(getUrl(0));
+    mirrors.add(getUrl(1));
+
+    EXPECT_EQ(std::string(), download(mirrors));
+}
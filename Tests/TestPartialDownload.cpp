@@ -0,0 +1,184 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/PartialDownload.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+
+class PartialDownloadTest : public ::testing::Test {
+protected:
+    // The partial downloads in a directory of their own, with the downloaded file next to it
+    PartialDownloadTest()
+        : _tempDirectory(_T("pdt")),
+          _directory(_tempDirectory.getFile(_T("partial"))),
+          _downloadFilename(_tempDirectory.getFile(_T("plugin.zip")))
+    {
+    }
+
+    virtual void SetUp()
+    {
+        ::CreateDirectory(_directory.c_str(), NULL);
+
+        // 100KB, with no repeats, so a piece in the wrong place is noticed
+        for (int index = 0; _content.size() < 100000; ++index)
+        {
+            char line[20];
+            sprintf_s(line, 20, "%09d\n", index);
+            _content.append(line);
+        }
+
+        ASSERT_TRUE(_server.start());
+        _server.addFile("/plugin.zip", _content);
+        _url = _server.getBaseUrl() + _T("/plugin.zip");
+
+        DownloadManager::setPartialDirectory(_directory);
+    }
+
+    virtual void TearDown()
+    {
+        DownloadManager::setPartialDirectory(tstring());
+        _server.stop();
+    }
+
+    BOOL download()
+    {
+        CancelToken cancelToken;
+        DownloadManager downloadManager(cancelToken);
+        downloadManager.disableCache();
+        ModuleInfo moduleInfo(NULL, NULL);
+
+        tstring contentType;
+        return downloadManager.getUrl(_url.c_str(), _downloadFilename, contentType, &moduleInfo);
+    }
+
+    std::string readDownload()
+    {
+        std::string contents;
+        char buffer[4096];
+        FILE* file = _tfopen(_downloadFilename.c_str(), _T("rb"));
+        if (file)
+        {
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.append(buffer, bytesRead);
+            fclose(file);
+        }
+        return contents;
+    }
+
+    TempDirectory _tempDirectory;
+    TestServer  _server;
+    std::string _content;
+    tstring     _url;
+    tstring     _directory;
+    tstring     _downloadFilename;
+};
+
+
+TEST_F(PartialDownloadTest, test_continues_after_dropped_connection)
+{
+    _server.setDropAfter(40000);
+    EXPECT_FALSE(download());
+    EXPECT_TRUE(_server.getLastRange("/plugin.zip").empty());
+
+    _server.setDropAfter(0);
+    ASSERT_TRUE(download());
+
+    // Only the rest of the file is asked for
+    std::string range = _server.getLastRange("/plugin.zip");
+    ASSERT_FALSE(range.empty());
+    EXPECT_GT(atol(range.c_str()), 0);
+    EXPECT_EQ(_content, readDownload());
+}
+
+TEST_F(PartialDownloadTest, test_changed_file_is_downloaded_again)
+{
+    _server.setDropAfter(40000);
+    EXPECT_FALSE(download());
+
+    // A new ETag, so If-Range gets the whole of the new file
+    std::string newContent(_content);
+    newContent[0] = 'X';
+    newContent[50000] = 'Y';
+    _server.addFile("/plugin.zip", newContent);
+
+    _server.setDropAfter(0);
+    ASSERT_TRUE(download());
+    EXPECT_EQ(newContent, readDownload());
+}
+
+TEST_F(PartialDownloadTest, test_completed_download_leaves_nothing_to_continue)
+{
+    ASSERT_TRUE(download());
+    EXPECT_EQ(_content, readDownload());
+
+    PartialDownload partial(_directory, _url);
+    EXPECT_FALSE(partial.load());
+    EXPECT_EQ(INVALID_FILE_ATTRIBUTES, ::GetFileAttributes(partial.getPartFilename().c_str()));
+}
+
+TEST_F(PartialDownloadTest, test_part_file_is_cut_to_recorded_length)
+{
+    PartialDownload partial(_directory, _url);
+    ASSERT_TRUE(partial.begin(_T("\"5\""), _T("")));
+
+    FILE* file = _tfopen(partial.getPartFilename().c_str(), _T("wb"));
+    fwrite("0123456789", 1, 10, file);
+    fclose(file);
+    partial.setReceivedLength(6);
+
+    // The quotes are part of the ETag, so must survive the ini file
+    PartialDownload reloaded(_directory, _url);
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(6u, reloaded.getReceivedLength());
+    EXPECT_EQ(tstring(_T("Range: bytes=6-\r\nIf-Range: \"5\"\r\n")), reloaded.getRequestHeaders());
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    ASSERT_TRUE(::GetFileAttributesEx(reloaded.getPartFilename().c_str(), GetFileExInfoStandard, &attributes));
+    EXPECT_EQ(6u, attributes.nFileSizeLow);
+}
+
+TEST_F(PartialDownloadTest, test_response_without_validators_is_not_kept)
+{
+    PartialDownload partial(_directory, _url);
+    ASSERT_TRUE(partial.begin(_T(""), _T("")));
+    partial.setReceivedLength(1000);
+
+    PartialDownload reloaded(_directory, _url);
+    EXPECT_FALSE(reloaded.load());
+    EXPECT_TRUE(reloaded.getRequestHeaders().empty());
+}
+
+TEST_F(PartialDownloadTest, test_old_partial_downloads_are_removed)
+{
+    tstring oldFilename(_directory + _T("\\old.part"));
+    tstring newFilename(_directory + _T("\\new.part"));
+    FILE* file = _tfopen(oldFilename.c_str(), _T("wb"));
+    fclose(file);
+    file = _tfopen(newFilename.c_str(), _T("wb"));
+    fclose(file);
+
+    // Last written eight days ago
+    FILETIME now;
+    ::GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER written;
+    written.LowPart = now.dwLowDateTime;
+    written.HighPart = now.dwHighDateTime;
+    written.QuadPart -= 8ULL * 24 * 60 * 60 * 10000000;
+    FILETIME writtenTime;
+    writtenTime.dwLowDateTime = written.LowPart;
+    writtenTime.dwHighDateTime = written.HighPart;
+
+    HANDLE hFile = ::CreateFile(oldFilename.c_str(), FILE_WRITE_ATTRIBUTES, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ASSERT_NE(INVALID_HANDLE_VALUE, hFile);
+    ::SetFileTime(hFile, NULL, NULL, &writtenTime);
+    ::CloseHandle(hFile);
+
+    PartialDownload::removeExpired(_directory, 7);
+    EXPECT_EQ(INVALID_FILE_ATTRIBUTES, ::GetFileAttributes(oldFilename.c_str()));
+    EXPECT_NE(INVALID_FILE_ATTRIBUTES, ::GetFileAttributes(newFilename.c_str()));
+}
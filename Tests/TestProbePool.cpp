@@ -0,0 +1,307 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/PluginProbe.h"
+#include "libinstall/ProbePool.h"
+
+#include <set>
+#include <vector>
+
+
+/* Answers from a fixed list - anything not in it is not a plugin */
+class FakePluginLoader : public PluginLoader
+{
+public:
+    void addPlugin(const tstring& filename, const tstring& name)
+    {
+        _names[filename] = name;
+    }
+
+    ProbeResult probe(const tstring& filename)
+    {
+        ProbeResult result;
+        std::map<tstring, tstring>::const_iterator name = _names.find(filename);
+        if (name == _names.end())
+        {
+            result.status = PROBE_NOTPLUGIN;
+        }
+        else
+        {
+            result.status = PROBE_PLUGIN;
+            result.isUnicode = TRUE;
+            result.name = name->second;
+        }
+        return result;
+    }
+
+private:
+    std::map<tstring, tstring> _names;
+};
+
+
+/* A worker that goes through the protocol in process, but never answers for the dlls
+ * marked as hanging - as if the host had timed out or crashed on them */
+class FakeProbeWorker : public ProbeWorker
+{
+public:
+    FakeProbeWorker(PluginLoader& loader, const std::set<tstring>& hangs)
+        : _host(loader), _hangs(hangs), _hung(FALSE)
+    {
+    }
+
+    BOOL start() { return TRUE; }
+
+    BOOL send(const std::string& request)
+    {
+        _requests.push_back(request);
+        return TRUE;
+    }
+
+    BOOL receive(std::string& resultLine, DWORD /*timeout*/)
+    {
+        if (_hung || _requests.empty())
+            return FALSE;
+
+        std::string request = _requests.front();
+        _requests.erase(_requests.begin());
+
+        tstring filename;
+        ProbeHost::decodeRequest(request, filename);
+        if (_hangs.count(filename))
+        {
+            _hung = TRUE;
+            return FALSE;
+        }
+
+        resultLine = _host.handleRequest(request);
+        return TRUE;
+    }
+
+    void stop(BOOL /*terminate*/) {}
+
+private:
+    ProbeHost                _host;
+    const std::set<tstring>& _hangs;
+    std::vector<std::string> _requests;
+    BOOL                     _hung;
+};
+
+class FakeProbeWorkerFactory : public ProbeWorkerFactory
+{
+public:
+    FakeProbeWorkerFactory(PluginLoader& loader)
+        : _loader(loader), _createCount(0), _canStart(TRUE)
+    {
+        ::InitializeCriticalSection(&_lock);
+    }
+
+    ~FakeProbeWorkerFactory()
+    {
+        ::DeleteCriticalSection(&_lock);
+    }
+
+    std::shared_ptr<ProbeWorker> create()
+    {
+        ::EnterCriticalSection(&_lock);
+        ++_createCount;
+        ::LeaveCriticalSection(&_lock);
+
+        if (!_canStart)
+            return std::shared_ptr<ProbeWorker>(new FailingProbeWorker());
+        return std::shared_ptr<ProbeWorker>(new FakeProbeWorker(_loader, _hangs));
+    }
+
+    void addHang(const tstring& filename) { _hangs.insert(filename); }
+    void setCanStart(BOOL canStart) { _canStart = canStart; }
+    int getCreateCount() const { return _createCount; }
+
+private:
+    class FailingProbeWorker : public ProbeWorker
+    {
+    public:
+        BOOL start() { return FALSE; }
+        BOOL send(const std::string&) { return FALSE; }
+        BOOL receive(std::string&, DWORD) { return FALSE; }
+        void stop(BOOL) {}
+    };
+
+    PluginLoader&     _loader;
+    std::set<tstring> _hangs;
+    CRITICAL_SECTION  _lock;
+    int               _createCount;
+    BOOL              _canStart;
+};
+
+
+static tstring dllName(int index)
+{
+    TCHAR filename[MAX_PATH];
+    _stprintf_s(filename, MAX_PATH, _T("C:\\Program Files\\Notepad++\\plugins\\Plugin%d.dll"), index);
+    return tstring(filename);
+}
+
+
+TEST(ProbeHostTest, test_results_round_trip)
+{
+    ProbeResult plugin;
+    plugin.status = PROBE_PLUGIN;
+    plugin.isUnicode = TRUE;
+    plugin.name = _T("Compare\tPlugin \x00e9");
+
+    ProbeResult decoded;
+    ASSERT_TRUE(ProbeHost::decodeResult(ProbeHost::encodeResult(plugin), decoded));
+    EXPECT_EQ(PROBE_PLUGIN, decoded.status);
+    EXPECT_TRUE(decoded.isUnicode);
+    EXPECT_EQ(plugin.name, decoded.name);
+
+    ProbeResult notPlugin;
+    notPlugin.status = PROBE_NOTPLUGIN;
+    ASSERT_TRUE(ProbeHost::decodeResult(ProbeHost::encodeResult(notPlugin), decoded));
+    EXPECT_EQ(PROBE_NOTPLUGIN, decoded.status);
+
+    EXPECT_FALSE(ProbeHost::decodeResult("plugin\tx\tName", decoded));
+    EXPECT_FALSE(ProbeHost::decodeResult("", decoded));
+}
+
+TEST(ProbeHostTest, test_line_breaks_are_removed_from_names)
+{
+    ProbeResult plugin;
+    plugin.status = PROBE_PLUGIN;
+    plugin.name = _T("Two\r\nLines");
+
+    std::string resultLine = ProbeHost::encodeResult(plugin);
+    EXPECT_EQ(std::string::npos, resultLine.find('\n'));
+    EXPECT_EQ(std::string::npos, resultLine.find('\r'));
+}
+
+TEST(ProbeHostTest, test_requests_are_answered_by_the_loader)
+{
+    FakePluginLoader loader;
+    loader.addPlugin(dllName(1), _T("First"));
+    ProbeHost host(loader);
+
+    ProbeResult result;
+    ASSERT_TRUE(ProbeHost::decodeResult(host.handleRequest(ProbeHost::encodeRequest(dllName(1))), result));
+    EXPECT_EQ(PROBE_PLUGIN, result.status);
+    EXPECT_EQ(tstring(_T("First")), result.name);
+
+    ASSERT_TRUE(ProbeHost::decodeResult(host.handleRequest(ProbeHost::encodeRequest(dllName(2))), result));
+    EXPECT_EQ(PROBE_NOTPLUGIN, result.status);
+
+    ASSERT_TRUE(ProbeHost::decodeResult(host.handleRequest(""), result));
+    EXPECT_EQ(PROBE_NOTPLUGIN, result.status);
+}
+
+
+TEST(ProbePoolTest, test_results_are_in_request_order)
+{
+    FakePluginLoader loader;
+    std::vector<tstring> filenames;
+    for (int index = 0; index < 23; ++index)
+    {
+        filenames.push_back(dllName(index));
+        if (index % 3)
+        {
+            TCHAR name[20];
+            _stprintf_s(name, 20, _T("Plugin %d"), index);
+            loader.addPlugin(dllName(index), name);
+        }
+    }
+
+    FakeProbeWorkerFactory workerFactory(loader);
+    ProbePool probePool(workerFactory, 3, 1000, 2);
+
+    std::vector<ProbeResult> results;
+    ASSERT_TRUE(probePool.probe(filenames, results));
+    ASSERT_EQ(filenames.size(), results.size());
+
+    for (int index = 0; index < 23; ++index)
+    {
+        if (index % 3)
+        {
+            TCHAR name[20];
+            _stprintf_s(name, 20, _T("Plugin %d"), index);
+            EXPECT_EQ(PROBE_PLUGIN, results[index].status) << index;
+            EXPECT_EQ(tstring(name), results[index].name) << index;
+        }
+        else
+        {
+            EXPECT_EQ(PROBE_NOTPLUGIN, results[index].status) << index;
+        }
+    }
+
+    EXPECT_EQ(3, workerFactory.getCreateCount());
+    EXPECT_EQ(0u, probePool.getRestartCount());
+}
+
+TEST(ProbePoolTest, test_hung_probe_fails_only_that_dll)
+{
+    FakePluginLoader loader;
+    std::vector<tstring> filenames;
+    for (int index = 0; index < 10; ++index)
+    {
+        filenames.push_back(dllName(index));
+        loader.addPlugin(dllName(index), _T("Plugin"));
+    }
+
+    FakeProbeWorkerFactory workerFactory(loader);
+    workerFactory.addHang(dllName(2));
+    workerFactory.addHang(dllName(7));
+
+    // One worker, so the rest of each batch has to go to a replacement
+    ProbePool probePool(workerFactory, 1, 1000, 5);
+
+    std::vector<ProbeResult> results;
+    ASSERT_TRUE(probePool.probe(filenames, results));
+
+    for (int index = 0; index < 10; ++index)
+    {
+        if (index == 2 || index == 7)
+            EXPECT_EQ(PROBE_FAILED, results[index].status) << index;
+        else
+            EXPECT_EQ(PROBE_PLUGIN, results[index].status) << index;
+    }
+
+    EXPECT_EQ(2u, probePool.getRestartCount());
+    EXPECT_EQ(3, workerFactory.getCreateCount());
+}
+
+TEST(ProbePoolTest, test_no_workers_is_reported)
+{
+    FakePluginLoader loader;
+    FakeProbeWorkerFactory workerFactory(loader);
+    workerFactory.setCanStart(FALSE);
+
+    std::vector<tstring> filenames;
+    filenames.push_back(dllName(1));
+
+    ProbePool probePool(workerFactory, 2, 1000, 8);
+    std::vector<ProbeResult> results;
+    EXPECT_FALSE(probePool.probe(filenames, results));
+}
+
+TEST(ProbePoolTest, test_in_process_worker_probes_everything)
+{
+    FakePluginLoader loader;
+    loader.addPlugin(dllName(1), _T("First"));
+
+    std::vector<tstring> filenames;
+    filenames.push_back(dllName(1));
+    filenames.push_back(dllName(2));
+
+    InProcessProbeWorkerFactory workerFactory(loader);
+    ProbePool probePool(workerFactory, 1, 1000, filenames.size());
+
+    std::vector<ProbeResult> results;
+    ASSERT_TRUE(probePool.probe(filenames, results));
+    EXPECT_EQ(PROBE_PLUGIN, results[0].status);
+    EXPECT_EQ(tstring(_T("First")), results[0].name);
+    EXPECT_EQ(PROBE_NOTPLUGIN, results[1].status);
+}
+
+TEST(ProbePoolTest, test_missing_dll_is_not_a_plugin)
+{
+    Win32PluginLoader loader;
+    ProbeResult result = loader.probe(_T("C:\\does\\not\\exist\\NoPlugin.dll"));
+    EXPECT_EQ(PROBE_NOTPLUGIN, result.status);
+}
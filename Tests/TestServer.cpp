@@ -0,0 +1,382 @@
+#include "precompiled_headers.h"
+
+#include "TestServer.h"
+
+using namespace std;
+
+// ms a kept alive connection waits for the next request, like a real server's idle timeout -
+// without it, stop() would wait for the client to close its idle connections
+#define KEEPALIVE_TIMEOUT  2000
+
+#define VALIDATE_PATH      "/validate?md5="
+
+
+TestServer::TestServer()
+    : _listenSocket(INVALID_SOCKET),
+      _hThread(NULL),
+      _port(0),
+      _winsockStarted(FALSE),
+      _responseDelay(0),
+      _dropAfter(0),
+      _nextEtag(1),
+      _keepAlive(FALSE),
+      _connectionCount(0),
+      _validatedHashCount(0)
+{
+    ::InitializeCriticalSection(&_lock);
+}
+
+TestServer::~TestServer()
+{
+    stop();
+    ::DeleteCriticalSection(&_lock);
+}
+
+BOOL TestServer::start()
+{
+    WSADATA wsaData;
+    if (::WSAStartup(MAKEWORD(2, 2), &wsaData))
+        return FALSE;
+    _winsockStarted = TRUE;
+
+    _listenSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == _listenSocket)
+        return FALSE;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    int addressLength = sizeof(address);
+    if (::bind(_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+        || ::listen(_listenSocket, SOMAXCONN)
+        || ::getsockname(_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressLength))
+    {
+        stop();
+        return FALSE;
+    }
+
+    _port = ntohs(address.sin_port);
+
+    _hThread = ::CreateThread(0, 0, TestServer::serverThreadProc, this, 0, 0);
+    return _hThread != NULL;
+}
+
+void TestServer::stop()
+{
+    // Closing the socket fails the accept(), which ends the server thread
+    if (INVALID_SOCKET != _listenSocket)
+    {
+        ::closesocket(_listenSocket);
+        _listenSocket = INVALID_SOCKET;
+    }
+
+    if (_hThread)
+    {
+        ::WaitForSingleObject(_hThread, INFINITE);
+        ::CloseHandle(_hThread);
+        _hThread = NULL;
+    }
+
+    for (vector<HANDLE>::iterator it = _connectionThreads.begin(); it != _connectionThreads.end(); ++it)
+    {
+        ::WaitForSingleObject(*it, INFINITE);
+        ::CloseHandle(*it);
+    }
+    _connectionThreads.clear();
+
+    if (_winsockStarted)
+    {
+        ::WSACleanup();
+        _winsockStarted = FALSE;
+    }
+}
+
+void TestServer::addFile(const string& path, const string& content)
+{
+    ::EnterCriticalSection(&_lock);
+    _files[path] = content;
+
+    char etag[20];
+    sprintf_s(etag, 20, "\"%d\"", _nextEtag++);
+    _etags[path] = etag;
+    ::LeaveCriticalSection(&_lock);
+}
+
+tstring TestServer::getBaseUrl() const
+{
+    TCHAR baseUrl[40];
+    _stprintf_s(baseUrl, 40, _T("http://127.0.0.1:%d"), _port);
+    return tstring(baseUrl);
+}
+
+int TestServer::getRequestCount(const string& path)
+{
+    ::EnterCriticalSection(&_lock);
+    int requestCount = _requestCounts[path];
+    ::LeaveCriticalSection(&_lock);
+    return requestCount;
+}
+
+void TestServer::setResponseDelay(DWORD delay)
+{
+    _responseDelay = delay;
+}
+
+void TestServer::setDropAfter(size_t bytes)
+{
+    _dropAfter = bytes;
+}
+
+string TestServer::getLastRange(const string& path)
+{
+    ::EnterCriticalSection(&_lock);
+    string range = _lastRanges[path];
+    ::LeaveCriticalSection(&_lock);
+    return range;
+}
+
+int TestServer::getNotModifiedCount(const string& path)
+{
+    ::EnterCriticalSection(&_lock);
+    int notModifiedCount = _notModifiedCounts[path];
+    ::LeaveCriticalSection(&_lock);
+    return notModifiedCount;
+}
+
+void TestServer::setKeepAlive(BOOL keepAlive)
+{
+    _keepAlive = keepAlive;
+}
+
+int TestServer::getConnectionCount()
+{
+    ::EnterCriticalSection(&_lock);
+    int connectionCount = _connectionCount;
+    ::LeaveCriticalSection(&_lock);
+    return connectionCount;
+}
+
+void TestServer::setHashStatus(const string& md5, const string& status)
+{
+    ::EnterCriticalSection(&_lock);
+    _hashStatuses[md5] = status;
+    ::LeaveCriticalSection(&_lock);
+}
+
+int TestServer::getValidatedHashCount()
+{
+    ::EnterCriticalSection(&_lock);
+    int validatedHashCount = _validatedHashCount;
+    ::LeaveCriticalSection(&_lock);
+    return validatedHashCount;
+}
+
+/* The body of the answer to /validate, for the comma separated hashList.  Called with the lock held. */
+string TestServer::validate(const string& hashList)
+{
+    string body;
+    BOOL isBatch = hashList.find(',') != string::npos;
+    string::size_type start = 0;
+    while (start <= hashList.size())
+    {
+        string::size_type end = hashList.find(',', start);
+        if (string::npos == end)
+            end = hashList.size();
+
+        string md5(hashList, start, end - start);
+        ++_validatedHashCount;
+
+        map<string, string>::const_iterator hashStatus = _hashStatuses.find(md5);
+        string status = (hashStatus == _hashStatuses.end()) ? "unknown" : hashStatus->second;
+        if (isBatch)
+            body.append(md5 + " " + status + "\n");
+        else
+            body = status;
+
+        start = end + 1;
+    }
+
+    return body;
+}
+
+/* Returns the value of the header called name (e.g. "Range: "), or empty */
+string TestServer::getHeader(const string& request, const char* name)
+{
+    string::size_type start = request.find(string("\r\n") + name);
+    if (string::npos == start)
+        return string();
+
+    start += strlen(name) + 2;
+    return request.substr(start, request.find("\r\n", start) - start);
+}
+
+DWORD WINAPI TestServer::serverThreadProc(LPVOID param)
+{
+    reinterpret_cast<TestServer*>(param)->serve();
+    return 0;
+}
+
+DWORD WINAPI TestServer::connectionThreadProc(LPVOID param)
+{
+    Connection* connection = reinterpret_cast<Connection*>(param);
+    connection->server->handleConnection(connection->socket);
+    ::closesocket(connection->socket);
+    delete connection;
+    return 0;
+}
+
+void TestServer::serve()
+{
+    SOCKET socket;
+    while (INVALID_SOCKET != (socket = ::accept(_listenSocket, NULL, NULL)))
+    {
+        ::EnterCriticalSection(&_lock);
+        ++_connectionCount;
+        ::LeaveCriticalSection(&_lock);
+
+        Connection* connection = new Connection;
+        connection->server = this;
+        connection->socket = socket;
+
+        HANDLE hThread = ::CreateThread(0, 0, TestServer::connectionThreadProc, connection, 0, 0);
+        if (hThread)
+        {
+            _connectionThreads.push_back(hThread);
+        }
+        else
+        {
+            ::closesocket(socket);
+            delete connection;
+        }
+    }
+}
+
+void TestServer::handleConnection(SOCKET connection)
+{
+    // With keep-alive, the connection lasts until the client closes it, or is idle for too long
+    if (_keepAlive)
+    {
+        DWORD timeout = KEEPALIVE_TIMEOUT;
+        ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+
+    string received;
+    while (handleRequest(connection, received) && _keepAlive && !_dropAfter)
+    {
+    }
+
+    ::shutdown(connection, SD_SEND);
+}
+
+/* Answers the next request on the connection.  received holds anything read past the end
+ * of the request, for the next one. */
+BOOL TestServer::handleRequest(SOCKET connection, string& received)
+{
+    // Only the request line and a few headers matter, but read the whole header so the client isn't reset
+    char buffer[1024];
+    string::size_type headerEnd;
+    while ((headerEnd = received.find("\r\n\r\n")) == string::npos)
+    {
+        int bytesReceived = ::recv(connection, buffer, sizeof(buffer), 0);
+        if (bytesReceived <= 0)
+            return FALSE;
+        received.append(buffer, bytesReceived);
+    }
+
+    string request(received, 0, headerEnd + 4);
+    received.erase(0, headerEnd + 4);
+
+    // GET /path HTTP/1.1
+    string::size_type pathStart = request.find(' ');
+    string::size_type pathEnd = request.find(' ', pathStart + 1);
+    if (string::npos == pathStart || string::npos == pathEnd)
+        return FALSE;
+
+    string path = request.substr(pathStart + 1, pathEnd - pathStart - 1);
+
+    string status("200 OK");
+    string body;
+    string extraHeaders;
+    string range = getHeader(request, "Range: bytes=");
+    string ifRange = getHeader(request, "If-Range: ");
+    string ifNoneMatch = getHeader(request, "If-None-Match: ");
+
+    ::EnterCriticalSection(&_lock);
+    ++_requestCounts[path];
+    _lastRanges[path] = range;
+    map<string, string>::const_iterator file = _files.find(path);
+    if (0 == path.compare(0, strlen(VALIDATE_PATH), VALIDATE_PATH))
+    {
+        body = validate(path.substr(strlen(VALIDATE_PATH)));
+    }
+    else if (file != _files.end())
+    {
+        body = file->second;
+        string etag = _etags[path];
+        extraHeaders = "ETag: " + etag + "\r\n";
+
+        if (ifNoneMatch == etag)
+        {
+            ++_notModifiedCounts[path];
+            status = "304 Not Modified";
+            body.clear();
+        }
+        // Only "bytes=<start>-" ranges are supported
+        else if (!range.empty() && (ifRange.empty() || ifRange == etag))
+        {
+            size_t rangeStart = static_cast<size_t>(atol(range.c_str()));
+            if (rangeStart < body.size())
+            {
+                char contentRange[100];
+                sprintf_s(contentRange, 100, "Content-Range: bytes %u-%u/%u\r\n", static_cast<unsigned int>(rangeStart),
+                    static_cast<unsigned int>(body.size() - 1), static_cast<unsigned int>(body.size()));
+                extraHeaders.append(contentRange);
+                status = "206 Partial Content";
+                body = body.substr(rangeStart);
+            }
+            else
+            {
+                status = "416 Range Not Satisfiable";
+                body.clear();
+            }
+        }
+    }
+    else
+    {
+        status = "404 Not Found";
+        body = "<html><body>Not found</body></html>";
+    }
+    ::LeaveCriticalSection(&_lock);
+
+    if (_responseDelay)
+        ::Sleep(_responseDelay);
+
+    char header[200];
+    sprintf_s(header, 200, "HTTP/1.1 %s\r\nContent-Length: %u\r\nContent-Type: text/xml\r\nConnection: %s\r\n",
+        status.c_str(), static_cast<unsigned int>(body.size()), (_keepAlive && !_dropAfter) ? "keep-alive" : "close");
+
+    string response(header);
+    response.append(extraHeaders);
+    response.append("\r\n");
+
+    if (_dropAfter && _dropAfter < body.size())
+        response.append(body, 0, _dropAfter);
+    else
+        response.append(body);
+
+    const char* sendPosition = response.c_str();
+    int remaining = static_cast<int>(response.size());
+    while (remaining > 0)
+    {
+        int sent = ::send(connection, sendPosition, remaining, 0);
+        if (sent <= 0)
+            return FALSE;
+        sendPosition += sent;
+        remaining -= sent;
+    }
+
+    return TRUE;
+}
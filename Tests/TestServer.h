@@ -0,0 +1,93 @@
+#pragma once
+
+#include <winsock2.h>
+#include <vector>
+
+/* A stand-in for the plugin list server - serves fixed files over HTTP on 127.0.0.1,
+ * on a port chosen by the OS.  Anything not added with addFile() is a 404.
+ * Each connection is handled on its own thread, so requests can overlap.  Connections are
+ * closed after each response, unless setKeepAlive() is on.
+ *
+ * Every file has an ETag, which changes when the file is replaced.  A Range request (with
+ * If-Range) is answered with just that part of the file, and an If-None-Match with the
+ * current ETag with a 304.
+ *
+ * /validate?md5=<md5> is answered like the validate page, with the status given by
+ * setHashStatus() ("unknown" if none was), and a batch (validate?md5=<md5>,<md5>,...) with
+ * a "<md5> <status>" line for each hash.
+ */
+class TestServer
+{
+public:
+    TestServer();
+    ~TestServer();
+
+    BOOL start();
+    void stop();
+
+    void addFile(const std::string& path, const std::string& content);
+
+    /* http://127.0.0.1:<port> - append the path to get a URL */
+    tstring getBaseUrl() const;
+
+    int getRequestCount(const std::string& path);
+
+    /* Waits this long before answering each request, to stand in for network latency */
+    void setResponseDelay(DWORD delay);
+
+    /* Closes each connection after sending this many bytes of the body, 0 to send it all */
+    void setDropAfter(size_t bytes);
+
+    /* The Range header of the last request for path, or empty if it didn't have one */
+    std::string getLastRange(const std::string& path);
+
+    int getNotModifiedCount(const std::string& path);
+
+    /* Answers more than one request on each connection */
+    void setKeepAlive(BOOL keepAlive);
+
+    /* The number of connections accepted so far */
+    int getConnectionCount();
+
+    void setHashStatus(const std::string& md5, const std::string& status);
+
+    /* The number of hashes sent to /validate so far, in batches or on their own */
+    int getValidatedHashCount();
+
+private:
+    struct Connection
+    {
+        TestServer* server;
+        SOCKET      socket;
+    };
+
+    static DWORD WINAPI serverThreadProc(LPVOID param);
+    static DWORD WINAPI connectionThreadProc(LPVOID param);
+    void serve();
+    void handleConnection(SOCKET connection);
+    BOOL handleRequest(SOCKET connection, std::string& received);
+    static std::string getHeader(const std::string& request, const char* name);
+    std::string validate(const std::string& hashList);
+
+    SOCKET              _listenSocket;
+    HANDLE              _hThread;
+    int                 _port;
+    BOOL                _winsockStarted;
+    DWORD               _responseDelay;
+    size_t              _dropAfter;
+    int                 _nextEtag;
+    BOOL                _keepAlive;
+
+    // Only touched by the server thread, and by stop() once that has finished
+    std::vector<HANDLE> _connectionThreads;
+
+    CRITICAL_SECTION    _lock;
+    int                 _connectionCount;
+    std::map<std::string, std::string> _files;
+    std::map<std::string, int>         _requestCounts;
+    std::map<std::string, std::string> _etags;
+    std::map<std::string, std::string> _lastRanges;
+    std::map<std::string, int>         _notModifiedCounts;
+    std::map<std::string, std::string> _hashStatuses;
+    int                                _validatedHashCount;
+};
@@ -0,0 +1,124 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "tinyxml/tinyxml.h"
+#include "TempDirectory.h"
+
+#include <string>
+
+
+class StreamReaderTest : public ::testing::Test {
+protected:
+    StreamReaderTest()
+        : _directory(_T("srt")),
+          _filename(_directory.getFile(_T("plugins.xml")))
+    {
+    }
+
+    void writeFile(const std::string& contents)
+    {
+        FILE* file = _tfopen(_filename.c_str(), _T("wb"));
+        fwrite(contents.c_str(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    TempDirectory _directory;
+    tstring _filename;
+};
+
+
+TEST_F(StreamReaderTest, test_reads_each_child_across_chunk_boundaries) 
+{
+    writeFile("\xEF\xBB\xBF<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\r\n"
+              "<!-- list of plugins -->\r\n"
+              "<plugins version=\"2\">\r\n"
+              "  <plugin name=\"caf\xC3\xA9 > bar\">\r\n"
+              "    <description>a &lt;tag&gt;</description>\r\n"
+              "    <!-- <plugin name=\"commented\" /> -->\r\n"
+              "    <price>\xE2\x82\xAC" "5</price>\r\n"
+              "  </plugin>\r\n"
+              "  <pluginNames><name md5='abc' name=\"x/>y\" /></pluginNames>\r\n"
+              "  <plugin name=\"empty\" />\r\n"
+              "</plugins>\r\n");
+
+    // Small chunks, so that tokens and UTF-8 sequences are split between reads
+    for (size_t chunkSize = 1; chunkSize < 12; ++chunkSize)
+    {
+        TiXmlStreamReader reader;
+        reader.SetChunkSize(chunkSize);
+
+        ASSERT_TRUE(reader.Open(_filename.c_str()));
+        EXPECT_STREQ(_T("plugins"), reader.RootValue());
+
+        TiXmlElement* child = reader.NextChild();
+        ASSERT_TRUE(child != NULL);
+        EXPECT_STREQ(_T("plugin"), child->Value());
+        EXPECT_STREQ(L"caf\u00e9 > bar", child->Attribute(_T("name")));
+        EXPECT_STREQ(_T("a <tag>"), child->FirstChildElement(_T("description"))->FirstChild()->Value());
+        EXPECT_STREQ(L"\u20ac5", child->FirstChildElement(_T("price"))->FirstChild()->Value());
+
+        child = reader.NextChild();
+        ASSERT_TRUE(child != NULL);
+        EXPECT_STREQ(_T("pluginNames"), child->Value());
+        EXPECT_STREQ(_T("x/>y"), child->FirstChildElement()->Attribute(_T("name")));
+
+        child = reader.NextChild();
+        ASSERT_TRUE(child != NULL);
+        EXPECT_STREQ(_T("empty"), child->Attribute(_T("name")));
+
+        EXPECT_TRUE(reader.NextChild() == NULL);
+        EXPECT_FALSE(reader.Error());
+    }
+}
+
+TEST_F(StreamReaderTest, test_cdata_is_read_as_text)
+{
+    writeFile("<plugins>\n"
+              "  <plugin name=\"a\">\n"
+              "    <description><![CDATA[a > b <i> </description> <plugin>]]></description>\n"
+              "    <version>1.0</version>\n"
+              "  </plugin>\n"
+              "  <plugin name=\"b\" />\n"
+              "</plugins>\n");
+
+    for (size_t chunkSize = 1; chunkSize < 12; ++chunkSize)
+    {
+        TiXmlStreamReader reader;
+        reader.SetChunkSize(chunkSize);
+        ASSERT_TRUE(reader.Open(_filename.c_str()));
+
+        TiXmlElement* child = reader.NextChild();
+        ASSERT_TRUE(child != NULL);
+        EXPECT_STREQ(_T("a"), child->Attribute(_T("name")));
+        EXPECT_STREQ(_T("a > b <i> </description> <plugin>"), child->FirstChildElement(_T("description"))->FirstChild()->Value());
+        EXPECT_STREQ(_T("1.0"), child->FirstChildElement(_T("version"))->FirstChild()->Value());
+
+        child = reader.NextChild();
+        ASSERT_TRUE(child != NULL);
+        EXPECT_STREQ(_T("b"), child->Attribute(_T("name")));
+
+        EXPECT_TRUE(reader.NextChild() == NULL);
+        EXPECT_FALSE(reader.Error());
+    }
+}
+
+TEST_F(StreamReaderTest, test_unclosed_root_is_an_error)
+{
+    writeFile("<plugins>\n  <plugin name=\"a\" />\n  <plugin name=\"b\">\n");
+
+    TiXmlStreamReader reader;
+    ASSERT_TRUE(reader.Open(_filename.c_str()));
+
+    EXPECT_TRUE(reader.NextChild() != NULL);
+    EXPECT_TRUE(reader.NextChild() == NULL);
+    EXPECT_TRUE(reader.Error());
+}
+
+TEST_F(StreamReaderTest, test_missing_file_is_an_error)
+{
+    ::DeleteFile(_filename.c_str());
+
+    TiXmlStreamReader reader;
+    EXPECT_FALSE(reader.Open(_filename.c_str()));
+    EXPECT_TRUE(reader.Error());
+}
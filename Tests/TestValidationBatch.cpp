@@ -0,0 +1,218 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/Validate.h"
+#include "libinstall/ValidationDatabase.h"
+#include "libinstall/ValidationCache.h"
+#include "libinstall/CopyStep.h"
+#include "libinstall/md5.h"
+#include "libinstall/CancelToken.h"
+#include "libinstall/ModuleInfo.h"
+#include "libinstall/WcharMbcsConverter.h"
+#include "TestServer.h"
+#include "TempDirectory.h"
+
+
+class ValidationBatchTest : public ::testing::Test {
+protected:
+    ValidationBatchTest()
+        : _directory(_T("vbt")),
+          _moduleInfo(NULL, NULL)
+    {
+    }
+
+    virtual void SetUp()
+    {
+        ASSERT_TRUE(_server.start());
+        _validateUrl = _server.getBaseUrl() + _T("/validate?md5=");
+    }
+
+    virtual void TearDown()
+    {
+        Validator::setDatabaseFilename(tstring());
+        Validator::setCacheFilename(tstring());
+        _server.stop();
+    }
+
+    static tstring hashOf(const char* content)
+    {
+        TCHAR hashBuffer[(MD5::HASH_LENGTH * 2) + 1];
+        MD5::hash(reinterpret_cast<const BYTE*>(content), strlen(content), hashBuffer, (MD5::HASH_LENGTH * 2) + 1);
+        return tstring(hashBuffer);
+    }
+
+    void setStatus(const tstring& md5, const char* status)
+    {
+        _server.setHashStatus(WcharMbcsConverter::tchar2char(md5.c_str()).get(), status);
+    }
+
+    static void writeFile(const tstring& filename, const char* content)
+    {
+        FILE* file = _tfopen(filename.c_str(), _T("wb"));
+        ASSERT_TRUE(file != NULL);
+        fwrite(content, 1, strlen(content), file);
+        fclose(file);
+    }
+
+    TempDirectory _directory;
+    TestServer  _server;
+    ModuleInfo  _moduleInfo;
+    CancelToken _cancelToken;
+    tstring     _validateUrl;
+};
+
+
+TEST_F(ValidationBatchTest, test_resolves_hashes_with_one_request)
+{
+    tstring good = hashOf("good");
+    tstring banned = hashOf("banned");
+    tstring unknown = hashOf("unknown");
+    setStatus(good, VALIDATE_RESULT_OK);
+    setStatus(banned, VALIDATE_RESULT_BANNED);
+
+    ValidationBatch batch;
+    batch.add(good);
+    batch.add(banned);
+    batch.add(unknown);
+    batch.add(good);
+    batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+
+    EXPECT_EQ(1, batch.getRequestCount());
+    EXPECT_EQ(3, _server.getValidatedHashCount());
+
+    EXPECT_EQ(VALIDATE_OK, batch.getStatus(_validateUrl, good, _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_BANNED, batch.getStatus(_validateUrl, banned, _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_UNKNOWN, batch.getStatus(_validateUrl, unknown, _cancelToken, &_moduleInfo));
+
+    // Results are kept, so resolving them again sends nothing
+    batch.add(good);
+    batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+    EXPECT_EQ(1, batch.getRequestCount());
+
+    // Anything not in a batch is validated on its own
+    tstring later = hashOf("later");
+    setStatus(later, VALIDATE_RESULT_OK);
+    EXPECT_EQ(VALIDATE_OK, batch.getStatus(_validateUrl, later, _cancelToken, &_moduleInfo));
+    EXPECT_EQ(2, batch.getRequestCount());
+}
+
+TEST_F(ValidationBatchTest, test_failed_batch_is_unknown)
+{
+    _server.stop();
+
+    ValidationBatch batch;
+    batch.add(hashOf("first"));
+    batch.add(hashOf("second"));
+    batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+
+    EXPECT_EQ(VALIDATE_UNKNOWN, batch.getStatus(_validateUrl, hashOf("first"), _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_UNKNOWN, batch.getStatus(_validateUrl, hashOf("second"), _cancelToken, &_moduleInfo));
+    EXPECT_EQ(1, batch.getRequestCount());
+}
+
+TEST_F(ValidationBatchTest, test_copy_step_validates_all_its_files_together)
+{
+    tstring fromDir(_directory.getFile(_T("from\\")));
+    tstring toDir(_directory.getFile(_T("to")));
+    ::CreateDirectory(fromDir.c_str(), NULL);
+    ::CreateDirectory((fromDir + _T("docs")).c_str(), NULL);
+
+    writeFile(fromDir + _T("First.dll"), "first");
+    writeFile(fromDir + _T("Second.dll"), "second");
+    writeFile(fromDir + _T("docs\\readme.txt"), "readme");
+    setStatus(hashOf("first"), VALIDATE_RESULT_OK);
+    setStatus(hashOf("second"), VALIDATE_RESULT_OK);
+    setStatus(hashOf("readme"), VALIDATE_RESULT_OK);
+
+    ValidationBatch batch;
+    CopyStep copyStep(_T("*.*"), toDir.c_str(), NULL, TRUE, TRUE, FALSE, FALSE, TRUE, _validateUrl);
+    copyStep.setValidationBatch(&batch);
+
+    TiXmlElement forGpup(_T("install"));
+    StepStatus status = copyStep.perform(fromDir, &forGpup,
+        [](const TCHAR*) {}, [](const int) {}, &_moduleInfo, _cancelToken);
+
+    EXPECT_EQ(STEPSTATUS_SUCCESS, status);
+    EXPECT_EQ(1, batch.getRequestCount());
+    EXPECT_EQ(3, _server.getValidatedHashCount());
+    EXPECT_TRUE(::PathFileExists((toDir + _T("\\First.dll")).c_str()));
+    EXPECT_TRUE(::PathFileExists((toDir + _T("\\docs\\readme.txt")).c_str()));
+}
+
+TEST_F(ValidationBatchTest, test_database_answers_without_the_server)
+{
+    tstring databaseFilename(_directory.getFile(VALIDATIONDB_FILENAME));
+
+    std::map<tstring, ValidateStatus> hashes;
+    for (int i = 0; i < 100; ++i)
+    {
+        char content[20];
+        sprintf_s(content, 20, "file %d", i);
+        hashes[hashOf(content)] = (i % 10) ? VALIDATE_OK : VALIDATE_BANNED;
+    }
+    ASSERT_TRUE(ValidationDatabase::save(databaseFilename.c_str(), hashes));
+
+    ValidationDatabase database;
+    ASSERT_TRUE(database.open(databaseFilename.c_str()));
+    EXPECT_EQ(100u, database.getCount());
+
+    ValidateStatus status;
+    for (std::map<tstring, ValidateStatus>::const_iterator it = hashes.begin(); it != hashes.end(); ++it)
+    {
+        ASSERT_TRUE(database.lookup(it->first, status));
+        EXPECT_EQ(it->second, status);
+    }
+    EXPECT_FALSE(database.lookup(hashOf("not there"), status));
+    EXPECT_FALSE(database.lookup(_T("not a hash"), status));
+    database.close();
+
+    // Only the hash that isn't in the database goes to the server
+    Validator::setDatabaseFilename(databaseFilename);
+    tstring online = hashOf("online");
+    setStatus(online, VALIDATE_RESULT_OK);
+
+    ValidationBatch batch;
+    batch.add(hashOf("file 1"));
+    batch.add(hashOf("file 10"));
+    batch.add(online);
+    batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+
+    EXPECT_EQ(1, _server.getValidatedHashCount());
+    EXPECT_EQ(VALIDATE_OK, batch.getStatus(_validateUrl, hashOf("file 1"), _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_BANNED, batch.getStatus(_validateUrl, hashOf("file 10"), _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_OK, batch.getStatus(_validateUrl, online, _cancelToken, &_moduleInfo));
+
+    EXPECT_EQ(VALIDATE_BANNED, Validator::validateHash(_validateUrl, hashOf("file 20"), _cancelToken, &_moduleInfo));
+    EXPECT_EQ(1, _server.getValidatedHashCount());
+}
+
+TEST_F(ValidationBatchTest, test_answers_are_cached_between_installs)
+{
+    Validator::setCacheFilename(_directory.getFile(VALIDATIONCACHE_FILENAME));
+
+    tstring good = hashOf("good");
+    tstring banned = hashOf("banned");
+    setStatus(good, VALIDATE_RESULT_OK);
+    setStatus(banned, VALIDATE_RESULT_BANNED);
+
+    {
+        ValidationBatch batch;
+        batch.add(good);
+        batch.add(banned);
+        batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+        EXPECT_EQ(2, _server.getValidatedHashCount());
+    }
+
+    // A later install (or gpup) doesn't ask again
+    size_t hits = Validator::getCacheHitCount();
+    ValidationBatch batch;
+    batch.add(good);
+    batch.add(banned);
+    batch.resolve(_validateUrl, _cancelToken, &_moduleInfo);
+    EXPECT_EQ(VALIDATE_BANNED, batch.getStatus(_validateUrl, banned, _cancelToken, &_moduleInfo));
+    EXPECT_EQ(VALIDATE_OK, Validator::validateHash(_validateUrl, good, _cancelToken, &_moduleInfo));
+
+    EXPECT_EQ(0, batch.getRequestCount());
+    EXPECT_EQ(2, _server.getValidatedHashCount());
+    EXPECT_EQ(hits + 3, Validator::getCacheHitCount());
+}
@@ -0,0 +1,124 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/ValidationCache.h"
+#include "TempDirectory.h"
+
+#define FIRST_MD5   _T("0123456789abcdef0123456789abcdef")
+#define SECOND_MD5  _T("fedcba9876543210fedcba9876543210")
+#define THIRD_MD5   _T("00000000000000000000000000000000")
+
+
+class ValidationCacheTest : public ::testing::Test {
+protected:
+    // No cache yet
+    ValidationCacheTest()
+        : _directory(_T("vct")),
+          _filename(_directory.getFile(VALIDATIONCACHE_FILENAME))
+    {
+    }
+
+    TempDirectory _directory;
+    tstring _filename;
+};
+
+
+TEST_F(ValidationCacheTest, test_verdicts_are_kept)
+{
+    ValidationCache cache(_filename);
+    EXPECT_FALSE(cache.load());
+    cache.add(FIRST_MD5, VALIDATE_OK);
+    cache.add(SECOND_MD5, VALIDATE_BANNED);
+    ASSERT_TRUE(cache.save());
+
+    ValidationCache loadedCache(_filename);
+    ASSERT_TRUE(loadedCache.load());
+    EXPECT_EQ(2u, loadedCache.getEntryCount());
+
+    ValidateStatus status;
+    EXPECT_TRUE(loadedCache.lookup(FIRST_MD5, status));
+    EXPECT_EQ(VALIDATE_OK, status);
+    EXPECT_TRUE(loadedCache.lookup(SECOND_MD5, status));
+    EXPECT_EQ(VALIDATE_BANNED, status);
+    EXPECT_FALSE(loadedCache.lookup(THIRD_MD5, status));
+
+    EXPECT_EQ(2u, loadedCache.getHitCount());
+    EXPECT_EQ(1u, loadedCache.getMissCount());
+}
+
+TEST_F(ValidationCacheTest, test_expired_verdicts_are_not_used)
+{
+    ValidationCache cache(_filename);
+    cache.setTtl(VALIDATE_UNKNOWN, 0);
+    cache.add(FIRST_MD5, VALIDATE_OK);
+    cache.add(SECOND_MD5, VALIDATE_UNKNOWN);
+
+    ValidateStatus status;
+    EXPECT_FALSE(cache.lookup(SECOND_MD5, status));
+    ASSERT_TRUE(cache.save());
+
+    // Expired entries are dropped when the cache is read
+    ValidationCache loadedCache(_filename);
+    ASSERT_TRUE(loadedCache.load());
+    EXPECT_EQ(1u, loadedCache.getEntryCount());
+    EXPECT_FALSE(loadedCache.lookup(SECOND_MD5, status));
+}
+
+TEST_F(ValidationCacheTest, test_save_keeps_verdicts_of_other_processes)
+{
+    // Both loaded before either saves, as by Plugin Manager and gpup at once
+    ValidationCache first(_filename);
+    ValidationCache second(_filename);
+    first.load();
+    second.load();
+
+    first.add(FIRST_MD5, VALIDATE_OK);
+    second.add(SECOND_MD5, VALIDATE_BANNED);
+    ASSERT_TRUE(first.save());
+    ASSERT_TRUE(second.save());
+
+    ValidationCache loadedCache(_filename);
+    ASSERT_TRUE(loadedCache.load());
+    ValidateStatus status;
+    EXPECT_TRUE(loadedCache.lookup(FIRST_MD5, status));
+    EXPECT_TRUE(loadedCache.lookup(SECOND_MD5, status));
+}
+
+TEST_F(ValidationCacheTest, test_locked_cache_is_empty)
+{
+    ValidationCache cache(_filename);
+    cache.add(FIRST_MD5, VALIDATE_OK);
+    ASSERT_TRUE(cache.save());
+
+    // Another process with the file open for longer than the cache waits for it
+    HANDLE hFile = ::CreateFile(_filename.c_str(), GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ASSERT_NE(INVALID_HANDLE_VALUE, hFile);
+
+    ValidationCache lockedCache(_filename);
+    EXPECT_FALSE(lockedCache.load());
+    lockedCache.add(SECOND_MD5, VALIDATE_OK);
+    EXPECT_FALSE(lockedCache.save());
+    ::CloseHandle(hFile);
+
+    ValidationCache loadedCache(_filename);
+    ASSERT_TRUE(loadedCache.load());
+    EXPECT_EQ(1u, loadedCache.getEntryCount());
+}
+
+TEST_F(ValidationCacheTest, test_damaged_cache_is_empty)
+{
+    HANDLE hFile = ::CreateFile(_filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ASSERT_NE(INVALID_HANDLE_VALUE, hFile);
+    DWORD bytesWritten;
+    ::WriteFile(hFile, "PMVC and then some", 18, &bytesWritten, NULL);
+    ::CloseHandle(hFile);
+
+    ValidationCache cache(_filename);
+    EXPECT_FALSE(cache.load());
+
+    // and is replaced by the next save
+    cache.add(FIRST_MD5, VALIDATE_OK);
+    ASSERT_TRUE(cache.save());
+    ValidationCache loadedCache(_filename);
+    EXPECT_TRUE(loadedCache.load());
+}
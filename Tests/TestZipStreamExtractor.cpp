@@ -0,0 +1,162 @@
+#include "precompiled_headers.h"
+
+#include "gtest/gtest.h"
+#include "libinstall/ZipStreamExtractor.h"
+#include "TempDirectory.h"
+
+
+// "hello hello hello hello hello hello\n", deflated
+static const char DEFLATED[] = "\xcb\x48\xcd\xc9\xc9\x57\xc8\xc0\x47\x72\x01\x00";
+static const DWORD DEFLATED_CRC = 0xc75da0f3;
+static const DWORD DEFLATED_SIZE = 36;
+
+static const DWORD HELLO_CRC = 0x3610a686;
+
+
+class ZipStreamExtractorTest : public ::testing::Test {
+protected:
+    ZipStreamExtractorTest()
+        : _directory(_T("zse")),
+          _destDir(_directory.getPath() + _T("\\"))
+    {
+    }
+
+    static void appendWord(std::string& zip, WORD value)
+    {
+        zip.push_back(static_cast<char>(value & 0xFF));
+        zip.push_back(static_cast<char>(value >> 8));
+    }
+
+    static void appendDword(std::string& zip, DWORD value)
+    {
+        appendWord(zip, static_cast<WORD>(value & 0xFFFF));
+        appendWord(zip, static_cast<WORD>(value >> 16));
+    }
+
+    static void addEntry(std::string& zip, const char* name, WORD flags, WORD method, DWORD crc, const std::string& data, DWORD uncompressedSize)
+    {
+        appendDword(zip, 0x04034b50);
+        appendWord(zip, 20);
+        appendWord(zip, flags);
+        appendWord(zip, method);
+        appendDword(zip, 0);
+        appendDword(zip, crc);
+        appendDword(zip, static_cast<DWORD>(data.size()));
+        appendDword(zip, uncompressedSize);
+        appendWord(zip, static_cast<WORD>(strlen(name)));
+        appendWord(zip, 0);
+        zip.append(name);
+        zip.append(data);
+    }
+
+    // Just the start of it - the extractor stops at the signature
+    static void addCentralDirectory(std::string& zip)
+    {
+        appendDword(zip, 0x02014b50);
+        zip.append(42, '\0');
+    }
+
+    std::string makeZip()
+    {
+        std::string zip;
+        addEntry(zip, "a.txt", 0, 0, HELLO_CRC, "hello", 5);
+        addEntry(zip, "dir/", 0, 0, 0, std::string(), 0);
+        addEntry(zip, "dir/b.txt", 0, 8, DEFLATED_CRC, std::string(DEFLATED, sizeof(DEFLATED) - 1), DEFLATED_SIZE);
+        addCentralDirectory(zip);
+        return zip;
+    }
+
+    // Gives the extractor the zip a few bytes at a time, as a slow download would
+    void writeInParts(ZipStreamExtractor& extractor, const std::string& zip, size_t partSize)
+    {
+        for (size_t offset = 0; offset < zip.size(); offset += partSize)
+        {
+            size_t length = min(partSize, zip.size() - offset);
+            extractor.write(offset, reinterpret_cast<const BYTE*>(zip.c_str() + offset), static_cast<DWORD>(length));
+        }
+    }
+
+    std::string readFile(const tstring& filename)
+    {
+        std::string contents;
+        char buffer[1024];
+        FILE* file = _tfopen(filename.c_str(), _T("rb"));
+        if (file)
+        {
+            size_t bytesRead;
+            while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                contents.append(buffer, bytesRead);
+            fclose(file);
+        }
+        return contents;
+    }
+
+    TempDirectory _directory;
+    tstring _destDir;
+};
+
+
+TEST_F(ZipStreamExtractorTest, test_entries_are_extracted_as_they_arrive)
+{
+    ZipStreamExtractor extractor(_destDir);
+    writeInParts(extractor, makeZip(), 7);
+
+    EXPECT_TRUE(extractor.isComplete());
+    EXPECT_EQ(std::string("hello"), readFile(_destDir + _T("a.txt")));
+    EXPECT_EQ(std::string("hello hello hello hello hello hello\n"), readFile(_destDir + _T("dir\\b.txt")));
+}
+
+TEST_F(ZipStreamExtractorTest, test_data_descriptor_gives_up)
+{
+    std::string zip;
+    addEntry(zip, "a.txt", 0x0008, 0, 0, "hello", 0);
+    addCentralDirectory(zip);
+
+    ZipStreamExtractor extractor(_destDir);
+    writeInParts(extractor, zip, 7);
+
+    EXPECT_FALSE(extractor.isComplete());
+    EXPECT_TRUE(extractor.hasFailed());
+}
+
+TEST_F(ZipStreamExtractorTest, test_bad_crc_gives_up)
+{
+    std::string zip;
+    addEntry(zip, "a.txt", 0, 0, HELLO_CRC + 1, "hello", 5);
+    addCentralDirectory(zip);
+
+    ZipStreamExtractor extractor(_destDir);
+    writeInParts(extractor, zip, 1000);
+
+    EXPECT_TRUE(extractor.hasFailed());
+}
+
+TEST_F(ZipStreamExtractorTest, test_not_a_zip_gives_up)
+{
+    ZipStreamExtractor extractor(_destDir);
+    writeInParts(extractor, "<html><body>Not found</body></html>", 1000);
+
+    EXPECT_TRUE(extractor.hasFailed());
+}
+
+TEST_F(ZipStreamExtractorTest, test_continued_download_gives_up)
+{
+    std::string zip = makeZip();
+
+    ZipStreamExtractor extractor(_destDir);
+    extractor.write(10, reinterpret_cast<const BYTE*>(zip.c_str() + 10), static_cast<DWORD>(zip.size() - 10));
+
+    EXPECT_TRUE(extractor.hasFailed());
+}
+
+TEST_F(ZipStreamExtractorTest, test_download_started_again_is_extracted)
+{
+    std::string zip = makeZip();
+
+    ZipStreamExtractor extractor(_destDir);
+    extractor.write(0, reinterpret_cast<const BYTE*>(zip.c_str()), 20);
+    writeInParts(extractor, zip, 1000);
+
+    EXPECT_TRUE(extractor.isComplete());
+    EXPECT_EQ(std::string("hello"), readFile(_destDir + _T("a.txt")));
+}
@@ -9,10 +9,15 @@
 
 #include <stdio.h>
 #include <tchar.h>
+#include <string>
+#include <map>
+#include <memory>
+#include <functional>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
+typedef std::basic_string<TCHAR>			tstring;
 
 
 // TODO: reference additional headers your program requires here
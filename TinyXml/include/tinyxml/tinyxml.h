@@ -54,6 +54,7 @@ distribution.
 #ifdef TIXML_USE_STL
 	#include <string>
  	#include <iostream>
+	#include <vector>
     //#include <ostream>
 	#define TIXML_STRING	std::generic_string
 	//#define TIXML_ISTREAM	std::istream
@@ -126,6 +127,7 @@ class TiXmlBase
 	friend class TiXmlNode;
 	friend class TiXmlElement;
 	friend class TiXmlDocument;
+	friend class TiXmlStreamReader;
 
 public:
 	TiXmlBase()								{}
@@ -1265,5 +1267,107 @@ private:
 };
 
 
+
+#ifdef TIXML_USE_STL
+
+/** A pull reader for large documents, where only the children of the root element
+	are of interest. Rather than loading the whole file into a DOM, the file is read
+	in chunks, and each child of the root element is parsed on its own, when it is
+	asked for. Peak memory is then the size of the largest child, not the document.
+
+	The file is assumed to be UTF-8, and is converted in the same way as LoadFile().
+	@verbatim
+	TiXmlStreamReader reader;
+	if ( reader.Open( "catalog.xml" ) )
+	{
+		while ( TiXmlElement* child = reader.NextChild() )
+		{
+			// child is only valid until the next call to NextChild()
+		}
+		if ( reader.Error() )
+			...
+	}
+	@endverbatim
+*/
+class TiXmlStreamReader
+{
+public:
+	TiXmlStreamReader();
+	~TiXmlStreamReader();
+
+	/** Opens the file and reads up to the end of the start tag of the root element.
+		Returns false if the file could not be opened or has no root element.
+	*/
+	bool Open( const TCHAR* filename );
+	/// Closes the file. Called automatically by the destructor.
+	void Close();
+
+	/// The name of the root element. Valid after a successful Open().
+	const TCHAR* RootValue() const			{ return rootValue.c_str(); }
+
+	/** Reads the next child element of the root element into source, without parsing it.
+		Text, comments and processing instructions between the children are skipped.
+		Returns false at the end of the root element, or if an error occured.
+	*/
+	bool NextChildSource( TIXML_STRING* source );
+
+	/** Reads and parses the next child element of the root element. The element is
+		owned by the reader, and is deleted by the next call. Returns null at the end
+		of the root element, or if an error occured.
+	*/
+	TiXmlElement* NextChild();
+
+	/** Parses source, as returned by NextChildSource(), into the document the reader
+		uses for its children. Returns the element, or null on an error.
+	*/
+	TiXmlElement* ParseChild( const TIXML_STRING& source );
+
+	/// True if an error occured reading or parsing the file.
+	bool Error() const						{ return document.Error(); }
+	/// A description of the error, if one occured.
+	const TCHAR* ErrorDesc() const			{ return document.ErrorDesc(); }
+	/// The row of the file the error occured in.
+	int ErrorRow()							{ return childRow + document.ErrorRow(); }
+	/// The column of the error. For errors within a child, this is only correct on the first row of the child.
+	int ErrorCol()							{ return document.ErrorCol(); }
+
+	/** The row (0 based) the last child returned by NextChildSource() started on. Add
+		this to the error row of a document the source was parsed into separately.
+	*/
+	int ChildRow() const					{ return childRow; }
+
+	/// The number of bytes read from the file at a time. Must be set before Open().
+	void SetChunkSize( size_t _chunkSize )	{ chunkSize = _chunkSize; }
+
+private:
+	TiXmlStreamReader( const TiXmlStreamReader& );				// not implemented.
+	void operator=( const TiXmlStreamReader& );					// not implemented.
+
+	bool ReadChunk();
+	bool Fill( size_t length );
+	bool Find( const TCHAR* token, size_t from, size_t* found );
+	bool SkipMarkup( size_t start, size_t* end );
+	bool ScanTag( size_t start, size_t* end, bool* isEmpty );
+	bool ScanElement( size_t start, size_t* end );
+	void Advance( size_t newPos );
+	void SetError( int err );
+
+	FILE*				file;
+	size_t				chunkSize;
+	bool				firstChunk;
+	bool				pendingCR;
+	std::vector<char>	pending;		// Bytes of an incomplete UTF-8 sequence at the end of the last chunk
+
+	TIXML_STRING		buffer;			// Decoded text that has not yet been consumed
+	size_t				pos;			// Position in buffer of the next character to read
+	int					row;			// Row of pos in the file (0 based)
+	int					childRow;		// Row of the start of the last child
+
+	TIXML_STRING		rootValue;
+	bool				rootEnded;
+	TiXmlDocument		document;		// Holds the last child parsed
+};
+
 #endif
 
+#endif
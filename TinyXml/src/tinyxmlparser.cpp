@@ -521,11 +521,13 @@ TiXmlNode* TiXmlNode::Identify( const TCHAR* p )
 	// - Elements start with a letter or underscore, but xml is reserved.
 	// - Comments: <!--
 	// - Decleration: <?xml
+	// - CDATA sections: <![CDATA[ (read as text)
 	// - Everthing else is unknown to tinyxml.
 	//
 
 	const TCHAR* xmlHeader = { TEXT("<?xml") };
 	const TCHAR* commentHeader = { TEXT("<!--") };
+	const TCHAR* cdataHeader = { TEXT("<![CDATA[") };
 
 	if ( StringEqual( p, xmlHeader, true ) )
 	{
@@ -549,6 +551,13 @@ TiXmlNode* TiXmlNode::Identify( const TCHAR* p )
 		#endif
 		returnNode = new TiXmlComment();
 	}
+	else if ( StringEqual( p, cdataHeader, false ) )
+	{
+		#ifdef DEBUG_PARSER
+			TIXML_LOG( "XML parsing CDATA\n" );
+		#endif
+		returnNode = new TiXmlText( TEXT("") );
+	}
 	else
 	{
 		#ifdef DEBUG_PARSER
@@ -1050,6 +1059,21 @@ const TCHAR* TiXmlText::Parse( const TCHAR* p, TiXmlParsingData* data )
 	}
 	bool ignoreWhite = true;
 
+	// A CDATA section is taken as it is, markup and all, up to the ]]>
+	const TCHAR* cdataHeader = TEXT("<![CDATA[");
+	if ( StringEqual( p, cdataHeader, false ) )
+	{
+		p += _tcslen( cdataHeader );
+		while ( *p && !StringEqual( p, TEXT("]]>"), false ) )
+		{
+			value += *p;
+			++p;
+		}
+		if ( !*p )
+			return 0;
+		return p + 3;
+	}
+
 	const TCHAR* end = TEXT("<");
 	p = ReadText( p, &value, ignoreWhite, end, false );
 	if ( p )
@@ -1142,3 +1166,431 @@ bool TiXmlText::Blank() const
 	return true;
 }
 
+
+
+#ifdef TIXML_USE_STL
+
+TiXmlStreamReader::TiXmlStreamReader()
+	: file( 0 ),
+	  chunkSize( 64 * 1024 ),
+	  firstChunk( true ),
+	  pendingCR( false ),
+	  pos( 0 ),
+	  row( 0 ),
+	  childRow( 0 ),
+	  rootEnded( true )
+{
+}
+
+TiXmlStreamReader::~TiXmlStreamReader()
+{
+	Close();
+}
+
+bool TiXmlStreamReader::Open( const TCHAR* filename )
+{
+	Close();
+	document.Clear();
+	document.ClearError();
+
+	file = generic_fopen( filename, TEXT("rb") );
+	if ( !file )
+	{
+		SetError( TiXmlBase::TIXML_ERROR_OPENING_FILE );
+		return false;
+	}
+
+	buffer.reserve( chunkSize * 2 );
+
+	// Skip over the declaration, comments etc. to the root element.
+	size_t lt;
+	while ( Find( TEXT("<"), pos, &lt ) )
+	{
+		Advance( lt );
+		if ( !Fill( pos + 2 ) )
+			break;
+
+		if ( buffer[pos + 1] == '?' || buffer[pos + 1] == '!' )
+		{
+			size_t end;
+			if ( !SkipMarkup( pos, &end ) )
+				break;
+			Advance( end );
+			continue;
+		}
+
+		size_t end;
+		bool isEmpty;
+		if ( !ScanTag( pos, &end, &isEmpty ) )
+		{
+			SetError( TiXmlBase::TIXML_ERROR_PARSING_ELEMENT );
+			return false;
+		}
+
+		size_t nameEnd = pos + 1;
+		while ( nameEnd < end && !_istspace( buffer[nameEnd] ) && buffer[nameEnd] != '/' && buffer[nameEnd] != '>' )
+			++nameEnd;
+
+		rootValue.assign( buffer, pos + 1, nameEnd - pos - 1 );
+		rootEnded = isEmpty;
+		Advance( end );
+		return true;
+	}
+
+	SetError( TiXmlBase::TIXML_ERROR_DOCUMENT_EMPTY );
+	return false;
+}
+
+void TiXmlStreamReader::Close()
+{
+	if ( file )
+	{
+		fclose( file );
+		file = 0;
+	}
+
+	buffer.clear();
+	pending.clear();
+	pos = 0;
+	row = 0;
+	childRow = 0;
+	firstChunk = true;
+	pendingCR = false;
+	rootEnded = true;
+	rootValue.clear();
+}
+
+bool TiXmlStreamReader::NextChildSource( TIXML_STRING* source )
+{
+	if ( rootEnded || document.Error() )
+		return false;
+
+	size_t lt;
+	while ( Find( TEXT("<"), pos, &lt ) )
+	{
+		Advance( lt );
+		if ( !Fill( pos + 2 ) )
+			break;
+
+		if ( buffer[pos + 1] == '/' )
+		{
+			// End tag of the root element
+			rootEnded = true;
+			return false;
+		}
+
+		if ( buffer[pos + 1] == '?' || buffer[pos + 1] == '!' )
+		{
+			size_t end;
+			if ( !SkipMarkup( pos, &end ) )
+				break;
+			Advance( end );
+			continue;
+		}
+
+		size_t end;
+		if ( !ScanElement( pos, &end ) )
+		{
+			SetError( TiXmlBase::TIXML_ERROR_PARSING_ELEMENT );
+			return false;
+		}
+
+		childRow = row;
+		source->assign( buffer, pos, end - pos );
+		Advance( end );
+
+		// Drop what has been read, once it is worth the copy
+		if ( pos > chunkSize )
+		{
+			buffer.erase( 0, pos );
+			pos = 0;
+		}
+		return true;
+	}
+
+	// Ran out of file before the root element was closed
+	SetError( TiXmlBase::TIXML_ERROR_READING_END_TAG );
+	return false;
+}
+
+TiXmlElement* TiXmlStreamReader::NextChild()
+{
+	TIXML_STRING source;
+	if ( !NextChildSource( &source ) )
+		return 0;
+
+	return ParseChild( source );
+}
+
+TiXmlElement* TiXmlStreamReader::ParseChild( const TIXML_STRING& source )
+{
+	document.Clear();
+	document.Parse( source.c_str(), 0 );
+	if ( document.Error() )
+		return 0;
+
+	return document.RootElement();
+}
+
+bool TiXmlStreamReader::ReadChunk()
+{
+	if ( !file )
+		return false;
+
+	std::vector<char> bytes( pending );
+	size_t pendingSize = bytes.size();
+	bytes.resize( pendingSize + chunkSize );
+	size_t bytesRead = fread( &bytes[pendingSize], 1, chunkSize, file );
+	bytes.resize( pendingSize + bytesRead );
+	pending.clear();
+
+	bool atEnd = ( bytesRead < chunkSize );
+	if ( atEnd )
+	{
+		fclose( file );
+		file = 0;
+	}
+
+	size_t start = 0;
+	if ( firstChunk )
+	{
+		firstChunk = false;
+		// Skip the UTF-8 byte order mark
+		if ( bytes.size() >= 3 && (unsigned char)bytes[0] == 0xEF && (unsigned char)bytes[1] == 0xBB && (unsigned char)bytes[2] == 0xBF )
+			start = 3;
+	}
+
+	size_t complete = bytes.size();
+
+#ifdef UNICODE
+	// Keep back an incomplete UTF-8 sequence at the end of the chunk, for the next read
+	if ( !atEnd )
+	{
+		for ( size_t back = 1; back <= 4 && back <= complete - start; ++back )
+		{
+			unsigned char lead = (unsigned char)bytes[complete - back];
+			if ( ( lead & 0xC0 ) == 0x80 )
+				continue;
+
+			size_t sequenceLength = 1;
+			if ( lead >= 0xF0 )
+				sequenceLength = 4;
+			else if ( lead >= 0xE0 )
+				sequenceLength = 3;
+			else if ( lead >= 0xC0 )
+				sequenceLength = 2;
+
+			if ( sequenceLength > back )
+				complete -= back;
+			break;
+		}
+		pending.assign( bytes.begin() + complete, bytes.end() );
+	}
+
+	std::vector<wchar_t> text;
+	if ( complete > start )
+	{
+		int length = MultiByteToWideChar( CP_UTF8, 0, &bytes[start], (int)( complete - start ), 0, 0 );
+		if ( length > 0 )
+		{
+			text.resize( length );
+			MultiByteToWideChar( CP_UTF8, 0, &bytes[start], (int)( complete - start ), &text[0], length );
+		}
+	}
+#else
+	std::vector<char> text( bytes.begin() + start, bytes.end() );
+#endif
+
+	// Drop the \r of \r\n pairs, as reading the file in text mode does
+	size_t appended = 0;
+	for ( size_t i = 0; i < text.size(); ++i )
+	{
+		if ( pendingCR )
+		{
+			pendingCR = false;
+			if ( text[i] != '\n' )
+			{
+				buffer += '\r';
+				++appended;
+			}
+		}
+
+		if ( text[i] == '\r' )
+		{
+			pendingCR = true;
+		}
+		else
+		{
+			buffer += text[i];
+			++appended;
+		}
+	}
+
+	if ( atEnd && pendingCR )
+	{
+		pendingCR = false;
+		buffer += '\r';
+		++appended;
+	}
+
+	// A chunk that was all \r or an incomplete sequence still made progress, unless it was the last
+	return appended > 0 || file != 0;
+}
+
+bool TiXmlStreamReader::Fill( size_t length )
+{
+	while ( buffer.length() < length )
+	{
+		if ( !ReadChunk() )
+			return false;
+	}
+	return true;
+}
+
+bool TiXmlStreamReader::Find( const TCHAR* token, size_t from, size_t* found )
+{
+	size_t tokenLength = _tcslen( token );
+	for ( ;; )
+	{
+		size_t index = buffer.find( token, from );
+		if ( index != TIXML_STRING::npos )
+		{
+			*found = index;
+			return true;
+		}
+
+		// The token may be split across the end of the buffer
+		if ( buffer.length() >= tokenLength && from < buffer.length() - tokenLength + 1 )
+			from = buffer.length() - tokenLength + 1;
+
+		if ( !ReadChunk() )
+			return false;
+	}
+}
+
+bool TiXmlStreamReader::SkipMarkup( size_t start, size_t* end )
+{
+	size_t found;
+	Fill( start + 9 );
+
+	// Skipped in the same way as the parser reads them - comments to -->,
+	// CDATA sections to ]]>, declarations to ?> and anything else (e.g. <!DOCTYPE)
+	// to the next >
+	if ( buffer.compare( start, 4, TEXT("<!--") ) == 0 )
+	{
+		if ( !Find( TEXT("-->"), start + 4, &found ) )
+			return false;
+		*end = found + 3;
+	}
+	else if ( buffer.compare( start, 9, TEXT("<![CDATA[") ) == 0 )
+	{
+		if ( !Find( TEXT("]]>"), start + 9, &found ) )
+			return false;
+		*end = found + 3;
+	}
+	else if ( buffer.compare( start, 2, TEXT("<?") ) == 0 )
+	{
+		if ( !Find( TEXT("?>"), start + 2, &found ) )
+			return false;
+		*end = found + 2;
+	}
+	else
+	{
+		if ( !Find( TEXT(">"), start + 2, &found ) )
+			return false;
+		*end = found + 1;
+	}
+	return true;
+}
+
+bool TiXmlStreamReader::ScanTag( size_t start, size_t* end, bool* isEmpty )
+{
+	size_t i = start + 1;
+	for ( ;; )
+	{
+		if ( !Fill( i + 1 ) )
+			return false;
+
+		TCHAR c = buffer[i];
+		if ( c == '"' || c == '\'' )
+		{
+			TCHAR quote[2] = { c, 0 };
+			size_t closeQuote;
+			if ( !Find( quote, i + 1, &closeQuote ) )
+				return false;
+			i = closeQuote + 1;
+		}
+		else if ( c == '>' )
+		{
+			*end = i + 1;
+			*isEmpty = ( buffer[i - 1] == '/' );
+			return true;
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+bool TiXmlStreamReader::ScanElement( size_t start, size_t* end )
+{
+	int depth = 0;
+	size_t i = start;
+	for ( ;; )
+	{
+		if ( !Fill( i + 2 ) )
+			return false;
+
+		size_t next;
+		if ( buffer[i + 1] == '/' )
+		{
+			if ( !Find( TEXT(">"), i, &next ) )
+				return false;
+			++next;
+			--depth;
+		}
+		else if ( buffer[i + 1] == '!' || buffer[i + 1] == '?' )
+		{
+			if ( !SkipMarkup( i, &next ) )
+				return false;
+		}
+		else
+		{
+			bool isEmpty;
+			if ( !ScanTag( i, &next, &isEmpty ) )
+				return false;
+			if ( !isEmpty )
+				++depth;
+		}
+
+		if ( depth <= 0 )
+		{
+			*end = next;
+			return true;
+		}
+
+		if ( !Find( TEXT("<"), next, &i ) )
+			return false;
+	}
+}
+
+void TiXmlStreamReader::Advance( size_t newPos )
+{
+	for ( size_t i = pos; i < newPos; ++i )
+	{
+		if ( buffer[i] == '\n' )
+			++row;
+	}
+	pos = newPos;
+}
+
+void TiXmlStreamReader::SetError( int err )
+{
+	// The document has no location for these errors, so its ErrorRow() is 0
+	childRow = row + 1;
+	document.Clear();
+	document.SetError( err, 0, 0 );
+}
+
+#endif
@@ -58,6 +58,16 @@ void Options::setIsAdmin(const BOOL isAdmin)
     _isAdmin = isAdmin;
 }
 
+void Options::setMetricsFormat(const TCHAR* metricsFormat)
+{
+    _metricsFormat = metricsFormat;
+}
+
+void Options::setDownloadCacheSize(const TCHAR* downloadCacheSize)
+{
+    _downloadCacheSize = _ttoi(downloadCacheSize);
+}
+
 
 const tstring& Options::getActionsFile() const
 {
@@ -92,4 +102,14 @@ const std::list<tstring*>& Options::getArgList() const
 const BOOL Options::isAdmin() const 
 {
     return _isAdmin;
-}
\ No newline at end of file
+}
+
+const tstring& Options::getMetricsFormat() const
+{
+    return _metricsFormat;
+}
+
+const int Options::getDownloadCacheSize() const
+{
+    return _downloadCacheSize;
+}
@@ -26,7 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 class Options
 {
 public:
-    Options() : _isAdmin(FALSE) {};
+    Options() : _isAdmin(FALSE), _downloadCacheSize(-1) {};
     ~Options() {};
 
     void setActionsFile(const TCHAR* actionsFile);
@@ -36,6 +36,8 @@ public:
     void setCopyTo(const TCHAR* copyTo);
     void setArgList(const std::list<tstring*>& argList);
     void setIsAdmin(const BOOL isAdmin);
+    void setMetricsFormat(const TCHAR* metricsFormat);
+    void setDownloadCacheSize(const TCHAR* downloadCacheSize);
 
     const tstring& getActionsFile() const;
     const tstring& getExeName() const;
@@ -43,6 +45,8 @@ public:
     const tstring& getCopyFrom() const;
     const tstring& getCopyTo() const;
     const BOOL isAdmin() const;
+    const tstring& getMetricsFormat() const;
+    const int getDownloadCacheSize() const;
     const std::list<tstring*>& getArgList() const;
 
 private: 
@@ -52,6 +56,8 @@ private:
     tstring _copyFrom;
     tstring _copyTo;
     BOOL _isAdmin;
+    tstring _metricsFormat;
+    int _downloadCacheSize;     // MB, or -1 if not given
     std::list<tstring*> _argList;
 };
 
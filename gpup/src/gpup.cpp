@@ -34,6 +34,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "libinstall/VariableHandler.h"
 #include "libinstall/CancelToken.h"
 #include "libinstall/ModuleInfo.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/DownloadCache.h"
+#include "libinstall/DownloadMetrics.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/Validate.h"
+#include "libinstall/ValidationDatabase.h"
+#include "libinstall/ValidationCache.h"
 #include "ProgressDialog.h"
 
 #define RETURN_SUCCESS				0
@@ -59,6 +66,7 @@ BOOL parseCommandLine(const TCHAR* cmdLine, Options& options)
 	 * -a <actionsFile.xml>
 	 * -w <windowName>
 	 * -e <exeToRun>
+	 * -m <log|json>  (record the timings of the downloads - see libinstall/DownloadMetrics.h)
 	 *
      * w and e are mandatory 
 	 */
@@ -175,6 +183,18 @@ BOOL parseCommandLine(const TCHAR* cmdLine, Options& options)
         {
             options.setIsAdmin(TRUE);
         }
+		else if (*(*iter) == _T("-m"))
+		{
+			++iter;
+			if (iter != argList.end())
+				options.setMetricsFormat((*iter)->c_str());
+		}
+		else if (*(*iter) == _T("-s"))
+		{
+			++iter;
+			if (iter != argList.end())
+				options.setDownloadCacheSize((*iter)->c_str());
+		}
 
 		++iter;
 	}
@@ -281,12 +301,49 @@ void stepProgress(int /*percentageComplete*/)
 }
 
 
-BOOL processActionsFile(const tstring& actionsFile)
+BOOL processActionsFile(const tstring& actionsFile, const tstring& metricsFormat, int downloadCacheSize)
 {
     ModuleInfo moduleInfo(::GetModuleHandle(NULL), NULL);
 
     CancelToken cancelToken;
 
+    // One session for all the downloads, so connections to the server are reused
+    DownloadManager::useSharedTransport();
+
+    // The actions file is in the plugin config directory, so the download and validation caches, the mirror scores and the validation database are next to it
+    tstring::size_type lastSlash = actionsFile.find_last_of(_T('\\'));
+    if (lastSlash != tstring::npos)
+    {
+        // The size Plugin Manager is configured with (in MB), where 0 means no cache at all
+        if (downloadCacheSize != 0)
+        {
+            tstring cacheDir(actionsFile.substr(0, lastSlash + 1));
+            cacheDir.append(DOWNLOADCACHE_DIRECTORY);
+            DownloadManager::setCacheDirectory(cacheDir, downloadCacheSize < 0 ? DOWNLOADCACHE_DEFAULT_SIZE : static_cast<UINT64>(downloadCacheSize) * 1024 * 1024);
+        }
+
+        tstring mirrorScoresFile(actionsFile.substr(0, lastSlash + 1));
+        mirrorScoresFile.append(MIRRORSCORES_FILENAME);
+        DownloadManager::setMirrorScores(std::shared_ptr<MirrorScores>(new MirrorScores(mirrorScoresFile)));
+
+        tstring validationDatabaseFile(actionsFile.substr(0, lastSlash + 1));
+        validationDatabaseFile.append(VALIDATIONDB_FILENAME);
+        Validator::setDatabaseFilename(validationDatabaseFile);
+
+        tstring validationCacheFile(actionsFile.substr(0, lastSlash + 1));
+        validationCacheFile.append(VALIDATIONCACHE_FILENAME);
+        Validator::setCacheFilename(validationCacheFile);
+
+        // Next to the ones from Plugin Manager
+        if (metricsFormat == _T("log") || metricsFormat == _T("json"))
+        {
+            DOWNLOADMETRICS_FORMAT format = (metricsFormat == _T("json")) ? DOWNLOADMETRICS_FORMAT_JSON : DOWNLOADMETRICS_FORMAT_LOG;
+            tstring metricsFile(actionsFile.substr(0, lastSlash + 1));
+            metricsFile.append(DOWNLOADMETRICS_FORMAT_JSON == format ? DOWNLOADMETRICS_JSON_FILENAME : DOWNLOADMETRICS_LOG_FILENAME);
+            DownloadManager::setMetricsSink(std::shared_ptr<DownloadMetricsSink>(new DownloadMetricsFile(metricsFile, format)));
+        }
+    }
+
 	TiXmlDocument xmlDocument(actionsFile.c_str());
 	if (xmlDocument.LoadFile())
 	{
@@ -299,6 +356,7 @@ BOOL processActionsFile(const tstring& actionsFile)
 			VariableHandler variableHandler;
             
 			InstallStepFactory installStepFactory(&variableHandler);
+			ValidationBatch validationBatch;
 			TiXmlElement *step = install->FirstChildElement();
 			int stepCount = 0;
 			while (step)
@@ -323,6 +381,8 @@ BOOL processActionsFile(const tstring& actionsFile)
 					continue;
 				}
 
+				installStep->setValidationBatch(&validationBatch);
+
 				StepStatus stepStatus;
 				stepStatus = installStep->perform(basePath,           // basePath
 												&stillToComplete,   // forGpup (still can't achieve, so basically a fail)
@@ -480,7 +540,7 @@ int APIENTRY _tWinMain(HINSTANCE hInstance,
         else 
         {
             shouldRestartProcess = FALSE;
-            if (!processActionsFile(options.getActionsFile())) 
+            if (!processActionsFile(options.getActionsFile(), options.getMetricsFormat(), options.getDownloadCacheSize())) 
             {
 			    MessageBox(NULL, _T("Error finishing installation steps.  Plugin installation has not completed successfully."), _T("Plugin Manager"), MB_OK | MB_ICONERROR);
             }
@@ -0,0 +1,49 @@
+/*
+This file is part of GPUP, which is part of Plugin Manager 
+Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/* gpupprobe.exe loads plugins for the plugin manager to ask them their names - see
+ * libinstall/PluginProbe.h.  It is a separate exe from gpup.exe, as it must run with the
+ * rights of Notepad++ (asInvoker), where gpup.exe asks to be elevated.
+ */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <tchar.h>
+#include <string>
+
+typedef std::basic_string<TCHAR> tstring;
+
+#include "libinstall/PluginProbe.h"
+
+
+int APIENTRY _tWinMain(HINSTANCE /*hInstance*/,
+                       HINSTANCE /*hPrevInstance*/,
+                       LPTSTR    /*lpCmdLine*/,
+                       int       /*nCmdShow*/)
+{
+	// A plugin that hangs or crashes whilst loading only takes this process with it.
+	// No error dialogs - the plugin manager just times the probe out.
+	::SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOGPFAULTERRORBOX | SEM_NOOPENFILEERRORBOX);
+
+	Win32PluginLoader loader;
+	ProbeHost probeHost(loader);
+	probeHost.run(::GetStdHandle(STD_INPUT_HANDLE), ::GetStdHandle(STD_OUTPUT_HANDLE));
+	return 0;
+}
@@ -14,10 +14,10 @@ public:
 
     BOOL isSignalled() const;
 
-    int getRefCount() const { return *m_refCount; }
+    int getRefCount() const { return static_cast<int>(*m_refCount); }
 
 private:
-    int *m_refCount;
+    volatile LONG *m_refCount;
     HANDLE m_token;
 
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _CATALOGPATCHER_H
+#define _CATALOGPATCHER_H
+
+#include <list>
+#include <map>
+
+class DownloadManager;
+class ModuleInfo;
+
+/* Maximum number of patches applied in one update, before falling back to the full list */
+#define CATALOGPATCH_MAX_CHAIN  16
+
+/* Brings the local plugin list up to date by applying patches, rather than downloading
+ * the whole list again.
+ *
+ * A patch is published for each version of the list (identified by the MD5 of the XML on
+ * the server), at <patchBaseUrl><old md5>.xml, and takes the list to the next version:
+ *
+ *    <patch from="old md5" to="new md5" result="md5 of the patched list">
+ *        <plugin name="Added or changed plugin"> ... </plugin>
+ *        <remove name="Removed plugin" />
+ *        <pluginNames> ... </pluginNames>
+ *    </patch>
+ *
+ * A <plugin> replaces the plugin with the same name, or is added to the end of the list.
+ * Any other element replaces all the elements of that type (e.g. <pluginNames>).
+ * <remove> takes a name, and optionally element="pluginNames" to remove other elements.
+ *
+ * The patched list is written by the client, so is not byte for byte the same as the list
+ * on the server.  The version file records which server version the local list is, along
+ * with the MD5 of the local list so that it is ignored if the list is replaced.
+ *
+ * result is the MD5 of the list as save() writes it, once the patch has been applied to the
+ * list it is from.  The list is only written if it matches the result of the last patch, so a
+ * list that has drifted from the server's is downloaded in full rather than patched wrongly.
+ */
+class CatalogPatcher
+{
+public:
+	CatalogPatcher(DownloadManager& downloadManager, const ModuleInfo* moduleInfo);
+
+	/* Returns the server version of the local list, given the MD5 of the local list */
+	static tstring getCatalogVersion(const TCHAR* versionFilename, const tstring& catalogHash);
+	static BOOL setCatalogVersion(const TCHAR* versionFilename, const tstring& serverHash, const tstring& catalogHash);
+
+	/* Applies the chain of patches from the version of the local list to serverHash.
+	 * Returns FALSE if there is no chain of patches, or the patched list isn't the result the
+	 * last patch gives, in which case the list is not changed, and the full list should be
+	 * downloaded instead.
+	 */
+	BOOL update(const TCHAR* catalogFilename, const TCHAR* versionFilename, const tstring& catalogHash,
+				const tstring& patchBaseUrl, const tstring& serverHash);
+
+	/* The steps of update(), for testing */
+	BOOL load(const TCHAR* catalogFilename);
+	BOOL apply(const std::string& patch, tstring& version);
+	BOOL save(const TCHAR* catalogFilename);
+
+	size_t getPatchesApplied() const { return _patchesApplied; }
+
+private:
+	struct CatalogChild
+	{
+		tstring key;
+		tstring source;
+	};
+
+	typedef std::list<CatalogChild> ChildContainer;
+
+	void replaceChild(const tstring& key, const tstring& source);
+	void removeChild(const tstring& key);
+
+	std::string toXml();
+	static BOOL writeCatalog(const TCHAR* catalogFilename, const std::string& xml);
+
+	static tstring makeKey(const TCHAR* elementName, const TCHAR* name);
+	static tstring sourceKey(const tstring& source);
+
+	DownloadManager&    _downloadManager;
+	const ModuleInfo*   _moduleInfo;
+
+	/* Children of <plugins>, in document order */
+	ChildContainer      _children;
+
+	/* Key to children - the name for plugins, or the element name for anything else */
+	std::multimap<tstring, ChildContainer::iterator> _index;
+
+	size_t              _patchesApplied;
+
+	/* The result attribute of the last patch applied */
+	tstring             _resultHash;
+};
+
+#endif
@@ -53,6 +53,8 @@ public:
 
     void replaceVariables(VariableHandler *variableHandler);
 
+    void setValidationBatch(ValidationBatch* validationBatch) { _validationBatch = validationBatch; }
+
 private:
     
     ValidateStatus Validate(tstring& file);
@@ -64,13 +66,21 @@ private:
                      std::function<void(const TCHAR*)> setStatus,
                      std::function<void(const int)> stepProgress, 
                      const ModuleInfo* moduleInfo,
+                     ValidationBatch& validationBatch,
                      CancelToken& cancelToken);
 
+    /* Hashes the files copyDirectory() would copy, into _fileHashes, and queues them with validationBatch */
+    void hashFiles(const tstring& fromPath, ValidationBatch& validationBatch, CancelToken& cancelToken);
+
     
     tstring	_from;
     tstring _to;
     tstring _toFile;
     tstring _validateBaseUrl;
+    ValidationBatch* _validationBatch;
+
+    // source file -> MD5, whilst the files are being validated
+    std::map<tstring, tstring> _fileHashes;
 
 
     ToDestination _toDestination;
@@ -20,6 +20,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef _DECOMPRESS_H
 #define _DECOMPRESS_H
 
+/* unzip() uses a thread per processor, up to this many */
+#define DECOMPRESS_MAX_THREADS			4
+
+/* A zip with less than this in it is extracted on the calling thread - starting the threads
+ * would take longer than inflating it */
+#define DECOMPRESS_PARALLEL_MIN_SIZE	(256 * 1024)
+
 
 class Decompress
 {
@@ -29,9 +36,25 @@ public:
 
 	static BOOL unzip(const tstring& zipFile, const tstring& destDir);
 
+	/* Reads the zip's central directory once, and creates its directories in the order they
+	 * are listed, then inflates the files on up to threadCount threads, each with its own
+	 * handle on the zip.  Returns FALSE if a file couldn't be created or written - the files
+	 * that were extracted by then are left. */
+	static BOOL unzip(const tstring& zipFile, const tstring& destDir, size_t threadCount);
+
+	/* The path that filename (a file in a zip, with forward slashes) is extracted to in destDir.
+	 * Creates the directories it is in, if they don't exist. */
+	static tstring makeOutputPath(const tstring& destDir, const TCHAR* filename);
+
 private:
 	static const int BUFFER_SIZE = 4096;
 
+	struct ExtractContext;
+
+	static DWORD WINAPI extractThreadProc(LPVOID param);
+	static void extractFiles(ExtractContext& context, void* hZip);
+	static BOOL extractFile(void* hZip, const tstring& outputFilename, UINT64 uncompressedSize);
+
 	static void setString(const tstring &src, std::string &dest);
 };
 
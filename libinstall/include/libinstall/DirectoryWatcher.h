@@ -0,0 +1,64 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _DIRECTORYWATCHER_H
+#define _DIRECTORYWATCHER_H
+
+#include <set>
+
+/* Records the names of the files that change in a directory, so a caller that has read the
+ * whole directory once only needs to read the changed files again.
+ */
+class DirectoryWatcher
+{
+public:
+	virtual ~DirectoryWatcher() {}
+
+	/* Starts recording changes - anything that changes after this returns is reported */
+	virtual BOOL start(const tstring& directory) = 0;
+
+	/* Adds the names (without the path) of the files added, changed, removed or renamed since
+	 * the last call, waiting up to timeout milliseconds for the first change.
+	 * Returns FALSE if some changes may have been missed (or the watcher isn't running), in
+	 * which case the whole directory should be read again. */
+	virtual BOOL getChanges(std::set<tstring>& changedFilenames, DWORD timeout) = 0;
+};
+
+
+/* Uses ReadDirectoryChangesW on the directory (not its subdirectories) */
+class Win32DirectoryWatcher : public DirectoryWatcher
+{
+public:
+	Win32DirectoryWatcher();
+	~Win32DirectoryWatcher();
+
+	BOOL start(const tstring& directory);
+	BOOL getChanges(std::set<tstring>& changedFilenames, DWORD timeout);
+
+private:
+	BOOL readChanges();
+	void stop();
+
+	HANDLE		_hDirectory;
+	OVERLAPPED	_overlapped;
+	DWORD		_buffer[16384];		// DWORD aligned, as ReadDirectoryChangesW requires
+	BOOL		_reading;
+};
+
+#endif
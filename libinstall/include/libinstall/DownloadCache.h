@@ -0,0 +1,87 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _DOWNLOADCACHE_H
+#define _DOWNLOADCACHE_H
+
+/* Name of the cache directory, in the plugin config directory - Plugin Manager and gpup both
+ * use the same one */
+#define DOWNLOADCACHE_DIRECTORY     _T("plugin_download_cache")
+
+/* Default maximum size of the cache, in bytes */
+#define DOWNLOADCACHE_DEFAULT_SIZE  (100 * 1024 * 1024)
+
+struct DownloadCacheEntry
+{
+	tstring hash;
+	tstring etag;
+	tstring lastModified;
+	tstring contentType;
+};
+
+/* A cache of downloaded files that lasts between installs.
+ *
+ * The files are stored by the MD5 of their content (<md5>.dat), so a file that is
+ * downloaded from more than one URL is only stored once, and a download step that knows
+ * the MD5 of its file doesn't need the network at all.  Each URL has a small ini file
+ * (<md5 of url>.ini) with the MD5 of its content and the ETag and Last-Modified it was sent
+ * with, so the next download of the URL can be made conditional - a 304 is answered from
+ * the cache.
+ *
+ * Files are only ever moved into place whole, so more than one process can use the cache
+ * at a time.  When the files are larger than maxSize in total, the least recently used are
+ * removed.
+ */
+class DownloadCache
+{
+public:
+	DownloadCache(const tstring& directory, UINT64 maxSize);
+
+	/* Finds the entry for url.  Returns FALSE if there isn't one, or its file has gone. */
+	BOOL lookup(const tstring& url, DownloadCacheEntry& entry);
+
+	/* The If-None-Match and If-Modified-Since request headers to revalidate entry */
+	static tstring getRevalidationHeaders(const DownloadCacheEntry& entry);
+
+	/* Copies the file with the given MD5 to filename */
+	BOOL copyTo(const tstring& hash, const tstring& filename);
+
+	BOOL contains(const tstring& hash);
+
+	/* Adds the downloaded file as the content of url, then trims the cache to its maximum size */
+	BOOL add(const tstring& url, const tstring& filename, const DownloadCacheEntry& entry);
+
+	/* Removes the least recently used files until they fit in the maximum size */
+	void trim();
+
+private:
+	tstring getFilename(const tstring& hash);
+	tstring getEntryFilename(const tstring& url);
+	BOOL moveIntoPlace(const tstring& tempFilename, const tstring& filename, BOOL replace);
+	void touch(const tstring& filename);
+
+	void writeValue(const TCHAR* filename, const TCHAR* key, const tstring& value);
+	tstring readValue(const TCHAR* filename, const TCHAR* key);
+
+	tstring	_directory;
+	UINT64	_maxSize;
+};
+
+#endif
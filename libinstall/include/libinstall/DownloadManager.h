@@ -19,9 +19,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 #pragma once
 
+#include <vector>
 #include "CancelToken.h"
 
 class ModuleInfo;
+class HttpTransport;
+class HttpRequest;
+class InternetDownload;
+class MirrorList;
+class MirrorScores;
+class DownloadMetricsSink;
+class DownloadCache;
+struct DownloadMetrics;
 
 
 class DownloadManager
@@ -31,19 +40,81 @@ public:
     ~DownloadManager();
     BOOL getUrl(const TCHAR *url, tstring& filename, tstring& contentType, const ModuleInfo *moduleInfo);
     BOOL getUrl(const TCHAR *url, std::string& result, const ModuleInfo *moduleInfo);
+
+    /* Downloads from the best of a list of mirrors (see MirrorList.h).  The best
+     * MIRROR_RACE_COUNT are sent the request at once, and the first to answer is used - if it
+     * fails or stalls, the next best is tried, and so on.  Only a 200 from a mirror counts,
+     * or a 304 for a file in the download cache, which is kept under the first URL. */
+    BOOL getUrl(const MirrorList& mirrors, tstring& filename, tstring& contentType, const ModuleInfo *moduleInfo);
+    BOOL getUrl(const MirrorList& mirrors, std::string& result, const ModuleInfo *moduleInfo);
+
     void cancelDownload();
     void disableCache();
 
+    /* The MD5 of the file the next getUrl() is expected to download - if the download cache
+     * has a file with that MD5, it is used without going to the network */
+    void setExpectedHash(const tstring& hash);
+
     void setProgressFunction(std::function<void(int)> progressFunction);
 
+    /* Called with each part of a download to a file as it arrives, and the offset of that
+     * part in the file - e.g. to extract it whilst it downloads (see ZipStreamExtractor).
+     * Not called for a file that comes from the download cache. */
+    void setDataFunction(std::function<void(UINT64, const BYTE*, DWORD)> dataFunction);
+
     static void setUserAgent(const TCHAR* userAgent);
 
+    /* Sends all later downloads through transport, which keeps its connections open between
+     * them.  NULL (the default) gives each download a WinINet session of its own. */
+    static void setTransport(std::shared_ptr<HttpTransport> transport);
+
+    /* Sends all later downloads through one WinINet session, with the current user agent */
+    static void useSharedTransport();
+
+    /* Sends the timings and counts of every later download to sink (see DownloadMetrics.h).
+     * NULL (the default) doesn't record them. */
+    static void setMetricsSink(std::shared_ptr<DownloadMetricsSink> sink);
+
+    /* Keeps the latency of each mirror in scores, to choose between them.  NULL (the default)
+     * only keeps them for the length of each download. */
+    static void setMirrorScores(std::shared_ptr<MirrorScores> scores);
+
+    /* Downloads to a file that fail part way through are kept in partialDirectory, and
+     * continued from where they stopped the next time the same URL is downloaded.
+     * Empty (the default) always downloads the whole file. */
+    static void setPartialDirectory(const tstring& partialDirectory);
+
+    /* Files downloaded with getUrl() are kept in cacheDirectory (see DownloadCache.h), up to
+     * maxSize bytes.  Empty (the default) doesn't keep them. */
+    static void setCacheDirectory(const tstring& cacheDirectory, UINT64 maxSize);
+
+    /* TRUE if the download cache has a file with the given MD5 */
+    static BOOL isCached(const tstring& hash);
+
 
 private:
+    static std::shared_ptr<HttpTransport> getTransport();
+    static void reportMetrics(DownloadMetrics& metrics);
+    static void reportMetrics(InternetDownload& download, const TCHAR* url, BOOL success);
+    static std::shared_ptr<MirrorScores> getMirrorScores();
+
+    BOOL copyExpectedFile(DownloadCache& cache, const TCHAR* url, const tstring& filename);
+
+    BOOL getFromMirrors(const MirrorList& mirrors, const ModuleInfo *moduleInfo, const tstring* filename, tstring* contentType, std::string* result);
+    BOOL raceMirrors(HttpTransport& transport, std::vector<tstring>& urls, const tstring& headers, MirrorScores& scores, std::shared_ptr<HttpRequest>& winner);
+
     std::function<void(int)> _progressFunction;
     BOOL					   _progressFunctionSet;
+    std::function<void(UINT64, const BYTE*, DWORD)> _dataFunction;
     static tstring				_userAgent;
+    static tstring				_partialDirectory;
+    static tstring				_cacheDirectory;
+    static UINT64				_cacheMaxSize;
+    static std::shared_ptr<HttpTransport> _transport;
+    static std::shared_ptr<DownloadMetricsSink> _metricsSink;
+    static std::shared_ptr<MirrorScores> _mirrorScores;
 
     CancelToken                m_cancelToken;
     BOOL                       m_disableCache;
+    tstring                    m_expectedHash;
 };
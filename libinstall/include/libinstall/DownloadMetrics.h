@@ -0,0 +1,95 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _DOWNLOADMETRICS_H
+#define _DOWNLOADMETRICS_H
+
+/* The metrics files, in the plugin config directory - Plugin Manager and gpup both add to them */
+#define DOWNLOADMETRICS_LOG_FILENAME    _T("PluginManagerDownloads.log")
+#define DOWNLOADMETRICS_JSON_FILENAME   _T("PluginManagerDownloads.json")
+
+/* The timings and counts of one DownloadManager::getUrl.  The times are in ms after the
+ * download started, or -1 for a phase that didn't happen (there is no name lookup or
+ * connect on a connection that was kept alive, and none at all for a file from the cache).
+ * The phases are those of the last request, when there were retries.
+ */
+struct DownloadMetrics
+{
+	DownloadMetrics();
+
+	tstring	url;
+	BOOL	success;
+	BOOL	fromCache;          // Answered from the download cache, without a request
+	DWORD	statusCode;
+
+	double	resolving;
+	double	resolved;
+	double	connecting;
+	double	connected;
+	double	requestSent;        // Includes the TLS handshake of a new https connection
+	double	firstByte;          // The response headers arrived
+	double	finished;
+
+	UINT64	bytesReceived;      // Of the body, in all requests
+	double	bytesPerSecond;     // From the first byte to the end
+	int		retries;
+	int		proxyAuthRequests;  // 407s from the proxy
+
+	/* ms from the performance counter, for the times above */
+	static double now();
+};
+
+
+/* Where DownloadManager sends the metrics of each download (see DownloadManager::setMetricsSink).
+ * Downloads happen on more than one thread, so a sink has to cope with that. */
+class DownloadMetricsSink
+{
+public:
+	virtual ~DownloadMetricsSink() {}
+
+	virtual void downloadFinished(const DownloadMetrics& metrics) = 0;
+};
+
+
+enum DOWNLOADMETRICS_FORMAT
+{
+	DOWNLOADMETRICS_FORMAT_LOG = 1,     // A line of text for each download
+	DOWNLOADMETRICS_FORMAT_JSON = 2     // A JSON object on a line for each download (JSON lines)
+};
+
+/* Appends the metrics of each download to a file */
+class DownloadMetricsFile : public DownloadMetricsSink
+{
+public:
+	DownloadMetricsFile(const tstring& filename, DOWNLOADMETRICS_FORMAT format);
+	~DownloadMetricsFile();
+
+	virtual void downloadFinished(const DownloadMetrics& metrics);
+
+	static std::string formatLog(const DownloadMetrics& metrics);
+	static std::string formatJson(const DownloadMetrics& metrics);
+
+private:
+	tstring					_filename;
+	DOWNLOADMETRICS_FORMAT	_format;
+	CRITICAL_SECTION		_lock;
+};
+
+#endif
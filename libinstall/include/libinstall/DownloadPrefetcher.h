@@ -0,0 +1,99 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _DOWNLOADPREFETCHER_H
+#define _DOWNLOADPREFETCHER_H
+
+#include <vector>
+#include "CancelToken.h"
+#include "MirrorList.h"
+
+class ModuleInfo;
+
+/* Downloads the files of an install ahead of the steps that use them, so that the downloads
+ * of all the selected plugins overlap with each other and with the copying and unzipping.
+ * The steps still run in order - a DownloadStep just takes its file from here, instead of
+ * downloading it itself.
+ *
+ * At most threadCount downloads run at once.  The files are downloaded to temporary files in
+ * downloadDirectory, and any that are not taken are deleted by the destructor.
+ */
+class DownloadPrefetcher
+{
+public:
+	DownloadPrefetcher(const tstring& downloadDirectory, int threadCount, const ModuleInfo* moduleInfo, CancelToken& cancelToken);
+	~DownloadPrefetcher();
+
+	/* Queues a download from the mirrors, the first of which is the URL it is taken by.
+	 * expectedHash is the MD5 of the file, if known, so it can come from the download cache.
+	 * A URL that is already queued is only downloaded once. */
+	void add(const MirrorList& mirrors, const tstring& expectedHash);
+
+	/* Starts downloading what has been queued */
+	void start();
+
+	/* Waits for the download of url.  On success, the downloaded file (filename) belongs to
+	 * the caller.  Returns FALSE if url wasn't queued or couldn't be downloaded, or is
+	 * already taken - the caller should download it itself. */
+	BOOL take(const tstring& url, tstring& filename, tstring& contentType);
+
+	size_t getDownloadCount() const { return _downloads.size(); }
+
+	/* The number of downloads that have finished, whether or not they succeeded */
+	size_t getFinishedCount();
+
+private:
+	enum DownloadState
+	{
+		DOWNLOAD_QUEUED,
+		DOWNLOAD_RUNNING,
+		DOWNLOAD_DONE,
+		DOWNLOAD_FAILED,
+		DOWNLOAD_TAKEN
+	};
+
+	struct Download
+	{
+		tstring			url;
+		MirrorList		mirrors;
+		tstring			expectedHash;
+		tstring			filename;
+		tstring			contentType;
+		DownloadState	state;
+		HANDLE			hFinished;		// set once the state is DONE or FAILED
+	};
+
+	static DWORD WINAPI downloadThreadProc(LPVOID param);
+	void runDownloads();
+	std::shared_ptr<Download> findDownload(const tstring& url);
+
+	tstring					_downloadDirectory;
+	int						_threadCount;
+	const ModuleInfo*		_moduleInfo;
+	CancelToken				_cancelToken;
+
+	CRITICAL_SECTION		_lock;
+	std::vector< std::shared_ptr<Download> >	_downloads;
+	size_t					_nextDownload;
+	size_t					_finishedCount;
+	std::vector<HANDLE>		_threads;
+};
+
+#endif
@@ -23,11 +23,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 class ModuleInfo;
 class CancelToken;
+class DownloadPrefetcher;
 
 class DownloadStep : public InstallStep
 {
 public:
-	DownloadStep(const TCHAR* url, const TCHAR* filename);
+	/* md5 is optional - if it is given, and the download cache has a file with that MD5,
+	 * the file is not downloaded.  mirrors is an optional list of other URLs for the same
+	 * file (see MirrorList.h) - the fastest is used. */
+	DownloadStep(const TCHAR* url, const TCHAR* filename, const TCHAR* md5 = NULL, const TCHAR* mirrors = NULL);
 	~DownloadStep() {};
 	
 	StepStatus perform(tstring& basePath, TiXmlElement* forGpup,
@@ -36,9 +40,14 @@ public:
         const ModuleInfo *moduleInfo,
         CancelToken& cancelToken);
 
+	void setDownloadPrefetcher(DownloadPrefetcher* prefetcher);
+
 private:
 	tstring	_url;
 	tstring _filename;
+	tstring _md5;
+	tstring _mirrors;
+	DownloadPrefetcher* _prefetcher;
 };
 
 #endif
@@ -0,0 +1,54 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _FILEFINGERPRINT_H
+#define _FILEFINGERPRINT_H
+
+/* Reads the size, MD5 and file version of a dll or exe, mapping the file once.
+ * The version is read from the mapped file with PeVersionReader, rather than through the
+ * version APIs, which would open and read the file again.  A file this process has just
+ * written already has its hash in FileHashes, so only the pages with the version are read.
+ */
+class FileFingerprint
+{
+public:
+	FileFingerprint();
+
+	BOOL read(const TCHAR* filename);
+
+	/* Reads from a file that is already in memory */
+	BOOL read(const BYTE* file, size_t size);
+
+	UINT64			getSize() const { return _size; }
+	const tstring&	getHash() const { return _hash; }
+	BOOL			hasVersion() const { return _hasVersion; }
+	UINT32			getFileVersionMS() const { return _fileVersionMS; }
+	UINT32			getFileVersionLS() const { return _fileVersionLS; }
+
+private:
+	BOOL read(const BYTE* file, size_t size, const tstring& knownHash);
+
+	UINT64		_size;
+	tstring		_hash;
+	BOOL		_hasVersion;
+	UINT32		_fileVersionMS;
+	UINT32		_fileVersionLS;
+};
+
+#endif
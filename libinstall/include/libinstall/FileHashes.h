@@ -0,0 +1,69 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _FILEHASHES_H
+#define _FILEHASHES_H
+
+#include <map>
+#include "FileSystem.h"
+
+/* Forgotten all at once when there are more than this many (in a very long session) */
+#define FILEHASHES_MAX_ENTRIES  4096
+
+/* The MD5s of the files this process has just written - downloaded, extracted or copied -
+ * worked out from the bytes as they went by (see MD5::update), so that validating the
+ * files, or matching an installed dll to its version, doesn't read them again to hash them.
+ *
+ * A hash is only given back whilst the file has the size and last write time it had when
+ * the hash was recorded, so a file that has since been changed is hashed again as before.
+ * Can be used from any thread.
+ */
+class FileHashes
+{
+public:
+	/* Records md5 as the hash of filename, which has been written and closed */
+	static void record(const tstring& filename, const tstring& md5);
+
+	/* The recorded hash of filename, if there is one and the file hasn't changed since */
+	static BOOL lookup(const tstring& filename, tstring& md5);
+
+	/* Forgets everything recorded */
+	static void clear();
+
+private:
+	struct Entry
+	{
+		FileStat	fileStat;
+		tstring		md5;
+	};
+
+	struct Registry
+	{
+		Registry() { ::InitializeCriticalSection(&lock); }
+		~Registry() { ::DeleteCriticalSection(&lock); }
+
+		CRITICAL_SECTION				lock;
+		std::map<tstring, Entry>		entries;
+	};
+
+	static Registry& getRegistry();
+	static tstring getKey(const tstring& filename);
+};
+
+#endif
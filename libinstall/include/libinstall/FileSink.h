@@ -0,0 +1,96 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _FILESINK_H
+#define _FILESINK_H
+
+/* Writes to the file are this size, at offsets that are a multiple of it (apart from the
+ * first and last), so a download's 16KB parts are written in a few large pieces */
+#define FILESINK_BUFFER_SIZE    (256 * 1024)
+
+/* How many buffers can be being written at once - write() only waits when they all are */
+#define FILESINK_BUFFER_COUNT   4
+
+/* Writes a file with overlapped I/O, for downloads and extraction.  Data is gathered into
+ * page aligned buffers, and each full buffer is written in the background whilst the next
+ * fills, so the network or inflate thread doesn't wait for the disk.
+ *
+ * When the final size is known (e.g. Content-Length, or the uncompressed size of a zip
+ * entry) reserve() sets it up front, so the file is allocated once rather than as it grows.
+ * Writes past the end of what has been written so far may still be completed synchronously
+ * by the file system, but they are few and large.
+ */
+class FileSink
+{
+public:
+	FileSink();
+	~FileSink();
+
+	/* Creates filename, replacing any file that is there */
+	BOOL create(const tstring& filename);
+
+	/* Opens filename (creating it if need be) to add to the end of it */
+	BOOL append(const tstring& filename);
+
+	BOOL isOpen() const { return INVALID_HANDLE_VALUE != _hFile; }
+
+	/* Sets the size the file will be once everything is written - space that isn't used is
+	 * given back by close() */
+	BOOL reserve(UINT64 size);
+
+	/* FALSE if this or an earlier write failed */
+	BOOL write(const BYTE* data, DWORD length);
+
+	/* The length of the file that has been written to disk, from the start - it can be less
+	 * than has been given to write() */
+	UINT64 getWrittenLength() const { return _writtenLength; }
+
+	/* Writes what is left, waits for all the writes, and sets the end of the file to the end
+	 * of the data.  FALSE if any write failed - closing a sink that isn't open does nothing. */
+	BOOL close();
+
+private:
+	struct Buffer
+	{
+		BYTE*		data;
+		DWORD		length;
+		BOOL		pending;
+		OVERLAPPED	overlapped;
+	};
+
+	// Not copyable - the writes in progress point into the buffers
+	FileSink(const FileSink&);
+	FileSink& operator=(const FileSink&);
+
+	BOOL open(const tstring& filename, DWORD creationDisposition);
+	DWORD getCapacity() const;
+	void writeBuffer();
+	BOOL waitForOldest();
+
+	HANDLE	_hFile;
+	Buffer	_buffers[FILESINK_BUFFER_COUNT];
+	int		_current;
+	int		_oldest;
+	int		_pendingCount;
+	UINT64	_offset;			// Where the current buffer goes in the file
+	UINT64	_writtenLength;
+	BOOL	_failed;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _FILESYSTEM_H
+#define _FILESYSTEM_H
+
+/* Size and last write time of a file - if either changes, the file is assumed to have changed */
+struct FileStat
+{
+	UINT64	size;
+	UINT64	lastWriteTime;		// FILETIME, as a single value
+
+	bool operator==(const FileStat& rhs) const
+	{
+		return size == rhs.size && lastWriteTime == rhs.lastWriteTime;
+	}
+
+	bool operator!=(const FileStat& rhs) const
+	{
+		return !(*this == rhs);
+	}
+};
+
+
+/* The file operations used by the caches, so that they can be tested and benchmarked
+ * without real files */
+class FileSystem
+{
+public:
+	virtual ~FileSystem() {}
+
+	virtual BOOL getFileStat(const tstring& filename, FileStat& fileStat) = 0;
+	virtual BOOL readFile(const tstring& filename, std::string& contents) = 0;
+
+	/* Replaces the whole file, such that a reader sees either the old or the new contents */
+	virtual BOOL writeFile(const tstring& filename, const std::string& contents) = 0;
+};
+
+
+class Win32FileSystem : public FileSystem
+{
+public:
+	BOOL getFileStat(const tstring& filename, FileStat& fileStat);
+	BOOL readFile(const tstring& filename, std::string& contents);
+	BOOL writeFile(const tstring& filename, const std::string& contents);
+};
+
+#endif
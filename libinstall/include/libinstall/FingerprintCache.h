@@ -0,0 +1,91 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _FINGERPRINTCACHE_H
+#define _FINGERPRINTCACHE_H
+
+#include <map>
+#include "FileSystem.h"
+
+#define FINGERPRINTCACHE_MAGIC     0x46434D50      // "PMCF"
+#define FINGERPRINTCACHE_VERSION   1
+
+/* What was read from an installed plugin dll */
+struct Fingerprint
+{
+	BOOL	isPlugin;			// FALSE if the dll could not be loaded, or has no getName()
+	tstring	name;				// as reported by the plugin's getName()
+	tstring	hash;				// MD5 of the dll, or empty if it could not be read
+	BOOL	hasVersion;
+	UINT32	fileVersionMS;		// from VS_FIXEDFILEINFO
+	UINT32	fileVersionLS;
+
+	Fingerprint() : isPlugin(FALSE), hasVersion(FALSE), fileVersionMS(0), fileVersionLS(0) {}
+};
+
+
+/* Persistent cache of the fingerprints of the installed dlls, so that an unchanged dll
+ * doesn't need to be loaded or read again.  Entries are keyed by the full path, and are
+ * only used whilst the size and last write time of the file are the same.
+ *
+ * The cache file is only a copy - if it is missing or can't be read, the dlls are just
+ * read again.  Values are stored in native byte order.
+ */
+class FingerprintCache
+{
+public:
+	FingerprintCache(FileSystem& fileSystem);
+
+	BOOL load(const tstring& cacheFilename);
+
+	/* Writes the cache, if anything has changed since it was loaded */
+	BOOL save(const tstring& cacheFilename);
+
+	/* Fills fileStat with the current size and time of the file, then fills fingerprint and
+	 * returns TRUE if there is an entry for that size and time.  On a miss, the fingerprint
+	 * should be read from the file, and passed to add() with the same fileStat. */
+	BOOL lookup(const tstring& filename, FileStat& fileStat, Fingerprint& fingerprint);
+	void add(const tstring& filename, const FileStat& fileStat, const Fingerprint& fingerprint);
+
+	/* Removes the entries that haven't been looked up or added since load() -
+	 * i.e. dlls that have since been removed */
+	void removeUnused();
+
+	size_t getEntryCount() const { return _entries.size(); }
+	size_t getHitCount() const { return _hits; }
+	size_t getMissCount() const { return _misses; }
+
+private:
+	struct CacheEntry
+	{
+		FileStat	fileStat;
+		Fingerprint	fingerprint;
+		BOOL		used;
+	};
+
+	typedef std::map<tstring, CacheEntry> EntryContainer;
+
+	FileSystem&		_fileSystem;
+	EntryContainer	_entries;
+	BOOL			_changed;
+	size_t			_hits;
+	size_t			_misses;
+};
+
+#endif
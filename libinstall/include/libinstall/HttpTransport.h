@@ -0,0 +1,91 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _HTTPTRANSPORT_H
+#define _HTTPTRANSPORT_H
+
+#include "CancelToken.h"
+
+/* Flags for HttpTransport::openRequest */
+#define HTTP_REQUEST_NO_CACHE   0x0001      // Don't answer the request from a local cache (DownloadManager::disableCache)
+
+/* When each phase of a request happened, in ms after it was opened, or -1 if it didn't - there
+ * is no name lookup or connect on a connection that was kept alive */
+struct HttpRequestTimings
+{
+	double resolving;
+	double resolved;
+	double connecting;
+	double connected;
+	double requestSent;
+	double responseReceived;
+};
+
+/* A GET request that has been sent.  Everything waits for the network, until the cancel
+ * token the request was opened with is signalled. */
+class HttpRequest
+{
+public:
+	virtual ~HttpRequest() {}
+
+	/* Waits for the response headers.  FALSE if the request failed or was cancelled. */
+	virtual BOOL waitForResponse() = 0;
+
+	virtual DWORD getStatusCode() = 0;
+
+	/* The value of the named response header (e.g. _T("ETag")), or empty if it wasn't sent */
+	virtual tstring getHeader(const TCHAR* name) = 0;
+
+	/* Reads the next part of the body - bytesRead is 0 at the end of it */
+	virtual BOOL read(BYTE* buffer, DWORD bufferLength, DWORD& bytesRead) = 0;
+
+	/* After a 407, asks the user for the proxy login.  TRUE if the request should be sent again. */
+	virtual BOOL askProxyLogin(HWND parentHwnd) = 0;
+
+	virtual void getTimings(HttpRequestTimings& timings) = 0;
+
+	/* ms to wait for the response, or for each part of the body, before the request is
+	 * taken to have stalled and fails */
+	virtual void setTimeout(DWORD timeout) = 0;
+
+	/* Gives up on the request, from any thread - anything waiting for it fails straight away,
+	 * without signalling the cancel token (e.g. the losers of a race between mirrors) */
+	virtual void abort() = 0;
+};
+
+
+/* Where InternetDownload sends its requests.  A transport keeps its connections open between
+ * requests, so the requests of a whole install (and the validation of each file) to the same
+ * server reuse one connection, rather than each making a new one, TLS handshake included.
+ *
+ * A transport can be used from more than one thread at a time, and must outlive the requests
+ * it opens.  See WinInetTransport.
+ */
+class HttpTransport
+{
+public:
+	virtual ~HttpTransport() {}
+
+	/* Sends a GET for url, with extraHeaders (each ending "\r\n") added to the request.
+	 * Returns NULL if it couldn't be sent. */
+	virtual std::shared_ptr<HttpRequest> openRequest(const tstring& url, const tstring& extraHeaders, DWORD flags, CancelToken& cancelToken) = 0;
+};
+
+#endif
@@ -26,6 +26,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 class VariableHandler;
 class ModuleInfo;
 class CancelToken;
+class DownloadPrefetcher;
+class ValidationBatch;
 
 enum StepStatus 
 {
@@ -55,6 +57,14 @@ public:
 
 	virtual void replaceVariables(VariableHandler* /*variableHandler*/) { };
 
+	/* Queues anything the step will download with the prefetcher, so it can be downloaded
+	 * before the step is performed.  NULL stops the step using the prefetcher. */
+	virtual void setDownloadPrefetcher(DownloadPrefetcher* /*prefetcher*/) { };
+
+	/* The batch that the files the step validates are sent with, so the results are shared
+	 * with the other steps of the install.  NULL and the step uses a batch of its own. */
+	virtual void setValidationBatch(ValidationBatch* /*validationBatch*/) { };
+
 protected:
 //	void setTstring(const char *src, tstring &dest);
 
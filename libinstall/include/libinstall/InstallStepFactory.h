@@ -34,6 +34,9 @@ public:
 
 	std::shared_ptr<InstallStep> create(TiXmlElement* element);
 
+	/* Returns TRUE if create() would return a step for the element, without creating it */
+	static BOOL createsStep(TiXmlElement* element);
+
 private:
 	VariableHandler* _variableHandler;
 };
@@ -0,0 +1,108 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _MIRRORLIST_H
+#define _MIRRORLIST_H
+
+#include <vector>
+
+/* Name of the mirror scores file, in the plugin config directory - Plugin Manager and gpup
+ * both use the same one */
+#define MIRRORSCORES_FILENAME       _T("PluginManagerMirrors.ini")
+
+/* How many of the best mirrors are sent the request at once - the first to answer is used */
+#define MIRROR_RACE_COUNT           2
+
+/* ms without a response, or the next part of the body, before a mirror is taken to have
+ * stalled, and the next one is tried */
+#define MIRROR_STALL_TIMEOUT        15000
+
+/* The latency (ms) a failed request counts as in a mirror's score */
+#define MIRROR_FAILURE_LATENCY      30000
+
+/* The URLs of the same file on different servers, best known first.
+ *
+ * Lists are written as URLs separated by whitespace - e.g. the mirrors attribute of a
+ * <download> step, or the validate base URL variable.
+ */
+class MirrorList
+{
+public:
+	MirrorList();
+	MirrorList(const tstring& url);
+
+	void add(const tstring& url);
+
+	/* Adds each of the URLs in a whitespace separated list */
+	void addList(const TCHAR* urls);
+
+	/* Adds url on each of the servers in a whitespace separated list of "scheme://host[:port]",
+	 * with the same path - e.g. a mirror of the whole catalog site */
+	void addServers(const tstring& url, const TCHAR* servers);
+
+	size_t size() const { return _urls.size(); }
+	const tstring& getUrl(size_t index) const { return _urls[index]; }
+	const std::vector<tstring>& getUrls() const { return _urls; }
+
+	/* The same list with suffix appended to each URL (e.g. the MD5 to validate) */
+	MirrorList append(const tstring& suffix) const;
+
+	/* The whitespace separated form, that addList() reads */
+	tstring toString() const;
+
+	/* The "scheme://host[:port]" part of url, which mirrors are scored by */
+	static tstring getServer(const tstring& url);
+
+private:
+	std::vector<tstring> _urls;
+};
+
+
+/* The latency of each mirror server, so the fastest are tried first.  A score is the time to
+ * the response headers in ms, averaged so that one slow request doesn't count for too much.
+ * A failed request counts as MIRROR_FAILURE_LATENCY.
+ *
+ * With a filename, the scores are kept in that ini file, so they last between runs and are
+ * shared by every process that uses the file.  Without one, they only last as long as this.
+ */
+class MirrorScores
+{
+public:
+	MirrorScores(const tstring& filename);
+	~MirrorScores();
+
+	/* The score of the server url is on, or -1 if it hasn't been tried */
+	int getScore(const tstring& url);
+
+	void recordResponse(const tstring& url, double latency);
+	void recordFailure(const tstring& url);
+
+	/* Orders urls by score, lowest first.  A server that hasn't been tried comes before any
+	 * that have, so every mirror gets a score - otherwise URLs keep the order they are in. */
+	void order(std::vector<tstring>& urls);
+
+private:
+	void record(const tstring& url, double latency);
+
+	tstring _filename;
+	std::map<tstring, int> _scores;
+	CRITICAL_SECTION _lock;
+};
+
+#endif
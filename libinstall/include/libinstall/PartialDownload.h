@@ -0,0 +1,83 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _PARTIALDOWNLOAD_H
+#define _PARTIALDOWNLOAD_H
+
+/* Name of the partial downloads directory, in the plugin config directory.  It is not under
+ * plugin_install_temp, which is removed every time Notepad++ starts. */
+#define PARTIALDOWNLOAD_DIRECTORY   _T("plugin_partial_downloads")
+
+/* Days a partial download is kept without being continued */
+#define PARTIALDOWNLOAD_MAX_AGE     7
+
+/* A download that stopped part way through, kept so that it can be continued with a Range
+ * request, rather than started again from the beginning.
+ *
+ * What has been received so far is in <directory>\<md5 of the URL>.part.  A small ini file
+ * next to it (.part.ini) holds the ETag and Last-Modified of the response, and how many bytes
+ * of the .part file are known to have been written.  A download is only continued if the server
+ * sent one of the two, so that If-Range can check the file has not changed in the meantime.
+ */
+class PartialDownload
+{
+public:
+	PartialDownload(const tstring& directory, const tstring& url);
+
+	/* Reads the ini file, and cuts the .part file back to the length that is known to be good.
+	 * Returns FALSE, and discards anything left over, if there is nothing to continue. */
+	BOOL load();
+
+	/* The Range and If-Range request headers to continue the download - empty if it can't be */
+	tstring getRequestHeaders() const;
+
+	/* Starts again from the beginning, with the validators of a new response */
+	BOOL begin(const tstring& etag, const tstring& lastModified);
+
+	/* Records that length bytes of the .part file have been written */
+	void setReceivedLength(UINT64 length);
+
+	/* Moves the completed .part file to filename */
+	BOOL complete(const tstring& filename);
+
+	/* Deletes the .part file and its ini file */
+	void discard();
+
+	/* Deletes the partial downloads in directory that haven't been written for maxAgeDays */
+	static void removeExpired(const tstring& directory, UINT maxAgeDays);
+
+	BOOL canResume() const { return !_etag.empty() || !_lastModified.empty(); }
+
+	const tstring& getPartFilename() const { return _partFilename; }
+	UINT64 getReceivedLength() const { return _receivedLength; }
+
+private:
+	void writeValue(const TCHAR* key, const tstring& value);
+	tstring readValue(const TCHAR* key);
+
+	tstring	_directory;
+	tstring	_partFilename;
+	tstring	_infoFilename;
+	tstring	_etag;
+	tstring	_lastModified;
+	UINT64	_receivedLength;
+};
+
+#endif
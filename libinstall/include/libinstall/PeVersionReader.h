@@ -0,0 +1,54 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _PEVERSIONREADER_H
+#define _PEVERSIONREADER_H
+
+/* Reads the VS_FIXEDFILEINFO from the version resource of a PE file (dll or exe, 32 or 64 bit),
+ * given the bytes of the file as they are on disk.
+ *
+ * It only walks the headers and the resource directory, so it is cheap to run over a file
+ * that is mapped for hashing anyway.  It doesn't use any Windows APIs, and checks every offset
+ * against the size of the file, so it is safe to run over damaged or hostile files.
+ */
+class PeVersionReader
+{
+public:
+	PeVersionReader(const BYTE* file, size_t size);
+
+	/* Fills the version, as in VS_FIXEDFILEINFO::dwFileVersionMS / LS.
+	 * Returns FALSE if the file isn't a PE file, or has no version resource */
+	BOOL getFileVersion(UINT32& versionMS, UINT32& versionLS);
+
+private:
+	BOOL readUInt16(size_t offset, UINT16& value);
+	BOOL readUInt32(size_t offset, UINT32& value);
+
+	BOOL rvaToOffset(UINT32 rva, size_t& offset);
+	BOOL findFirstEntry(size_t directoryOffset, BOOL matchId, UINT16 id, UINT32& offsetToData);
+
+	const BYTE*	_file;
+	size_t		_size;
+
+	/* Section table, for converting RVAs to file offsets */
+	size_t		_sectionTableOffset;
+	UINT16		_sectionCount;
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _PLUGINPROBE_H
+#define _PLUGINPROBE_H
+
+/* Asking a dll for its plugin name means loading it, which runs the plugin's DllMain.
+ * gpupprobe.exe hosts the loading in a separate process, so that a plugin that hangs or
+ * crashes whilst loading doesn't take Notepad++ with it.  See ProbePool for the caller.
+ *
+ * The protocol is one line per dll, in UTF-8:
+ *   request:  <full path of the dll>\n
+ *   result:   plugin<TAB><isUnicode 0|1><TAB><name>\n   or   notplugin\n
+ * Results come back in the order of the requests.
+ */
+
+enum ProbeStatus
+{
+	PROBE_PLUGIN,			// has getName()
+	PROBE_NOTPLUGIN,		// could not be loaded, or has no getName()
+	PROBE_FAILED			// the probe timed out or crashed the host
+};
+
+struct ProbeResult
+{
+	ProbeStatus	status;
+	BOOL		isUnicode;
+	tstring		name;		// with any '&' removed, as in the plugins menu
+
+	ProbeResult() : status(PROBE_FAILED), isUnicode(FALSE) {}
+};
+
+
+class PluginLoader
+{
+public:
+	virtual ~PluginLoader() {}
+
+	virtual ProbeResult probe(const tstring& filename) = 0;
+};
+
+
+/* Loads the dll into this process with LoadLibrary */
+class Win32PluginLoader : public PluginLoader
+{
+public:
+	ProbeResult probe(const tstring& filename);
+};
+
+
+class ProbeHost
+{
+public:
+	ProbeHost(PluginLoader& loader);
+
+	/* Answers requests from input until it is closed */
+	void run(HANDLE input, HANDLE output);
+
+	/* Returns the result line for a request line (neither including the \n) */
+	std::string handleRequest(const std::string& request);
+
+	static std::string encodeRequest(const tstring& filename);
+	static BOOL decodeRequest(const std::string& request, tstring& filename);
+	static std::string encodeResult(const ProbeResult& result);
+	static BOOL decodeResult(const std::string& resultLine, ProbeResult& result);
+
+private:
+	PluginLoader& _loader;
+};
+
+#endif
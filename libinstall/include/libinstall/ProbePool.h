@@ -0,0 +1,156 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _PROBEPOOL_H
+#define _PROBEPOOL_H
+
+#include <vector>
+#include "PluginProbe.h"
+
+/* One probe host - normally a gpupprobe.exe process */
+class ProbeWorker
+{
+public:
+	virtual ~ProbeWorker() {}
+
+	virtual BOOL start() = 0;
+	virtual BOOL send(const std::string& request) = 0;
+
+	/* Returns FALSE if no result arrives within timeout milliseconds, or the host has gone */
+	virtual BOOL receive(std::string& resultLine, DWORD timeout) = 0;
+
+	/* Ends the host.  If terminate is TRUE, any probe that is still running is abandoned */
+	virtual void stop(BOOL terminate) = 0;
+};
+
+class ProbeWorkerFactory
+{
+public:
+	virtual ~ProbeWorkerFactory() {}
+
+	virtual std::shared_ptr<ProbeWorker> create() = 0;
+};
+
+
+/* Runs gpupprobe.exe, talking to it over its standard input and output */
+class ProcessProbeWorker : public ProbeWorker
+{
+public:
+	ProcessProbeWorker(const tstring& probeExe);
+	~ProcessProbeWorker();
+
+	BOOL start();
+	BOOL send(const std::string& request);
+	BOOL receive(std::string& resultLine, DWORD timeout);
+	void stop(BOOL terminate);
+
+private:
+	tstring		_probeExe;
+	HANDLE		_hProcess;
+	HANDLE		_hRequestWrite;
+	HANDLE		_hResultRead;
+	std::string	_received;
+};
+
+class ProcessProbeWorkerFactory : public ProbeWorkerFactory
+{
+public:
+	ProcessProbeWorkerFactory(const tstring& probeExe) : _probeExe(probeExe) {}
+
+	std::shared_ptr<ProbeWorker> create();
+
+private:
+	tstring _probeExe;
+};
+
+
+/* Probes on the calling thread, with no protection from the plugin - used when gpupprobe.exe
+ * isn't available.  A probe that hangs here hangs the caller. */
+class InProcessProbeWorker : public ProbeWorker
+{
+public:
+	InProcessProbeWorker(PluginLoader& loader);
+
+	BOOL start() { return TRUE; }
+	BOOL send(const std::string& request);
+	BOOL receive(std::string& resultLine, DWORD timeout);
+	void stop(BOOL /*terminate*/) {}
+
+private:
+	ProbeHost				_host;
+	std::vector<std::string> _requests;
+	size_t					_nextRequest;
+};
+
+class InProcessProbeWorkerFactory : public ProbeWorkerFactory
+{
+public:
+	InProcessProbeWorkerFactory(PluginLoader& loader) : _loader(loader) {}
+
+	std::shared_ptr<ProbeWorker> create();
+
+private:
+	PluginLoader& _loader;
+};
+
+
+/* Probes a list of dlls across a number of workers.  Each worker is sent a batch of dlls at
+ * a time.  If a dll doesn't answer within the probe timeout, or crashes its worker, that
+ * dll's result is PROBE_FAILED, the worker is replaced, and the rest of its batch is sent
+ * to the new worker.
+ */
+class ProbePool
+{
+public:
+	ProbePool(ProbeWorkerFactory& workerFactory, size_t workerCount, DWORD probeTimeout, size_t batchSize);
+	~ProbePool();
+
+	/* Fills results in the same order as filenames.  Returns FALSE (and probes nothing) if
+	 * no worker could be started. */
+	BOOL probe(const std::vector<tstring>& filenames, std::vector<ProbeResult>& results);
+
+	/* Number of workers replaced during the last probe() */
+	size_t getRestartCount() const { return _restartCount; }
+
+private:
+	static DWORD WINAPI workerThreadProc(LPVOID param);
+
+	struct WorkerContext
+	{
+		ProbePool*						pool;
+		std::shared_ptr<ProbeWorker>	worker;
+	};
+
+	void runWorker(std::shared_ptr<ProbeWorker>& worker);
+	BOOL nextBatch(size_t& batchStart, size_t& batchEnd);
+	std::shared_ptr<ProbeWorker> startWorker();
+
+	ProbeWorkerFactory&				_workerFactory;
+	size_t							_workerCount;
+	DWORD							_probeTimeout;
+	size_t							_batchSize;
+
+	CRITICAL_SECTION				_lock;
+	const std::vector<tstring>*		_filenames;
+	std::vector<ProbeResult>*		_results;
+	size_t							_nextFile;
+	size_t							_restartCount;
+};
+
+#endif
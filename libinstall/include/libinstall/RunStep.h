@@ -39,6 +39,8 @@ public:
 
     void replaceVariables(VariableHandler *variableHandler);
 
+    void setValidationBatch(ValidationBatch* validationBatch) { _validationBatch = validationBatch; }
+
 private:
     BOOL execute(const TCHAR *executable, const TCHAR *arguments);
 
@@ -46,6 +48,7 @@ private:
     tstring	_file;
     tstring _arguments;
     tstring _validateBaseUrl;
+    ValidationBatch* _validationBatch;
 };
 
 #endif
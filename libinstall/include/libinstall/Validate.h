@@ -5,6 +5,12 @@
 #define VALIDATE_RESULT_UNKNOWN   "unknown"
 #define VALIDATE_RESULT_BANNED    "banned"
 
+/* Hashes sent in each batch request - they all go in the URL, so it must stay well short of
+ * what servers and proxies accept (33 characters a hash) */
+#define VALIDATE_BATCH_SIZE       150
+
+#include <vector>
+
 enum ValidateStatus
 {
 	VALIDATE_OK,
@@ -14,9 +20,62 @@ enum ValidateStatus
 
 class ModuleInfo;
 class CancelToken;
+class ValidationCache;
 
 namespace Validator {
 	ValidateStatus validate(const tstring& validateBaseUrl, const tstring& file, CancelToken& cancelToken, const ModuleInfo *moduleInfo);
+
+	/* Validates a file by its MD5 (as from MD5::hash) - from the validation database if it's
+	 * there, otherwise online */
+	ValidateStatus validateHash(const tstring& validateBaseUrl, const tstring& md5, CancelToken& cancelToken, const ModuleInfo *moduleInfo);
+
+	/* The validation database to look hashes up in before going online (see ValidationDatabase).
+	 * It is opened for each validation, rather than kept open, so that a new plugin list can replace it. */
+	void setDatabaseFilename(const tstring& filename);
+
+	/* The cache of the server's answers to check before asking it again (see ValidationCache) */
+	void setCacheFilename(const tstring& filename);
+
+	/* Hashes found and not found in the cache, by this process */
+	size_t getCacheHitCount();
+	size_t getCacheMissCount();
 }
 
-#endif
\ No newline at end of file
+
+/* Validates the files of an install together.  The hashes are queued, then any that aren't
+ * in the validation database or cache are sent in one request to the validate URL, as a
+ * comma separated list (validate?md5=<md5>,<md5>,...), which is answered with a
+ * "<md5> <status>" line for each hash.
+ *
+ * Results are kept by hash for the rest of the install, so a file that is copied and then
+ * run, or installed by more than one plugin, is only sent once.  A server that doesn't
+ * answer for a hash (e.g. one that only takes single hashes) is asked for it on its own.
+ */
+class ValidationBatch
+{
+public:
+	ValidationBatch();
+
+	/* Queues a hash to be sent by the next resolve() */
+	void add(const tstring& md5);
+
+	/* Looks up everything queued that doesn't have a result yet in the validation database
+	 * and cache, and sends the rest, VALIDATE_BATCH_SIZE hashes a request.  If a request fails, its
+	 * hashes are VALIDATE_UNKNOWN. */
+	void resolve(const tstring& validateBaseUrl, CancelToken& cancelToken, const ModuleInfo* moduleInfo);
+
+	/* The result for md5, validating it on its own if it hasn't been resolved */
+	ValidateStatus getStatus(const tstring& validateBaseUrl, const tstring& md5, CancelToken& cancelToken, const ModuleInfo* moduleInfo);
+
+	/* The number of requests made, batches and single hashes */
+	int getRequestCount() const { return _requestCount; }
+
+private:
+	BOOL sendBatch(const tstring& validateBaseUrl, const std::vector<tstring>& hashes, CancelToken& cancelToken, const ModuleInfo* moduleInfo, ValidationCache* cache);
+
+	std::vector<tstring>				_queued;
+	std::map<tstring, ValidateStatus>	_results;
+	int									_requestCount;
+};
+
+#endif
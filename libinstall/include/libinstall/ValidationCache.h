@@ -0,0 +1,93 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _VALIDATIONCACHE_H
+#define _VALIDATIONCACHE_H
+
+#include <map>
+#include "Validate.h"
+
+#define VALIDATIONCACHE_FILENAME      _T("PluginManagerValidation.cache")
+#define VALIDATIONCACHE_MAGIC         0x43564D50      // "PMVC"
+#define VALIDATIONCACHE_VERSION       1
+
+/* How long each verdict is kept for, in seconds.  A file that was ok can be banned later,
+ * and an unknown one can be added to the list at any time, so those are kept for less. */
+#define VALIDATIONCACHE_OK_TTL        (7 * 24 * 60 * 60)
+#define VALIDATIONCACHE_BANNED_TTL    (30 * 24 * 60 * 60)
+#define VALIDATIONCACHE_UNKNOWN_TTL   (60 * 60)
+
+/* Attempts at opening the cache whilst another process has it, VALIDATIONCACHE_LOCK_WAIT ms apart */
+#define VALIDATIONCACHE_LOCK_ATTEMPTS 20
+#define VALIDATIONCACHE_LOCK_WAIT     50
+
+
+/* Persistent cache of the verdicts of the validate server, keyed by MD5, so that a file that
+ * is installed again (a reinstall, a repair, or gpup carrying out the rest of an install)
+ * isn't sent again.  Only answers from the server are cached - not a failure to ask it.
+ *
+ * The cache file is shared by Plugin Manager and gpup, which may have it at the same time.
+ * It is only ever opened exclusively, which serves as the lock between them - so a reader
+ * never sees half a write, and save() merges with whatever the other process has written
+ * since load(), rather than overwriting it.  If the file stays locked, or is damaged, the
+ * cache is just empty.
+ */
+class ValidationCache
+{
+public:
+	ValidationCache(const tstring& filename);
+
+	/* Reads the verdicts that haven't expired.  FALSE if there are none (no cache yet). */
+	BOOL load();
+
+	/* Writes the verdicts added since load(), if any */
+	BOOL save();
+
+	BOOL lookup(const tstring& md5, ValidateStatus& status);
+	void add(const tstring& md5, ValidateStatus status);
+
+	/* Seconds a verdict of status is kept for (defaults are the VALIDATIONCACHE_*_TTLs) */
+	void setTtl(ValidateStatus status, UINT32 seconds);
+
+	size_t getEntryCount() const { return _entries.size(); }
+	size_t getHitCount() const { return _hits; }
+	size_t getMissCount() const { return _misses; }
+
+private:
+	struct CacheEntry
+	{
+		ValidateStatus	status;
+		UINT64			expires;	// FILETIME
+	};
+
+	typedef std::map<tstring, CacheEntry> EntryContainer;
+
+	HANDLE openLocked(DWORD creationDisposition);
+	static BOOL readEntries(HANDLE hFile, UINT64 now, EntryContainer& entries);
+	static UINT64 getNow();
+
+	tstring			_filename;
+	EntryContainer	_entries;
+	EntryContainer	_added;
+	UINT32			_ttl[3];		// by ValidateStatus
+	size_t			_hits;
+	size_t			_misses;
+};
+
+#endif
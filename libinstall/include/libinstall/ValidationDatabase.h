@@ -0,0 +1,77 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _VALIDATIONDATABASE_H
+#define _VALIDATIONDATABASE_H
+
+#include "Validate.h"
+
+/* The validation database is a list of the MD5s of known files, with whether each is ok or
+ * banned.  It is shipped in plugins.zip alongside the plugin list (see website/validatedb.php),
+ * so it is extracted into the config directory with it, and lets files be validated without
+ * asking the server.  Only hashes that aren't in it are looked up online.
+ *
+ * The file is a header (magic, version, record count, as little endian UINT32s), then
+ * a record for each hash - the 16 bytes of the MD5 and a status byte - sorted by MD5, so
+ * that a hash is found with a binary search of the mapped file.
+ */
+#define VALIDATIONDB_FILENAME      _T("PluginManagerValidate.db")
+#define VALIDATIONDB_MAGIC         0x44564D50      // "PMVD"
+#define VALIDATIONDB_VERSION       1
+
+#define VALIDATIONDB_HEADER_SIZE   12
+#define VALIDATIONDB_RECORD_SIZE   17
+
+/* Record status */
+#define VALIDATIONDB_STATUS_OK       1
+#define VALIDATIONDB_STATUS_BANNED   2
+
+class ValidationDatabase
+{
+public:
+	ValidationDatabase();
+	~ValidationDatabase();
+
+	/* Maps the file, and checks the header.  FALSE if there is no database, or it's not
+	 * one this version understands. */
+	BOOL open(const TCHAR* filename);
+	void close();
+
+	BOOL isOpen() const { return _view != NULL; }
+	size_t getCount() const { return _count; }
+
+	/* If md5 (as from MD5::hash) is in the database, sets status and returns TRUE */
+	BOOL lookup(const tstring& md5, ValidateStatus& status) const;
+
+	/* Writes a database of hashes (MD5 -> VALIDATE_OK or VALIDATE_BANNED) */
+	static BOOL save(const TCHAR* filename, const std::map<tstring, ValidateStatus>& hashes);
+
+private:
+	ValidationDatabase(const ValidationDatabase&);
+	ValidationDatabase& operator=(const ValidationDatabase&);
+
+	static BOOL parseHash(const tstring& md5, BYTE* hash);
+
+	HANDLE		_hFile;
+	HANDLE		_hMapping;
+	const BYTE*	_view;
+	size_t		_count;
+};
+
+#endif
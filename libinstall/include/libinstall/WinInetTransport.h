@@ -0,0 +1,50 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _WININETTRANSPORT_H
+#define _WININETTRANSPORT_H
+
+#include "HttpTransport.h"
+
+#include <map>
+
+/* The WinINet transport.  All its requests share one asynchronous WinINet session, with one
+ * InternetConnect handle per server, so WinINet keeps the connections to each server alive
+ * between requests.
+ */
+class WinInetTransport : public HttpTransport
+{
+public:
+	WinInetTransport(const tstring& userAgent);
+	~WinInetTransport();
+
+	virtual std::shared_ptr<HttpRequest> openRequest(const tstring& url, const tstring& extraHeaders, DWORD flags, CancelToken& cancelToken);
+
+private:
+	HINTERNET getConnection(const tstring& hostName, INTERNET_PORT port);
+
+	HINTERNET						_hInternet;
+
+	// The connection handle for each "host:port"
+	CRITICAL_SECTION				_lock;
+	std::map<tstring, HINTERNET>	_connections;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _ZIPSTREAMEXTRACTOR_H
+#define _ZIPSTREAMEXTRACTOR_H
+
+#include <vector>
+#include "FileSink.h"
+#include "md5.h"
+
+struct z_stream_s;
+
+/* Extracts a zip whilst it is being downloaded, from its local file headers, rather than
+ * waiting for the whole file and reading it back through the central directory.
+ *
+ * Give it the data as it arrives with write().  It gives up (and ignores the rest) on
+ * anything it can't extract from the data alone - an entry with a data descriptor (whose
+ * sizes come after its data), an encrypted or zip64 entry, a method other than stored or
+ * deflated, a bad CRC, or data that isn't the start of a zip at all.  Whatever happens, the
+ * download itself carries on - if isComplete() isn't TRUE at the end, extract the downloaded
+ * file with Decompress::unzip as usual, which overwrites anything extracted here.
+ */
+class ZipStreamExtractor
+{
+public:
+	ZipStreamExtractor(const tstring& destDir);
+	~ZipStreamExtractor();
+
+	/* The next length bytes of the download, which start offset bytes into the file.  A
+	 * download that starts again from 0 starts the extraction again. */
+	void write(UINT64 offset, const BYTE* data, DWORD length);
+
+	/* TRUE once every entry has been extracted and the central directory reached */
+	BOOL isComplete() const { return STATE_COMPLETE == _state; }
+
+	/* TRUE if it has given up, and the file needs extracting with Decompress::unzip */
+	BOOL hasFailed() const { return STATE_FAILED == _state; }
+
+private:
+	enum State
+	{
+		STATE_HEADER,       // Reading a local file header (or the central directory signature)
+		STATE_DATA,         // Extracting the data of an entry
+		STATE_COMPLETE,
+		STATE_FAILED
+	};
+
+	void reset();
+	void fail();
+	size_t readHeader(const BYTE* data, size_t length);
+	size_t readData(const BYTE* data, size_t length);
+	BOOL startEntry();
+	BOOL finishEntry();
+	BOOL writeOutput(const BYTE* data, size_t length);
+	void closeEntry();
+
+	tstring				_destDir;
+	State				_state;
+	UINT64				_position;
+
+	// The header of the current entry, as it arrives
+	std::vector<BYTE>	_header;
+
+	// The current entry
+	WORD				_method;
+	DWORD				_crc;
+	DWORD				_compressedSize;
+	DWORD				_uncompressedSize;
+	DWORD				_remaining;
+	DWORD				_outputCrc;
+	DWORD				_outputSize;
+	BOOL				_streamEnded;
+	FileSink			_output;
+	tstring				_outputFilename;
+	MD5					_outputHash;
+	BOOL				_hashing;
+	z_stream_s*			_inflate;
+};
+
+#endif
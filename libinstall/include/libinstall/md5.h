@@ -18,6 +18,9 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#ifndef _MD5_H
+#define _MD5_H
+
 #define BUFSIZE 4096
 #define MD5LEN    16
 
@@ -25,7 +28,30 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 class MD5 
 {
 public:
+	MD5();
+	~MD5();
+
+	/* Hashes data a part at a time, as it is downloaded or written - init(), update() with
+	 * each part in turn, then final() for the hash.  Once final() has been called, init()
+	 * starts a new hash. */
+	BOOL init();
+	BOOL update(const BYTE *data, size_t dataLength);
+	BOOL final(TCHAR *hashBuffer, int hashBufferLength);
+
 	static BOOL hash(const TCHAR *filename, TCHAR *hashBuffer, int hashBufferLength);
+	static BOOL hash(const BYTE *data, size_t dataLength, TCHAR *hashBuffer, int hashBufferLength);
 
 	static const int HASH_LENGTH = 16;
-};
\ No newline at end of file
+
+private:
+	MD5(const MD5&);
+	MD5& operator=(const MD5&);
+
+	void release();
+
+	ULONG_PTR	_hProv;		// HCRYPTPROV
+	ULONG_PTR	_hHash;		// HCRYPTHASH
+	BOOL		_failed;	// an update() failed, so there's no hash
+};
+
+#endif
@@ -3,7 +3,7 @@
 #include "libinstall/CancelToken.h"
 
 CancelToken::CancelToken() 
-    : m_refCount(new int(1))
+    : m_refCount(new LONG(1))
 {
     m_token = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/); 
 }
@@ -11,7 +11,7 @@ CancelToken::CancelToken()
 CancelToken::CancelToken(const CancelToken& copy) 
 {
     m_refCount = copy.m_refCount;
-    (*m_refCount)++;
+    ::InterlockedIncrement(m_refCount);
     m_token = copy.m_token;
 }
 
@@ -19,7 +19,7 @@ CancelToken& CancelToken::operator=(CancelToken& other)
 {
     this->~CancelToken();
     m_refCount = other.m_refCount;
-    (*m_refCount)++;
+    ::InterlockedIncrement(m_refCount);
     m_token = other.m_token;
 
     return *this;
@@ -27,10 +27,10 @@ CancelToken& CancelToken::operator=(CancelToken& other)
 
 CancelToken::~CancelToken() 
 {
-    (*m_refCount)--;
-    if (0 == *m_refCount) {
+    // Copies are made and destroyed on the download threads too
+    if (0 == ::InterlockedDecrement(m_refCount)) {
         ::CloseHandle(m_token);
-        delete m_refCount;
+        delete const_cast<LONG*>(m_refCount);
         m_refCount = NULL;
     }
 }
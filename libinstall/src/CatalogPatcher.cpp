@@ -0,0 +1,311 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/CatalogPatcher.h"
+#include "libinstall/DownloadManager.h"
+#include "libinstall/WcharMbcsConverter.h"
+#include "libinstall/md5.h"
+#include "tinyxml/tinyxml.h"
+
+using namespace std;
+
+#define CATALOGVERSION_GROUP        _T("Catalog")
+#define CATALOGVERSION_SERVERHASH   _T("ServerHash")
+#define CATALOGVERSION_LOCALHASH    _T("LocalHash")
+
+
+CatalogPatcher::CatalogPatcher(DownloadManager& downloadManager, const ModuleInfo* moduleInfo)
+	: _downloadManager(downloadManager),
+	  _moduleInfo(moduleInfo),
+	  _patchesApplied(0)
+{
+}
+
+
+tstring CatalogPatcher::getCatalogVersion(const TCHAR* versionFilename, const tstring& catalogHash)
+{
+	TCHAR serverHash[(MD5LEN * 2) + 1];
+	TCHAR localHash[(MD5LEN * 2) + 1];
+
+	::GetPrivateProfileString(CATALOGVERSION_GROUP, CATALOGVERSION_SERVERHASH, _T(""), serverHash, (MD5LEN * 2) + 1, versionFilename);
+	::GetPrivateProfileString(CATALOGVERSION_GROUP, CATALOGVERSION_LOCALHASH, _T(""), localHash, (MD5LEN * 2) + 1, versionFilename);
+
+	// If the list has been replaced since it was patched, it is whatever the list's own hash says
+	if (serverHash[0] && !_tcsicmp(localHash, catalogHash.c_str()))
+		return tstring(serverHash);
+
+	return catalogHash;
+}
+
+
+BOOL CatalogPatcher::setCatalogVersion(const TCHAR* versionFilename, const tstring& serverHash, const tstring& catalogHash)
+{
+	return ::WritePrivateProfileString(CATALOGVERSION_GROUP, CATALOGVERSION_SERVERHASH, serverHash.c_str(), versionFilename)
+		&& ::WritePrivateProfileString(CATALOGVERSION_GROUP, CATALOGVERSION_LOCALHASH, catalogHash.c_str(), versionFilename);
+}
+
+
+BOOL CatalogPatcher::update(const TCHAR* catalogFilename, const TCHAR* versionFilename, const tstring& catalogHash,
+							const tstring& patchBaseUrl, const tstring& serverHash)
+{
+	tstring version = getCatalogVersion(versionFilename, catalogHash);
+	if (!_tcsicmp(version.c_str(), serverHash.c_str()))
+		return TRUE;
+
+	if (!load(catalogFilename))
+		return FALSE;
+
+	while (_tcsicmp(version.c_str(), serverHash.c_str()))
+	{
+		if (_patchesApplied >= CATALOGPATCH_MAX_CHAIN)
+			return FALSE;
+
+		tstring patchUrl(patchBaseUrl);
+		patchUrl.append(version);
+		patchUrl.append(_T(".xml"));
+
+		// A missing patch comes back as the server's error page, which apply() rejects
+		string patch;
+		if (!_downloadManager.getUrl(patchUrl.c_str(), patch, _moduleInfo)
+			|| !apply(patch, version))
+			return FALSE;
+	}
+
+	// Only written if it is what the server says it should be
+	string xml = toXml();
+	TCHAR hashBuffer[(MD5LEN * 2) + 1];
+	if (_resultHash.empty()
+		|| !MD5::hash(reinterpret_cast<const BYTE*>(xml.c_str()), xml.size(), hashBuffer, (MD5LEN * 2) + 1)
+		|| _tcsicmp(hashBuffer, _resultHash.c_str()))
+		return FALSE;
+
+	if (!writeCatalog(catalogFilename, xml))
+		return FALSE;
+
+	setCatalogVersion(versionFilename, serverHash, hashBuffer);
+	return TRUE;
+}
+
+
+BOOL CatalogPatcher::load(const TCHAR* catalogFilename)
+{
+	_children.clear();
+	_index.clear();
+
+	TiXmlStreamReader reader;
+	if (!reader.Open(catalogFilename) || _tcscmp(reader.RootValue(), _T("plugins")))
+		return FALSE;
+
+	TIXML_STRING source;
+	while (reader.NextChildSource(&source))
+	{
+		CatalogChild child;
+		child.key = sourceKey(source);
+		child.source.swap(source);
+
+		_index.insert(make_pair(child.key, _children.insert(_children.end(), child)));
+	}
+
+	return !reader.Error();
+}
+
+
+BOOL CatalogPatcher::apply(const string& patch, tstring& version)
+{
+	// Skip the BOM, if the patch was saved with one
+	const char* patchStart = patch.c_str();
+	if (patch.compare(0, 3, "\xEF\xBB\xBF") == 0)
+		patchStart += 3;
+
+	std::shared_ptr<TCHAR> patchText = WcharMbcsConverter::char2tchar(patchStart);
+
+	TiXmlDocument document;
+	document.Parse(patchText.get());
+	if (document.Error())
+		return FALSE;
+
+	TiXmlElement* patchElement = document.RootElement();
+	if (!patchElement || _tcscmp(patchElement->Value(), _T("patch")))
+		return FALSE;
+
+	const TCHAR* from = patchElement->Attribute(_T("from"));
+	const TCHAR* to = patchElement->Attribute(_T("to"));
+	if (!from || !to || _tcsicmp(from, version.c_str()))
+		return FALSE;
+
+	for (TiXmlElement* element = patchElement->FirstChildElement(); element; element = element->NextSiblingElement())
+	{
+		if (!_tcscmp(element->Value(), _T("remove")))
+		{
+			const TCHAR* elementName = element->Attribute(_T("element"));
+			removeChild(makeKey(elementName ? elementName : _T("plugin"), element->Attribute(_T("name"))));
+		}
+		else
+		{
+			TIXML_STRING source;
+			source << *element;
+			replaceChild(makeKey(element->Value(), element->Attribute(_T("name"))), source);
+		}
+	}
+
+	const TCHAR* result = patchElement->Attribute(_T("result"));
+	_resultHash = result ? result : _T("");
+
+	version = to;
+	++_patchesApplied;
+	return TRUE;
+}
+
+
+BOOL CatalogPatcher::save(const TCHAR* catalogFilename)
+{
+	return writeCatalog(catalogFilename, toXml());
+}
+
+
+string CatalogPatcher::toXml()
+{
+	string xml("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\r\n<plugins>\r\n");
+
+	for (ChildContainer::iterator it = _children.begin(); it != _children.end(); ++it)
+	{
+		std::shared_ptr<char> source = WcharMbcsConverter::tchar2char(it->source.c_str());
+		xml.append("  ");
+		xml.append(source.get());
+		xml.append("\r\n");
+	}
+
+	xml.append("</plugins>\r\n");
+	return xml;
+}
+
+
+BOOL CatalogPatcher::writeCatalog(const TCHAR* catalogFilename, const string& xml)
+{
+	// Write to a temporary file first, so a failed write leaves the old list in place
+	tstring tempFilename(catalogFilename);
+	tempFilename.append(_T(".tmp"));
+
+	FILE* file = NULL;
+	if (_tfopen_s(&file, tempFilename.c_str(), _T("wb")) || !file)
+		return FALSE;
+
+	size_t written = fwrite(xml.c_str(), 1, xml.size(), file);
+	fclose(file);
+
+	if (written != xml.size()
+		|| !::MoveFileEx(tempFilename.c_str(), catalogFilename, MOVEFILE_REPLACE_EXISTING))
+	{
+		::DeleteFile(tempFilename.c_str());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+void CatalogPatcher::replaceChild(const tstring& key, const tstring& source)
+{
+	pair<multimap<tstring, ChildContainer::iterator>::iterator,
+		 multimap<tstring, ChildContainer::iterator>::iterator> range = _index.equal_range(key);
+
+	if (range.first == range.second)
+	{
+		CatalogChild child;
+		child.key = key;
+		child.source = source;
+		_index.insert(make_pair(key, _children.insert(_children.end(), child)));
+		return;
+	}
+
+	// Replace the first, and drop any later duplicates - the list only ever used the last one
+	range.first->second->source = source;
+
+	multimap<tstring, ChildContainer::iterator>::iterator duplicate = range.first;
+	++duplicate;
+	while (duplicate != range.second)
+	{
+		_children.erase(duplicate->second);
+		duplicate = _index.erase(duplicate);
+	}
+}
+
+
+void CatalogPatcher::removeChild(const tstring& key)
+{
+	pair<multimap<tstring, ChildContainer::iterator>::iterator,
+		 multimap<tstring, ChildContainer::iterator>::iterator> range = _index.equal_range(key);
+
+	for (multimap<tstring, ChildContainer::iterator>::iterator it = range.first; it != range.second; ++it)
+		_children.erase(it->second);
+
+	_index.erase(range.first, range.second);
+}
+
+
+/* Plugins are keyed by name, other elements (e.g. pluginNames) just by the element name */
+tstring CatalogPatcher::makeKey(const TCHAR* elementName, const TCHAR* name)
+{
+	tstring key(elementName);
+	if (!_tcscmp(elementName, _T("plugin")))
+	{
+		key.push_back(_T('\n'));
+		if (name)
+			key.append(name);
+	}
+
+	return key;
+}
+
+
+/* Works out the key of a child from its start tag, without parsing the whole element */
+tstring CatalogPatcher::sourceKey(const tstring& source)
+{
+	TCHAR quote = 0;
+	tstring::size_type end = 0;
+	for (; end < source.size(); ++end)
+	{
+		TCHAR ch = source[end];
+		if (quote)
+		{
+			if (ch == quote)
+				quote = 0;
+		}
+		else if (ch == _T('"') || ch == _T('\''))
+			quote = ch;
+		else if (ch == _T('>'))
+			break;
+	}
+
+	tstring startTag(source, 0, end);
+	if (!startTag.empty() && startTag[startTag.size() - 1] == _T('/'))
+		startTag.erase(startTag.size() - 1);
+	startTag.append(_T("/>"));
+
+	TiXmlDocument document;
+	document.Parse(startTag.c_str());
+	// An unreadable start tag gets a key of its own, so it is kept as it is
+	TiXmlElement* element = document.RootElement();
+	if (!element)
+		return source;
+
+	return makeKey(element->Value(), element->Attribute(_T("name")));
+}
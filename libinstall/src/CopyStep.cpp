@@ -28,6 +28,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "libinstall/Validate.h"
 #include "libinstall/ModuleInfo.h"
 #include "libinstall/CancelToken.h"
+#include "libinstall/FileHashes.h"
 
 using namespace std;
 
@@ -37,7 +38,7 @@ CopyStep::CopyStep(const TCHAR *from, const TCHAR *to, const TCHAR *toFile, BOOL
 				   const tstring& validateBaseUrl)
 				   : _from(from), _validate(validate), _failIfExists(!attemptReplace),
 				     _isGpup(isGpup), _backup(backup), _recursive(recursive),
-                     _validateBaseUrl(validateBaseUrl)
+                     _validateBaseUrl(validateBaseUrl), _validationBatch(NULL)
 {
 
 	if (to)
@@ -127,7 +128,75 @@ StepStatus CopyStep::perform(tstring &basePath, TiXmlElement* forGpup,
 		return STEPSTATUS_SUCCESS;
 	}
 
-	return copyDirectory(fromPath, toPath, forGpup, setStatus, stepProgress, moduleInfo, cancelToken);
+	// Hash everything that is to be copied first, so it can all be validated in one request
+	ValidationBatch ownValidationBatch;
+	ValidationBatch& validationBatch = _validationBatch ? *_validationBatch : ownValidationBatch;
+	_fileHashes.clear();
+	if (_validate)
+	{
+		setStatus(_T("Validating files..."));
+		hashFiles(fromPath, validationBatch, cancelToken);
+		validationBatch.resolve(_validateBaseUrl, cancelToken, moduleInfo);
+	}
+
+	StepStatus status = copyDirectory(fromPath, toPath, forGpup, setStatus, stepProgress, moduleInfo, validationBatch, cancelToken);
+	_fileHashes.clear();
+	return status;
+}
+
+
+void CopyStep::hashFiles(const tstring& fromPath, ValidationBatch& validationBatch, CancelToken& cancelToken)
+{
+	tstring fromDir;
+
+	tstring::size_type backSlash = fromPath.find_last_of(_T("\\"));
+	if (backSlash != tstring::npos)
+		fromDir = fromPath.substr(0, backSlash + 1);
+	else
+		fromDir = fromPath;
+
+	WIN32_FIND_DATA foundData;
+	HANDLE hFindFile = ::FindFirstFile(fromPath.c_str(), &foundData);
+	if (hFindFile == INVALID_HANDLE_VALUE)
+		return;
+
+	TCHAR md5[(MD5::HASH_LENGTH * 2) + 1];
+	do
+	{
+		if (!_tcscmp(foundData.cFileName, _T(".")) || !_tcscmp(foundData.cFileName, _T("..")))
+			continue;
+
+		tstring fullFoundPath(fromDir);
+		fullFoundPath.append(foundData.cFileName);
+
+		// The same files as copyDirectory() goes through
+		if (::PathIsDirectory(fullFoundPath.c_str()))
+		{
+			if (_recursive)
+			{
+				fullFoundPath.append(_T("\\*.*"));
+				hashFiles(fullFoundPath, validationBatch, cancelToken);
+			}
+		}
+		else
+		{
+			// A file that was just extracted was hashed as it was written
+			tstring fileHash;
+			if (!FileHashes::lookup(fullFoundPath, fileHash)
+				&& MD5::hash(fullFoundPath.c_str(), md5, (MD5::HASH_LENGTH * 2) + 1))
+			{
+				fileHash = md5;
+			}
+
+			if (!fileHash.empty())
+			{
+				_fileHashes[fullFoundPath] = fileHash;
+				validationBatch.add(fileHash);
+			}
+		}
+	} while (!cancelToken.isSignalled() && ::FindNextFile(hFindFile, &foundData));
+
+	::FindClose(hFindFile);
 }
 
 
@@ -136,6 +205,7 @@ StepStatus CopyStep::copyDirectory(tstring& fromPath, tstring& toPath,
 					 std::function<void(const TCHAR*)> setStatus,
 					 std::function<void(const int)> stepProgress,
                      const ModuleInfo* moduleInfo,
+                     ValidationBatch& validationBatch,
                      CancelToken& cancelToken)
 {
 	StepStatus status = STEPSTATUS_SUCCESS;
@@ -211,7 +281,7 @@ StepStatus CopyStep::copyDirectory(tstring& fromPath, tstring& toPath,
 						// Destination must end in a backslash for directories
 						dest.append(_T("\\"));
 						// Recursively call ourselves to copy this directory
-						status = copyDirectory(fullFoundPath, dest, forGpup, setStatus, stepProgress, moduleInfo, cancelToken);
+						status = copyDirectory(fullFoundPath, dest, forGpup, setStatus, stepProgress, moduleInfo, validationBatch, cancelToken);
 
 					}
 
@@ -228,7 +298,13 @@ StepStatus CopyStep::copyDirectory(tstring& fromPath, tstring& toPath,
 				bool copy = false;
 				if (_validate)
 				{
-					switch(Validator::validate(_validateBaseUrl.c_str(), src, cancelToken, moduleInfo))
+					// Everything found is hashed and resolved by perform(), unless it has appeared since
+					map<tstring, tstring>::const_iterator fileHash = _fileHashes.find(src);
+					ValidateStatus validateStatus = (fileHash == _fileHashes.end())
+						? Validator::validate(_validateBaseUrl, src, cancelToken, moduleInfo)
+						: validationBatch.getStatus(_validateBaseUrl, fileHash->second, cancelToken, moduleInfo);
+
+					switch(validateStatus)
 					{
 
 						case VALIDATE_OK:
@@ -340,6 +416,16 @@ StepStatus CopyStep::copyDirectory(tstring& fromPath, tstring& toPath,
 						forGpup->LinkEndChild(copyElement);
 
 					}
+					else
+					{
+						// The copy has the same hash, for matching the installed version to
+						tstring fileHash;
+						map<tstring, tstring>::const_iterator knownHash = _fileHashes.find(src);
+						if (knownHash != _fileHashes.end())
+							FileHashes::record(dest, knownHash->second);
+						else if (FileHashes::lookup(src, fileHash))
+							FileHashes::record(dest, fileHash);
+					}
 				}
 			}
 		} while(status != STEPSTATUS_FAIL && ::FindNextFile(hFindFile, &foundData));
@@ -22,37 +22,102 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "libinstall/WcharMbcsConverter.h"
 #include "libinstall/tstring.h"
 #include "libinstall/DirectoryUtil.h"
+#include "libinstall/FileSink.h"
+#include "libinstall/FileHashes.h"
+#include "libinstall/md5.h"
 
 #include "unzip.h"
 #include "iowin32.h"
 
+#include <vector>
+#include <algorithm>
+
 using namespace std;
 
+/* A file to extract - where it is in the zip, and where it goes */
+struct ZipFileEntry
+{
+	unz_file_pos	position;
+	tstring			outputFilename;
+	UINT64			uncompressedSize;
+};
+
+/* Largest first, so the last file to start isn't a big one that leaves the others waiting */
+static bool largerFile(const ZipFileEntry& lhs, const ZipFileEntry& rhs)
+{
+	return lhs.uncompressedSize > rhs.uncompressedSize;
+}
+
+/* Removes an earlier entry for the same file (paths compare without case, and the
+ * slashes are already the same), so no two threads ever write one file.  As with a
+ * single thread, the last entry in the zip is the one that's left.
+ */
+static UINT64 removeDuplicate(vector<ZipFileEntry>& files, const tstring& outputFilename)
+{
+	for (vector<ZipFileEntry>::iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (0 == _tcsicmp(it->outputFilename.c_str(), outputFilename.c_str()))
+		{
+			UINT64 size = it->uncompressedSize;
+			files.erase(it);
+			return size;
+		}
+	}
+	return 0;
+}
+
+struct Decompress::ExtractContext
+{
+	tstring						zipFile;
+	vector<ZipFileEntry>		files;
+
+	CRITICAL_SECTION			lock;
+	size_t						nextFile;
+	BOOL						failed;
+};
+
+
 BOOL Decompress::unzip(const tstring &zipFile, const tstring &destDir)
+{
+	SYSTEM_INFO systemInfo;
+	::GetSystemInfo(&systemInfo);
+	size_t threadCount = min(static_cast<size_t>(systemInfo.dwNumberOfProcessors), static_cast<size_t>(DECOMPRESS_MAX_THREADS));
+
+	return unzip(zipFile, destDir, threadCount);
+}
+
+BOOL Decompress::unzip(const tstring &zipFile, const tstring &destDir, size_t threadCount)
 {
 
 	zlib_filefunc_def filefunc;
 	fill_win32_filefunc(&filefunc);
 	unzFile hZip = unzOpen2(zipFile.c_str(), &filefunc);
 
+	if (NULL == hZip)
+		return FALSE;
+
 	if (unzGoToFirstFile(hZip) != UNZ_OK)
 	{
 		unzClose(hZip);
 		return FALSE;
 	}
 
+	ExtractContext context;
+	context.zipFile = zipFile;
+	context.nextFile = 0;
+	context.failed = FALSE;
+
+	// Everything is read from the central directory here, and the directories are all
+	// created, in the order they are listed, before any file is extracted - so the threads
+	// only ever create files
+	UINT64 totalSize = 0;
 	int nextFileResult;
 
 	do {
-		if (unzOpenCurrentFile(hZip) != UNZ_OK)
-		{
-			unzClose(hZip);
-			return FALSE;
-		}
-
 		char filename[MAX_PATH];
+		unz_file_info fileInfo;
 
-		if (unzGetCurrentFileInfo(hZip, NULL, filename, MAX_PATH, NULL, 0, NULL, 0) != UNZ_OK)
+		if (unzGetCurrentFileInfo(hZip, &fileInfo, filename, MAX_PATH, NULL, 0, NULL, 0) != UNZ_OK)
 		{
 			unzClose(hZip);
 			return FALSE;
@@ -67,76 +132,192 @@ BOOL Decompress::unzip(const tstring &zipFile, const tstring &destDir)
 
 			outputDir.append(tFilename.get());
 			outputDir.erase(outputDir.size() - 1);
-			::CreateDirectory(outputDir.c_str(), NULL);
-			unzCloseCurrentFile(hZip);
+			if (!::PathIsDirectory(outputDir.c_str()))
+				DirectoryUtil::createDirectories(outputDir.c_str());
 		}
 		else
 		{
+			ZipFileEntry entry;
+			if (unzGetFilePos(hZip, &entry.position) != UNZ_OK)
+			{
+				unzClose(hZip);
+				return FALSE;
+			}
 
-			FILE *fp = NULL;
-			tstring outputFilename (destDir);
+			entry.outputFilename = makeOutputPath(destDir, tFilename.get());
+			entry.uncompressedSize = fileInfo.uncompressed_size;
+			totalSize -= removeDuplicate(context.files, entry.outputFilename);
+			totalSize += fileInfo.uncompressed_size;
+			context.files.push_back(entry);
+		}
+		nextFileResult = unzGoToNextFile(hZip);
 
-			outputFilename.append(tFilename.get());
+	} while (nextFileResult == UNZ_OK);
 
-			tstring::size_type pos = outputFilename.find_first_of(_T('/'));
-			// Replace all the forward slashes with backward ones
-			while (pos != string::npos)
-			{
+	sort(context.files.begin(), context.files.end(), largerFile);
 
-				outputFilename.replace(pos, 1, 1, _T('\\'));
-				pos = outputFilename.find_first_of(_T('/'), pos);
-			}
+	// No more threads than files, and none at all for a small zip
+	size_t workerCount = min(threadCount, min(context.files.size(), static_cast<size_t>(MAXIMUM_WAIT_OBJECTS)));
+	if (totalSize < DECOMPRESS_PARALLEL_MIN_SIZE)
+		workerCount = 1;
 
-			// Now grab the directory name of the output
-			pos = outputFilename.find_last_of(_T('\\'));
+	::InitializeCriticalSection(&context.lock);
 
-			if (pos != tstring::npos)
-			{
-				// If it doesn't exist, create it (and its parents)
-				tstring outputDir = tstring(outputFilename, 0, pos);
-				if (!::PathFileExists(outputDir.c_str()))
-				{
-					DirectoryUtil::createDirectories(outputDir.c_str());
-				}
-			}
+	vector<HANDLE> threads;
+	for (size_t workerIndex = 1; workerIndex < workerCount; ++workerIndex)
+	{
+		HANDLE hThread = ::CreateThread(0, 0, Decompress::extractThreadProc, &context, 0, 0);
+		if (hThread)
+			threads.push_back(hThread);
+	}
 
-			if (_tfopen_s(&fp, outputFilename.c_str(), _T("wb")) == 0)
-			{
-				char buffer[BUFFER_SIZE];
-				int bytesRead;
+	// This thread works through the files too, with the handle it already has.  It also
+	// picks up any that were left by a thread that couldn't open the zip.
+	extractFiles(context, hZip);
 
-				do
-				{
-					bytesRead = unzReadCurrentFile(hZip, buffer, BUFFER_SIZE);
+	if (!threads.empty())
+		::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
 
-					if (bytesRead > 0 && fp)
-						fwrite(buffer, bytesRead, 1, fp);
+	for (size_t threadIndex = 0; threadIndex < threads.size(); ++threadIndex)
+		::CloseHandle(threads[threadIndex]);
 
-				} while(bytesRead > 0);
-			}
-			else
-			{
-				// Opening output file failed, so close the zip and fail the step
-				unzClose(hZip);
-				return FALSE;
-			}
+	::DeleteCriticalSection(&context.lock);
+	unzClose(hZip);
 
-			unzCloseCurrentFile(hZip);
-			if (fp)
-			{
-				fclose(fp);
-			}
+	return !context.failed;
+}
+
+DWORD WINAPI Decompress::extractThreadProc(LPVOID param)
+{
+	ExtractContext* context = reinterpret_cast<ExtractContext*>(param);
+
+	zlib_filefunc_def filefunc;
+	fill_win32_filefunc(&filefunc);
+	unzFile hZip = unzOpen2(context->zipFile.c_str(), &filefunc);
+	if (hZip)
+	{
+		extractFiles(*context, hZip);
+		unzClose(hZip);
+	}
+
+	return 0;
+}
+
+/* Extracts the files that are left, one at a time, until there are none or one has failed */
+void Decompress::extractFiles(ExtractContext& context, void* hZip)
+{
+	for (;;)
+	{
+		::EnterCriticalSection(&context.lock);
+		size_t fileIndex = context.nextFile;
+		BOOL finished = context.failed || fileIndex >= context.files.size();
+		if (!finished)
+			++context.nextFile;
+		::LeaveCriticalSection(&context.lock);
+
+		if (finished)
+			return;
+
+		ZipFileEntry& entry = context.files[fileIndex];
+		if (unzGoToFilePos(hZip, &entry.position) != UNZ_OK
+			|| !extractFile(hZip, entry.outputFilename, entry.uncompressedSize))
+		{
+			::EnterCriticalSection(&context.lock);
+			context.failed = TRUE;
+			::LeaveCriticalSection(&context.lock);
+			return;
 		}
-		nextFileResult = unzGoToNextFile(hZip);
+	}
+}
 
-	} while (nextFileResult == UNZ_OK);
+/* Inflates the current file of hZip to outputFilename */
+BOOL Decompress::extractFile(void* hZip, const tstring& outputFilename, UINT64 uncompressedSize)
+{
+	if (unzOpenCurrentFile(hZip) != UNZ_OK)
+		return FALSE;
 
-	unzClose(hZip);
+	FileSink sink;
+	MD5 fileHash;
+	BOOL hashing = FALSE;
+
+	if (!sink.create(outputFilename))
+	{
+		// Opening output file failed, so fail the step
+		unzCloseCurrentFile(hZip);
+		return FALSE;
+	}
+
+	// The whole file is allocated up front, and written whilst the next part is inflated
+	sink.reserve(uncompressedSize);
+
+	// Hashed on the way through, so validating the file doesn't read it again
+	hashing = fileHash.init();
+
+	char buffer[BUFFER_SIZE];
+	int bytesRead;
+
+	do
+	{
+		bytesRead = unzReadCurrentFile(hZip, buffer, BUFFER_SIZE);
+
+		if (bytesRead > 0)
+		{
+			sink.write(reinterpret_cast<BYTE*>(buffer), bytesRead);
+			if (hashing)
+				hashing = fileHash.update(reinterpret_cast<BYTE*>(buffer), bytesRead);
+		}
+
+	} while(bytesRead > 0);
+
+	// An error part way through leaves a file that isn't what the zip holds
+	if (bytesRead < 0)
+		hashing = FALSE;
+
+	unzCloseCurrentFile(hZip);
+
+	// As above, for a file that couldn't be written
+	if (!sink.close())
+		return FALSE;
+
+	TCHAR hash[(MD5LEN * 2) + 1];
+	if (hashing && fileHash.final(hash, (MD5LEN * 2) + 1))
+		FileHashes::record(outputFilename, hash);
 
 	return TRUE;
 }
 
 
+tstring Decompress::makeOutputPath(const tstring& destDir, const TCHAR* filename)
+{
+	tstring outputFilename (destDir);
+
+	outputFilename.append(filename);
+
+	tstring::size_type pos = outputFilename.find_first_of(_T('/'));
+	// Replace all the forward slashes with backward ones
+	while (pos != string::npos)
+	{
+
+		outputFilename.replace(pos, 1, 1, _T('\\'));
+		pos = outputFilename.find_first_of(_T('/'), pos);
+	}
+
+	// Now grab the directory name of the output
+	pos = outputFilename.find_last_of(_T('\\'));
+
+	if (pos != tstring::npos)
+	{
+		// If it doesn't exist, create it (and its parents)
+		tstring outputDir = tstring(outputFilename, 0, pos);
+		if (!::PathFileExists(outputDir.c_str()))
+		{
+			DirectoryUtil::createDirectories(outputDir.c_str());
+		}
+	}
+
+	return outputFilename;
+}
+
 void Decompress::setString(const tstring &src, std::string &dest)
 {
 	std::shared_ptr<char> cDest = WcharMbcsConverter::tchar2char(src.c_str());
@@ -0,0 +1,136 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/DirectoryWatcher.h"
+
+using namespace std;
+
+#define DIRECTORYWATCHER_FILTER		(FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+
+Win32DirectoryWatcher::Win32DirectoryWatcher()
+	: _hDirectory(INVALID_HANDLE_VALUE),
+	  _reading(FALSE)
+{
+	memset(&_overlapped, 0, sizeof(OVERLAPPED));
+}
+
+Win32DirectoryWatcher::~Win32DirectoryWatcher()
+{
+	stop();
+}
+
+BOOL Win32DirectoryWatcher::start(const tstring& directory)
+{
+	stop();
+
+	_hDirectory = ::CreateFile(directory.c_str(),
+							FILE_LIST_DIRECTORY,
+							FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+							NULL,
+							OPEN_EXISTING,
+							FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+							NULL);
+
+	if (INVALID_HANDLE_VALUE == _hDirectory)
+		return FALSE;
+
+	_overlapped.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!_overlapped.hEvent || !readChanges())
+	{
+		stop();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Once the first read has been issued, the system keeps recording changes between reads,
+ * until its own buffer overflows */
+BOOL Win32DirectoryWatcher::readChanges()
+{
+	::ResetEvent(_overlapped.hEvent);
+	_reading = ::ReadDirectoryChangesW(_hDirectory, _buffer, sizeof(_buffer), FALSE,
+							DIRECTORYWATCHER_FILTER, NULL, &_overlapped, NULL);
+	return _reading;
+}
+
+BOOL Win32DirectoryWatcher::getChanges(set<tstring>& changedFilenames, DWORD timeout)
+{
+	if (!_reading)
+		return FALSE;
+
+	while (WAIT_OBJECT_0 == ::WaitForSingleObject(_overlapped.hEvent, timeout))
+	{
+		DWORD bytesReturned = 0;
+		if (!::GetOverlappedResult(_hDirectory, &_overlapped, &bytesReturned, FALSE))
+		{
+			_reading = FALSE;
+			return FALSE;
+		}
+
+		// No bytes means there were too many changes to fit in the buffer
+		BOOL complete = (bytesReturned > 0);
+
+		const BYTE* position = reinterpret_cast<const BYTE*>(_buffer);
+		while (complete)
+		{
+			const FILE_NOTIFY_INFORMATION* notify = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(position);
+			changedFilenames.insert(tstring(notify->FileName, notify->FileNameLength / sizeof(WCHAR)));
+
+			if (0 == notify->NextEntryOffset)
+				break;
+			position += notify->NextEntryOffset;
+		}
+
+		if (!readChanges() || !complete)
+			return FALSE;
+
+		// Anything else that has already arrived is collected without waiting
+		timeout = 0;
+	}
+
+	return TRUE;
+}
+
+void Win32DirectoryWatcher::stop()
+{
+	if (INVALID_HANDLE_VALUE != _hDirectory)
+	{
+		if (_reading)
+		{
+			::CancelIo(_hDirectory);
+			DWORD bytesReturned;
+			::GetOverlappedResult(_hDirectory, &_overlapped, &bytesReturned, TRUE);
+		}
+
+		::CloseHandle(_hDirectory);
+		_hDirectory = INVALID_HANDLE_VALUE;
+	}
+
+	if (_overlapped.hEvent)
+	{
+		::CloseHandle(_overlapped.hEvent);
+		_overlapped.hEvent = NULL;
+	}
+
+	_reading = FALSE;
+}
@@ -0,0 +1,270 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/DownloadCache.h"
+#include "libinstall/DirectoryUtil.h"
+#include "libinstall/WcharMbcsConverter.h"
+#include "libinstall/md5.h"
+#include "libinstall/FileHashes.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#define DOWNLOADCACHE_GROUP         _T("Download")
+#define DOWNLOADCACHE_HASH          _T("Hash")
+#define DOWNLOADCACHE_ETAG          _T("ETag")
+#define DOWNLOADCACHE_LASTMODIFIED  _T("LastModified")
+#define DOWNLOADCACHE_CONTENTTYPE   _T("ContentType")
+
+#define DOWNLOADCACHE_VALUE_LENGTH  1024
+
+
+DownloadCache::DownloadCache(const tstring& directory, UINT64 maxSize)
+	: _directory(directory),
+	  _maxSize(maxSize)
+{
+}
+
+
+BOOL DownloadCache::lookup(const tstring& url, DownloadCacheEntry& entry)
+{
+	tstring entryFilename = getEntryFilename(url);
+	entry.hash = readValue(entryFilename.c_str(), DOWNLOADCACHE_HASH);
+	if (entry.hash.empty())
+		return FALSE;
+
+	// The file may have been trimmed since
+	if (!contains(entry.hash))
+	{
+		::DeleteFile(entryFilename.c_str());
+		return FALSE;
+	}
+
+	entry.etag = readValue(entryFilename.c_str(), DOWNLOADCACHE_ETAG);
+	entry.lastModified = readValue(entryFilename.c_str(), DOWNLOADCACHE_LASTMODIFIED);
+	entry.contentType = readValue(entryFilename.c_str(), DOWNLOADCACHE_CONTENTTYPE);
+	return TRUE;
+}
+
+
+tstring DownloadCache::getRevalidationHeaders(const DownloadCacheEntry& entry)
+{
+	tstring headers;
+	if (!entry.etag.empty())
+	{
+		headers.append(_T("If-None-Match: "));
+		headers.append(entry.etag);
+		headers.append(_T("\r\n"));
+	}
+
+	if (!entry.lastModified.empty())
+	{
+		headers.append(_T("If-Modified-Since: "));
+		headers.append(entry.lastModified);
+		headers.append(_T("\r\n"));
+	}
+
+	return headers;
+}
+
+
+BOOL DownloadCache::contains(const tstring& hash)
+{
+	return ::GetFileAttributes(getFilename(hash).c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+
+BOOL DownloadCache::copyTo(const tstring& hash, const tstring& filename)
+{
+	tstring cachedFilename = getFilename(hash);
+	if (!::CopyFile(cachedFilename.c_str(), filename.c_str(), FALSE))
+		return FALSE;
+
+	touch(cachedFilename);
+	FileHashes::record(filename, hash);
+	return TRUE;
+}
+
+
+BOOL DownloadCache::add(const tstring& url, const tstring& filename, const DownloadCacheEntry& entry)
+{
+	if (!::PathIsDirectory(_directory.c_str()))
+		DirectoryUtil::createDirectories(_directory.c_str());
+
+	// Usually hashed as it was downloaded
+	tstring hash;
+	if (!FileHashes::lookup(filename, hash))
+	{
+		TCHAR hashBuffer[(MD5LEN * 2) + 1];
+		if (!MD5::hash(filename.c_str(), hashBuffer, (MD5LEN * 2) + 1))
+			return FALSE;
+		hash = hashBuffer;
+	}
+
+	// Copy to a temporary name first, so no one sees half a file
+	TCHAR tempFilename[MAX_PATH];
+	if (!::GetTempFileName(_directory.c_str(), _T("add"), 0, tempFilename))
+		return FALSE;
+
+	if (!::CopyFile(filename.c_str(), tempFilename, FALSE)
+		|| !moveIntoPlace(tempFilename, getFilename(hash), FALSE))
+	{
+		::DeleteFile(tempFilename);
+		return FALSE;
+	}
+
+	touch(getFilename(hash));
+
+	if (!::GetTempFileName(_directory.c_str(), _T("add"), 0, tempFilename))
+		return FALSE;
+
+	writeValue(tempFilename, DOWNLOADCACHE_HASH, hash);
+	writeValue(tempFilename, DOWNLOADCACHE_ETAG, entry.etag);
+	writeValue(tempFilename, DOWNLOADCACHE_LASTMODIFIED, entry.lastModified);
+	writeValue(tempFilename, DOWNLOADCACHE_CONTENTTYPE, entry.contentType);
+
+	if (!moveIntoPlace(tempFilename, getEntryFilename(url), TRUE))
+	{
+		::DeleteFile(tempFilename);
+		return FALSE;
+	}
+
+	trim();
+	return TRUE;
+}
+
+
+struct CachedFile
+{
+	tstring		filename;
+	UINT64		size;
+	FILETIME	lastUsed;
+};
+
+static bool lessRecentlyUsed(const CachedFile& first, const CachedFile& second)
+{
+	return ::CompareFileTime(&first.lastUsed, &second.lastUsed) < 0;
+}
+
+void DownloadCache::trim()
+{
+	vector<CachedFile> cachedFiles;
+	UINT64 totalSize = 0;
+
+	WIN32_FIND_DATA foundData;
+	HANDLE hFindFile = ::FindFirstFile((_directory + _T("\\*.dat")).c_str(), &foundData);
+	if (INVALID_HANDLE_VALUE == hFindFile)
+		return;
+
+	do
+	{
+		CachedFile cachedFile;
+		cachedFile.filename = _directory + _T("\\") + foundData.cFileName;
+		cachedFile.size = (static_cast<UINT64>(foundData.nFileSizeHigh) << 32) | foundData.nFileSizeLow;
+		cachedFile.lastUsed = foundData.ftLastWriteTime;
+		cachedFiles.push_back(cachedFile);
+		totalSize += cachedFile.size;
+	} while (::FindNextFile(hFindFile, &foundData));
+	::FindClose(hFindFile);
+
+	if (totalSize <= _maxSize)
+		return;
+
+	// The URL entries of removed files are removed when they are next looked up
+	sort(cachedFiles.begin(), cachedFiles.end(), lessRecentlyUsed);
+	for (vector<CachedFile>::iterator it = cachedFiles.begin(); it != cachedFiles.end() && totalSize > _maxSize; ++it)
+	{
+		if (::DeleteFile(it->filename.c_str()))
+			totalSize -= it->size;
+	}
+}
+
+
+tstring DownloadCache::getFilename(const tstring& hash)
+{
+	tstring filename(_directory);
+	filename.append(_T("\\"));
+	filename.append(hash);
+	filename.append(_T(".dat"));
+	return filename;
+}
+
+tstring DownloadCache::getEntryFilename(const tstring& url)
+{
+	std::shared_ptr<char> utf8Url = WcharMbcsConverter::tchar2char(url.c_str());
+	TCHAR urlHash[(MD5LEN * 2) + 1];
+	MD5::hash(reinterpret_cast<const BYTE*>(utf8Url.get()), strlen(utf8Url.get()), urlHash, (MD5LEN * 2) + 1);
+
+	tstring filename(_directory);
+	filename.append(_T("\\"));
+	filename.append(urlHash);
+	filename.append(_T(".ini"));
+	return filename;
+}
+
+/* The write time of a file is when it was last used, for trim() - CopyFile keeps the time of
+ * the original */
+void DownloadCache::touch(const tstring& filename)
+{
+	HANDLE hFile = ::CreateFile(filename.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE != hFile)
+	{
+		FILETIME now;
+		::GetSystemTimeAsFileTime(&now);
+		::SetFileTime(hFile, NULL, NULL, &now);
+		::CloseHandle(hFile);
+	}
+}
+
+/* Another process may be adding the same file - if it is already there, that one is as good */
+BOOL DownloadCache::moveIntoPlace(const tstring& tempFilename, const tstring& filename, BOOL replace)
+{
+	if (::MoveFileEx(tempFilename.c_str(), filename.c_str(), replace ? MOVEFILE_REPLACE_EXISTING : 0))
+		return TRUE;
+
+	DWORD error = ::GetLastError();
+	if (!replace && (ERROR_ALREADY_EXISTS == error || ERROR_FILE_EXISTS == error))
+	{
+		::DeleteFile(tempFilename.c_str());
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Quoted for the same reason as in PartialDownload - a quoted ETag would lose its quotes */
+void DownloadCache::writeValue(const TCHAR* filename, const TCHAR* key, const tstring& value)
+{
+	tstring quotedValue(_T("\""));
+	quotedValue.append(value);
+	quotedValue.append(_T("\""));
+	::WritePrivateProfileString(DOWNLOADCACHE_GROUP, key, quotedValue.c_str(), filename);
+}
+
+tstring DownloadCache::readValue(const TCHAR* filename, const TCHAR* key)
+{
+	TCHAR value[DOWNLOADCACHE_VALUE_LENGTH];
+	::GetPrivateProfileString(DOWNLOADCACHE_GROUP, key, _T(""), value, DOWNLOADCACHE_VALUE_LENGTH, filename);
+	return tstring(value);
+}
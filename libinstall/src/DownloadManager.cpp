@@ -6,9 +6,38 @@
 #include "InternetDownload.h"
 #include "libinstall/WcharMbcsConverter.h"
 #include "libinstall/ModuleInfo.h" 
+#include "libinstall/DownloadCache.h"
+#include "libinstall/WinInetTransport.h"
+#include "libinstall/DownloadMetrics.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/FileHashes.h"
 using namespace std;
 
+namespace {
+    // Guards DownloadManager::_transport, _metricsSink and _mirrorScores - downloads on other threads take a copy of them
+    class TransportLock {
+    public:
+        TransportLock() { ::InitializeCriticalSection(&lock); }
+        ~TransportLock() { ::DeleteCriticalSection(&lock); }
+        CRITICAL_SECTION lock;
+    };
+
+    TransportLock transportLock;
+
+    // Each mirror in a race waits for its response on a thread of its own
+    DWORD WINAPI waitForResponseProc(LPVOID param)
+    {
+        return reinterpret_cast<HttpRequest*>(param)->waitForResponse() ? 1 : 0;
+    }
+}
+
 tstring DownloadManager::_userAgent(_T("Plugin-Manager"));
+tstring DownloadManager::_partialDirectory;
+tstring DownloadManager::_cacheDirectory;
+UINT64 DownloadManager::_cacheMaxSize = DOWNLOADCACHE_DEFAULT_SIZE;
+std::shared_ptr<HttpTransport> DownloadManager::_transport;
+std::shared_ptr<DownloadMetricsSink> DownloadManager::_metricsSink;
+std::shared_ptr<MirrorScores> DownloadManager::_mirrorScores;
 
 DownloadManager::DownloadManager(CancelToken& cancelToken)
     : m_cancelToken(cancelToken),
@@ -27,26 +56,193 @@ void DownloadManager::setUserAgent(const TCHAR* userAgent)
     _userAgent = userAgent;
 }
 
+void DownloadManager::setTransport(std::shared_ptr<HttpTransport> transport)
+{
+    // The old transport is released outside the lock, as closing it can wait for the network
+    std::shared_ptr<HttpTransport> previous;
+    ::EnterCriticalSection(&transportLock.lock);
+    previous = _transport;
+    _transport = transport;
+    ::LeaveCriticalSection(&transportLock.lock);
+}
+
+void DownloadManager::useSharedTransport()
+{
+    setTransport(std::shared_ptr<HttpTransport>(new WinInetTransport(_userAgent)));
+}
+
+std::shared_ptr<HttpTransport> DownloadManager::getTransport()
+{
+    ::EnterCriticalSection(&transportLock.lock);
+    std::shared_ptr<HttpTransport> transport = _transport;
+    ::LeaveCriticalSection(&transportLock.lock);
+
+    if (!transport) {
+        transport.reset(new WinInetTransport(_userAgent));
+    }
+
+    return transport;
+}
+
+void DownloadManager::setMetricsSink(std::shared_ptr<DownloadMetricsSink> sink)
+{
+    std::shared_ptr<DownloadMetricsSink> previous;
+    ::EnterCriticalSection(&transportLock.lock);
+    previous = _metricsSink;
+    _metricsSink = sink;
+    ::LeaveCriticalSection(&transportLock.lock);
+}
+
+void DownloadManager::reportMetrics(DownloadMetrics& metrics)
+{
+    ::EnterCriticalSection(&transportLock.lock);
+    std::shared_ptr<DownloadMetricsSink> sink = _metricsSink;
+    ::LeaveCriticalSection(&transportLock.lock);
+
+    if (sink) {
+        sink->downloadFinished(metrics);
+    }
+}
+
+void DownloadManager::reportMetrics(InternetDownload& download, const TCHAR* url, BOOL success)
+{
+    DownloadMetrics metrics;
+    metrics.url = url;
+    metrics.success = success;
+    download.getMetrics(metrics);
+    reportMetrics(metrics);
+}
+
+void DownloadManager::setMirrorScores(std::shared_ptr<MirrorScores> scores)
+{
+    ::EnterCriticalSection(&transportLock.lock);
+    _mirrorScores = scores;
+    ::LeaveCriticalSection(&transportLock.lock);
+}
+
+std::shared_ptr<MirrorScores> DownloadManager::getMirrorScores()
+{
+    ::EnterCriticalSection(&transportLock.lock);
+    std::shared_ptr<MirrorScores> scores = _mirrorScores;
+    ::LeaveCriticalSection(&transportLock.lock);
+
+    if (!scores) {
+        scores.reset(new MirrorScores(tstring()));
+    }
+
+    return scores;
+}
+
+void DownloadManager::setPartialDirectory(const tstring& partialDirectory)
+{
+    _partialDirectory = partialDirectory;
+}
+
 void DownloadManager::setProgressFunction(std::function<void(int)> progressFunction)
 {
     _progressFunction = progressFunction;
     _progressFunctionSet = TRUE;
 }
 
+void DownloadManager::setDataFunction(std::function<void(UINT64, const BYTE*, DWORD)> dataFunction)
+{
+    _dataFunction = dataFunction;
+}
+
 void DownloadManager::disableCache() {
     m_disableCache = TRUE;
 }
 
+void DownloadManager::setExpectedHash(const tstring& hash)
+{
+    m_expectedHash = hash;
+}
+
+void DownloadManager::setCacheDirectory(const tstring& cacheDirectory, UINT64 maxSize)
+{
+    _cacheDirectory = cacheDirectory;
+    _cacheMaxSize = maxSize;
+}
+
+BOOL DownloadManager::isCached(const tstring& hash)
+{
+    if (_cacheDirectory.empty() || hash.empty())
+        return FALSE;
+
+    DownloadCache cache(_cacheDirectory, _cacheMaxSize);
+    return cache.contains(hash);
+}
+
+/* A file with the expected content is as good as a download */
+BOOL DownloadManager::copyExpectedFile(DownloadCache& cache, const TCHAR* url, const tstring& filename)
+{
+    if (m_expectedHash.empty() || !cache.copyTo(m_expectedHash, filename)) {
+        return FALSE;
+    }
+
+    if (_progressFunctionSet) {
+        _progressFunction(100);
+    }
+
+    DownloadMetrics metrics;
+    metrics.url = url;
+    metrics.success = TRUE;
+    metrics.fromCache = TRUE;
+    reportMetrics(metrics);
+    return TRUE;
+}
+
 BOOL DownloadManager::getUrl(CONST TCHAR *url, tstring& filename, tstring& contentType, const ModuleInfo *moduleInfo)
 {
-    InternetDownload download(moduleInfo->getHParent(), _userAgent, url, m_cancelToken, _progressFunction);
+    std::shared_ptr<DownloadCache> cache;
+    if (!_cacheDirectory.empty()) {
+        cache.reset(new DownloadCache(_cacheDirectory, _cacheMaxSize));
+    }
+
+    if (cache && copyExpectedFile(*cache, url, filename)) {
+        return TRUE;
+    }
+
+    std::shared_ptr<HttpTransport> transport = getTransport();
+    InternetDownload download(moduleInfo->getHParent(), *transport, url, m_cancelToken, _progressFunction);
     if (m_disableCache) {
         download.disableCache();
     }
+    download.setDataFunction(_dataFunction);
+
+    DownloadCacheEntry cacheEntry;
+    BOOL cached = cache && cache->lookup(url, cacheEntry);
+    if (cached) {
+        download.setConditionalHeaders(DownloadCache::getRevalidationHeaders(cacheEntry));
+    }
+
+    BOOL downloadSuccess = _partialDirectory.empty()
+        ? download.saveToFile(filename)
+        : download.resumeToFile(filename, _partialDirectory);
+
+    if (cached && HTTP_STATUS_NOT_MODIFIED == download.getStatusCode()) {
+        contentType.append(cacheEntry.contentType);
+        BOOL copied = cache->copyTo(cacheEntry.hash, filename);
+        reportMetrics(download, url, copied);
+        return copied;
+    }
 
-    BOOL downloadSuccess = download.saveToFile(filename);
     contentType.append(download.getContentType());
 
+    // The hash taken whilst it downloaded saves reading the file again for the cache, and to validate it
+    if (downloadSuccess) {
+        FileHashes::record(filename, download.getHash());
+    }
+
+    DWORD statusCode = download.getStatusCode();
+    if (downloadSuccess && cache && (HTTP_STATUS_OK == statusCode || HTTP_STATUS_PARTIAL_CONTENT == statusCode)) {
+        cacheEntry.etag = download.getETag();
+        cacheEntry.lastModified = download.getLastModified();
+        cacheEntry.contentType = download.getContentType();
+        cache->add(url, filename, cacheEntry);
+    }
+
+    reportMetrics(download, url, downloadSuccess);
     return downloadSuccess;
 }
 
@@ -54,14 +250,228 @@ BOOL DownloadManager::getUrl(CONST TCHAR *url, tstring& filename, tstring& conte
 
 BOOL DownloadManager::getUrl(CONST TCHAR *url, string& result, const ModuleInfo *moduleInfo)
 {
-    InternetDownload download(moduleInfo->getHParent(), _userAgent, url, m_cancelToken, _progressFunction);
+    std::shared_ptr<HttpTransport> transport = getTransport();
+    InternetDownload download(moduleInfo->getHParent(), *transport, url, m_cancelToken, _progressFunction);
     if (m_disableCache) {
         download.disableCache();
     }
     result.append( download.getContent());
+    reportMetrics(download, url, !result.empty());
     return !result.empty();
 }
 
+BOOL DownloadManager::getUrl(const MirrorList& mirrors, tstring& filename, tstring& contentType, const ModuleInfo *moduleInfo)
+{
+    if (mirrors.size() < 2) {
+        return mirrors.size() && getUrl(mirrors.getUrl(0).c_str(), filename, contentType, moduleInfo);
+    }
+
+    if (!_cacheDirectory.empty()) {
+        DownloadCache cache(_cacheDirectory, _cacheMaxSize);
+        if (copyExpectedFile(cache, mirrors.getUrl(0).c_str(), filename)) {
+            return TRUE;
+        }
+    }
+
+    return getFromMirrors(mirrors, moduleInfo, &filename, &contentType, NULL);
+}
+
+BOOL DownloadManager::getUrl(const MirrorList& mirrors, string& result, const ModuleInfo *moduleInfo)
+{
+    if (mirrors.size() < 2) {
+        return mirrors.size() && getUrl(mirrors.getUrl(0).c_str(), result, moduleInfo);
+    }
+
+    return getFromMirrors(mirrors, moduleInfo, NULL, NULL, &result);
+}
+
+/* Downloads to filename (and appends the content type), or to result if filename is NULL,
+ * from each mirror in turn until one succeeds */
+BOOL DownloadManager::getFromMirrors(const MirrorList& mirrors, const ModuleInfo *moduleInfo,
+                                     const tstring* filename, tstring* contentType, string* result)
+{
+    std::shared_ptr<MirrorScores> scores = getMirrorScores();
+    vector<tstring> urls = mirrors.getUrls();
+    scores->order(urls);
+
+    std::shared_ptr<HttpTransport> transport = getTransport();
+
+    // A file is cached under the first URL, whichever mirror it came from, and every mirror
+    // is asked if it has changed
+    std::shared_ptr<DownloadCache> cache;
+    DownloadCacheEntry cacheEntry;
+    BOOL cached = FALSE;
+    tstring conditionalHeaders;
+    if (filename && !_cacheDirectory.empty()) {
+        cache.reset(new DownloadCache(_cacheDirectory, _cacheMaxSize));
+        cached = cache->lookup(mirrors.getUrl(0), cacheEntry);
+        if (cached) {
+            conditionalHeaders = DownloadCache::getRevalidationHeaders(cacheEntry);
+        }
+    }
+
+    // The winner of the race goes first, then the rest in order of score
+    std::shared_ptr<HttpRequest> winner;
+    raceMirrors(*transport, urls, conditionalHeaders, *scores, winner);
+
+    for (vector<tstring>::const_iterator url = urls.begin(); url != urls.end(); ++url) {
+        if (m_cancelToken.isSignalled()) {
+            return FALSE;
+        }
+
+        InternetDownload download(moduleInfo->getHParent(), *transport, *url, m_cancelToken, _progressFunction);
+        if (m_disableCache) {
+            download.disableCache();
+        }
+        download.setDataFunction(_dataFunction);
+        download.setTimeout(MIRROR_STALL_TIMEOUT);
+        download.setConditionalHeaders(conditionalHeaders);
+
+        BOOL raced = (url == urls.begin() && winner);
+        if (raced) {
+            download.setRequest(winner);
+            winner.reset();
+        }
+
+        BOOL success;
+        if (filename) {
+            success = download.saveToFile(*filename);
+        } else {
+            *result = download.getContent();
+            success = !result->empty();
+        }
+        success = success && HTTP_STATUS_OK == download.getStatusCode();
+
+        BOOL notModified = cached && HTTP_STATUS_NOT_MODIFIED == download.getStatusCode();
+        if (notModified) {
+            success = cache->copyTo(cacheEntry.hash, *filename);
+        }
+        reportMetrics(download, url->c_str(), success);
+
+        if (success) {
+            // The winner of a race was scored by it
+            if (!raced) {
+                DownloadMetrics metrics;
+                download.getMetrics(metrics);
+                scores->recordResponse(*url, metrics.firstByte);
+            }
+
+            if (notModified) {
+                contentType->append(cacheEntry.contentType);
+            } else if (filename) {
+                contentType->append(download.getContentType());
+                FileHashes::record(*filename, download.getHash());
+
+                if (cache) {
+                    cacheEntry.etag = download.getETag();
+                    cacheEntry.lastModified = download.getLastModified();
+                    cacheEntry.contentType = download.getContentType();
+                    cache->add(mirrors.getUrl(0), *filename, cacheEntry);
+                }
+            }
+
+            return TRUE;
+        }
+
+        // A mirror isn't to blame for a download that was cancelled
+        if (!m_cancelToken.isSignalled()) {
+            scores->recordFailure(*url);
+        }
+    }
+
+    if (result) {
+        result->clear();
+    }
+
+    return FALSE;
+}
+
+/* Sends the request, with the extra headers, to the best MIRROR_RACE_COUNT of urls at once,
+ * and waits for the first to answer - the others are given up on.  urls is left with the
+ * winner first, and without any that failed.  Returns FALSE if none of them answered. */
+BOOL DownloadManager::raceMirrors(HttpTransport& transport, vector<tstring>& urls, const tstring& headers, MirrorScores& scores, std::shared_ptr<HttpRequest>& winner)
+{
+    size_t racerCount = min(urls.size(), static_cast<size_t>(MIRROR_RACE_COUNT));
+    vector< std::shared_ptr<HttpRequest> > requests(racerCount);
+    vector<BOOL> failed(racerCount, FALSE);
+    vector<HANDLE> threads;
+    vector<size_t> threadRacers;
+    double started = DownloadMetrics::now();
+    DWORD flags = m_disableCache ? HTTP_REQUEST_NO_CACHE : 0;
+
+    for (size_t racer = 0; racer < racerCount; ++racer) {
+        requests[racer] = transport.openRequest(urls[racer], headers, flags, m_cancelToken);
+        HANDLE hThread = NULL;
+        if (requests[racer]) {
+            requests[racer]->setTimeout(MIRROR_STALL_TIMEOUT);
+            hThread = ::CreateThread(0, 0, waitForResponseProc, requests[racer].get(), 0, 0);
+        }
+
+        if (hThread) {
+            threads.push_back(hThread);
+            threadRacers.push_back(racer);
+        } else {
+            failed[racer] = TRUE;
+            scores.recordFailure(urls[racer]);
+        }
+    }
+
+    size_t winnerIndex = racerCount;
+    while (!threads.empty() && winnerIndex == racerCount) {
+        DWORD waitResult = ::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], FALSE, INFINITE);
+        size_t finished = waitResult - WAIT_OBJECT_0;
+        if (finished >= threads.size()) {
+            break;
+        }
+
+        DWORD answered = 0;
+        ::GetExitCodeThread(threads[finished], &answered);
+        ::CloseHandle(threads[finished]);
+        size_t racer = threadRacers[finished];
+        threads.erase(threads.begin() + finished);
+        threadRacers.erase(threadRacers.begin() + finished);
+
+        if (answered) {
+            winnerIndex = racer;
+            scores.recordResponse(urls[racer], DownloadMetrics::now() - started);
+        } else {
+            failed[racer] = TRUE;
+
+            // A mirror isn't to blame for a download that was cancelled
+            if (!m_cancelToken.isSignalled()) {
+                scores.recordFailure(urls[racer]);
+            }
+        }
+    }
+
+    // The losers are at least as slow as the winner
+    double lost = DownloadMetrics::now() - started;
+    for (size_t thread = 0; thread < threads.size(); ++thread) {
+        requests[threadRacers[thread]]->abort();
+        ::WaitForSingleObject(threads[thread], INFINITE);
+        ::CloseHandle(threads[thread]);
+
+        if (winnerIndex < racerCount) {
+            scores.recordResponse(urls[threadRacers[thread]], lost);
+        }
+    }
+
+    vector<tstring> ordered;
+    if (winnerIndex < racerCount) {
+        winner = requests[winnerIndex];
+        ordered.push_back(urls[winnerIndex]);
+    }
+
+    for (size_t index = 0; index < urls.size(); ++index) {
+        if (index != winnerIndex && (index >= racerCount || !failed[index])) {
+            ordered.push_back(urls[index]);
+        }
+    }
+    urls.swap(ordered);
+
+    return winner != NULL;
+}
+
 void DownloadManager::cancelDownload() 
 {
     m_cancelToken.triggerCancel();
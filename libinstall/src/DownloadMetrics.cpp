@@ -0,0 +1,159 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "precompiled_headers.h"
+#include "libinstall/DownloadMetrics.h"
+#include "libinstall/WcharMbcsConverter.h"
+
+using namespace std;
+
+
+DownloadMetrics::DownloadMetrics()
+	: success(FALSE),
+	  fromCache(FALSE),
+	  statusCode(0),
+	  resolving(-1),
+	  resolved(-1),
+	  connecting(-1),
+	  connected(-1),
+	  requestSent(-1),
+	  firstByte(-1),
+	  finished(-1),
+	  bytesReceived(0),
+	  bytesPerSecond(0),
+	  retries(0),
+	  proxyAuthRequests(0)
+{
+}
+
+double DownloadMetrics::now()
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	::QueryPerformanceFrequency(&frequency);
+	::QueryPerformanceCounter(&counter);
+	return (static_cast<double>(counter.QuadPart) * 1000.0) / static_cast<double>(frequency.QuadPart);
+}
+
+
+
+DownloadMetricsFile::DownloadMetricsFile(const tstring& filename, DOWNLOADMETRICS_FORMAT format)
+	: _filename(filename),
+	  _format(format)
+{
+	::InitializeCriticalSection(&_lock);
+}
+
+DownloadMetricsFile::~DownloadMetricsFile()
+{
+	::DeleteCriticalSection(&_lock);
+}
+
+void DownloadMetricsFile::downloadFinished(const DownloadMetrics& metrics)
+{
+	string line = (DOWNLOADMETRICS_FORMAT_JSON == _format) ? formatJson(metrics) : formatLog(metrics);
+	line.append("\n");
+
+	::EnterCriticalSection(&_lock);
+	FILE* fp = NULL;
+	if (0 == _tfopen_s(&fp, _filename.c_str(), _T("ab")))
+	{
+		fwrite(line.c_str(), line.size(), 1, fp);
+		fclose(fp);
+	}
+	::LeaveCriticalSection(&_lock);
+}
+
+/* The local time, as "2016-01-31 13:45:10" */
+static string formatTime()
+{
+	SYSTEMTIME now;
+	::GetLocalTime(&now);
+
+	char buffer[30];
+	sprintf_s(buffer, 30, "%04hu-%02hu-%02hu %02hu:%02hu:%02hu",
+		now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+	return string(buffer);
+}
+
+string DownloadMetricsFile::formatLog(const DownloadMetrics& metrics)
+{
+	std::shared_ptr<char> url = WcharMbcsConverter::tchar2char(metrics.url.c_str());
+
+	char buffer[400];
+	sprintf_s(buffer, 400, " %s status=%lu cache=%d resolving=%.1f resolved=%.1f connecting=%.1f connected=%.1f sent=%.1f"
+		" firstbyte=%.1f finished=%.1f bytes=%I64u rate=%.0f retries=%d proxyauth=%d ",
+		metrics.success ? "OK" : "FAILED", metrics.statusCode, metrics.fromCache,
+		metrics.resolving, metrics.resolved, metrics.connecting, metrics.connected, metrics.requestSent,
+		metrics.firstByte, metrics.finished, metrics.bytesReceived, metrics.bytesPerSecond,
+		metrics.retries, metrics.proxyAuthRequests);
+
+	string line(formatTime());
+	line.append(buffer);
+	line.append(url.get());
+	return line;
+}
+
+/* Quotes and escapes str (UTF-8) as a JSON string */
+static string jsonString(const char* str)
+{
+	string result("\"");
+	for (; *str; ++str)
+	{
+		unsigned char ch = static_cast<unsigned char>(*str);
+		if ('"' == ch || '\\' == ch)
+		{
+			result.push_back('\\');
+			result.push_back(ch);
+		}
+		else if (ch < 0x20)
+		{
+			char escaped[8];
+			sprintf_s(escaped, 8, "\\u%04x", ch);
+			result.append(escaped);
+		}
+		else
+		{
+			result.push_back(ch);
+		}
+	}
+	result.push_back('"');
+	return result;
+}
+
+string DownloadMetricsFile::formatJson(const DownloadMetrics& metrics)
+{
+	std::shared_ptr<char> url = WcharMbcsConverter::tchar2char(metrics.url.c_str());
+
+	char buffer[400];
+	sprintf_s(buffer, 400, ",\"success\":%s,\"status\":%lu,\"cache\":%s,\"resolving\":%.1f,\"resolved\":%.1f,"
+		"\"connecting\":%.1f,\"connected\":%.1f,\"sent\":%.1f,\"firstByte\":%.1f,\"finished\":%.1f,"
+		"\"bytes\":%I64u,\"bytesPerSecond\":%.0f,\"retries\":%d,\"proxyAuth\":%d}",
+		metrics.success ? "true" : "false", metrics.statusCode, metrics.fromCache ? "true" : "false",
+		metrics.resolving, metrics.resolved, metrics.connecting, metrics.connected, metrics.requestSent,
+		metrics.firstByte, metrics.finished, metrics.bytesReceived, metrics.bytesPerSecond,
+		metrics.retries, metrics.proxyAuthRequests);
+
+	string line("{\"time\":");
+	line.append(jsonString(formatTime().c_str()));
+	line.append(",\"url\":");
+	line.append(jsonString(url.get()));
+	line.append(buffer);
+	return line;
+}
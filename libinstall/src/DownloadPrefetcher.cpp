@@ -0,0 +1,199 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/DownloadPrefetcher.h"
+#include "libinstall/DownloadManager.h"
+
+using namespace std;
+
+
+DownloadPrefetcher::DownloadPrefetcher(const tstring& downloadDirectory, int threadCount, const ModuleInfo* moduleInfo, CancelToken& cancelToken)
+	: _downloadDirectory(downloadDirectory),
+	  _threadCount(threadCount),
+	  _moduleInfo(moduleInfo),
+	  _cancelToken(cancelToken),
+	  _nextDownload(0),
+	  _finishedCount(0)
+{
+	::InitializeCriticalSection(&_lock);
+}
+
+DownloadPrefetcher::~DownloadPrefetcher()
+{
+	// Nothing is handed out after this, so the threads stop after their current download
+	::EnterCriticalSection(&_lock);
+	_nextDownload = _downloads.size();
+	::LeaveCriticalSection(&_lock);
+
+	if (!_threads.empty())
+	{
+		::WaitForMultipleObjects(static_cast<DWORD>(_threads.size()), &_threads[0], TRUE, INFINITE);
+		for (vector<HANDLE>::iterator it = _threads.begin(); it != _threads.end(); ++it)
+			::CloseHandle(*it);
+	}
+
+	for (vector< shared_ptr<Download> >::iterator it = _downloads.begin(); it != _downloads.end(); ++it)
+	{
+		if ((*it)->state != DOWNLOAD_TAKEN && !(*it)->filename.empty())
+			::DeleteFile((*it)->filename.c_str());
+		::CloseHandle((*it)->hFinished);
+	}
+
+	::DeleteCriticalSection(&_lock);
+}
+
+void DownloadPrefetcher::add(const MirrorList& mirrors, const tstring& expectedHash)
+{
+	::EnterCriticalSection(&_lock);
+	if (!findDownload(mirrors.getUrl(0)))
+	{
+		shared_ptr<Download> download(new Download());
+		download->url = mirrors.getUrl(0);
+		download->mirrors = mirrors;
+		download->expectedHash = expectedHash;
+		download->state = DOWNLOAD_QUEUED;
+		download->hFinished = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL);
+		_downloads.push_back(download);
+	}
+	::LeaveCriticalSection(&_lock);
+}
+
+void DownloadPrefetcher::start()
+{
+	::CreateDirectory(_downloadDirectory.c_str(), NULL);
+
+	size_t threadCount = min(static_cast<size_t>(_threadCount), _downloads.size());
+	for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+	{
+		HANDLE hThread = ::CreateThread(0, 0, DownloadPrefetcher::downloadThreadProc, this, 0, 0);
+		if (hThread)
+			_threads.push_back(hThread);
+	}
+}
+
+BOOL DownloadPrefetcher::take(const tstring& url, tstring& filename, tstring& contentType)
+{
+	::EnterCriticalSection(&_lock);
+	shared_ptr<Download> download = findDownload(url);
+	if (!download || download->state == DOWNLOAD_TAKEN)
+	{
+		::LeaveCriticalSection(&_lock);
+		return FALSE;
+	}
+
+	// Not started yet - the caller can download it just as quickly itself
+	if (download->state == DOWNLOAD_QUEUED)
+	{
+		download->state = DOWNLOAD_TAKEN;
+		::LeaveCriticalSection(&_lock);
+		return FALSE;
+	}
+	::LeaveCriticalSection(&_lock);
+
+	::WaitForSingleObject(download->hFinished, INFINITE);
+
+	::EnterCriticalSection(&_lock);
+	BOOL success = (download->state == DOWNLOAD_DONE);
+	if (success)
+	{
+		filename = download->filename;
+		contentType = download->contentType;
+		download->state = DOWNLOAD_TAKEN;
+	}
+	::LeaveCriticalSection(&_lock);
+
+	return success;
+}
+
+size_t DownloadPrefetcher::getFinishedCount()
+{
+	::EnterCriticalSection(&_lock);
+	size_t finishedCount = _finishedCount;
+	::LeaveCriticalSection(&_lock);
+	return finishedCount;
+}
+
+shared_ptr<DownloadPrefetcher::Download> DownloadPrefetcher::findDownload(const tstring& url)
+{
+	for (vector< shared_ptr<Download> >::iterator it = _downloads.begin(); it != _downloads.end(); ++it)
+	{
+		if ((*it)->url == url)
+			return *it;
+	}
+
+	return shared_ptr<Download>();
+}
+
+DWORD WINAPI DownloadPrefetcher::downloadThreadProc(LPVOID param)
+{
+	reinterpret_cast<DownloadPrefetcher*>(param)->runDownloads();
+	return 0;
+}
+
+void DownloadPrefetcher::runDownloads()
+{
+	for (;;)
+	{
+		// Take the next download nobody has asked for yet
+		shared_ptr<Download> download;
+		::EnterCriticalSection(&_lock);
+		while (_nextDownload < _downloads.size() && !download)
+		{
+			if (_downloads[_nextDownload]->state == DOWNLOAD_QUEUED)
+			{
+				download = _downloads[_nextDownload];
+				download->state = DOWNLOAD_RUNNING;
+			}
+			++_nextDownload;
+		}
+		::LeaveCriticalSection(&_lock);
+
+		if (!download)
+			return;
+
+		// A cancelled download still has to be finished, so take() doesn't wait forever
+		TCHAR downloadFilename[MAX_PATH];
+		BOOL success = FALSE;
+		tstring contentType;
+		if (!_cancelToken.isSignalled()
+			&& ::GetTempFileName(_downloadDirectory.c_str(), _T("prefetch"), 0, downloadFilename))
+		{
+			DownloadManager downloadManager(_cancelToken);
+			tstring filename(downloadFilename);
+			downloadManager.setExpectedHash(download->expectedHash);
+			success = downloadManager.getUrl(download->mirrors, filename, contentType, _moduleInfo);
+			if (!success)
+				::DeleteFile(downloadFilename);
+		}
+
+		::EnterCriticalSection(&_lock);
+		if (success)
+		{
+			download->filename = downloadFilename;
+			download->contentType = contentType;
+		}
+		download->state = success ? DOWNLOAD_DONE : DOWNLOAD_FAILED;
+		++_finishedCount;
+		::LeaveCriticalSection(&_lock);
+
+		::SetEvent(download->hFinished);
+	}
+}
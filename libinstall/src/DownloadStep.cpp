@@ -8,15 +8,39 @@
 #include "libinstall/DirectLinkSearch.h"
 #include "libinstall/ProxyInfo.h"
 #include "libinstall/ModuleInfo.h"
+#include "libinstall/DownloadPrefetcher.h"
+#include "libinstall/ZipStreamExtractor.h"
+#include "libinstall/MirrorList.h"
 
 using namespace std;
+using namespace std::placeholders;
 
-DownloadStep::DownloadStep(const TCHAR *url, const TCHAR *filename)
+DownloadStep::DownloadStep(const TCHAR *url, const TCHAR *filename, const TCHAR *md5 /* = NULL */, const TCHAR *mirrors /* = NULL */)
+    : _prefetcher(NULL)
 {
     _url = url;
 
     if (filename)
         _filename = filename;
+
+    if (md5)
+        _md5 = md5;
+
+    if (mirrors)
+        _mirrors = mirrors;
+}
+
+void DownloadStep::setDownloadPrefetcher(DownloadPrefetcher* prefetcher)
+{
+    _prefetcher = prefetcher;
+
+    // Nothing to fetch if the file will come from the download cache
+    if (_prefetcher && !DownloadManager::isCached(_md5))
+    {
+        MirrorList mirrors(_url);
+        mirrors.addList(_mirrors.c_str());
+        _prefetcher->add(mirrors, _md5);
+    }
 }
 
 StepStatus DownloadStep::perform(tstring &basePath, TiXmlElement* forGpup,
@@ -51,11 +75,39 @@ StepStatus DownloadStep::perform(tstring &basePath, TiXmlElement* forGpup,
 
     // Link up the progress callback
     downloadManager.setProgressFunction(stepProgress);
+    downloadManager.setExpectedHash(_md5);
 
+    // Extract the zip whilst it downloads - if that can't be done, it is unzipped below once it is all here
+    ZipStreamExtractor extractor(basePath);
+    downloadManager.setDataFunction(std::bind(&ZipStreamExtractor::write, &extractor, _1, _2, _3));
 
     tstring contentType;
 
-    if (downloadManager.getUrl(_url.c_str(), downloadFilename, contentType, moduleInfo))
+    // Use the prefetched file if there is one, otherwise download it now
+    BOOL downloaded = FALSE;
+    tstring prefetchedFilename;
+    if (_prefetcher && _prefetcher->take(_url, prefetchedFilename, contentType))
+    {
+        downloaded = ::MoveFileEx(prefetchedFilename.c_str(), downloadFilename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED);
+        if (downloaded)
+        {
+            stepProgress(100);
+        }
+        else
+        {
+            ::DeleteFile(prefetchedFilename.c_str());
+            contentType.clear();
+        }
+    }
+
+    if (!downloaded)
+    {
+        MirrorList mirrors(_url);
+        mirrors.addList(_mirrors.c_str());
+        downloaded = downloadManager.getUrl(mirrors, downloadFilename, contentType, moduleInfo);
+    }
+
+    if (downloaded)
     {
         if (contentType == _T("text/html"))
         {
@@ -87,7 +139,9 @@ StepStatus DownloadStep::perform(tstring &basePath, TiXmlElement* forGpup,
 
             if (realLink.get())
             {
+                // The real file is only on the server the page pointed to
                 _url = realLink.get();
+                _mirrors.clear();
                 return perform(basePath, forGpup, setStatus, stepProgress, moduleInfo, cancelToken);
             }
             else
@@ -97,7 +151,7 @@ StepStatus DownloadStep::perform(tstring &basePath, TiXmlElement* forGpup,
             // Assume it is a zip file - if unzipping fails, then check if the filename is filled in
             // - if it is, then just leave the file as it is (ie. direct download)
             //   the file will be available for copying or installing.
-            if (Decompress::unzip(downloadFilename, basePath) || !_filename.empty())
+            if (extractor.isComplete() || Decompress::unzip(downloadFilename, basePath) || !_filename.empty())
             {
                 return STEPSTATUS_SUCCESS;
             }
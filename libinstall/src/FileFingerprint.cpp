@@ -0,0 +1,107 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/FileFingerprint.h"
+#include "libinstall/PeVersionReader.h"
+#include "libinstall/md5.h"
+#include "libinstall/FileHashes.h"
+
+
+FileFingerprint::FileFingerprint()
+	: _size(0),
+	  _hasVersion(FALSE),
+	  _fileVersionMS(0),
+	  _fileVersionLS(0)
+{
+}
+
+
+BOOL FileFingerprint::read(const TCHAR* filename)
+{
+	tstring knownHash;
+	FileHashes::lookup(filename, knownHash);
+
+	HANDLE hFile = ::CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(hFile, &fileSize)
+		|| static_cast<UINT64>(fileSize.QuadPart) > static_cast<UINT64>(static_cast<size_t>(-1)))
+	{
+		::CloseHandle(hFile);
+		return FALSE;
+	}
+
+	// An empty file can't be mapped
+	if (0 == fileSize.QuadPart)
+	{
+		::CloseHandle(hFile);
+		return read(NULL, 0, knownHash);
+	}
+
+	BOOL success = FALSE;
+	HANDLE hMapping = ::CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping)
+	{
+		const BYTE* view = reinterpret_cast<const BYTE*>(::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+		if (view)
+		{
+			success = read(view, static_cast<size_t>(fileSize.QuadPart), knownHash);
+			::UnmapViewOfFile(view);
+		}
+		::CloseHandle(hMapping);
+	}
+
+	::CloseHandle(hFile);
+	return success;
+}
+
+
+BOOL FileFingerprint::read(const BYTE* file, size_t size)
+{
+	return read(file, size, tstring());
+}
+
+
+BOOL FileFingerprint::read(const BYTE* file, size_t size, const tstring& knownHash)
+{
+	_size = size;
+
+	PeVersionReader versionReader(file, size);
+	_hasVersion = versionReader.getFileVersion(_fileVersionMS, _fileVersionLS);
+
+	if (!knownHash.empty())
+	{
+		_hash = knownHash;
+		return TRUE;
+	}
+
+	TCHAR hashBuffer[(MD5LEN * 2) + 1];
+	if (!MD5::hash(file, size, hashBuffer, (MD5LEN * 2) + 1))
+	{
+		_hash.clear();
+		return FALSE;
+	}
+
+	_hash = hashBuffer;
+	return TRUE;
+}
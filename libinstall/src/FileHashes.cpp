@@ -0,0 +1,94 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "precompiled_headers.h"
+#include "libinstall/FileHashes.h"
+
+using namespace std;
+
+
+FileHashes::Registry& FileHashes::getRegistry()
+{
+	// Created the first time it's needed, so it's there for the other statics
+	static Registry registry;
+	return registry;
+}
+
+/* Paths are compared without case, and with either slash */
+tstring FileHashes::getKey(const tstring& filename)
+{
+	tstring key(filename);
+	for (tstring::iterator it = key.begin(); it != key.end(); ++it)
+	{
+		if (_T('/') == *it)
+			*it = _T('\\');
+	}
+
+	if (!key.empty())
+		::CharLowerBuff(&key[0], static_cast<DWORD>(key.size()));
+
+	return key;
+}
+
+void FileHashes::record(const tstring& filename, const tstring& md5)
+{
+	Entry entry;
+	Win32FileSystem fileSystem;
+	if (md5.empty() || !fileSystem.getFileStat(filename, entry.fileStat))
+		return;
+	entry.md5 = md5;
+
+	tstring key = getKey(filename);
+	Registry& registry = getRegistry();
+	::EnterCriticalSection(&registry.lock);
+	if (registry.entries.size() >= FILEHASHES_MAX_ENTRIES)
+		registry.entries.clear();
+	registry.entries[key] = entry;
+	::LeaveCriticalSection(&registry.lock);
+}
+
+BOOL FileHashes::lookup(const tstring& filename, tstring& md5)
+{
+	FileStat fileStat;
+	Win32FileSystem fileSystem;
+	if (!fileSystem.getFileStat(filename, fileStat))
+		return FALSE;
+
+	tstring key = getKey(filename);
+	Registry& registry = getRegistry();
+	BOOL found = FALSE;
+	::EnterCriticalSection(&registry.lock);
+	map<tstring, Entry>::const_iterator it = registry.entries.find(key);
+	if (it != registry.entries.end() && it->second.fileStat == fileStat)
+	{
+		md5 = it->second.md5;
+		found = TRUE;
+	}
+	::LeaveCriticalSection(&registry.lock);
+
+	return found;
+}
+
+void FileHashes::clear()
+{
+	Registry& registry = getRegistry();
+	::EnterCriticalSection(&registry.lock);
+	registry.entries.clear();
+	::LeaveCriticalSection(&registry.lock);
+}
@@ -0,0 +1,231 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/FileSink.h"
+
+using namespace std;
+
+
+FileSink::FileSink()
+	: _hFile(INVALID_HANDLE_VALUE),
+	  _current(0),
+	  _oldest(0),
+	  _pendingCount(0),
+	  _offset(0),
+	  _writtenLength(0),
+	  _failed(FALSE)
+{
+	memset(_buffers, 0, sizeof(_buffers));
+}
+
+FileSink::~FileSink()
+{
+	close();
+
+	for (int index = 0; index < FILESINK_BUFFER_COUNT; ++index)
+	{
+		if (_buffers[index].data)
+			::VirtualFree(_buffers[index].data, 0, MEM_RELEASE);
+
+		if (_buffers[index].overlapped.hEvent)
+			::CloseHandle(_buffers[index].overlapped.hEvent);
+	}
+}
+
+BOOL FileSink::create(const tstring& filename)
+{
+	return open(filename, CREATE_ALWAYS);
+}
+
+BOOL FileSink::append(const tstring& filename)
+{
+	return open(filename, OPEN_ALWAYS);
+}
+
+BOOL FileSink::open(const tstring& filename, DWORD creationDisposition)
+{
+	close();
+
+	_hFile = ::CreateFile(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, creationDisposition,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+	if (INVALID_HANDLE_VALUE == _hFile)
+		return FALSE;
+
+	// Overlapped writes say where they go, so appending is just starting at the end
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(_hFile, &size))
+	{
+		::CloseHandle(_hFile);
+		_hFile = INVALID_HANDLE_VALUE;
+		return FALSE;
+	}
+
+	_current = 0;
+	_oldest = 0;
+	_pendingCount = 0;
+	_offset = static_cast<UINT64>(size.QuadPart);
+	_writtenLength = _offset;
+	_failed = FALSE;
+	return TRUE;
+}
+
+BOOL FileSink::reserve(UINT64 size)
+{
+	if (!isOpen() || _failed)
+		return FALSE;
+
+	// Never cut off what has already been written
+	if (size <= _offset + _buffers[_current].length)
+		return TRUE;
+
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(size);
+	return ::SetFilePointerEx(_hFile, end, NULL, FILE_BEGIN) && ::SetEndOfFile(_hFile);
+}
+
+/* The current buffer ends on the next multiple of FILESINK_BUFFER_SIZE in the file, so
+ * after an append starts part way through, the writes are aligned again */
+DWORD FileSink::getCapacity() const
+{
+	return FILESINK_BUFFER_SIZE - static_cast<DWORD>(_offset % FILESINK_BUFFER_SIZE);
+}
+
+BOOL FileSink::write(const BYTE* data, DWORD length)
+{
+	if (!isOpen() || _failed)
+		return FALSE;
+
+	while (length > 0)
+	{
+		Buffer& buffer = _buffers[_current];
+
+		// Buffers are only allocated when needed, as most files fit in one
+		if (!buffer.data)
+		{
+			buffer.data = reinterpret_cast<BYTE*>(::VirtualAlloc(NULL, FILESINK_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			if (!buffer.overlapped.hEvent)
+				buffer.overlapped.hEvent = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
+
+			if (!buffer.data || !buffer.overlapped.hEvent)
+			{
+				_failed = TRUE;
+				return FALSE;
+			}
+		}
+
+		DWORD copyLength = min(length, getCapacity() - buffer.length);
+		memcpy(buffer.data + buffer.length, data, copyLength);
+		buffer.length += copyLength;
+		data += copyLength;
+		length -= copyLength;
+
+		if (buffer.length == getCapacity())
+			writeBuffer();
+	}
+
+	return !_failed;
+}
+
+/* Starts writing the current buffer, and moves on to the next one, waiting for it to be
+ * written first if need be */
+void FileSink::writeBuffer()
+{
+	// Anything that has finished in the meantime counts as written
+	while (_pendingCount > 0 && _buffers[_oldest].pending && HasOverlappedIoCompleted(&_buffers[_oldest].overlapped))
+		waitForOldest();
+
+	Buffer& buffer = _buffers[_current];
+	HANDLE hEvent = buffer.overlapped.hEvent;
+	memset(&buffer.overlapped, 0, sizeof(OVERLAPPED));
+	buffer.overlapped.hEvent = hEvent;
+	buffer.overlapped.Offset = static_cast<DWORD>(_offset);
+	buffer.overlapped.OffsetHigh = static_cast<DWORD>(_offset >> 32);
+
+	// Even a write that finishes straight away is collected by waitForOldest()
+	if (::WriteFile(_hFile, buffer.data, buffer.length, NULL, &buffer.overlapped) || ERROR_IO_PENDING == ::GetLastError())
+	{
+		buffer.pending = TRUE;
+		++_pendingCount;
+	}
+	else
+	{
+		_failed = TRUE;
+	}
+
+	_offset += buffer.length;
+	_current = (_current + 1) % FILESINK_BUFFER_COUNT;
+
+	while (_buffers[_current].pending)
+		waitForOldest();
+
+	_buffers[_current].length = 0;
+}
+
+/* Waits for the oldest write that was started, and adds it to the written length */
+BOOL FileSink::waitForOldest()
+{
+	Buffer& buffer = _buffers[_oldest];
+	_oldest = (_oldest + 1) % FILESINK_BUFFER_COUNT;
+
+	if (!buffer.pending)
+		return FALSE;
+
+	buffer.pending = FALSE;
+	--_pendingCount;
+
+	DWORD bytesWritten = 0;
+	if (!::GetOverlappedResult(_hFile, &buffer.overlapped, &bytesWritten, TRUE) || bytesWritten != buffer.length)
+	{
+		_failed = TRUE;
+		return FALSE;
+	}
+
+	// Once one has failed, what comes after it isn't any use
+	if (!_failed)
+		_writtenLength += bytesWritten;
+
+	return TRUE;
+}
+
+BOOL FileSink::close()
+{
+	if (!isOpen())
+		return TRUE;
+
+	if (!_failed && _buffers[_current].length > 0)
+		writeBuffer();
+
+	while (_pendingCount > 0)
+		waitForOldest();
+
+	// Gives back any reserved space that wasn't used - and if a write failed, leaves the
+	// file with only what was written before it
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(_failed ? _writtenLength : _offset);
+	if (!::SetFilePointerEx(_hFile, end, NULL, FILE_BEGIN) || !::SetEndOfFile(_hFile))
+		_failed = TRUE;
+
+	::CloseHandle(_hFile);
+	_hFile = INVALID_HANDLE_VALUE;
+	_buffers[_current].length = 0;
+
+	return !_failed;
+}
@@ -0,0 +1,86 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/FileSystem.h"
+
+using namespace std;
+
+
+BOOL Win32FileSystem::getFileStat(const tstring& filename, FileStat& fileStat)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return FALSE;
+
+	fileStat.size = (static_cast<UINT64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	fileStat.lastWriteTime = (static_cast<UINT64>(attributes.ftLastWriteTime.dwHighDateTime) << 32)
+		| attributes.ftLastWriteTime.dwLowDateTime;
+	return TRUE;
+}
+
+
+BOOL Win32FileSystem::readFile(const tstring& filename, string& contents)
+{
+	HANDLE hFile = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(hFile, &fileSize) || fileSize.HighPart != 0)
+	{
+		::CloseHandle(hFile);
+		return FALSE;
+	}
+
+	contents.resize(static_cast<size_t>(fileSize.QuadPart));
+
+	DWORD bytesRead = 0;
+	BOOL readSuccess = contents.empty()
+		|| ::ReadFile(hFile, &contents[0], fileSize.LowPart, &bytesRead, NULL);
+	::CloseHandle(hFile);
+
+	return readSuccess && bytesRead == contents.size();
+}
+
+
+BOOL Win32FileSystem::writeFile(const tstring& filename, const string& contents)
+{
+	tstring tempFilename(filename);
+	tempFilename.append(_T(".tmp"));
+
+	HANDLE hFile = ::CreateFile(tempFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	DWORD bytesWritten = 0;
+	BOOL writeSuccess = contents.empty()
+		|| ::WriteFile(hFile, contents.c_str(), static_cast<DWORD>(contents.size()), &bytesWritten, NULL);
+	::CloseHandle(hFile);
+
+	if (!writeSuccess || bytesWritten != contents.size()
+		|| !::MoveFileEx(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		::DeleteFile(tempFilename.c_str());
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,224 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/FingerprintCache.h"
+
+using namespace std;
+
+
+static void writeUInt(string& buffer, UINT32 value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(UINT32));
+}
+
+static void writeUInt64(string& buffer, UINT64 value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(UINT64));
+}
+
+static void writeString(string& buffer, const tstring& str)
+{
+	writeUInt(buffer, static_cast<UINT32>(str.size()));
+	buffer.append(reinterpret_cast<const char*>(str.c_str()), str.size() * sizeof(TCHAR));
+}
+
+static BOOL readUInt(const string& buffer, size_t& position, UINT32& value)
+{
+	if (buffer.size() - position < sizeof(UINT32))
+		return FALSE;
+
+	memcpy(&value, buffer.c_str() + position, sizeof(UINT32));
+	position += sizeof(UINT32);
+	return TRUE;
+}
+
+static BOOL readUInt64(const string& buffer, size_t& position, UINT64& value)
+{
+	if (buffer.size() - position < sizeof(UINT64))
+		return FALSE;
+
+	memcpy(&value, buffer.c_str() + position, sizeof(UINT64));
+	position += sizeof(UINT64);
+	return TRUE;
+}
+
+static BOOL readString(const string& buffer, size_t& position, tstring& str)
+{
+	UINT32 length;
+	if (!readUInt(buffer, position, length))
+		return FALSE;
+
+	size_t byteLength = static_cast<size_t>(length) * sizeof(TCHAR);
+	if (buffer.size() - position < byteLength)
+		return FALSE;
+
+	str.assign(reinterpret_cast<const TCHAR*>(buffer.c_str() + position), length);
+	position += byteLength;
+	return TRUE;
+}
+
+
+FingerprintCache::FingerprintCache(FileSystem& fileSystem)
+	: _fileSystem(fileSystem),
+	  _changed(FALSE),
+	  _hits(0),
+	  _misses(0)
+{
+}
+
+
+BOOL FingerprintCache::load(const tstring& cacheFilename)
+{
+	_entries.clear();
+	_changed = FALSE;
+
+	string buffer;
+	if (!_fileSystem.readFile(cacheFilename, buffer))
+		return FALSE;
+
+	size_t position = 0;
+	UINT32 magic, version, charSize, count;
+	if (!readUInt(buffer, position, magic) || magic != FINGERPRINTCACHE_MAGIC
+		|| !readUInt(buffer, position, version) || version != FINGERPRINTCACHE_VERSION
+		|| !readUInt(buffer, position, charSize) || charSize != sizeof(TCHAR)
+		|| !readUInt(buffer, position, count))
+		return FALSE;
+
+	for (UINT32 index = 0; index < count; ++index)
+	{
+		tstring filename;
+		CacheEntry entry;
+		UINT32 isPlugin, hasVersion;
+
+		if (!readString(buffer, position, filename)
+			|| !readUInt64(buffer, position, entry.fileStat.size)
+			|| !readUInt64(buffer, position, entry.fileStat.lastWriteTime)
+			|| !readUInt(buffer, position, isPlugin)
+			|| !readString(buffer, position, entry.fingerprint.name)
+			|| !readString(buffer, position, entry.fingerprint.hash)
+			|| !readUInt(buffer, position, hasVersion)
+			|| !readUInt(buffer, position, entry.fingerprint.fileVersionMS)
+			|| !readUInt(buffer, position, entry.fingerprint.fileVersionLS))
+		{
+			// A damaged cache is just discarded
+			_entries.clear();
+			return FALSE;
+		}
+
+		entry.fingerprint.isPlugin = isPlugin ? TRUE : FALSE;
+		entry.fingerprint.hasVersion = hasVersion ? TRUE : FALSE;
+		entry.used = FALSE;
+		_entries[filename] = entry;
+	}
+
+	return TRUE;
+}
+
+
+BOOL FingerprintCache::save(const tstring& cacheFilename)
+{
+	if (!_changed)
+		return TRUE;
+
+	string buffer;
+	buffer.reserve(_entries.size() * 256);
+
+	writeUInt(buffer, FINGERPRINTCACHE_MAGIC);
+	writeUInt(buffer, FINGERPRINTCACHE_VERSION);
+	writeUInt(buffer, sizeof(TCHAR));
+	writeUInt(buffer, static_cast<UINT32>(_entries.size()));
+
+	for (EntryContainer::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		writeString(buffer, it->first);
+		writeUInt64(buffer, it->second.fileStat.size);
+		writeUInt64(buffer, it->second.fileStat.lastWriteTime);
+		writeUInt(buffer, it->second.fingerprint.isPlugin ? 1 : 0);
+		writeString(buffer, it->second.fingerprint.name);
+		writeString(buffer, it->second.fingerprint.hash);
+		writeUInt(buffer, it->second.fingerprint.hasVersion ? 1 : 0);
+		writeUInt(buffer, it->second.fingerprint.fileVersionMS);
+		writeUInt(buffer, it->second.fingerprint.fileVersionLS);
+	}
+
+	if (!_fileSystem.writeFile(cacheFilename, buffer))
+		return FALSE;
+
+	_changed = FALSE;
+	return TRUE;
+}
+
+
+BOOL FingerprintCache::lookup(const tstring& filename, FileStat& fileStat, Fingerprint& fingerprint)
+{
+	if (!_fileSystem.getFileStat(filename, fileStat))
+	{
+		// Can't tell if it's changed, so don't use or keep the entry
+		fileStat.size = 0;
+		fileStat.lastWriteTime = 0;
+		++_misses;
+		return FALSE;
+	}
+
+	EntryContainer::iterator it = _entries.find(filename);
+	if (it == _entries.end() || it->second.fileStat != fileStat)
+	{
+		++_misses;
+		return FALSE;
+	}
+
+	it->second.used = TRUE;
+	fingerprint = it->second.fingerprint;
+	++_hits;
+	return TRUE;
+}
+
+
+void FingerprintCache::add(const tstring& filename, const FileStat& fileStat, const Fingerprint& fingerprint)
+{
+	// Without a time, a later change to the file couldn't be spotted
+	if (0 == fileStat.lastWriteTime)
+		return;
+
+	CacheEntry& entry = _entries[filename];
+	entry.fileStat = fileStat;
+	entry.fingerprint = fingerprint;
+	entry.used = TRUE;
+	_changed = TRUE;
+}
+
+
+void FingerprintCache::removeUnused()
+{
+	EntryContainer::iterator it = _entries.begin();
+	while (it != _entries.end())
+	{
+		if (it->second.used)
+		{
+			++it;
+		}
+		else
+		{
+			it = _entries.erase(it);
+			_changed = TRUE;
+		}
+	}
+}
@@ -42,7 +42,8 @@ std::shared_ptr<InstallStep> InstallStepFactory::create(TiXmlElement* element)
 
 	if (!_tcscmp(element->Value(), _T("download")) && element->FirstChild())
 	{
-		installStep.reset(new DownloadStep(element->FirstChild()->Value(), element->Attribute(_T("filename"))));
+		installStep.reset(new DownloadStep(element->FirstChild()->Value(), element->Attribute(_T("filename")), element->Attribute(_T("md5")),
+			element->Attribute(_T("mirrors"))));
 	}
 	else if (!_tcscmp(element->Value(), _T("copy")))
 	{
@@ -131,4 +132,17 @@ std::shared_ptr<InstallStep> InstallStepFactory::create(TiXmlElement* element)
 }
 
 
+BOOL InstallStepFactory::createsStep(TiXmlElement* element)
+{
+	if (!_tcscmp(element->Value(), _T("download")))
+		return element->FirstChild() != NULL;
+
+	if (!_tcscmp(element->Value(), _T("delete")))
+		return element->Attribute(_T("file")) != NULL;
+
+	return !_tcscmp(element->Value(), _T("copy"))
+		|| !_tcscmp(element->Value(), _T("run"));
+}
+
+
 
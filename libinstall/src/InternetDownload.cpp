@@ -2,129 +2,68 @@
 #include "precompiled_headers.h"
 #include "InternetDownload.h"
 #include "libinstall/CancelToken.h"
+#include "libinstall/PartialDownload.h"
+#include "libinstall/HttpTransport.h"
+#include "libinstall/DownloadMetrics.h"
 
-InternetDownload::InternetDownload(HWND parentHwnd, const tstring& userAgent, const tstring& url, CancelToken cancelToken, std::function<void(int)> progressFunction /* = NULL */)
+// The received length of a partial download is recorded each time this much more has been written
+#define PARTIAL_CHECKPOINT_SIZE  (1024 * 1024)
+
+// Not in older versions of WinInet.h
+#ifndef HTTP_STATUS_RANGE_NOT_SATISFIABLE
+#define HTTP_STATUS_RANGE_NOT_SATISFIABLE  416
+#endif
+
+InternetDownload::InternetDownload(HWND parentHwnd, HttpTransport& transport, const tstring& url, CancelToken cancelToken, std::function<void(int)> progressFunction /* = NULL */)
     : m_progressFunction(progressFunction),
       m_url(url),
-      m_hInternet(NULL),
-      m_hConnect(NULL),
-      m_hHttp(NULL),
+      m_rangeRequested(FALSE),
+      m_dataOffset(0),
+      m_contentLength(0),
+      m_transport(transport),
+      m_timeout(0),
       m_cancelToken(cancelToken),
       m_parentHwnd(parentHwnd),
       m_receivedBytes(0),
       m_error(0),
-      m_flags(0)
+      m_flags(0),
+      m_statusCode(0),
+      m_requestOpened(0),
+      m_firstByte(-1),
+      m_bytesReceived(0),
+      m_retries(0),
+      m_proxyAuthRequests(0)
 {
-    m_requestComplete = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
-    m_responseReceived = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
-
-    m_hInternet = ::InternetOpen(userAgent.c_str(), INTERNET_OPEN_TYPE_PRECONFIG, NULL /* proxy*/ , NULL /* proxy bypass */, INTERNET_FLAG_ASYNC /* dwflags */);
-
-    INTERNET_STATUS_CALLBACK ourCallback = &InternetDownload::statusCallback;
-    ::InternetSetStatusCallback(m_hInternet, ourCallback);
-    DWORD timeout = 120000;
-    ::InternetSetOption(m_hInternet, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(DWORD));
-    ::InternetSetOption(m_hInternet, INTERNET_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(DWORD));
+    m_started = DownloadMetrics::now();
 }
 
 InternetDownload::~InternetDownload()
 {
-    if (m_hHttp) {
-        ::InternetCloseHandle(m_hHttp);
-        m_hHttp = NULL;
-    }
-
-    if (m_hConnect) {
-        ::InternetCloseHandle(m_hConnect);
-        m_hConnect = NULL;
-    }
-
-    if (m_hInternet) {
-        ::InternetCloseHandle(m_hInternet);
-        m_hInternet = NULL;
-    }
-
-    if (m_responseReceived) {
-        ::CloseHandle(m_responseReceived);
-        m_responseReceived = NULL;
-    }
-
-    if (m_requestComplete) {
-        ::CloseHandle(m_requestComplete);
-        m_requestComplete = NULL;
-    }
 }
 
-void InternetDownload::statusCallback( HINTERNET /* hInternet */,
-     DWORD_PTR dwContext,
-     DWORD dwInternetStatus,
-     LPVOID lpvStatusInformation,
-     DWORD /* dwStatusInformationLength */)
-{
-    InternetDownload *download = reinterpret_cast<InternetDownload*>(dwContext);
-    switch(dwInternetStatus) {
-    case INTERNET_STATUS_RECEIVING_RESPONSE:
-            download->receivingResponse();
-            break;
-
-    case INTERNET_STATUS_REQUEST_COMPLETE:
-            download->responseReceived();
-            break;
-    case INTERNET_STATUS_HANDLE_CREATED:
-            download->m_hHttp = (*(HANDLE*)lpvStatusInformation);
-            break;
-
-    default:
-        break;
-
-    }
-
-
-}
 void InternetDownload::disableCache() {
-    m_flags = INTERNET_FLAG_PRAGMA_NOCACHE | INTERNET_FLAG_RESYNCHRONIZE;
+    m_flags = HTTP_REQUEST_NO_CACHE;
 }
 
 BOOL InternetDownload::request() {
+    m_requestOpened = DownloadMetrics::now();
+    m_firstByte = -1;
 
-    if (!m_hInternet) {
-        return FALSE;
+    if (m_sentRequest && m_requestHeaders == m_conditionalHeaders) {
+        m_request = m_sentRequest;
+    } else {
+        m_request = m_transport.openRequest(m_url, m_requestHeaders, m_flags, m_cancelToken);
     }
+    m_sentRequest.reset();
 
-    m_hHttp = InternetOpenUrl(m_hInternet, m_url.c_str(), NULL, 0, m_flags, reinterpret_cast<DWORD_PTR>(this));
-    return TRUE;
-}
-
-BOOL InternetDownload::waitForHandle(HANDLE handle)
-{
-    HANDLE waitHandles[2];
-    waitHandles[0] = m_cancelToken.getToken();
-    waitHandles[1] = handle;
-    int waitResponse = WaitForMultipleObjects(2, waitHandles, FALSE, 60000);
-
-    switch(waitResponse) {
-        case WAIT_OBJECT_0:
-            {
-                // cancelled
-                return FALSE;
-            }
-
-        case WAIT_TIMEOUT:
-            {
-                // More than 60seconds for response
-                return FALSE;
-            }
-
-        case WAIT_FAILED:
-            {
-                return FALSE;
-            }
+    if (m_request && m_timeout) {
+        m_request->setTimeout(m_timeout);
     }
 
-    return TRUE;
+    return m_request != NULL;
 }
 
-DOWNLOAD_STATUS InternetDownload::getData(writeData_t writeData, void *context)
+DOWNLOAD_STATUS InternetDownload::getData(writeData_t writeData, void *context, startData_t startData /* = NULL */)
 {
 
     if (m_error) {
@@ -137,46 +76,42 @@ DOWNLOAD_STATUS InternetDownload::getData(writeData_t writeData, void *context)
 
     OutputDebugString(_T("Beginning getData - waiting for request completion\n"));
 
-    if (!waitForHandle(m_responseReceived)) {
+    m_statusCode = 0;
+    m_dataOffset = 0;
+    m_hash.clear();
+    if (!m_request->waitForResponse()) {
         return DOWNLOAD_STATUS_FAIL;
     }
 
-    TCHAR headerBuffer[1024] = { 0 };
-    DWORD headerIndex = 0;
-    DWORD bufferLength = 1024;
-
-    DWORD statusCode = 0;
-    BOOL statusCodeSuccess = HttpQueryInfo(m_hHttp, HTTP_QUERY_STATUS_CODE, headerBuffer, &bufferLength, &headerIndex);
-    if (statusCodeSuccess) {
-        statusCode = _ttol(headerBuffer);
-    }
+    m_firstByte = DownloadMetrics::now();
+    DWORD statusCode = m_request->getStatusCode();
+    m_statusCode = statusCode;
 
     if (HTTP_STATUS_PROXY_AUTH_REQ == statusCode) {
-        LPVOID errorBuffer = 0;
-        DWORD dwFlags = FLAGS_ERROR_UI_FLAGS_GENERATE_DATA | FLAGS_ERROR_UI_FLAGS_CHANGE_OPTIONS;
-        DWORD errorResult = InternetErrorDlg(m_parentHwnd, m_hHttp, ERROR_INTERNET_INCORRECT_PASSWORD, dwFlags, &errorBuffer);
-        if (errorResult == ERROR_INTERNET_FORCE_RETRY) {
+        ++m_proxyAuthRequests;
+        if (m_request->askProxyLogin(m_parentHwnd)) {
             return DOWNLOAD_STATUS_FORCE_RETRY;
         }
-
     }
 
-    bufferLength = 1024;
-    headerIndex = 0;
-    long contentLength = 0;
-    BOOL contentLengthSuccess = HttpQueryInfo(m_hHttp, HTTP_QUERY_CONTENT_LENGTH, headerBuffer, &bufferLength, &headerIndex);
-    if (contentLengthSuccess) {
-        contentLength = _ttol(headerBuffer);
+    if (HTTP_STATUS_NOT_MODIFIED == statusCode) {
+        return DOWNLOAD_STATUS_NOT_MODIFIED;
     }
 
+    long contentLength = _ttol(m_request->getHeader(_T("Content-Length")).c_str());
+    m_contentLength = contentLength > 0 ? static_cast<UINT64>(contentLength) : 0;
+    m_contentType = m_request->getHeader(_T("Content-Type"));
+    m_etag = m_request->getHeader(_T("ETag"));
+    m_lastModified = m_request->getHeader(_T("Last-Modified"));
 
-    bufferLength = 1024;
-    headerIndex = 0;
-    BOOL contentTypeSuccess = HttpQueryInfo(m_hHttp, HTTP_QUERY_CONTENT_TYPE, headerBuffer, &bufferLength, &headerIndex);
-    if (contentTypeSuccess) {
-        m_contentType = headerBuffer;
+    if (startData && !(*this.*startData)(context)) {
+        return DOWNLOAD_STATUS_FAIL;
     }
 
+    // The body is hashed as it arrives, so the file needn't be read again to validate it -
+    // only when it all arrives here, not when it continues what an earlier download left
+    BOOL hashing = (0 == m_dataOffset) && m_md5.init();
+
     long bytesWritten = 0;
 
     // Make point-at-which-we-receive-the-headers 5% of the total progress (arbitrarily chosen!)
@@ -189,23 +124,25 @@ DOWNLOAD_STATUS InternetDownload::getData(writeData_t writeData, void *context)
     BYTE buffer[16384]; // InternetReadFile seems to give back 8k buffers, so an 8k buffer is optimal
     DWORD bytesRead = 0;
     do {
-        receivingResponse();
-        int readFileResponse = InternetReadFile(m_hHttp, buffer, bytesToRead, &bytesRead);
-        if (!readFileResponse && ERROR_IO_PENDING == GetLastError()) {
-            if (!waitForHandle(m_responseReceived)) {
-                return DOWNLOAD_STATUS_CANCELLED;
-            }
-        } else if (!readFileResponse) {
-            return DOWNLOAD_STATUS_FAIL;
+        if (!m_request->read(buffer, bytesToRead, bytesRead)) {
+            return m_cancelToken.isSignalled() ? DOWNLOAD_STATUS_CANCELLED : DOWNLOAD_STATUS_FAIL;
         }
 
-        // Check the cancellation token, because otherwise we only check it if we get an ASYNC result from InternetReadFile
+        // Check the cancellation token, because otherwise we only check it if the read has to wait for the network
         // That tends to happen on slow(ish) connections, but isn't guaranteed. (From what I've seen)
         if (m_cancelToken.isSignalled()) {
             return DOWNLOAD_STATUS_CANCELLED;
         }
 
         (*this.*writeData)(buffer, bytesRead, context);
+        if (m_dataFunction != nullptr && bytesRead > 0) {
+            m_dataFunction(m_dataOffset, buffer, bytesRead);
+        }
+        if (hashing && bytesRead > 0) {
+            hashing = m_md5.update(buffer, bytesRead);
+        }
+        m_dataOffset += bytesRead;
+        m_bytesReceived += bytesRead;
         bytesWritten += bytesRead;
         if (contentLength && m_progressFunction != nullptr) {
             int percent = static_cast<int>((static_cast<double>(bytesWritten) / static_cast<double>(contentLength)) * 95 + 5);
@@ -214,40 +151,96 @@ DOWNLOAD_STATUS InternetDownload::getData(writeData_t writeData, void *context)
 
     } while (bytesRead != 0);
 
+    // A connection that is dropped part way through just looks like the end of the data
+    if (contentLength && bytesWritten < contentLength) {
+        return DOWNLOAD_STATUS_FAIL;
+    }
+
+    TCHAR hash[(MD5LEN * 2) + 1];
+    if (hashing && m_md5.final(hash, (MD5LEN * 2) + 1)) {
+        m_hash = hash;
+    }
+
     return DOWNLOAD_STATUS_SUCCESS;
 
 }
 
 BOOL InternetDownload::saveToFile(const tstring& filename) {
+    m_requestHeaders = m_conditionalHeaders;
     if (request()) {
-        FILE *fp = NULL;
-        if (_tfopen_s(&fp, filename.c_str(), _T("wb")) == 0) {
-            DOWNLOAD_STATUS status = getData(&InternetDownload::writeToFile, fp);
-            if (fp)
-            {
-                fclose(fp);
-            }
+        FileSink sink;
+        if (sink.create(filename)) {
+            DOWNLOAD_STATUS status = getData(&InternetDownload::writeToFile, &sink, &InternetDownload::startFile);
+            BOOL written = sink.close();
             if (status == DOWNLOAD_STATUS_FORCE_RETRY) {
-                // This is where we should have used a second class for the actual request.
-                ::InternetCloseHandle(m_hHttp);
-                m_hHttp = NULL;
+                m_request.reset();
+                ++m_retries;
                 return saveToFile(filename);
             }
-            return DOWNLOAD_STATUS_SUCCESS == status;
+            return DOWNLOAD_STATUS_SUCCESS == status && written;
         }
     }
 
     return FALSE;
 }
 
+BOOL InternetDownload::resumeToFile(const tstring& filename, const tstring& partialDirectory) {
+    PartialDownload partial(partialDirectory, m_url);
+    m_requestHeaders = m_conditionalHeaders;
+    m_rangeRequested = FALSE;
+
+    // A conditional request wants the whole file or nothing, so leaves any partial download alone
+    if (m_conditionalHeaders.empty() && partial.load()) {
+        m_requestHeaders = partial.getRequestHeaders();
+        m_rangeRequested = TRUE;
+    }
+
+    if (!request()) {
+        return FALSE;
+    }
+
+    // The file is opened once the response says whether the range was sent
+    PartialFile partialFile;
+    partialFile.partial = &partial;
+    partialFile.checkpointLength = 0;
+
+    DOWNLOAD_STATUS status = getData(&InternetDownload::writeToPartialFile, &partialFile, &InternetDownload::startPartialFile);
+    BOOL fileOpened = partialFile.sink.isOpen();
+    BOOL written = partialFile.sink.close();
+
+    if (DOWNLOAD_STATUS_SUCCESS == status && written) {
+        return partial.complete(filename);
+    }
+
+    // If the file was never opened (e.g. a proxy login), what was there before is still good
+    BOOL rangeRejected = m_rangeRequested && HTTP_STATUS_RANGE_NOT_SATISFIABLE == m_statusCode;
+    if (rangeRejected) {
+        partial.discard();
+    } else if (fileOpened) {
+        if (partial.canResume()) {
+            partial.setReceivedLength(partialFile.sink.getWrittenLength());
+        } else {
+            partial.discard();
+        }
+    }
+
+    if (DOWNLOAD_STATUS_FORCE_RETRY == status || rangeRejected) {
+        m_request.reset();
+        ++m_retries;
+        return resumeToFile(filename, partialDirectory);
+    }
+
+    return FALSE;
+}
+
 std::string InternetDownload::getContent() {
     if (request()) {
         std::string result;
         DOWNLOAD_STATUS status = getData(&InternetDownload::writeToString, &result);
 
         if (DOWNLOAD_STATUS_FORCE_RETRY == status) {
-            ::InternetCloseHandle(m_hHttp);
-            m_hHttp = NULL;
+            m_request.reset();
+            ++m_retries;
             return getContent();
         }
 
@@ -259,10 +252,92 @@ std::string InternetDownload::getContent() {
     return "";
 }
 
+BOOL InternetDownload::startFile(void* context) {
+    // Not being able to reserve the space isn't a reason to fail
+    reinterpret_cast<FileSink*>(context)->reserve(m_contentLength);
+    return TRUE;
+}
+
 void InternetDownload::writeToFile(BYTE* buffer, DWORD bufferLength, void *context) {
-    fwrite(buffer, bufferLength, 1, reinterpret_cast<FILE*>(context));
+    reinterpret_cast<FileSink*>(context)->write(buffer, bufferLength);
+}
+
+BOOL InternetDownload::startPartialFile(void* context) {
+    PartialFile* partialFile = reinterpret_cast<PartialFile*>(context);
+    PartialDownload* partial = partialFile->partial;
+
+    if (HTTP_STATUS_PARTIAL_CONTENT == m_statusCode && partial->getReceivedLength() > 0) {
+        partialFile->checkpointLength = partial->getReceivedLength();
+        m_dataOffset = partial->getReceivedLength();
+        if (!partialFile->sink.append(partial->getPartFilename())) {
+            return FALSE;
+        }
+
+        partialFile->sink.reserve(partial->getReceivedLength() + m_contentLength);
+        return TRUE;
+    }
+
+    if (HTTP_STATUS_RANGE_NOT_SATISFIABLE == m_statusCode && m_rangeRequested) {
+        return FALSE;
+    }
+
+    // The whole file is coming (e.g. it has changed since the partial download) - only a
+    // successful response is worth keeping to continue later
+    if (HTTP_STATUS_OK == m_statusCode) {
+        partial->begin(m_etag, m_lastModified);
+    } else {
+        partial->begin(tstring(), tstring());
+    }
+
+    if (!partialFile->sink.create(partial->getPartFilename())) {
+        return FALSE;
+    }
+
+    partialFile->sink.reserve(m_contentLength);
+    return TRUE;
+}
+
+void InternetDownload::writeToPartialFile(BYTE* buffer, DWORD bufferLength, void* context) {
+    PartialFile* partialFile = reinterpret_cast<PartialFile*>(context);
+    partialFile->sink.write(buffer, bufferLength);
+
+    // Record what is on disk now and again, in case the process doesn't get to the end
+    UINT64 writtenLength = partialFile->sink.getWrittenLength();
+    if (writtenLength - partialFile->checkpointLength >= PARTIAL_CHECKPOINT_SIZE
+        && partialFile->partial->canResume()) {
+        partialFile->partial->setReceivedLength(writtenLength);
+        partialFile->checkpointLength = writtenLength;
+    }
 }
 
 void InternetDownload::writeToString(BYTE* buffer, DWORD bufferLength, void* context) {
     reinterpret_cast<std::string*>(context)->append(reinterpret_cast<char*>(buffer), static_cast<size_t>(bufferLength));
 }
+
+void InternetDownload::getMetrics(DownloadMetrics& metrics) {
+    double now = DownloadMetrics::now();
+    metrics.statusCode = m_statusCode;
+    metrics.bytesReceived = m_bytesReceived;
+    metrics.retries = m_retries;
+    metrics.proxyAuthRequests = m_proxyAuthRequests;
+    metrics.finished = now - m_started;
+
+    if (m_firstByte >= 0) {
+        metrics.firstByte = m_firstByte - m_started;
+        if (now > m_firstByte) {
+            metrics.bytesPerSecond = static_cast<double>(m_bytesReceived) * 1000.0 / (now - m_firstByte);
+        }
+    }
+
+    // The phases of the last request, from when it was opened
+    if (m_request) {
+        HttpRequestTimings timings;
+        m_request->getTimings(timings);
+        double opened = m_requestOpened - m_started;
+        metrics.resolving = timings.resolving < 0 ? -1 : opened + timings.resolving;
+        metrics.resolved = timings.resolved < 0 ? -1 : opened + timings.resolved;
+        metrics.connecting = timings.connecting < 0 ? -1 : opened + timings.connecting;
+        metrics.connected = timings.connected < 0 ? -1 : opened + timings.connected;
+        metrics.requestSent = timings.requestSent < 0 ? -1 : opened + timings.requestSent;
+    }
+}
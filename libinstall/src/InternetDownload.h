@@ -1,60 +1,110 @@
 #pragma once
 
 #include "libinstall/CancelToken.h"
+#include "libinstall/FileSink.h"
+#include "libinstall/md5.h"
+
+class PartialDownload;
+class HttpTransport;
+class HttpRequest;
+struct DownloadMetrics;
 
 enum DOWNLOAD_STATUS {
     DOWNLOAD_STATUS_SUCCESS,
     DOWNLOAD_STATUS_FAIL,
     DOWNLOAD_STATUS_CANCELLED,
-    DOWNLOAD_STATUS_FORCE_RETRY
+    DOWNLOAD_STATUS_FORCE_RETRY,
+    DOWNLOAD_STATUS_NOT_MODIFIED
 };
 
 class InternetDownload {
 public:
-    InternetDownload(HWND parentHwnd, const tstring& userAgent, const tstring& url, CancelToken cancelToken, std::function<void(int)> progressFunction = NULL);
+    InternetDownload(HWND parentHwnd, HttpTransport& transport, const tstring& url, CancelToken cancelToken, std::function<void(int)> progressFunction = NULL);
         
     ~InternetDownload();
 
     void disableCache();
 
+    /* Called with each part of the body as it is written, and where it is in the file - a
+     * download that continues a partial one doesn't start at 0 */
+    void setDataFunction(std::function<void(UINT64, const BYTE*, DWORD)> dataFunction) { m_dataFunction = dataFunction; }
+
+    /* Makes the request conditional (If-None-Match / If-Modified-Since) - if the server says
+     * the file is not modified, nothing is saved, and getStatusCode() is HTTP_STATUS_NOT_MODIFIED */
+    void setConditionalHeaders(const tstring& headers) { m_conditionalHeaders = headers; }
+
+    /* A request that has already been sent for the URL (e.g. the winner of a race between
+     * mirrors), used in place of sending the first one.  It must have been sent with the
+     * conditional headers, if there are any, and no other extra headers. */
+    void setRequest(std::shared_ptr<HttpRequest> request) { m_sentRequest = request; }
+
+    /* ms without a response, or the next part of the body, before the download fails - 0
+     * leaves it to the transport */
+    void setTimeout(DWORD timeout) { m_timeout = timeout; }
+
     BOOL saveToFile(const tstring& filename);
 
+    /* Saves to filename, continuing from what an earlier download of the same URL left in
+     * partialDirectory, and leaving what is received there if this one fails too */
+    BOOL resumeToFile(const tstring& filename, const tstring& partialDirectory);
+
     std::string getContent();
     
     const tstring& getContentType() const { return m_contentType; }
+    const tstring& getETag() const { return m_etag; }
+    const tstring& getLastModified() const { return m_lastModified; }
+    DWORD getStatusCode() const { return m_statusCode; }
+
+    /* The MD5 of the body, worked out as it was received - empty unless the whole of it was,
+     * so a download that continued a partial one has none */
+    const tstring& getHash() const { return m_hash; }
+
+    /* The timings and counts of the download so far - see DownloadMetrics.h */
+    void getMetrics(DownloadMetrics& metrics);
 
 private:
 
+    struct PartialFile
+    {
+        PartialDownload* partial;
+        FileSink         sink;
+        UINT64           checkpointLength;
+    };
+
     BOOL request();
+    BOOL startFile(void* context);
     void writeToFile(BYTE* buffer, DWORD bufferLength, void* context);
     void writeToString(BYTE* buffer, DWORD bufferLength, void* context);
-    BOOL waitForHandle(HANDLE handle);
-
-    static void __stdcall statusCallback(HINTERNET hInternet,
-         DWORD_PTR dwContext,
-         DWORD dwInternetStatus,
-         LPVOID lpvStatusInformation,
-         DWORD dwStatusInformationLength);
-
-    void responseReceived() { ::SetEvent(m_responseReceived); }
-    void receivingResponse() { ::ResetEvent(m_responseReceived); }
-    void requestComplete() { ::SetEvent(m_requestComplete); }
+    BOOL startPartialFile(void* context);
+    void writeToPartialFile(BYTE* buffer, DWORD bufferLength, void* context);
 
     typedef void (InternetDownload::*writeData_t)(BYTE* buffer, DWORD bufferLength, void* context);
 
-    DOWNLOAD_STATUS getData(writeData_t writeData, void* context);
+    // Called once the response headers have arrived, before any data is written
+    typedef BOOL (InternetDownload::*startData_t)(void* context);
+
+    DOWNLOAD_STATUS getData(writeData_t writeData, void* context, startData_t startData = NULL);
 
     std::function<void(int)> m_progressFunction;
+    std::function<void(UINT64, const BYTE*, DWORD)> m_dataFunction;
+    UINT64 m_dataOffset;
+    UINT64 m_contentLength;
 
     tstring m_url;
-    tstring m_userAgent;
     tstring m_contentType;
-
-    HINTERNET m_hInternet;
-    HINTERNET m_hConnect;
-    HINTERNET m_hHttp;
-    HANDLE m_responseReceived;
-    HANDLE m_requestComplete;
+    tstring m_etag;
+    tstring m_lastModified;
+    tstring m_conditionalHeaders;
+    tstring m_requestHeaders;
+    BOOL m_rangeRequested;
+
+    MD5 m_md5;
+    tstring m_hash;
+
+    HttpTransport& m_transport;
+    std::shared_ptr<HttpRequest> m_request;
+    std::shared_ptr<HttpRequest> m_sentRequest;
+    DWORD m_timeout;
     CancelToken m_cancelToken;
     HWND m_parentHwnd;
 
@@ -63,5 +113,14 @@ private:
 
     DWORD m_error;
     DWORD m_flags;
+    DWORD m_statusCode;
+
+    // For the metrics - times are from DownloadMetrics::now()
+    double m_started;
+    double m_requestOpened;
+    double m_firstByte;
+    UINT64 m_bytesReceived;
+    int m_retries;
+    int m_proxyAuthRequests;
     
 };
\ No newline at end of file
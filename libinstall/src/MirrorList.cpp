@@ -0,0 +1,199 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/MirrorList.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#define MIRRORSCORES_GROUP      _T("Mirrors")
+
+/* Each new latency moves the score this fraction of the way towards it */
+#define MIRRORSCORES_WEIGHT     4
+
+#define URL_SEPARATORS          _T(" \t\r\n")
+
+
+MirrorList::MirrorList()
+{
+}
+
+MirrorList::MirrorList(const tstring& url)
+{
+	add(url);
+}
+
+void MirrorList::add(const tstring& url)
+{
+	if (!url.empty() && find(_urls.begin(), _urls.end(), url) == _urls.end())
+		_urls.push_back(url);
+}
+
+void MirrorList::addList(const TCHAR* urls)
+{
+	if (!urls)
+		return;
+
+	tstring list(urls);
+	tstring::size_type start = list.find_first_not_of(URL_SEPARATORS);
+	while (start != tstring::npos)
+	{
+		tstring::size_type end = list.find_first_of(URL_SEPARATORS, start);
+		add(list.substr(start, end == tstring::npos ? tstring::npos : end - start));
+		start = list.find_first_not_of(URL_SEPARATORS, end);
+	}
+}
+
+void MirrorList::addServers(const tstring& url, const TCHAR* servers)
+{
+	tstring path = url.substr(getServer(url).size());
+
+	MirrorList serverList;
+	serverList.addList(servers);
+	for (vector<tstring>::const_iterator it = serverList._urls.begin(); it != serverList._urls.end(); ++it)
+	{
+		// Allow "https://mirror.example.org/" as well as "https://mirror.example.org"
+		tstring server(*it);
+		if (!server.empty() && _T('/') == server[server.size() - 1])
+			server.erase(server.size() - 1);
+
+		add(server + path);
+	}
+}
+
+MirrorList MirrorList::append(const tstring& suffix) const
+{
+	MirrorList appended;
+	for (vector<tstring>::const_iterator it = _urls.begin(); it != _urls.end(); ++it)
+		appended.add(*it + suffix);
+
+	return appended;
+}
+
+tstring MirrorList::toString() const
+{
+	tstring list;
+	for (vector<tstring>::const_iterator it = _urls.begin(); it != _urls.end(); ++it)
+	{
+		if (!list.empty())
+			list.push_back(_T(' '));
+		list.append(*it);
+	}
+
+	return list;
+}
+
+tstring MirrorList::getServer(const tstring& url)
+{
+	tstring::size_type hostStart = url.find(_T("://"));
+	if (hostStart == tstring::npos)
+		return tstring();
+
+	tstring::size_type pathStart = url.find_first_of(_T("/?#"), hostStart + 3);
+	return url.substr(0, pathStart);
+}
+
+
+
+MirrorScores::MirrorScores(const tstring& filename)
+	: _filename(filename)
+{
+	::InitializeCriticalSection(&_lock);
+}
+
+MirrorScores::~MirrorScores()
+{
+	::DeleteCriticalSection(&_lock);
+}
+
+int MirrorScores::getScore(const tstring& url)
+{
+	tstring server = MirrorList::getServer(url);
+	int score = -1;
+
+	::EnterCriticalSection(&_lock);
+	if (!_filename.empty())
+	{
+		// Read from the file each time, as another process may have changed it
+		score = static_cast<int>(::GetPrivateProfileInt(MIRRORSCORES_GROUP, server.c_str(), -1, _filename.c_str()));
+	}
+	else
+	{
+		map<tstring, int>::const_iterator it = _scores.find(server);
+		if (it != _scores.end())
+			score = it->second;
+	}
+	::LeaveCriticalSection(&_lock);
+
+	return score;
+}
+
+void MirrorScores::recordResponse(const tstring& url, double latency)
+{
+	record(url, latency);
+}
+
+void MirrorScores::recordFailure(const tstring& url)
+{
+	record(url, MIRROR_FAILURE_LATENCY);
+}
+
+void MirrorScores::record(const tstring& url, double latency)
+{
+	tstring server = MirrorList::getServer(url);
+	if (server.empty())
+		return;
+
+	::EnterCriticalSection(&_lock);
+	int score = getScore(url);
+	int sample = static_cast<int>(latency);
+	score = (score < 0) ? sample : score + (sample - score) / MIRRORSCORES_WEIGHT;
+
+	if (!_filename.empty())
+	{
+		TCHAR value[20];
+		_itot_s(score, value, 20, 10);
+		::WritePrivateProfileString(MIRRORSCORES_GROUP, server.c_str(), value, _filename.c_str());
+	}
+	else
+	{
+		_scores[server] = score;
+	}
+	::LeaveCriticalSection(&_lock);
+}
+
+void MirrorScores::order(vector<tstring>& urls)
+{
+	// Sorting on the score and then the position keeps URLs with the same score in order
+	vector< pair<int, size_t> > scores;
+	for (size_t index = 0; index < urls.size(); ++index)
+		scores.push_back(make_pair(getScore(urls[index]), index));
+
+	sort(scores.begin(), scores.end());
+
+	vector<tstring> ordered;
+	for (vector< pair<int, size_t> >::const_iterator it = scores.begin(); it != scores.end(); ++it)
+		ordered.push_back(urls[it->second]);
+
+	urls.swap(ordered);
+}
@@ -0,0 +1,220 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/PartialDownload.h"
+#include "libinstall/md5.h"
+#include "libinstall/DirectoryUtil.h"
+#include "libinstall/WcharMbcsConverter.h"
+
+using namespace std;
+
+#define PARTIAL_GROUP           _T("Download")
+#define PARTIAL_ETAG            _T("ETag")
+#define PARTIAL_LASTMODIFIED    _T("LastModified")
+#define PARTIAL_LENGTH          _T("Length")
+
+#define PARTIAL_VALUE_LENGTH    1024
+
+
+PartialDownload::PartialDownload(const tstring& directory, const tstring& url)
+	: _directory(directory),
+	  _receivedLength(0)
+{
+	std::shared_ptr<char> utf8Url = WcharMbcsConverter::tchar2char(url.c_str());
+	TCHAR urlHash[(MD5LEN * 2) + 1];
+	MD5::hash(reinterpret_cast<const BYTE*>(utf8Url.get()), strlen(utf8Url.get()), urlHash, (MD5LEN * 2) + 1);
+
+	_partFilename = directory;
+	_partFilename.append(_T("\\"));
+	_partFilename.append(urlHash);
+	_partFilename.append(_T(".part"));
+
+	_infoFilename = _partFilename;
+	_infoFilename.append(_T(".ini"));
+}
+
+
+BOOL PartialDownload::load()
+{
+	_etag = readValue(PARTIAL_ETAG);
+	_lastModified = readValue(PARTIAL_LASTMODIFIED);
+	_receivedLength = _tcstoui64(readValue(PARTIAL_LENGTH).c_str(), NULL, 10);
+
+	if (!canResume() || 0 == _receivedLength)
+	{
+		discard();
+		return FALSE;
+	}
+
+	// Anything after the recorded length may not have been written completely
+	BOOL truncated = FALSE;
+	HANDLE hFile = ::CreateFile(_partFilename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE != hFile)
+	{
+		LARGE_INTEGER fileSize;
+		LARGE_INTEGER receivedLength;
+		receivedLength.QuadPart = static_cast<LONGLONG>(_receivedLength);
+
+		truncated = ::GetFileSizeEx(hFile, &fileSize)
+			&& fileSize.QuadPart >= receivedLength.QuadPart
+			&& ::SetFilePointerEx(hFile, receivedLength, NULL, FILE_BEGIN)
+			&& ::SetEndOfFile(hFile);
+
+		::CloseHandle(hFile);
+	}
+
+	if (!truncated)
+	{
+		discard();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+tstring PartialDownload::getRequestHeaders() const
+{
+	tstring headers;
+	if (!canResume() || 0 == _receivedLength)
+		return headers;
+
+	TCHAR range[60];
+	_stprintf_s(range, 60, _T("Range: bytes=%I64u-\r\n"), _receivedLength);
+	headers.append(range);
+
+	// A strong ETag is preferred - the server sends the whole file if it no longer matches
+	headers.append(_T("If-Range: "));
+	headers.append(_etag.empty() ? _lastModified : _etag);
+	headers.append(_T("\r\n"));
+
+	return headers;
+}
+
+
+BOOL PartialDownload::begin(const tstring& etag, const tstring& lastModified)
+{
+	_etag = etag;
+	_lastModified = lastModified;
+	_receivedLength = 0;
+
+	if (!::PathIsDirectory(_directory.c_str()))
+		DirectoryUtil::createDirectories(_directory.c_str());
+	::DeleteFile(_infoFilename.c_str());
+
+	if (!canResume())
+		return TRUE;
+
+	writeValue(PARTIAL_ETAG, _etag);
+	writeValue(PARTIAL_LASTMODIFIED, _lastModified);
+	writeValue(PARTIAL_LENGTH, _T("0"));
+	return TRUE;
+}
+
+
+void PartialDownload::setReceivedLength(UINT64 length)
+{
+	_receivedLength = length;
+	if (canResume())
+	{
+		TCHAR lengthString[30];
+		_stprintf_s(lengthString, 30, _T("%I64u"), length);
+		writeValue(PARTIAL_LENGTH, lengthString);
+	}
+}
+
+
+BOOL PartialDownload::complete(const tstring& filename)
+{
+	::DeleteFile(_infoFilename.c_str());
+	BOOL moved = ::MoveFileEx(_partFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED);
+	if (!moved)
+		::DeleteFile(_partFilename.c_str());
+
+	_etag.clear();
+	_lastModified.clear();
+	_receivedLength = 0;
+	return moved;
+}
+
+
+void PartialDownload::discard()
+{
+	::DeleteFile(_partFilename.c_str());
+	::DeleteFile(_infoFilename.c_str());
+
+	_etag.clear();
+	_lastModified.clear();
+	_receivedLength = 0;
+}
+
+
+void PartialDownload::removeExpired(const tstring& directory, UINT maxAgeDays)
+{
+	FILETIME now;
+	::GetSystemTimeAsFileTime(&now);
+
+	ULARGE_INTEGER oldest;
+	oldest.LowPart = now.dwLowDateTime;
+	oldest.HighPart = now.dwHighDateTime;
+	oldest.QuadPart -= static_cast<ULONGLONG>(maxAgeDays) * 24 * 60 * 60 * 10000000;	// 100ns units
+
+	// The .part files and their .part.ini files
+	WIN32_FIND_DATA foundData;
+	HANDLE hFindFile = ::FindFirstFile((directory + _T("\\*.part*")).c_str(), &foundData);
+	if (INVALID_HANDLE_VALUE == hFindFile)
+		return;
+
+	do
+	{
+		ULARGE_INTEGER written;
+		written.LowPart = foundData.ftLastWriteTime.dwLowDateTime;
+		written.HighPart = foundData.ftLastWriteTime.dwHighDateTime;
+
+		if (!(foundData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && written.QuadPart < oldest.QuadPart)
+		{
+			tstring filename(directory);
+			filename.append(_T("\\"));
+			filename.append(foundData.cFileName);
+			::DeleteFile(filename.c_str());
+		}
+	} while (::FindNextFile(hFindFile, &foundData));
+
+	::FindClose(hFindFile);
+}
+
+
+/* GetPrivateProfileString strips one pair of enclosing quotes, which would change a quoted
+ * ETag, so every value is written inside an extra pair */
+void PartialDownload::writeValue(const TCHAR* key, const tstring& value)
+{
+	tstring quotedValue(_T("\""));
+	quotedValue.append(value);
+	quotedValue.append(_T("\""));
+	::WritePrivateProfileString(PARTIAL_GROUP, key, quotedValue.c_str(), _infoFilename.c_str());
+}
+
+tstring PartialDownload::readValue(const TCHAR* key)
+{
+	TCHAR value[PARTIAL_VALUE_LENGTH];
+	::GetPrivateProfileString(PARTIAL_GROUP, key, _T(""), value, PARTIAL_VALUE_LENGTH, _infoFilename.c_str());
+	return tstring(value);
+}
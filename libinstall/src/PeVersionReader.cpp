@@ -0,0 +1,212 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/PeVersionReader.h"
+
+#define PE_DOS_SIGNATURE            0x5A4D          // "MZ"
+#define PE_NT_SIGNATURE             0x00004550      // "PE\0\0"
+#define PE_OPTIONAL_MAGIC_PE32      0x010B
+#define PE_OPTIONAL_MAGIC_PE32PLUS  0x020B
+#define PE_DIRECTORY_RESOURCE       2
+#define PE_RESOURCE_TYPE_VERSION    16              // RT_VERSION
+#define PE_RESOURCE_SUBDIRECTORY    0x80000000
+#define PE_RESOURCE_NAMED           0x80000000
+#define PE_FIXEDFILEINFO_SIGNATURE  0xFEEF04BD
+
+
+PeVersionReader::PeVersionReader(const BYTE* file, size_t size)
+	: _file(file),
+	  _size(size),
+	  _sectionTableOffset(0),
+	  _sectionCount(0)
+{
+}
+
+
+/* All values in a PE file are little endian */
+BOOL PeVersionReader::readUInt16(size_t offset, UINT16& value)
+{
+	if (offset > _size || _size - offset < 2)
+		return FALSE;
+
+	value = static_cast<UINT16>(_file[offset] | (_file[offset + 1] << 8));
+	return TRUE;
+}
+
+BOOL PeVersionReader::readUInt32(size_t offset, UINT32& value)
+{
+	if (offset > _size || _size - offset < 4)
+		return FALSE;
+
+	value = static_cast<UINT32>(_file[offset])
+		| (static_cast<UINT32>(_file[offset + 1]) << 8)
+		| (static_cast<UINT32>(_file[offset + 2]) << 16)
+		| (static_cast<UINT32>(_file[offset + 3]) << 24);
+	return TRUE;
+}
+
+
+BOOL PeVersionReader::rvaToOffset(UINT32 rva, size_t& offset)
+{
+	for (UINT16 section = 0; section < _sectionCount; ++section)
+	{
+		size_t sectionHeader = _sectionTableOffset + (section * 40);
+		UINT32 virtualSize, virtualAddress, rawSize, rawPointer;
+		if (!readUInt32(sectionHeader + 8, virtualSize)
+			|| !readUInt32(sectionHeader + 12, virtualAddress)
+			|| !readUInt32(sectionHeader + 16, rawSize)
+			|| !readUInt32(sectionHeader + 20, rawPointer))
+			return FALSE;
+
+		// Some linkers leave the virtual size as 0
+		UINT32 sectionSize = virtualSize ? virtualSize : rawSize;
+		if (rva >= virtualAddress && rva - virtualAddress < sectionSize)
+		{
+			UINT32 sectionOffset = rva - virtualAddress;
+			if (sectionOffset >= rawSize)
+				return FALSE;
+
+			offset = static_cast<size_t>(rawPointer) + sectionOffset;
+			return offset < _size;
+		}
+	}
+
+	return FALSE;
+}
+
+
+/* Finds the entry with the given id in a resource directory - or the first entry, if matchId
+ * is FALSE.  offsetToData is relative to the start of the resource section. */
+BOOL PeVersionReader::findFirstEntry(size_t directoryOffset, BOOL matchId, UINT16 id, UINT32& offsetToData)
+{
+	UINT16 namedEntries, idEntries;
+	if (!readUInt16(directoryOffset + 12, namedEntries)
+		|| !readUInt16(directoryOffset + 14, idEntries))
+		return FALSE;
+
+	size_t entryOffset = directoryOffset + 16;
+	UINT32 entryCount = static_cast<UINT32>(namedEntries) + idEntries;
+
+	for (UINT32 entry = 0; entry < entryCount; ++entry, entryOffset += 8)
+	{
+		UINT32 name;
+		if (!readUInt32(entryOffset, name) || !readUInt32(entryOffset + 4, offsetToData))
+			return FALSE;
+
+		if (!matchId || (!(name & PE_RESOURCE_NAMED) && name == id))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+BOOL PeVersionReader::getFileVersion(UINT32& versionMS, UINT32& versionLS)
+{
+	UINT16 dosSignature;
+	UINT32 ntHeaderOffset, ntSignature;
+	if (!readUInt16(0, dosSignature) || dosSignature != PE_DOS_SIGNATURE
+		|| !readUInt32(0x3C, ntHeaderOffset)
+		|| !readUInt32(ntHeaderOffset, ntSignature) || ntSignature != PE_NT_SIGNATURE)
+		return FALSE;
+
+	// COFF file header follows the signature
+	UINT16 optionalHeaderSize;
+	size_t fileHeader = static_cast<size_t>(ntHeaderOffset) + 4;
+	if (!readUInt16(fileHeader + 2, _sectionCount)
+		|| !readUInt16(fileHeader + 16, optionalHeaderSize))
+		return FALSE;
+
+	size_t optionalHeader = fileHeader + 20;
+	_sectionTableOffset = optionalHeader + optionalHeaderSize;
+
+	// The data directories are in a different place for 64 bit files
+	UINT16 magic;
+	if (!readUInt16(optionalHeader, magic))
+		return FALSE;
+
+	size_t directoryCountOffset;
+	if (PE_OPTIONAL_MAGIC_PE32 == magic)
+		directoryCountOffset = optionalHeader + 92;
+	else if (PE_OPTIONAL_MAGIC_PE32PLUS == magic)
+		directoryCountOffset = optionalHeader + 108;
+	else
+		return FALSE;
+
+	UINT32 directoryCount, resourceRva, resourceSize;
+	if (!readUInt32(directoryCountOffset, directoryCount)
+		|| directoryCount <= PE_DIRECTORY_RESOURCE
+		|| !readUInt32(directoryCountOffset + 4 + (PE_DIRECTORY_RESOURCE * 8), resourceRva)
+		|| !readUInt32(directoryCountOffset + 8 + (PE_DIRECTORY_RESOURCE * 8), resourceSize)
+		|| 0 == resourceRva)
+		return FALSE;
+
+	size_t resourceOffset;
+	if (!rvaToOffset(resourceRva, resourceOffset))
+		return FALSE;
+
+	// Resource tree is type -> name -> language.  Take the first name and language,
+	// as VerQueryValue does
+	UINT32 typeEntry, nameEntry, languageEntry;
+	if (!findFirstEntry(resourceOffset, TRUE, PE_RESOURCE_TYPE_VERSION, typeEntry)
+		|| !(typeEntry & PE_RESOURCE_SUBDIRECTORY)
+		|| !findFirstEntry(resourceOffset + (typeEntry & ~PE_RESOURCE_SUBDIRECTORY), FALSE, 0, nameEntry)
+		|| !(nameEntry & PE_RESOURCE_SUBDIRECTORY)
+		|| !findFirstEntry(resourceOffset + (nameEntry & ~PE_RESOURCE_SUBDIRECTORY), FALSE, 0, languageEntry)
+		|| (languageEntry & PE_RESOURCE_SUBDIRECTORY))
+		return FALSE;
+
+	// Data entry holds the RVA and size of the VS_VERSIONINFO
+	UINT32 versionInfoRva, versionInfoSize;
+	size_t versionInfoOffset;
+	if (!readUInt32(resourceOffset + languageEntry, versionInfoRva)
+		|| !readUInt32(resourceOffset + languageEntry + 4, versionInfoSize)
+		|| !rvaToOffset(versionInfoRva, versionInfoOffset)
+		|| versionInfoSize > _size - versionInfoOffset)
+		return FALSE;
+
+	// VS_VERSIONINFO: wLength, wValueLength, wType, L"VS_VERSION_INFO", padding to 32 bits,
+	// then the VS_FIXEDFILEINFO
+	static const char versionInfoKey[] = "VS_VERSION_INFO";
+	UINT16 valueLength;
+	if (versionInfoSize < 40 + 52
+		|| !readUInt16(versionInfoOffset + 2, valueLength) || valueLength < 52)
+		return FALSE;
+
+	size_t keyOffset = versionInfoOffset + 6;
+	for (size_t index = 0; index < sizeof(versionInfoKey); ++index)
+	{
+		UINT16 keyChar;
+		if (!readUInt16(keyOffset + (index * 2), keyChar) || keyChar != static_cast<UINT16>(versionInfoKey[index]))
+			return FALSE;
+	}
+
+	size_t fixedInfoOffset = keyOffset + (sizeof(versionInfoKey) * 2);
+	fixedInfoOffset = versionInfoOffset + (((fixedInfoOffset - versionInfoOffset) + 3) & ~static_cast<size_t>(3));
+
+	UINT32 signature;
+	if (!readUInt32(fixedInfoOffset, signature) || signature != PE_FIXEDFILEINFO_SIGNATURE
+		|| !readUInt32(fixedInfoOffset + 8, versionMS)
+		|| !readUInt32(fixedInfoOffset + 12, versionLS))
+		return FALSE;
+
+	return TRUE;
+}
@@ -0,0 +1,167 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/PluginProbe.h"
+#include "libinstall/WcharMbcsConverter.h"
+
+using namespace std;
+
+typedef BOOL (__cdecl * PFUNCISUNICODE)();
+typedef const TCHAR * (__cdecl * PFUNCGETNAME)();
+
+
+ProbeResult Win32PluginLoader::probe(const tstring& filename)
+{
+	ProbeResult result;
+	result.status = PROBE_NOTPLUGIN;
+
+	HINSTANCE pluginInstance = ::LoadLibrary(filename.c_str());
+	if (!pluginInstance)
+		return result;
+
+	PFUNCISUNICODE pFuncIsUnicode = (PFUNCISUNICODE)::GetProcAddress(pluginInstance, "isUnicode");
+	result.isUnicode = (pFuncIsUnicode && pFuncIsUnicode()) ? TRUE : FALSE;
+
+	PFUNCGETNAME pFuncGetName = (PFUNCGETNAME)::GetProcAddress(pluginInstance, "getName");
+	if (pFuncGetName)
+	{
+		result.status = PROBE_PLUGIN;
+
+		CONST TCHAR* pluginName = pFuncGetName();
+		if (pluginName)
+		{
+			result.name = pluginName;
+			tstring::size_type ampPosition = result.name.find(_T("&"));
+			while (ampPosition != tstring::npos)
+			{
+				result.name.erase(ampPosition, 1);
+				ampPosition = result.name.find(_T("&"), ampPosition);
+			}
+		}
+	}
+
+	::FreeLibrary(pluginInstance);
+	return result;
+}
+
+
+ProbeHost::ProbeHost(PluginLoader& loader)
+	: _loader(loader)
+{
+}
+
+void ProbeHost::run(HANDLE input, HANDLE output)
+{
+	string received;
+	char buffer[4096];
+	DWORD bytesRead;
+
+	while (::ReadFile(input, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0)
+	{
+		received.append(buffer, bytesRead);
+
+		string::size_type newline;
+		while ((newline = received.find('\n')) != string::npos)
+		{
+			string resultLine(handleRequest(received.substr(0, newline)));
+			resultLine.push_back('\n');
+			received.erase(0, newline + 1);
+
+			DWORD bytesWritten;
+			if (!::WriteFile(output, resultLine.c_str(), static_cast<DWORD>(resultLine.size()), &bytesWritten, NULL))
+				return;
+		}
+	}
+}
+
+string ProbeHost::handleRequest(const string& request)
+{
+	tstring filename;
+	ProbeResult result;
+	result.status = PROBE_NOTPLUGIN;
+
+	if (decodeRequest(request, filename))
+		result = _loader.probe(filename);
+
+	return encodeResult(result);
+}
+
+
+string ProbeHost::encodeRequest(const tstring& filename)
+{
+	shared_ptr<char> request = WcharMbcsConverter::tchar2char(filename.c_str());
+	return string(request.get());
+}
+
+BOOL ProbeHost::decodeRequest(const string& request, tstring& filename)
+{
+	// Tolerate \r\n from a hand-typed request
+	string path(request);
+	if (!path.empty() && path[path.size() - 1] == '\r')
+		path.erase(path.size() - 1);
+
+	if (path.empty())
+		return FALSE;
+
+	shared_ptr<TCHAR> tpath = WcharMbcsConverter::char2tchar(path.c_str());
+	filename = tpath.get();
+	return TRUE;
+}
+
+string ProbeHost::encodeResult(const ProbeResult& result)
+{
+	if (PROBE_PLUGIN != result.status)
+		return string("notplugin");
+
+	string resultLine("plugin\t");
+	resultLine.append(result.isUnicode ? "1" : "0");
+	resultLine.push_back('\t');
+
+	// The name is the last field, so only the line separators need to go
+	shared_ptr<char> name = WcharMbcsConverter::tchar2char(result.name.c_str());
+	for (const char* nameChar = name.get(); *nameChar; ++nameChar)
+		resultLine.push_back((*nameChar == '\n' || *nameChar == '\r') ? ' ' : *nameChar);
+
+	return resultLine;
+}
+
+BOOL ProbeHost::decodeResult(const string& resultLine, ProbeResult& result)
+{
+	if (resultLine == "notplugin")
+	{
+		result = ProbeResult();
+		result.status = PROBE_NOTPLUGIN;
+		return TRUE;
+	}
+
+	// plugin<TAB>0|1<TAB>name
+	if (resultLine.compare(0, 7, "plugin\t") != 0
+		|| resultLine.size() < 9
+		|| (resultLine[7] != '0' && resultLine[7] != '1')
+		|| resultLine[8] != '\t')
+		return FALSE;
+
+	result.status = PROBE_PLUGIN;
+	result.isUnicode = (resultLine[7] == '1') ? TRUE : FALSE;
+	shared_ptr<TCHAR> name = WcharMbcsConverter::char2tchar(resultLine.c_str() + 9);
+	result.name = name.get();
+	return TRUE;
+}
@@ -0,0 +1,366 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/ProbePool.h"
+
+using namespace std;
+
+#define PROBE_PIPE_SIZE			65536
+#define PROBE_POLL_INTERVAL		2		// ms between checks for a result
+#define PROBE_EXIT_TIMEOUT		1000	// ms for a host to exit once its input is closed
+
+
+ProcessProbeWorker::ProcessProbeWorker(const tstring& probeExe)
+	: _probeExe(probeExe),
+	  _hProcess(NULL),
+	  _hRequestWrite(NULL),
+	  _hResultRead(NULL)
+{
+}
+
+ProcessProbeWorker::~ProcessProbeWorker()
+{
+	stop(TRUE);
+}
+
+BOOL ProcessProbeWorker::start()
+{
+	SECURITY_ATTRIBUTES securityAttributes;
+	securityAttributes.nLength = sizeof(SECURITY_ATTRIBUTES);
+	securityAttributes.lpSecurityDescriptor = NULL;
+	securityAttributes.bInheritHandle = TRUE;
+
+	// Only the child's ends of the pipes are inherited
+	HANDLE hRequestRead = NULL, hResultWrite = NULL;
+	if (!::CreatePipe(&hRequestRead, &_hRequestWrite, &securityAttributes, PROBE_PIPE_SIZE))
+		return FALSE;
+
+	if (!::CreatePipe(&_hResultRead, &hResultWrite, &securityAttributes, PROBE_PIPE_SIZE))
+	{
+		::CloseHandle(hRequestRead);
+		stop(TRUE);
+		return FALSE;
+	}
+
+	::SetHandleInformation(_hRequestWrite, HANDLE_FLAG_INHERIT, 0);
+	::SetHandleInformation(_hResultRead, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFO startup;
+	memset(&startup, 0, sizeof(STARTUPINFO));
+	startup.cb = sizeof(STARTUPINFO);
+	startup.dwFlags = STARTF_USESTDHANDLES;
+	startup.hStdInput = hRequestRead;
+	startup.hStdOutput = hResultWrite;
+	startup.hStdError = NULL;
+
+	tstring commandLine(_T("\""));
+	commandLine.append(_probeExe);
+	commandLine.append(_T("\""));
+	vector<TCHAR> commandLineBuffer(commandLine.begin(), commandLine.end());
+	commandLineBuffer.push_back(0);
+
+	PROCESS_INFORMATION processInfo;
+	BOOL started = ::CreateProcess(NULL,
+						&commandLineBuffer[0],
+						NULL,				// process security
+						NULL,				// thread security
+						TRUE,				// inherit handles flag
+						CREATE_NO_WINDOW,	// flags
+						NULL,				// inherit environment
+						NULL,				// inherit directory
+						&startup,
+						&processInfo);
+
+	// Close our copies of the child's ends, so a read fails once the child has gone
+	::CloseHandle(hRequestRead);
+	::CloseHandle(hResultWrite);
+
+	if (!started)
+	{
+		stop(TRUE);
+		return FALSE;
+	}
+
+	::CloseHandle(processInfo.hThread);
+	_hProcess = processInfo.hProcess;
+	return TRUE;
+}
+
+BOOL ProcessProbeWorker::send(const string& request)
+{
+	string requestLine(request);
+	requestLine.push_back('\n');
+
+	DWORD bytesWritten;
+	return _hRequestWrite
+		&& ::WriteFile(_hRequestWrite, requestLine.c_str(), static_cast<DWORD>(requestLine.size()), &bytesWritten, NULL)
+		&& bytesWritten == requestLine.size();
+}
+
+BOOL ProcessProbeWorker::receive(string& resultLine, DWORD timeout)
+{
+	if (!_hResultRead)
+		return FALSE;
+
+	DWORD startTime = ::GetTickCount();
+	for (;;)
+	{
+		string::size_type newline = _received.find('\n');
+		if (newline != string::npos)
+		{
+			resultLine = _received.substr(0, newline);
+			_received.erase(0, newline + 1);
+			return TRUE;
+		}
+
+		// An anonymous pipe can't be waited on, so poll it.  This fails once the host has exited.
+		DWORD bytesAvailable = 0;
+		if (!::PeekNamedPipe(_hResultRead, NULL, 0, NULL, &bytesAvailable, NULL))
+			return FALSE;
+
+		if (bytesAvailable > 0)
+		{
+			char buffer[4096];
+			DWORD bytesRead;
+			if (!::ReadFile(_hResultRead, buffer, min(bytesAvailable, static_cast<DWORD>(sizeof(buffer))), &bytesRead, NULL))
+				return FALSE;
+			_received.append(buffer, bytesRead);
+		}
+		else if (::GetTickCount() - startTime >= timeout)
+		{
+			return FALSE;
+		}
+		else
+		{
+			::Sleep(PROBE_POLL_INTERVAL);
+		}
+	}
+}
+
+void ProcessProbeWorker::stop(BOOL terminate)
+{
+	// Closing the requests ends the host's loop
+	if (_hRequestWrite)
+	{
+		::CloseHandle(_hRequestWrite);
+		_hRequestWrite = NULL;
+	}
+
+	if (_hProcess)
+	{
+		if (terminate || WAIT_OBJECT_0 != ::WaitForSingleObject(_hProcess, PROBE_EXIT_TIMEOUT))
+			::TerminateProcess(_hProcess, 1);
+
+		::CloseHandle(_hProcess);
+		_hProcess = NULL;
+	}
+
+	if (_hResultRead)
+	{
+		::CloseHandle(_hResultRead);
+		_hResultRead = NULL;
+	}
+
+	_received.clear();
+}
+
+shared_ptr<ProbeWorker> ProcessProbeWorkerFactory::create()
+{
+	return shared_ptr<ProbeWorker>(new ProcessProbeWorker(_probeExe));
+}
+
+
+InProcessProbeWorker::InProcessProbeWorker(PluginLoader& loader)
+	: _host(loader),
+	  _nextRequest(0)
+{
+}
+
+BOOL InProcessProbeWorker::send(const string& request)
+{
+	_requests.push_back(request);
+	return TRUE;
+}
+
+BOOL InProcessProbeWorker::receive(string& resultLine, DWORD /*timeout*/)
+{
+	if (_nextRequest >= _requests.size())
+		return FALSE;
+
+	resultLine = _host.handleRequest(_requests[_nextRequest++]);
+	return TRUE;
+}
+
+shared_ptr<ProbeWorker> InProcessProbeWorkerFactory::create()
+{
+	return shared_ptr<ProbeWorker>(new InProcessProbeWorker(_loader));
+}
+
+
+ProbePool::ProbePool(ProbeWorkerFactory& workerFactory, size_t workerCount, DWORD probeTimeout, size_t batchSize)
+	: _workerFactory(workerFactory),
+	  _workerCount(workerCount ? workerCount : 1),
+	  _probeTimeout(probeTimeout),
+	  _batchSize(batchSize ? batchSize : 1),
+	  _filenames(NULL),
+	  _results(NULL),
+	  _nextFile(0),
+	  _restartCount(0)
+{
+	::InitializeCriticalSection(&_lock);
+}
+
+ProbePool::~ProbePool()
+{
+	::DeleteCriticalSection(&_lock);
+}
+
+BOOL ProbePool::probe(const vector<tstring>& filenames, vector<ProbeResult>& results)
+{
+	results.assign(filenames.size(), ProbeResult());
+	_filenames = &filenames;
+	_results = &results;
+	_nextFile = 0;
+	_restartCount = 0;
+
+	if (filenames.empty())
+		return TRUE;
+
+	// No more workers than batches
+	size_t batchCount = (filenames.size() + _batchSize - 1) / _batchSize;
+	size_t workerCount = min(_workerCount, min(batchCount, static_cast<size_t>(MAXIMUM_WAIT_OBJECTS)));
+
+	// Start the workers up front, so the caller can fall back if there are none
+	vector<WorkerContext> contexts;
+	for (size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex)
+	{
+		WorkerContext context;
+		context.pool = this;
+		context.worker = startWorker();
+		if (context.worker)
+			contexts.push_back(context);
+	}
+
+	if (contexts.empty())
+		return FALSE;
+
+	vector<HANDLE> threads;
+	for (size_t contextIndex = 0; contextIndex < contexts.size(); ++contextIndex)
+	{
+		HANDLE hThread = ::CreateThread(0, 0, ProbePool::workerThreadProc, &contexts[contextIndex], 0, 0);
+		if (hThread)
+			threads.push_back(hThread);
+	}
+
+	// If no thread could be started, the batches are probed here
+	if (threads.empty())
+		runWorker(contexts[0].worker);
+
+	if (!threads.empty())
+		::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
+
+	for (size_t threadIndex = 0; threadIndex < threads.size(); ++threadIndex)
+		::CloseHandle(threads[threadIndex]);
+
+	for (size_t contextIndex = 0; contextIndex < contexts.size(); ++contextIndex)
+	{
+		if (contexts[contextIndex].worker)
+			contexts[contextIndex].worker->stop(FALSE);
+	}
+
+	_filenames = NULL;
+	_results = NULL;
+	return TRUE;
+}
+
+DWORD WINAPI ProbePool::workerThreadProc(LPVOID param)
+{
+	WorkerContext* context = reinterpret_cast<WorkerContext*>(param);
+	context->pool->runWorker(context->worker);
+	return 0;
+}
+
+void ProbePool::runWorker(shared_ptr<ProbeWorker>& worker)
+{
+	size_t batchStart, batchEnd;
+	while (worker && nextBatch(batchStart, batchEnd))
+	{
+		size_t index = batchStart;
+		while (index < batchEnd)
+		{
+			// Send what is left of the batch - all of it, unless a probe has failed
+			BOOL sent = TRUE;
+			for (size_t request = index; request < batchEnd && sent; ++request)
+				sent = worker->send(ProbeHost::encodeRequest((*_filenames)[request]));
+
+			string resultLine;
+			while (sent && index < batchEnd && worker->receive(resultLine, _probeTimeout))
+			{
+				if (!ProbeHost::decodeResult(resultLine, (*_results)[index]))
+					(*_results)[index] = ProbeResult();
+				++index;
+			}
+
+			if (index < batchEnd)
+			{
+				// The dll at index hung or crashed the worker.  It keeps the PROBE_FAILED
+				// result, and the rest of the batch goes to a new worker.
+				++index;
+				worker->stop(TRUE);
+
+				::EnterCriticalSection(&_lock);
+				++_restartCount;
+				::LeaveCriticalSection(&_lock);
+
+				worker = startWorker();
+				if (!worker)
+					break;
+			}
+		}
+	}
+}
+
+BOOL ProbePool::nextBatch(size_t& batchStart, size_t& batchEnd)
+{
+	::EnterCriticalSection(&_lock);
+	batchStart = _nextFile;
+	batchEnd = min(batchStart + _batchSize, _filenames->size());
+	_nextFile = batchEnd;
+	::LeaveCriticalSection(&_lock);
+
+	return batchStart < batchEnd;
+}
+
+shared_ptr<ProbeWorker> ProbePool::startWorker()
+{
+	shared_ptr<ProbeWorker> worker(_workerFactory.create());
+
+	// Workers are started one at a time, so that a new host doesn't inherit the pipes
+	// of one being started on another thread
+	::EnterCriticalSection(&_lock);
+	BOOL started = worker->start();
+	::LeaveCriticalSection(&_lock);
+
+	if (!started)
+		worker.reset();
+
+	return worker;
+}
@@ -24,6 +24,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "libinstall/tstring.h"
 #include "libinstall/Validate.h"
 #include "libinstall/ModuleInfo.h"
+#include "libinstall/md5.h"
+#include "libinstall/FileHashes.h"
 
 using namespace std;
 
@@ -32,7 +34,8 @@ RunStep::RunStep(const TCHAR *file, const TCHAR *arguments, BOOL outsideNpp, con
 	: _file(file), 
 	  _arguments( arguments ? arguments : _T("")),
 	  _outsideNpp(outsideNpp),
-      _validateBaseUrl(validateBaseUrl)
+      _validateBaseUrl(validateBaseUrl),
+      _validationBatch(NULL)
 {
 	
 }
@@ -78,7 +81,25 @@ StepStatus RunStep::perform(tstring& basePath, TiXmlElement*  forGpup,
 	tstring executable(basePath);
 	executable.append(_file);
     BOOL executeFile = FALSE;
-	switch(Validator::validate(_validateBaseUrl, executable, cancelToken, moduleInfo))
+
+	// If the executable was copied earlier in the install, the batch already has its result
+	ValidateStatus validateStatus = VALIDATE_UNKNOWN;
+	tstring md5;
+	if (!FileHashes::lookup(executable, md5))
+	{
+		TCHAR md5Buffer[(MD5::HASH_LENGTH * 2) + 1];
+		if (MD5::hash(executable.c_str(), md5Buffer, (MD5::HASH_LENGTH * 2) + 1))
+			md5 = md5Buffer;
+	}
+
+	if (!md5.empty())
+	{
+		validateStatus = _validationBatch
+			? _validationBatch->getStatus(_validateBaseUrl, md5, cancelToken, moduleInfo)
+			: Validator::validateHash(_validateBaseUrl, md5, cancelToken, moduleInfo);
+	}
+
+	switch(validateStatus)
 	{
 	
 		case VALIDATE_OK:
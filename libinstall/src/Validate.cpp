@@ -4,36 +4,255 @@
 #include "libinstall/tstring.h"
 #include "libinstall/md5.h"
 #include "libinstall/CancelToken.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/ValidationDatabase.h"
+#include "libinstall/ValidationCache.h"
+#include "libinstall/FileHashes.h"
+
+using namespace std;
 
 namespace Validator
 {
 
+static tstring s_databaseFilename;
+
+void setDatabaseFilename(const tstring& filename)
+{
+    s_databaseFilename = filename;
+}
+
+static BOOL openDatabase(ValidationDatabase& database)
+{
+    return !s_databaseFilename.empty() && database.open(s_databaseFilename.c_str());
+}
+
+static tstring s_cacheFilename;
+static volatile LONG s_cacheHits = 0;
+static volatile LONG s_cacheMisses = 0;
+
+void setCacheFilename(const tstring& filename)
+{
+    s_cacheFilename = filename;
+}
+
+size_t getCacheHitCount()
+{
+    return static_cast<size_t>(s_cacheHits);
+}
+
+size_t getCacheMissCount()
+{
+    return static_cast<size_t>(s_cacheMisses);
+}
+
+/* Creates and loads the verdict cache, if there is one */
+static std::shared_ptr<ValidationCache> loadCache()
+{
+    std::shared_ptr<ValidationCache> cache;
+    if (!s_cacheFilename.empty())
+    {
+        cache.reset(new ValidationCache(s_cacheFilename));
+        cache->load();
+    }
+    return cache;
+}
+
+/* Saves what has been added to the cache, and adds its lookups to the counts */
+static void saveCache(std::shared_ptr<ValidationCache> cache)
+{
+    if (cache)
+    {
+        cache->save();
+        ::InterlockedExchangeAdd(&s_cacheHits, static_cast<LONG>(cache->getHitCount()));
+        ::InterlockedExchangeAdd(&s_cacheMisses, static_cast<LONG>(cache->getMissCount()));
+    }
+}
+
+static ValidateStatus getStatus(const std::string& validateResult)
+{
+    if (validateResult == VALIDATE_RESULT_OK)
+        return VALIDATE_OK;
+
+    else if (validateResult == VALIDATE_RESULT_UNKNOWN)
+        return VALIDATE_UNKNOWN;
+
+    else if (validateResult == VALIDATE_RESULT_BANNED)
+        return VALIDATE_BANNED;
+    else 
+        return VALIDATE_UNKNOWN;
+}
+
 ValidateStatus validate(const tstring& validateBaseUrl, const tstring& file, CancelToken& cancelToken, const ModuleInfo* moduleInfo)
 {
+    // A file that was just downloaded or extracted already has its hash
+    tstring knownMD5;
+    if (FileHashes::lookup(file, knownMD5))
+        return validateHash(validateBaseUrl, knownMD5, cancelToken, moduleInfo);
+
+    TCHAR localMD5[(MD5::HASH_LENGTH * 2) + 1];
+    MD5::hash(file.c_str(), localMD5, (MD5::HASH_LENGTH * 2) + 1);
+
+    return validateHash(validateBaseUrl, localMD5, cancelToken, moduleInfo);
+}
+
+ValidateStatus validateHash(const tstring& validateBaseUrl, const tstring& md5, CancelToken& cancelToken, const ModuleInfo* moduleInfo)
+{
+    // Known files don't need the network
+    ValidationDatabase database;
+    ValidateStatus status;
+    if (openDatabase(database) && database.lookup(md5, status))
+        return status;
+    database.close();
+
+    // nor do those it has answered for recently
+    std::shared_ptr<ValidationCache> cache = loadCache();
+    if (cache && cache->lookup(md5, status))
+    {
+        saveCache(cache);
+        return status;
+    }
+
     DownloadManager download(cancelToken);
     
     download.disableCache();
 
-    TCHAR localMD5[(MD5::HASH_LENGTH * 2) + 1];
-    MD5::hash(file.c_str(), localMD5, (MD5::HASH_LENGTH * 2) + 1);
-    tstring validateUrl(validateBaseUrl);
-    validateUrl.append(localMD5);
+    // The base URL can be a list of mirrors
+    MirrorList baseUrls;
+    baseUrls.addList(validateBaseUrl.c_str());
     std::string validateResult;
-    if (download.getUrl(validateUrl.c_str(), validateResult, moduleInfo))
+    if (download.getUrl(baseUrls.append(md5), validateResult, moduleInfo))
     {
-        if (validateResult == VALIDATE_RESULT_OK)
-            return VALIDATE_OK;
+        status = getStatus(validateResult);
+        if (cache)
+            cache->add(md5, status);
+    }
+    else
+        status = VALIDATE_UNKNOWN;
+
+    saveCache(cache);
+    return status;
+}
+
+}
+
 
-        else if (validateResult == VALIDATE_RESULT_UNKNOWN)
-            return VALIDATE_UNKNOWN;
+ValidationBatch::ValidationBatch()
+    : _requestCount(0)
+{
+}
 
-        else if (validateResult == VALIDATE_RESULT_BANNED)
-            return VALIDATE_BANNED;
-        else 
-            return VALIDATE_UNKNOWN;
+void ValidationBatch::add(const tstring& md5)
+{
+    if (_results.find(md5) == _results.end())
+        _queued.push_back(md5);
+}
+
+void ValidationBatch::resolve(const tstring& validateBaseUrl, CancelToken& cancelToken, const ModuleInfo* moduleInfo)
+{
+    // Each hash only needs sending once, however many files have it, and those in the
+    // validation database don't need sending at all
+    ValidationDatabase database;
+    Validator::openDatabase(database);
+
+    std::shared_ptr<ValidationCache> cache = Validator::loadCache();
+
+    vector<tstring> hashes;
+    set<tstring> seen;
+    ValidateStatus status;
+    for (vector<tstring>::const_iterator it = _queued.begin(); it != _queued.end(); ++it)
+    {
+        if (_results.find(*it) != _results.end() || !seen.insert(*it).second)
+            continue;
+
+        if (database.lookup(*it, status) || (cache && cache->lookup(*it, status)))
+            _results[*it] = status;
+        else
+            hashes.push_back(*it);
     }
-    else
-        return VALIDATE_UNKNOWN;
+    _queued.clear();
+    database.close();
+
+    for (size_t start = 0; start < hashes.size() && !cancelToken.isSignalled(); start += VALIDATE_BATCH_SIZE)
+    {
+        vector<tstring> batch(hashes.begin() + start, hashes.begin() + min(start + VALIDATE_BATCH_SIZE, hashes.size()));
+
+        // A single hash may as well use the plain request
+        if (batch.size() == 1)
+            getStatus(validateBaseUrl, batch[0], cancelToken, moduleInfo);
+        else if (!sendBatch(validateBaseUrl, batch, cancelToken, moduleInfo, cache.get()))
+        {
+            for (vector<tstring>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+                _results[*it] = VALIDATE_UNKNOWN;
+        }
+    }
+
+    Validator::saveCache(cache);
+}
+
+ValidateStatus ValidationBatch::getStatus(const tstring& validateBaseUrl, const tstring& md5, CancelToken& cancelToken, const ModuleInfo* moduleInfo)
+{
+    map<tstring, ValidateStatus>::const_iterator result = _results.find(md5);
+    if (result != _results.end())
+        return result->second;
+
+    ++_requestCount;
+    ValidateStatus status = Validator::validateHash(validateBaseUrl, md5, cancelToken, moduleInfo);
+    _results[md5] = status;
+    return status;
 }
 
-}
\ No newline at end of file
+/* Sends one batch request, and records the result of each hash it answers for (in the
+ * cache too, if there is one).  Hashes it doesn't answer for are left to be validated on
+ * their own. */
+BOOL ValidationBatch::sendBatch(const tstring& validateBaseUrl, const vector<tstring>& hashes, CancelToken& cancelToken, const ModuleInfo* moduleInfo, ValidationCache* cache)
+{
+    tstring hashList;
+    for (vector<tstring>::const_iterator it = hashes.begin(); it != hashes.end(); ++it)
+    {
+        if (!hashList.empty())
+            hashList.push_back(_T(','));
+        hashList.append(*it);
+    }
+
+    DownloadManager download(cancelToken);
+    download.disableCache();
+
+    MirrorList baseUrls;
+    baseUrls.addList(validateBaseUrl.c_str());
+    std::string validateResult;
+    ++_requestCount;
+    if (!download.getUrl(baseUrls.append(hashList), validateResult, moduleInfo))
+        return FALSE;
+
+    set<tstring> requested(hashes.begin(), hashes.end());
+
+    // <md5> <status>, one a line
+    std::string::size_type lineStart = 0;
+    while (lineStart < validateResult.size())
+    {
+        std::string::size_type lineEnd = validateResult.find('\n', lineStart);
+        if (std::string::npos == lineEnd)
+            lineEnd = validateResult.size();
+
+        std::string line(validateResult, lineStart, lineEnd - lineStart);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        std::string::size_type space = line.find(' ');
+        if (std::string::npos != space)
+        {
+            // The hashes are hex, so widen as they are
+            tstring md5(line.begin(), line.begin() + space);
+            if (requested.find(md5) != requested.end())
+            {
+                _results[md5] = Validator::getStatus(line.substr(space + 1));
+                if (cache)
+                    cache->add(md5, _results[md5]);
+            }
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    return TRUE;
+}
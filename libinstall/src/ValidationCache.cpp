@@ -0,0 +1,221 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "precompiled_headers.h"
+#include "libinstall/ValidationCache.h"
+#include "libinstall/md5.h"
+
+using namespace std;
+
+#define VALIDATIONCACHE_HASH_SIZE     (MD5::HASH_LENGTH * 2)
+
+// 100ns FILETIME units in a second
+#define FILETIME_SECOND               10000000ULL
+
+
+ValidationCache::ValidationCache(const tstring& filename)
+	: _filename(filename),
+	  _hits(0),
+	  _misses(0)
+{
+	_ttl[VALIDATE_OK] = VALIDATIONCACHE_OK_TTL;
+	_ttl[VALIDATE_UNKNOWN] = VALIDATIONCACHE_UNKNOWN_TTL;
+	_ttl[VALIDATE_BANNED] = VALIDATIONCACHE_BANNED_TTL;
+}
+
+void ValidationCache::setTtl(ValidateStatus status, UINT32 seconds)
+{
+	_ttl[status] = seconds;
+}
+
+UINT64 ValidationCache::getNow()
+{
+	FILETIME now;
+	::GetSystemTimeAsFileTime(&now);
+	return (static_cast<UINT64>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+}
+
+/* Opens the cache file with no sharing, waiting whilst another process has it open */
+HANDLE ValidationCache::openLocked(DWORD creationDisposition)
+{
+	for (int attempt = 0; attempt < VALIDATIONCACHE_LOCK_ATTEMPTS; ++attempt)
+	{
+		HANDLE hFile = ::CreateFile(_filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, creationDisposition, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (INVALID_HANDLE_VALUE != hFile)
+			return hFile;
+
+		DWORD error = ::GetLastError();
+		if (ERROR_SHARING_VIOLATION != error && ERROR_LOCK_VIOLATION != error)
+			break;
+
+		::Sleep(VALIDATIONCACHE_LOCK_WAIT);
+	}
+
+	return INVALID_HANDLE_VALUE;
+}
+
+/* Reads the entries of the open cache file that expire after now.  FALSE (and no entries)
+ * if the file is empty or damaged. */
+BOOL ValidationCache::readEntries(HANDLE hFile, UINT64 now, EntryContainer& entries)
+{
+	entries.clear();
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0 || fileSize.HighPart != 0)
+		return FALSE;
+
+	string buffer(static_cast<size_t>(fileSize.QuadPart), '\0');
+	DWORD bytesRead = 0;
+	if (!::ReadFile(hFile, &buffer[0], fileSize.LowPart, &bytesRead, NULL) || bytesRead != fileSize.LowPart)
+		return FALSE;
+
+	const size_t headerSize = 3 * sizeof(UINT32);
+	const size_t recordSize = VALIDATIONCACHE_HASH_SIZE + sizeof(UINT32) + sizeof(UINT64);
+
+	UINT32 header[3];
+	if (buffer.size() < headerSize)
+		return FALSE;
+	memcpy(header, buffer.c_str(), headerSize);
+
+	if (header[0] != VALIDATIONCACHE_MAGIC || header[1] != VALIDATIONCACHE_VERSION
+		|| buffer.size() != headerSize + (header[2] * recordSize))
+		return FALSE;
+
+	const char* record = buffer.c_str() + headerSize;
+	for (UINT32 index = 0; index < header[2]; ++index, record += recordSize)
+	{
+		UINT32 status;
+		CacheEntry entry;
+		memcpy(&status, record + VALIDATIONCACHE_HASH_SIZE, sizeof(UINT32));
+		memcpy(&entry.expires, record + VALIDATIONCACHE_HASH_SIZE + sizeof(UINT32), sizeof(UINT64));
+
+		if (status > VALIDATE_BANNED)
+		{
+			entries.clear();
+			return FALSE;
+		}
+
+		if (entry.expires <= now)
+			continue;
+
+		// The hashes are hex, so widen as they are
+		entry.status = static_cast<ValidateStatus>(status);
+		entries[tstring(record, record + VALIDATIONCACHE_HASH_SIZE)] = entry;
+	}
+
+	return TRUE;
+}
+
+
+BOOL ValidationCache::load()
+{
+	_entries.clear();
+	_added.clear();
+
+	HANDLE hFile = openLocked(OPEN_EXISTING);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	BOOL loaded = readEntries(hFile, getNow(), _entries);
+	::CloseHandle(hFile);
+	return loaded && !_entries.empty();
+}
+
+
+BOOL ValidationCache::save()
+{
+	if (_added.empty())
+		return TRUE;
+
+	HANDLE hFile = openLocked(OPEN_ALWAYS);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	// Keep what other processes have added since load(), and drop what has expired since
+	EntryContainer entries;
+	readEntries(hFile, getNow(), entries);
+	for (EntryContainer::const_iterator it = _added.begin(); it != _added.end(); ++it)
+		entries[it->first] = it->second;
+
+	UINT32 header[3] = { VALIDATIONCACHE_MAGIC, VALIDATIONCACHE_VERSION, static_cast<UINT32>(entries.size()) };
+	string buffer(reinterpret_cast<const char*>(header), sizeof(header));
+	for (EntryContainer::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		for (tstring::const_iterator digit = it->first.begin(); digit != it->first.end(); ++digit)
+			buffer.push_back(static_cast<char>(*digit));
+
+		UINT32 status = static_cast<UINT32>(it->second.status);
+		buffer.append(reinterpret_cast<const char*>(&status), sizeof(UINT32));
+		buffer.append(reinterpret_cast<const char*>(&it->second.expires), sizeof(UINT64));
+	}
+
+	DWORD bytesWritten = 0;
+	BOOL writeSuccess = INVALID_SET_FILE_POINTER != ::SetFilePointer(hFile, 0, NULL, FILE_BEGIN)
+		&& ::WriteFile(hFile, buffer.c_str(), static_cast<DWORD>(buffer.size()), &bytesWritten, NULL)
+		&& bytesWritten == buffer.size()
+		&& ::SetEndOfFile(hFile);
+	::CloseHandle(hFile);
+
+	if (!writeSuccess)
+		return FALSE;
+
+	_entries.swap(entries);
+	_added.clear();
+	return TRUE;
+}
+
+
+BOOL ValidationCache::lookup(const tstring& md5, ValidateStatus& status)
+{
+	const CacheEntry* entry = NULL;
+	EntryContainer::const_iterator it = _added.find(md5);
+	if (it != _added.end())
+	{
+		entry = &it->second;
+	}
+	else
+	{
+		it = _entries.find(md5);
+		if (it != _entries.end())
+			entry = &it->second;
+	}
+
+	if (!entry || entry->expires <= getNow())
+	{
+		++_misses;
+		return FALSE;
+	}
+
+	status = entry->status;
+	++_hits;
+	return TRUE;
+}
+
+
+void ValidationCache::add(const tstring& md5, ValidateStatus status)
+{
+	// Only MD5s fit in a record
+	if (md5.size() != VALIDATIONCACHE_HASH_SIZE)
+		return;
+
+	CacheEntry entry;
+	entry.status = status;
+	entry.expires = getNow() + (_ttl[status] * FILETIME_SECOND);
+	_added[md5] = entry;
+}
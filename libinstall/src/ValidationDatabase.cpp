@@ -0,0 +1,207 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "precompiled_headers.h"
+#include "libinstall/ValidationDatabase.h"
+#include "libinstall/md5.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+
+ValidationDatabase::ValidationDatabase()
+	: _hFile(INVALID_HANDLE_VALUE),
+	  _hMapping(NULL),
+	  _view(NULL),
+	  _count(0)
+{
+}
+
+ValidationDatabase::~ValidationDatabase()
+{
+	close();
+}
+
+BOOL ValidationDatabase::open(const TCHAR* filename)
+{
+	close();
+
+	_hFile = ::CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == _hFile)
+		return FALSE;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(_hFile, &fileSize) || fileSize.QuadPart < VALIDATIONDB_HEADER_SIZE || fileSize.HighPart != 0)
+	{
+		close();
+		return FALSE;
+	}
+
+	_hMapping = ::CreateFileMapping(_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == _hMapping)
+	{
+		close();
+		return FALSE;
+	}
+
+	_view = reinterpret_cast<const BYTE*>(::MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (NULL == _view)
+	{
+		close();
+		return FALSE;
+	}
+
+	const UINT32* header = reinterpret_cast<const UINT32*>(_view);
+	size_t count = header[2];
+	if (header[0] != VALIDATIONDB_MAGIC
+		|| header[1] != VALIDATIONDB_VERSION
+		|| static_cast<size_t>(fileSize.QuadPart) != VALIDATIONDB_HEADER_SIZE + (count * VALIDATIONDB_RECORD_SIZE))
+	{
+		close();
+		return FALSE;
+	}
+
+	_count = count;
+	return TRUE;
+}
+
+void ValidationDatabase::close()
+{
+	if (_view)
+	{
+		::UnmapViewOfFile(_view);
+		_view = NULL;
+	}
+
+	if (_hMapping)
+	{
+		::CloseHandle(_hMapping);
+		_hMapping = NULL;
+	}
+
+	if (INVALID_HANDLE_VALUE != _hFile)
+	{
+		::CloseHandle(_hFile);
+		_hFile = INVALID_HANDLE_VALUE;
+	}
+
+	_count = 0;
+}
+
+BOOL ValidationDatabase::lookup(const tstring& md5, ValidateStatus& status) const
+{
+	BYTE hash[MD5::HASH_LENGTH];
+	if (!_view || !parseHash(md5, hash))
+		return FALSE;
+
+	const BYTE* records = _view + VALIDATIONDB_HEADER_SIZE;
+	size_t low = 0;
+	size_t high = _count;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		const BYTE* record = records + (middle * VALIDATIONDB_RECORD_SIZE);
+		int compare = memcmp(record, hash, MD5::HASH_LENGTH);
+		if (compare < 0)
+			low = middle + 1;
+		else if (compare > 0)
+			high = middle;
+		else
+		{
+			switch(record[MD5::HASH_LENGTH])
+			{
+				case VALIDATIONDB_STATUS_OK:
+					status = VALIDATE_OK;
+					return TRUE;
+
+				case VALIDATIONDB_STATUS_BANNED:
+					status = VALIDATE_BANNED;
+					return TRUE;
+
+				default:
+					// A status from a later version - leave it to the server
+					return FALSE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+BOOL ValidationDatabase::save(const TCHAR* filename, const map<tstring, ValidateStatus>& hashes)
+{
+	// Each record as a string, so they sort by the bytes of the hash
+	vector<string> records;
+	BYTE hash[MD5::HASH_LENGTH];
+	for (map<tstring, ValidateStatus>::const_iterator it = hashes.begin(); it != hashes.end(); ++it)
+	{
+		if (VALIDATE_UNKNOWN == it->second || !parseHash(it->first, hash))
+			continue;
+
+		string record(reinterpret_cast<const char*>(hash), MD5::HASH_LENGTH);
+		record.push_back(static_cast<char>(VALIDATE_OK == it->second ? VALIDATIONDB_STATUS_OK : VALIDATIONDB_STATUS_BANNED));
+		records.push_back(record);
+	}
+	sort(records.begin(), records.end());
+
+	UINT32 header[3] = { VALIDATIONDB_MAGIC, VALIDATIONDB_VERSION, static_cast<UINT32>(records.size()) };
+	string contents(reinterpret_cast<const char*>(header), VALIDATIONDB_HEADER_SIZE);
+	for (vector<string>::const_iterator it = records.begin(); it != records.end(); ++it)
+		contents.append(*it);
+
+	HANDLE hFile = ::CreateFile(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	DWORD bytesWritten = 0;
+	BOOL writeSuccess = ::WriteFile(hFile, contents.data(), static_cast<DWORD>(contents.size()), &bytesWritten, NULL);
+	::CloseHandle(hFile);
+
+	return writeSuccess && bytesWritten == contents.size();
+}
+
+/* Reads the 32 hex digits of md5 into hash.  FALSE if it isn't an MD5. */
+BOOL ValidationDatabase::parseHash(const tstring& md5, BYTE* hash)
+{
+	if (md5.size() != MD5::HASH_LENGTH * 2)
+		return FALSE;
+
+	for (int i = 0; i < MD5::HASH_LENGTH * 2; ++i)
+	{
+		TCHAR digit = md5[i];
+		BYTE value;
+		if (digit >= _T('0') && digit <= _T('9'))
+			value = static_cast<BYTE>(digit - _T('0'));
+		else if (digit >= _T('a') && digit <= _T('f'))
+			value = static_cast<BYTE>(digit - _T('a') + 10);
+		else if (digit >= _T('A') && digit <= _T('F'))
+			value = static_cast<BYTE>(digit - _T('A') + 10);
+		else
+			return FALSE;
+
+		if (i % 2)
+			hash[i / 2] |= value;
+		else
+			hash[i / 2] = static_cast<BYTE>(value << 4);
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,410 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "libinstall/WinInetTransport.h"
+
+#include <vector>
+
+using namespace std;
+
+#define WININET_TIMEOUT         120000      // ms for WinINet to connect, or to receive
+#define WININET_WAIT_TIMEOUT    60000       // ms to wait for a response, or the next part of the body, unless setTimeout() says otherwise
+#define WININET_CLOSE_TIMEOUT   30000       // ms to wait for a closed request handle's last callback
+
+
+class WinInetRequest : public HttpRequest
+{
+public:
+	WinInetRequest(CancelToken& cancelToken);
+	~WinInetRequest();
+
+	BOOL send(HINTERNET hConnect, const tstring& path, const tstring& extraHeaders, DWORD flags);
+
+	virtual BOOL waitForResponse();
+	virtual DWORD getStatusCode();
+	virtual tstring getHeader(const TCHAR* name);
+	virtual BOOL read(BYTE* buffer, DWORD bufferLength, DWORD& bytesRead);
+	virtual BOOL askProxyLogin(HWND parentHwnd);
+	virtual void getTimings(HttpRequestTimings& timings);
+	virtual void setTimeout(DWORD timeout);
+	virtual void abort();
+
+	static void __stdcall statusCallback(HINTERNET hInternet,
+		DWORD_PTR dwContext,
+		DWORD dwInternetStatus,
+		LPVOID lpvStatusInformation,
+		DWORD dwStatusInformationLength);
+
+private:
+	enum Phase
+	{
+		PHASE_RESOLVING,
+		PHASE_RESOLVED,
+		PHASE_CONNECTING,
+		PHASE_CONNECTED,
+		PHASE_REQUEST_SENT,
+		PHASE_RESPONSE_RECEIVED,
+		PHASE_COUNT
+	};
+
+	BOOL waitForComplete();
+	void recordPhase(Phase phase);
+	double getPhaseTime(Phase phase);
+
+	HINTERNET		_hRequest;
+	HANDLE			_requestComplete;
+	HANDLE			_handleClosed;
+	HANDLE			_aborted;
+	DWORD			_timeout;
+	DWORD			_error;
+	CancelToken		_cancelToken;
+
+	// An asynchronous read finishes into these, so they have to outlive a read that is
+	// given up on (cancelled or timed out) - the caller's buffer may not
+	vector<BYTE>	_readBuffer;
+	DWORD			_bytesRead;
+
+	// Performance counter values, set from the callbacks - 0 for a phase that hasn't happened
+	LARGE_INTEGER	_opened;
+	LONGLONG		_phaseTimes[PHASE_COUNT];
+};
+
+
+WinInetRequest::WinInetRequest(CancelToken& cancelToken)
+	: _hRequest(NULL),
+	  _error(0),
+	  _cancelToken(cancelToken),
+	  _timeout(WININET_WAIT_TIMEOUT),
+	  _bytesRead(0)
+{
+	::QueryPerformanceCounter(&_opened);
+	memset(_phaseTimes, 0, sizeof(_phaseTimes));
+
+	_requestComplete = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
+	_handleClosed = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
+	_aborted = ::CreateEvent(NULL, TRUE /*manualReset*/, FALSE /*initialState*/, NULL /*name*/);
+}
+
+WinInetRequest::~WinInetRequest()
+{
+	// Callbacks for the handle can still be on their way until it says it is closing
+	if (_hRequest)
+	{
+		::InternetCloseHandle(_hRequest);
+		::WaitForSingleObject(_handleClosed, WININET_CLOSE_TIMEOUT);
+	}
+
+	::CloseHandle(_requestComplete);
+	::CloseHandle(_handleClosed);
+	::CloseHandle(_aborted);
+}
+
+void WinInetRequest::statusCallback(HINTERNET /* hInternet */,
+	DWORD_PTR dwContext,
+	DWORD dwInternetStatus,
+	LPVOID lpvStatusInformation,
+	DWORD /* dwStatusInformationLength */)
+{
+	// The session and connection handles have no context
+	WinInetRequest* request = reinterpret_cast<WinInetRequest*>(dwContext);
+	if (!request)
+		return;
+
+	switch (dwInternetStatus)
+	{
+		case INTERNET_STATUS_RESOLVING_NAME:
+			request->recordPhase(PHASE_RESOLVING);
+			break;
+
+		case INTERNET_STATUS_NAME_RESOLVED:
+			request->recordPhase(PHASE_RESOLVED);
+			break;
+
+		case INTERNET_STATUS_CONNECTING_TO_SERVER:
+			request->recordPhase(PHASE_CONNECTING);
+			break;
+
+		case INTERNET_STATUS_CONNECTED_TO_SERVER:
+			request->recordPhase(PHASE_CONNECTED);
+			break;
+
+		case INTERNET_STATUS_REQUEST_SENT:
+			request->recordPhase(PHASE_REQUEST_SENT);
+			break;
+
+		case INTERNET_STATUS_REQUEST_COMPLETE:
+		{
+			// The first completion is of HttpSendRequest, so the response headers are here
+			request->recordPhase(PHASE_RESPONSE_RECEIVED);
+
+			INTERNET_ASYNC_RESULT* result = reinterpret_cast<INTERNET_ASYNC_RESULT*>(lpvStatusInformation);
+			request->_error = result->dwResult ? 0 : result->dwError;
+			::SetEvent(request->_requestComplete);
+			break;
+		}
+
+		case INTERNET_STATUS_HANDLE_CLOSING:
+			::SetEvent(request->_handleClosed);
+			break;
+
+		default:
+			break;
+	}
+}
+
+BOOL WinInetRequest::send(HINTERNET hConnect, const tstring& path, const tstring& extraHeaders, DWORD flags)
+{
+	_hRequest = ::HttpOpenRequest(hConnect, _T("GET"), path.c_str(), NULL /* version */, NULL /* referrer */,
+		NULL /* accept types */, flags, reinterpret_cast<DWORD_PTR>(this));
+	if (!_hRequest)
+		return FALSE;
+
+	const TCHAR* headers = extraHeaders.empty() ? NULL : extraHeaders.c_str();
+
+	::ResetEvent(_requestComplete);
+	if (::HttpSendRequest(_hRequest, headers, headers ? static_cast<DWORD>(-1L) : 0, NULL, 0))
+	{
+		// Finished already, so there won't be a REQUEST_COMPLETE
+		recordPhase(PHASE_RESPONSE_RECEIVED);
+		::SetEvent(_requestComplete);
+		return TRUE;
+	}
+
+	return ERROR_IO_PENDING == ::GetLastError();
+}
+
+BOOL WinInetRequest::waitForComplete()
+{
+	HANDLE waitHandles[3];
+	waitHandles[0] = _cancelToken.getToken();
+	waitHandles[1] = _aborted;
+	waitHandles[2] = _requestComplete;
+
+	// Cancelled, aborted, more than the timeout for a response, or the wait failed
+	if (WAIT_OBJECT_0 + 2 != ::WaitForMultipleObjects(3, waitHandles, FALSE, _timeout))
+		return FALSE;
+
+	return 0 == _error;
+}
+
+BOOL WinInetRequest::waitForResponse()
+{
+	return waitForComplete();
+}
+
+DWORD WinInetRequest::getStatusCode()
+{
+	DWORD statusCode = 0;
+	DWORD bufferLength = sizeof(statusCode);
+	DWORD headerIndex = 0;
+
+	if (!::HttpQueryInfo(_hRequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &bufferLength, &headerIndex))
+		return 0;
+
+	return statusCode;
+}
+
+tstring WinInetRequest::getHeader(const TCHAR* name)
+{
+	// HTTP_QUERY_CUSTOM takes the name of the header in the buffer
+	TCHAR headerBuffer[1024];
+	_tcsncpy_s(headerBuffer, 1024, name, _TRUNCATE);
+	DWORD bufferLength = sizeof(headerBuffer);
+	DWORD headerIndex = 0;
+
+	if (::HttpQueryInfo(_hRequest, HTTP_QUERY_CUSTOM, headerBuffer, &bufferLength, &headerIndex))
+		return tstring(headerBuffer);
+
+	return tstring();
+}
+
+BOOL WinInetRequest::read(BYTE* buffer, DWORD bufferLength, DWORD& bytesRead)
+{
+	bytesRead = 0;
+	if (_readBuffer.size() < bufferLength)
+		_readBuffer.resize(bufferLength);
+
+	_bytesRead = 0;
+	::ResetEvent(_requestComplete);
+	if (!::InternetReadFile(_hRequest, &_readBuffer[0], bufferLength, &_bytesRead))
+	{
+		if (ERROR_IO_PENDING != ::GetLastError() || !waitForComplete())
+			return FALSE;
+	}
+
+	bytesRead = _bytesRead;
+	memcpy(buffer, &_readBuffer[0], bytesRead);
+	return TRUE;
+}
+
+/* Only the first time - e.g. every read completes a request too */
+void WinInetRequest::recordPhase(Phase phase)
+{
+	if (0 == _phaseTimes[phase])
+	{
+		LARGE_INTEGER now;
+		::QueryPerformanceCounter(&now);
+		_phaseTimes[phase] = now.QuadPart;
+	}
+}
+
+double WinInetRequest::getPhaseTime(Phase phase)
+{
+	if (0 == _phaseTimes[phase])
+		return -1;
+
+	LARGE_INTEGER frequency;
+	::QueryPerformanceFrequency(&frequency);
+	return (static_cast<double>(_phaseTimes[phase] - _opened.QuadPart) * 1000.0) / static_cast<double>(frequency.QuadPart);
+}
+
+void WinInetRequest::getTimings(HttpRequestTimings& timings)
+{
+	timings.resolving = getPhaseTime(PHASE_RESOLVING);
+	timings.resolved = getPhaseTime(PHASE_RESOLVED);
+	timings.connecting = getPhaseTime(PHASE_CONNECTING);
+	timings.connected = getPhaseTime(PHASE_CONNECTED);
+	timings.requestSent = getPhaseTime(PHASE_REQUEST_SENT);
+	timings.responseReceived = getPhaseTime(PHASE_RESPONSE_RECEIVED);
+}
+
+void WinInetRequest::setTimeout(DWORD timeout)
+{
+	_timeout = timeout;
+}
+
+void WinInetRequest::abort()
+{
+	::SetEvent(_aborted);
+}
+
+BOOL WinInetRequest::askProxyLogin(HWND parentHwnd)
+{
+	LPVOID errorBuffer = 0;
+	DWORD dwFlags = FLAGS_ERROR_UI_FLAGS_GENERATE_DATA | FLAGS_ERROR_UI_FLAGS_CHANGE_OPTIONS;
+	DWORD errorResult = ::InternetErrorDlg(parentHwnd, _hRequest, ERROR_INTERNET_INCORRECT_PASSWORD, dwFlags, &errorBuffer);
+	return ERROR_INTERNET_FORCE_RETRY == errorResult;
+}
+
+
+
+WinInetTransport::WinInetTransport(const tstring& userAgent)
+{
+	::InitializeCriticalSection(&_lock);
+
+	_hInternet = ::InternetOpen(userAgent.c_str(), INTERNET_OPEN_TYPE_PRECONFIG, NULL /* proxy*/ , NULL /* proxy bypass */, INTERNET_FLAG_ASYNC /* dwflags */);
+	if (_hInternet)
+	{
+		// Inherited by the connection and request handles
+		::InternetSetStatusCallback(_hInternet, &WinInetRequest::statusCallback);
+
+		DWORD timeout = WININET_TIMEOUT;
+		::InternetSetOption(_hInternet, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(DWORD));
+		::InternetSetOption(_hInternet, INTERNET_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(DWORD));
+	}
+}
+
+WinInetTransport::~WinInetTransport()
+{
+	for (map<tstring, HINTERNET>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+		::InternetCloseHandle(it->second);
+
+	if (_hInternet)
+		::InternetCloseHandle(_hInternet);
+
+	::DeleteCriticalSection(&_lock);
+}
+
+HINTERNET WinInetTransport::getConnection(const tstring& hostName, INTERNET_PORT port)
+{
+	TCHAR portString[10];
+	_stprintf_s(portString, 10, _T(":%hu"), port);
+	tstring key(hostName);
+	key.append(portString);
+
+	::EnterCriticalSection(&_lock);
+
+	HINTERNET hConnect = NULL;
+	map<tstring, HINTERNET>::iterator it = _connections.find(key);
+	if (it != _connections.end())
+	{
+		hConnect = it->second;
+	}
+	else
+	{
+		// For HTTP this doesn't go to the network, so is fine to do whilst holding the lock
+		hConnect = ::InternetConnect(_hInternet, hostName.c_str(), port, NULL /* user */, NULL /* password */,
+			INTERNET_SERVICE_HTTP, 0, 0 /* context - no callbacks */);
+		if (hConnect)
+			_connections[key] = hConnect;
+	}
+
+	::LeaveCriticalSection(&_lock);
+	return hConnect;
+}
+
+std::shared_ptr<HttpRequest> WinInetTransport::openRequest(const tstring& url, const tstring& extraHeaders, DWORD flags, CancelToken& cancelToken)
+{
+	if (!_hInternet)
+		return std::shared_ptr<HttpRequest>();
+
+	// With no buffers given, the components just point into url
+	URL_COMPONENTS components;
+	memset(&components, 0, sizeof(components));
+	components.dwStructSize = sizeof(components);
+	components.dwSchemeLength = 1;
+	components.dwHostNameLength = 1;
+	components.dwUrlPathLength = 1;
+	components.dwExtraInfoLength = 1;
+
+	if (!::InternetCrackUrl(url.c_str(), 0, 0, &components)
+		|| (INTERNET_SCHEME_HTTP != components.nScheme && INTERNET_SCHEME_HTTPS != components.nScheme))
+	{
+		return std::shared_ptr<HttpRequest>();
+	}
+
+	tstring hostName(components.lpszHostName, components.dwHostNameLength);
+	tstring path(components.lpszUrlPath, components.dwUrlPathLength);
+	path.append(components.lpszExtraInfo, components.dwExtraInfoLength);
+	if (path.empty())
+		path = _T("/");
+
+	HINTERNET hConnect = getConnection(hostName, components.nPort);
+	if (!hConnect)
+		return std::shared_ptr<HttpRequest>();
+
+	DWORD requestFlags = INTERNET_FLAG_KEEP_CONNECTION;
+	if (INTERNET_SCHEME_HTTPS == components.nScheme)
+		requestFlags |= INTERNET_FLAG_SECURE;
+
+	if (flags & HTTP_REQUEST_NO_CACHE)
+		requestFlags |= INTERNET_FLAG_PRAGMA_NOCACHE | INTERNET_FLAG_RESYNCHRONIZE;
+
+	// A range of the file, or a conditional request, must not come from, or go into, the cache
+	if (!extraHeaders.empty())
+		requestFlags |= INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE;
+
+	std::shared_ptr<WinInetRequest> request(new WinInetRequest(cancelToken));
+	if (!request->send(hConnect, path, extraHeaders, requestFlags))
+		return std::shared_ptr<HttpRequest>();
+
+	return request;
+}
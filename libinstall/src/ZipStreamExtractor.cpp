@@ -0,0 +1,321 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "precompiled_headers.h"
+#include "libinstall/ZipStreamExtractor.h"
+#include "libinstall/Decompress.h"
+#include "libinstall/WcharMbcsConverter.h"
+#include "libinstall/FileHashes.h"
+
+#include "zlib.h"
+
+using namespace std;
+
+#define ZIP_LOCAL_HEADER_SIGNATURE      0x04034b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE    0x02014b50
+#define ZIP_END_SIGNATURE               0x06054b50
+
+#define ZIP_LOCAL_HEADER_SIZE           30
+
+#define ZIP_FLAG_ENCRYPTED              0x0001
+#define ZIP_FLAG_DATA_DESCRIPTOR        0x0008
+
+#define ZIP_METHOD_STORED               0
+#define ZIP_METHOD_DEFLATED             8
+
+#define ZIP_OUTPUT_BUFFER_SIZE          16384
+
+// Zip values are little endian
+static WORD readWord(const BYTE* data)
+{
+	return static_cast<WORD>(data[0] | (data[1] << 8));
+}
+
+static DWORD readDword(const BYTE* data)
+{
+	return static_cast<DWORD>(data[0]) | (static_cast<DWORD>(data[1]) << 8)
+		| (static_cast<DWORD>(data[2]) << 16) | (static_cast<DWORD>(data[3]) << 24);
+}
+
+
+ZipStreamExtractor::ZipStreamExtractor(const tstring& destDir)
+	: _destDir(destDir),
+	  _hashing(FALSE),
+	  _inflate(NULL)
+{
+	reset();
+}
+
+ZipStreamExtractor::~ZipStreamExtractor()
+{
+	closeEntry();
+}
+
+void ZipStreamExtractor::reset()
+{
+	closeEntry();
+	_state = STATE_HEADER;
+	_position = 0;
+	_header.clear();
+}
+
+void ZipStreamExtractor::fail()
+{
+	closeEntry();
+	_state = STATE_FAILED;
+}
+
+void ZipStreamExtractor::closeEntry()
+{
+	_output.close();
+
+	if (_inflate)
+	{
+		inflateEnd(_inflate);
+		delete _inflate;
+		_inflate = NULL;
+	}
+}
+
+void ZipStreamExtractor::write(UINT64 offset, const BYTE* data, DWORD length)
+{
+	if (0 == offset)
+		reset();
+
+	// Only the data in the order it is in the file can be extracted (not the rest of a
+	// download that continues from part way through)
+	if (STATE_FAILED == _state || offset != _position)
+	{
+		fail();
+		return;
+	}
+
+	_position += length;
+
+	size_t used = 0;
+	while (used < length && (STATE_HEADER == _state || STATE_DATA == _state))
+	{
+		if (STATE_HEADER == _state)
+			used += readHeader(data + used, length - used);
+		else
+			used += readData(data + used, length - used);
+	}
+}
+
+size_t ZipStreamExtractor::readHeader(const BYTE* data, size_t length)
+{
+	// The fixed part first, then the filename and extra field it gives the lengths of
+	size_t headerLength = ZIP_LOCAL_HEADER_SIZE;
+	if (_header.size() >= ZIP_LOCAL_HEADER_SIZE)
+		headerLength += readWord(&_header[26]) + readWord(&_header[28]);
+
+	size_t used = min(length, headerLength - _header.size());
+	_header.insert(_header.end(), data, data + used);
+
+	if (_header.size() >= 4)
+	{
+		DWORD signature = readDword(&_header[0]);
+
+		// The central directory comes after the last entry, and adds nothing
+		if (ZIP_CENTRAL_HEADER_SIGNATURE == signature || ZIP_END_SIGNATURE == signature)
+		{
+			_state = STATE_COMPLETE;
+			return length;
+		}
+
+		if (ZIP_LOCAL_HEADER_SIGNATURE != signature)
+		{
+			fail();
+			return length;
+		}
+	}
+
+	// Having just got the fixed part, the next call reads the rest
+	if (_header.size() < ZIP_LOCAL_HEADER_SIZE
+		|| _header.size() < ZIP_LOCAL_HEADER_SIZE + readWord(&_header[26]) + readWord(&_header[28]))
+	{
+		return used;
+	}
+
+	if (!startEntry())
+	{
+		fail();
+		return length;
+	}
+
+	return used;
+}
+
+BOOL ZipStreamExtractor::startEntry()
+{
+	WORD flags = readWord(&_header[6]);
+	_method = readWord(&_header[8]);
+	_crc = readDword(&_header[14]);
+	_compressedSize = readDword(&_header[18]);
+	_uncompressedSize = readDword(&_header[22]);
+	WORD filenameLength = readWord(&_header[26]);
+
+	// The sizes of an entry with a data descriptor aren't known until after its data, and
+	// 0xFFFFFFFF means the real sizes are in a zip64 extra field
+	if ((flags & (ZIP_FLAG_ENCRYPTED | ZIP_FLAG_DATA_DESCRIPTOR))
+		|| (ZIP_METHOD_STORED != _method && ZIP_METHOD_DEFLATED != _method)
+		|| 0xFFFFFFFF == _compressedSize || 0xFFFFFFFF == _uncompressedSize
+		|| 0 == filenameLength)
+	{
+		return FALSE;
+	}
+
+	string filename(reinterpret_cast<const char*>(&_header[ZIP_LOCAL_HEADER_SIZE]), filenameLength);
+	std::shared_ptr<TCHAR> tFilename = WcharMbcsConverter::char2tchar(filename.c_str());
+	_header.clear();
+
+	_remaining = _compressedSize;
+	_outputCrc = crc32(0L, Z_NULL, 0);
+	_outputSize = 0;
+	_streamEnded = FALSE;
+	_hashing = FALSE;
+	_state = STATE_DATA;
+
+	if (filename[filename.size() - 1] == '/')
+	{
+		// A directory - the same as Decompress::unzip
+		tstring outputDir(_destDir);
+		outputDir.append(tFilename.get());
+		outputDir.erase(outputDir.size() - 1);
+		::CreateDirectory(outputDir.c_str(), NULL);
+	}
+	else
+	{
+		_outputFilename = Decompress::makeOutputPath(_destDir, tFilename.get());
+		if (!_output.create(_outputFilename))
+			return FALSE;
+
+		_output.reserve(_uncompressedSize);
+		_hashing = _outputHash.init();
+	}
+
+	if (ZIP_METHOD_DEFLATED == _method)
+	{
+		// Zip entries are raw deflate data, with no zlib header
+		_inflate = new z_stream;
+		memset(_inflate, 0, sizeof(z_stream));
+		if (inflateInit2(_inflate, -MAX_WBITS) != Z_OK)
+		{
+			delete _inflate;
+			_inflate = NULL;
+			return FALSE;
+		}
+	}
+
+	if (0 == _remaining && !finishEntry())
+		return FALSE;
+
+	return TRUE;
+}
+
+size_t ZipStreamExtractor::readData(const BYTE* data, size_t length)
+{
+	size_t used = min(length, static_cast<size_t>(_remaining));
+	_remaining -= static_cast<DWORD>(used);
+
+	if (ZIP_METHOD_STORED == _method)
+	{
+		if (!writeOutput(data, used))
+		{
+			fail();
+			return length;
+		}
+	}
+	else
+	{
+		BYTE output[ZIP_OUTPUT_BUFFER_SIZE];
+		_inflate->next_in = const_cast<Bytef*>(data);
+		_inflate->avail_in = static_cast<uInt>(used);
+
+		// Until all the input is used, and there's room left over in the output (so no more is waiting)
+		do
+		{
+			_inflate->next_out = output;
+			_inflate->avail_out = ZIP_OUTPUT_BUFFER_SIZE;
+
+			int result = inflate(_inflate, Z_NO_FLUSH);
+			if (Z_STREAM_END == result)
+			{
+				_streamEnded = TRUE;
+			}
+			else if (Z_OK != result && Z_BUF_ERROR != result)
+			{
+				fail();
+				return length;
+			}
+
+			if (!writeOutput(output, ZIP_OUTPUT_BUFFER_SIZE - _inflate->avail_out))
+			{
+				fail();
+				return length;
+			}
+		} while (!_streamEnded && (_inflate->avail_in > 0 || 0 == _inflate->avail_out));
+	}
+
+	if (0 == _remaining && !finishEntry())
+	{
+		fail();
+		return length;
+	}
+
+	return used;
+}
+
+BOOL ZipStreamExtractor::writeOutput(const BYTE* data, size_t length)
+{
+	if (0 == length)
+		return TRUE;
+
+	// Directories have no content
+	if (!_output.isOpen() || !_output.write(data, static_cast<DWORD>(length)))
+		return FALSE;
+
+	_outputCrc = crc32(_outputCrc, data, static_cast<uInt>(length));
+	if (_hashing)
+		_hashing = _outputHash.update(data, length);
+	_outputSize += static_cast<DWORD>(length);
+	return TRUE;
+}
+
+BOOL ZipStreamExtractor::finishEntry()
+{
+	BOOL complete = (ZIP_METHOD_STORED == _method || _streamEnded)
+		&& _outputCrc == _crc
+		&& _outputSize == _uncompressedSize;
+
+	// A file that couldn't all be written isn't complete either
+	BOOL wasFile = _output.isOpen();
+	if (!_output.close())
+		complete = FALSE;
+
+	// The file's hash, from the output on its way to the disk
+	TCHAR hash[(MD5LEN * 2) + 1];
+	if (complete && wasFile && _hashing && _outputHash.final(hash, (MD5LEN * 2) + 1))
+		FileHashes::record(_outputFilename, hash);
+	_hashing = FALSE;
+
+	closeEntry();
+	_state = STATE_HEADER;
+	return complete;
+}
@@ -24,94 +24,144 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 
+MD5::MD5()
+	: _hProv(0),
+	  _hHash(0),
+	  _failed(FALSE)
+{
+}
+
+MD5::~MD5()
+{
+	release();
+}
+
+void MD5::release()
+{
+	if (_hHash)
+	{
+		CryptDestroyHash(static_cast<HCRYPTHASH>(_hHash));
+		_hHash = 0;
+	}
+
+	if (_hProv)
+	{
+		CryptReleaseContext(static_cast<HCRYPTPROV>(_hProv), 0);
+		_hProv = 0;
+	}
+}
+
+BOOL MD5::init()
+{
+	release();
+	_failed = FALSE;
+
+	HCRYPTPROV hProv = 0;
+	HCRYPTHASH hHash = 0;
+
+	// Get handle to the crypto provider
+	if (!CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT))
+		return FALSE;
+	_hProv = hProv;
+
+	if (!CryptCreateHash(hProv, CALG_MD5, 0, 0, &hHash))
+	{
+		release();
+		return FALSE;
+	}
+	_hHash = hHash;
+
+	return TRUE;
+}
+
+BOOL MD5::update(const BYTE *data, size_t dataLength)
+{
+	if (!_hHash || _failed)
+		return FALSE;
+
+	// CryptHashData takes a DWORD length, so hash large buffers in pieces
+	while (dataLength > 0)
+	{
+		DWORD chunkLength = dataLength > 0x40000000 ? 0x40000000 : static_cast<DWORD>(dataLength);
+		if (!CryptHashData(static_cast<HCRYPTHASH>(_hHash), data, chunkLength, 0))
+		{
+			_failed = TRUE;
+			return FALSE;
+		}
+		data += chunkLength;
+		dataLength -= chunkLength;
+	}
+
+	return TRUE;
+}
+
+BOOL MD5::final(TCHAR *hashBuffer, int hashBufferLength)
+{
+	BYTE rgbHash[MD5LEN];
+	DWORD cbHash = MD5LEN;
+
+	BOOL bResult = _hHash && !_failed
+		&& hashBufferLength >= ((MD5LEN * 2) + 1)
+		&& CryptGetHashParam(static_cast<HCRYPTHASH>(_hHash), HP_HASHVAL, rgbHash, &cbHash, 0);
+
+	if (bResult)
+	{
+		TCHAR *currentHashBuffer = hashBuffer;
+		for (DWORD i = 0; i < cbHash; i++)
+		{
+			_stprintf_s(currentHashBuffer, hashBufferLength - (i * 2), _T("%02x"), rgbHash[i]);
+			currentHashBuffer += 2;
+		}
+	}
+
+	release();
+	return bResult;
+}
+
+
 BOOL MD5::hash(const TCHAR *filename, TCHAR *hashBuffer, int hashBufferLength)
 {
-    DWORD dwStatus = 0;
-    BOOL bResult = FALSE;
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-    HANDLE hFile = NULL;
-    BYTE rgbFile[BUFSIZE];
-    DWORD cbRead = 0;
-    BYTE rgbHash[MD5LEN];
-    DWORD cbHash = 0;
-    
+	BYTE rgbFile[BUFSIZE];
+	DWORD cbRead = 0;
+
 	if (hashBufferLength < ((MD5LEN * 2) + 1))
 		return FALSE;
-    
-    hFile = CreateFile(filename,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_FLAG_SEQUENTIAL_SCAN,
-        NULL);
-
-    if (INVALID_HANDLE_VALUE == hFile)
-    {
-        return FALSE;
-    }
-
-    // Get handle to the crypto provider
-    if (!CryptAcquireContext(&hProv,
-        NULL,
-        NULL,
-        PROV_RSA_FULL,
-        CRYPT_VERIFYCONTEXT))
-    {
-        CloseHandle(hFile);
-        return FALSE;
-    }
-
-    if (!CryptCreateHash(hProv, CALG_MD5, 0, 0, &hHash))
-    {
-		CryptReleaseContext(hProv, 0);
-        CloseHandle(hFile);
-        return FALSE;
-    }
-
-	
-    do
-    {
-		bResult =  ReadFile(hFile, rgbFile, BUFSIZE, &cbRead, NULL);
-		if (!bResult || 0 == cbRead)
-			break;
-        
-
-        if (!CryptHashData(hHash, rgbFile, cbRead, 0))
-        {
-            return FALSE;
-        }
-	} while (bResult);
-	
-	if (bResult == FALSE)
+
+	HANDLE hFile = CreateFile(filename,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		NULL);
+
+	if (INVALID_HANDLE_VALUE == hFile)
 	{
-		CryptReleaseContext(hProv, 0);
-        CryptDestroyHash(hHash);
-        CloseHandle(hFile);
 		return FALSE;
 	}
 
-    
-    cbHash = MD5LEN;
-    if (CryptGetHashParam(hHash, HP_HASHVAL, rgbHash, &cbHash, 0))
-    {
-        TCHAR *currentHashBuffer = hashBuffer;
-        for (DWORD i = 0; i < cbHash; i++)
-        {
-            _stprintf_s(currentHashBuffer, hashBufferLength - (i * 2), _T("%02x"), rgbHash[i]);
-			currentHashBuffer += 2;
-        }
-        dwStatus = TRUE;
-    }
-    else
-    {
-        dwStatus = FALSE;
-    }
-
-    CryptDestroyHash(hHash);
-    CryptReleaseContext(hProv, 0);
-    CloseHandle(hFile);
-
-    return dwStatus; 
-}
\ No newline at end of file
+	MD5 md5;
+	BOOL bResult = md5.init();
+	while (bResult)
+	{
+		bResult = ReadFile(hFile, rgbFile, BUFSIZE, &cbRead, NULL);
+		if (!bResult || 0 == cbRead)
+			break;
+
+		bResult = md5.update(rgbFile, cbRead);
+	}
+
+	CloseHandle(hFile);
+
+	return bResult && md5.final(hashBuffer, hashBufferLength);
+}
+
+
+/* Hashes data that is already in memory (e.g. a mapped file) */
+BOOL MD5::hash(const BYTE *data, size_t dataLength, TCHAR *hashBuffer, int hashBufferLength)
+{
+	MD5 md5;
+	return md5.init()
+		&& md5.update(data, dataLength)
+		&& md5.final(hashBuffer, hashBufferLength);
+}
@@ -0,0 +1,198 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "CatalogCache.h"
+#include "PluginVersion.h"
+
+using namespace std;
+
+
+CatalogCacheWriter::CatalogCacheWriter()
+{
+	// Typical catalog compiles to a little under 1MB
+	_buffer.reserve(1024 * 1024);
+}
+
+void CatalogCacheWriter::writeUInt(UINT32 value)
+{
+	const BYTE* bytes = reinterpret_cast<const BYTE*>(&value);
+	_buffer.insert(_buffer.end(), bytes, bytes + sizeof(UINT32));
+}
+
+void CatalogCacheWriter::writeString(const tstring& str)
+{
+	writeUInt(static_cast<UINT32>(str.size()));
+	const BYTE* bytes = reinterpret_cast<const BYTE*>(str.c_str());
+	_buffer.insert(_buffer.end(), bytes, bytes + (str.size() * sizeof(TCHAR)));
+}
+
+void CatalogCacheWriter::writeString(const TCHAR* str)
+{
+	if (str)
+		writeString(tstring(str));
+	else
+		writeString(tstring());
+}
+
+void CatalogCacheWriter::writeVersion(const PluginVersion& version)
+{
+	writeUInt(static_cast<UINT32>(version.getMajor()));
+	writeUInt(static_cast<UINT32>(version.getMinor()));
+	writeUInt(static_cast<UINT32>(version.getRevision()));
+	writeUInt(static_cast<UINT32>(version.getBuild()));
+}
+
+BOOL CatalogCacheWriter::saveFile(const TCHAR* filename)
+{
+	tstring tempFilename(filename);
+	tempFilename.append(_T(".tmp"));
+
+	HANDLE hFile = ::CreateFile(tempFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return FALSE;
+
+	DWORD bytesWritten = 0;
+	BOOL writeSuccess = ::WriteFile(hFile, &_buffer[0], static_cast<DWORD>(_buffer.size()), &bytesWritten, NULL);
+	::CloseHandle(hFile);
+
+	if (!writeSuccess || bytesWritten != _buffer.size())
+	{
+		::DeleteFile(tempFilename.c_str());
+		return FALSE;
+	}
+
+	if (!::MoveFileEx(tempFilename.c_str(), filename, MOVEFILE_REPLACE_EXISTING))
+	{
+		::DeleteFile(tempFilename.c_str());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+
+CatalogCacheReader::CatalogCacheReader()
+	: _hFile(INVALID_HANDLE_VALUE),
+	  _hMapping(NULL),
+	  _view(NULL),
+	  _size(0),
+	  _position(0)
+{
+}
+
+CatalogCacheReader::~CatalogCacheReader()
+{
+	close();
+}
+
+BOOL CatalogCacheReader::open(const TCHAR* filename)
+{
+	close();
+
+	_hFile = ::CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == _hFile)
+		return FALSE;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(_hFile, &fileSize) || fileSize.QuadPart == 0 || fileSize.HighPart != 0)
+	{
+		close();
+		return FALSE;
+	}
+
+	_hMapping = ::CreateFileMapping(_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == _hMapping)
+	{
+		close();
+		return FALSE;
+	}
+
+	_view = reinterpret_cast<const BYTE*>(::MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (NULL == _view)
+	{
+		close();
+		return FALSE;
+	}
+
+	_size = static_cast<size_t>(fileSize.QuadPart);
+	_position = 0;
+	return TRUE;
+}
+
+void CatalogCacheReader::close()
+{
+	if (_view)
+	{
+		::UnmapViewOfFile(_view);
+		_view = NULL;
+	}
+
+	if (_hMapping)
+	{
+		::CloseHandle(_hMapping);
+		_hMapping = NULL;
+	}
+
+	if (INVALID_HANDLE_VALUE != _hFile)
+	{
+		::CloseHandle(_hFile);
+		_hFile = INVALID_HANDLE_VALUE;
+	}
+
+	_size = 0;
+	_position = 0;
+}
+
+BOOL CatalogCacheReader::readUInt(UINT32& value)
+{
+	if (_size - _position < sizeof(UINT32))
+		return FALSE;
+
+	memcpy(&value, _view + _position, sizeof(UINT32));
+	_position += sizeof(UINT32);
+	return TRUE;
+}
+
+BOOL CatalogCacheReader::readString(tstring& str)
+{
+	UINT32 length;
+	if (!readUInt(length))
+		return FALSE;
+
+	// Checked before multiplying, so a damaged length can't wrap round on 32 bit
+	if (length > (_size - _position) / sizeof(TCHAR))
+		return FALSE;
+
+	str.assign(reinterpret_cast<const TCHAR*>(_view + _position), length);
+	_position += static_cast<size_t>(length) * sizeof(TCHAR);
+	return TRUE;
+}
+
+BOOL CatalogCacheReader::readVersion(PluginVersion& version)
+{
+	UINT32 major, minor, revision, build;
+	if (!readUInt(major) || !readUInt(minor) || !readUInt(revision) || !readUInt(build))
+		return FALSE;
+
+	version = PluginVersion(major, minor, revision, build);
+	return TRUE;
+}
@@ -0,0 +1,87 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _CATALOGCACHE_H
+#define _CATALOGCACHE_H
+
+#include <vector>
+
+class PluginVersion;
+
+/* The catalog cache is a compiled binary snapshot of PluginManagerPlugins.xml,
+ * written next to the XML in the config directory.  The header records the MD5 of
+ * the XML it was built from, so it is only used whilst that hash still matches.
+ *
+ * All values are stored in native byte order - the file is never shared between machines.
+ */
+#define CATALOGCACHE_MAGIC     0x43434D50      // "PMCC"
+#define CATALOGCACHE_VERSION   2
+
+/* Header flags - the cache only holds the steps for the N++ it was built for */
+#define CATALOGCACHE_UNICODE   0x0001
+#define CATALOGCACHE_X64       0x0002
+
+/* Plugin entry flags */
+#define CATALOGCACHE_ENTRY_AVAILABLE  0x0001
+#define CATALOGCACHE_ENTRY_LIBRARY    0x0002
+
+class CatalogCacheWriter
+{
+public:
+	CatalogCacheWriter();
+
+	void writeUInt(UINT32 value);
+	void writeString(const tstring& str);
+	void writeString(const TCHAR* str);
+	void writeVersion(const PluginVersion& version);
+
+	/* Writes the buffer to a temporary file, then moves it over filename, so that a
+	 * reader never sees a half written cache */
+	BOOL saveFile(const TCHAR* filename);
+
+private:
+	std::vector<BYTE> _buffer;
+};
+
+
+class CatalogCacheReader
+{
+public:
+	CatalogCacheReader();
+	~CatalogCacheReader();
+
+	/* Maps the whole file into memory with a single view */
+	BOOL open(const TCHAR* filename);
+	void close();
+
+	BOOL readUInt(UINT32& value);
+	BOOL readString(tstring& str);
+	BOOL readVersion(PluginVersion& version);
+
+	BOOL atEnd() const { return _position == _size; }
+
+private:
+	HANDLE      _hFile;
+	HANDLE      _hMapping;
+	const BYTE* _view;
+	size_t      _size;
+	size_t      _position;
+};
+
+#endif
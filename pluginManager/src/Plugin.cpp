@@ -22,19 +22,37 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "PluginVersion.h"
 #include "libinstall/VariableHandler.h"
 #include "libinstall/ModuleInfo.h"
+#include "libinstall/InstallStepFactory.h"
+#include "CatalogCache.h"
+#include "StringPool.h"
 
 #include "tinyxml/tinyxml.h"
 
 using namespace std;
 
 
-Plugin::Plugin(void)
-: _isInstalled(FALSE),
+Plugin::Plugin(StringPool* stringPool)
+: _stringPool(stringPool),
+  _isInstalled(FALSE),
   _detailsAdded(FALSE),
   _updateDetailsAdded(FALSE),
   _installedForAllUsers(FALSE),
-  _isLibrary(FALSE)
-{
+  _isLibrary(FALSE),
+  _installStepCount(0),
+  _removeStepCount(0),
+  _installStepsBuilt(FALSE),
+  _removeStepsBuilt(FALSE)
+{
+	const tstring* empty = _stringPool->intern(_T(""));
+	_name = empty;
+	_description = empty;
+	_filename = empty;
+	_author = empty;
+	_category = empty;
+	_homepage = empty;
+	_sourceUrl = empty;
+	_latestUpdate = empty;
+	_stability = empty;
 }
 
 Plugin::~Plugin(void)
@@ -47,38 +65,39 @@ Plugin::~Plugin(void)
 
 void Plugin::setDescription(const TCHAR* description)
 {
-	_description = description;
-	replaceNewlines(_description);
+	tstring str(description);
+	replaceNewlines(str);
+	_description = _stringPool->intern(str);
 }
 
 void Plugin::setFilename(const TCHAR* filename)
 {
-	_filename = filename;;
+	_filename = _stringPool->intern(filename);
 }
 
 void Plugin::setFilename(const tstring& filename)
 {
-	_filename = filename;
+	_filename = _stringPool->intern(filename);
 }
 
 void Plugin::setName(const TCHAR* name)
 {
-	_name = name;
+	_name = _stringPool->intern(name);
 }
 
 void Plugin::setName(const tstring& name)
 {
-	_name = name;
+	_name = _stringPool->intern(name);
 }
 
 void Plugin::setAuthor(const TCHAR* author)
 {
-	_author = author;
+	_author = _stringPool->intern(author);
 }
 
 void Plugin::setCategory(const TCHAR* category)
 {
-	_category = category;
+	_category = _stringPool->intern(category);
 }
 
 void Plugin::setVersion(const PluginVersion &version)
@@ -88,23 +107,24 @@ void Plugin::setVersion(const PluginVersion &version)
 
 void Plugin::setHomepage(const TCHAR* homepage)
 {
-	_homepage = homepage;
+	_homepage = _stringPool->intern(homepage);
 }
 
 void Plugin::setSourceUrl(const TCHAR* sourceUrl)
 {
-	_sourceUrl = sourceUrl;
+	_sourceUrl = _stringPool->intern(sourceUrl);
 }
 
 void Plugin::setLatestUpdate(const TCHAR* latestUpdate)
 {
-	_latestUpdate = latestUpdate;
-	replaceNewlines(_latestUpdate);
+	tstring str(latestUpdate);
+	replaceNewlines(str);
+	_latestUpdate = _stringPool->intern(str);
 }
 
 void Plugin::setStability(const TCHAR* stability)
 {
-	_stability = stability;
+	_stability = _stringPool->intern(stability);
 }
 
 
@@ -136,42 +156,44 @@ void Plugin::setInstalledForAllUsers(BOOL installedForAllUsers)
 
 /* Getters */
 
-tstring& Plugin::getDescription()
+const tstring& Plugin::getDescription()
 {
 	if (!_detailsAdded)
 	{
-		if (_stability != _T("Good"))
+		_fullDescription = *_description;
+
+		if (*_stability != _T("Good"))
 		{
-			_description.append(_T("\r\nStability: "));
-			_description.append(_stability);
+			_fullDescription.append(_T("\r\nStability: "));
+			_fullDescription.append(*_stability);
 		}
 
-		if (!_author.empty())
+		if (!_author->empty())
 		{
-			_description.append(_T("\r\nAuthor: "));
-			_description.append(_author);
+			_fullDescription.append(_T("\r\nAuthor: "));
+			_fullDescription.append(*_author);
 		}
-		if (!_sourceUrl.empty())
+		if (!_sourceUrl->empty())
 		{
-			_description.append(_T("\r\nSource: "));
-			_description.append(_sourceUrl);
+			_fullDescription.append(_T("\r\nSource: "));
+			_fullDescription.append(*_sourceUrl);
 		}
-		if (!_homepage.empty())
+		if (!_homepage->empty())
 		{
-			_description.append(_T("\r\nHomepage: "));
-			_description.append(_homepage);
+			_fullDescription.append(_T("\r\nHomepage: "));
+			_fullDescription.append(*_homepage);
 		}
 
-		if (!_latestUpdate.empty())
+		if (!_latestUpdate->empty())
 		{
-			_description.append(_T("\r\nLatest update: "));
-			_description.append(_latestUpdate);
+			_fullDescription.append(_T("\r\nLatest update: "));
+			_fullDescription.append(*_latestUpdate);
 		}
 
 		_detailsAdded = TRUE;
 	}
 
-	return _description;
+	return _fullDescription;
 }
 
 tstring& Plugin::getUpdateDescription()
@@ -188,25 +210,25 @@ tstring& Plugin::getUpdateDescription()
 			_updateDescription.append(_T("\r\n"));
 		}
 
-		if (!_latestUpdate.empty())
+		if (!_latestUpdate->empty())
 		{
 			
 			_updateDescription.append(_T("Latest update: "));
-			_updateDescription.append(_latestUpdate);
+			_updateDescription.append(*_latestUpdate);
 			_updateDescription.append(_T("\r\n"));
 		}
 
-		if (_stability != _T("Good"))
+		if (*_stability != _T("Good"))
 		{
 			_updateDescription.append(_T("Stability: "));
-			_updateDescription.append(_stability);
+			_updateDescription.append(*_stability);
 			_updateDescription.append(_T("\r\n"));
 		}
 
 		// If there's nothing, just add the description
 		if (_updateDescription.empty())
 		{
-			_updateDescription.append(_description);
+			_updateDescription.append(*_description);
 		}
 
 		_updateDetailsAdded = true;
@@ -215,14 +237,14 @@ tstring& Plugin::getUpdateDescription()
 	return _updateDescription;
 }
 
-tstring& Plugin::getFilename()
+const tstring& Plugin::getFilename()
 {
-	return _filename;
+	return *_filename;
 }
 
-tstring& Plugin::getName()
+const tstring& Plugin::getName()
 {
-	return _name;
+	return *_name;
 }
 
 
@@ -239,24 +261,24 @@ PluginVersion& Plugin::getInstalledVersion()
 }
 
 	
-tstring& Plugin::getAuthor()
+const tstring& Plugin::getAuthor()
 {
-	return _author;
+	return *_author;
 }
 
-tstring& Plugin::getCategory()
+const tstring& Plugin::getCategory()
 {
-	return _category;
+	return *_category;
 }
 
-tstring& Plugin::getStability()
+const tstring& Plugin::getStability()
 {
-	return _stability;
+	return *_stability;
 }
 
-tstring& Plugin::getLatestUpdate()
+const tstring& Plugin::getLatestUpdate()
 {
-	return _latestUpdate;
+	return *_latestUpdate;
 }
 
 BOOL Plugin::getInstalledForAllUsers()
@@ -281,27 +303,38 @@ void Plugin::addBadVersion(const PluginVersion &version, const TCHAR* report)
 }
 
 
-void Plugin::addInstallStep(std::shared_ptr<InstallStep> step)
+size_t Plugin::getInstallStepCount()
 {
-	_installSteps.push_back(step);
+	return _installStepCount;
 }
 
-void Plugin::addRemoveStep(std::shared_ptr<InstallStep> step)
+size_t Plugin::getRemoveStepCount()
 {
-	_removeSteps.push_back(step);
+	// Add 1 for removal of plugin dll file
+	return _removeStepCount + 1;
 }
 
 
-
-size_t Plugin::getInstallStepCount()
+/* Builds the steps from their sources.  Elements that don't create a step (e.g. setVariable)
+ * still go through the factory, in order, so the variables are set before the later steps
+ * are created.
+ */
+void Plugin::buildSteps(const list<tstring>& sources, InstallStepContainer& steps, VariableHandler* variableHandler)
 {
-	return _installSteps.size();
-}
+	InstallStepFactory installStepFactory(variableHandler);
+	TiXmlDocument stepDocument;
 
-size_t Plugin::getRemoveStepCount()
-{
-	// Add 1 for removal of plugin dll file
-	return _removeSteps.size() + 1;
+	for (list<tstring>::const_iterator it = sources.begin(); it != sources.end(); ++it)
+	{
+		stepDocument.Clear();
+		stepDocument.Parse(it->c_str());
+		if (stepDocument.RootElement())
+		{
+			std::shared_ptr<InstallStep> installStep = installStepFactory.create(stepDocument.RootElement());
+			if (installStep.get())
+				steps.push_back(installStep);
+		}
+	}
 }
 
 
@@ -313,12 +346,41 @@ InstallStatus Plugin::install(tstring& basePath, TiXmlElement* forGpup,
 									  VariableHandler* variableHandler,
                                       CancelToken& cancelToken)
 {
-	
+	if (!_installStepsBuilt)
+	{
+		buildSteps(_installStepSources, _installSteps, variableHandler);
+		_installStepsBuilt = TRUE;
+	}
 
 	return runSteps(_installSteps, basePath, forGpup, setStatus, stepProgress, stepComplete, moduleInfo, variableHandler, cancelToken);
 }
 
 
+void Plugin::setDownloadPrefetcher(DownloadPrefetcher* prefetcher, VariableHandler* variableHandler)
+{
+	if (!_installStepsBuilt)
+	{
+		buildSteps(_installStepSources, _installSteps, variableHandler);
+		_installStepsBuilt = TRUE;
+	}
+
+	for (InstallStepContainer::iterator it = _installSteps.begin(); it != _installSteps.end(); ++it)
+		(*it)->setDownloadPrefetcher(prefetcher);
+}
+
+void Plugin::setValidationBatch(ValidationBatch* validationBatch, VariableHandler* variableHandler)
+{
+	if (!_installStepsBuilt)
+	{
+		buildSteps(_installStepSources, _installSteps, variableHandler);
+		_installStepsBuilt = TRUE;
+	}
+
+	for (InstallStepContainer::iterator it = _installSteps.begin(); it != _installSteps.end(); ++it)
+		(*it)->setValidationBatch(validationBatch);
+}
+
+
 InstallStatus Plugin::remove(tstring& basePath, TiXmlElement* forGpup, 
 									  std::function<void(const TCHAR*)> setStatus,
 									  std::function<void(const int)> stepProgress,
@@ -350,6 +412,12 @@ InstallStatus Plugin::remove(tstring& basePath, TiXmlElement* forGpup,
 	deleteElement->SetAttribute(_T("file"), fullFilename.c_str());
 
 	forGpup->LinkEndChild(deleteElement);	
+
+	if (!_removeStepsBuilt)
+	{
+		buildSteps(_removeStepSources, _removeSteps, variableHandler);
+		_removeStepsBuilt = TRUE;
+	}
 	
 	runSteps(_removeSteps, basePath, forGpup, setStatus, stepProgress, stepComplete, moduleInfo, variableHandler, cancelToken);
 
@@ -421,6 +489,151 @@ const list<tstring>& Plugin::getDependencies()
 	return _dependencies;
 }
 
+void Plugin::addInstallStepSource(const tstring& source, BOOL isStep)
+{
+	_installStepSources.push_back(source);
+	if (isStep)
+		++_installStepCount;
+}
+
+void Plugin::addRemoveStepSource(const tstring& source, BOOL isStep)
+{
+	_removeStepSources.push_back(source);
+	if (isStep)
+		++_removeStepCount;
+}
+
+const list<tstring>& Plugin::getInstallStepSources()
+{
+	return _installStepSources;
+}
+
+const list<tstring>& Plugin::getRemoveStepSources()
+{
+	return _removeStepSources;
+}
+
+
+static void writeStringList(CatalogCacheWriter& writer, const list<tstring>& strings)
+{
+	writer.writeUInt(static_cast<UINT32>(strings.size()));
+	for (list<tstring>::const_iterator it = strings.begin(); it != strings.end(); ++it)
+		writer.writeString(*it);
+}
+
+static BOOL readStringList(CatalogCacheReader& reader, list<tstring>& strings)
+{
+	UINT32 count;
+	if (!reader.readUInt(count))
+		return FALSE;
+
+	for (UINT32 index = 0; index < count; ++index)
+	{
+		tstring str;
+		if (!reader.readString(str))
+			return FALSE;
+		strings.push_back(str);
+	}
+	return TRUE;
+}
+
+/* Writes the fields that come from the plugin list */
+void Plugin::writeTo(CatalogCacheWriter& writer)
+{
+	writer.writeString(*_name);
+	writer.writeVersion(_version);
+	writer.writeString(*_description);
+	writer.writeString(*_filename);
+	writer.writeString(*_author);
+	writer.writeString(*_category);
+	writer.writeString(*_homepage);
+	writer.writeString(*_sourceUrl);
+	writer.writeString(*_latestUpdate);
+	writer.writeString(*_stability);
+	writer.writeUInt(_isLibrary ? 1 : 0);
+
+	writeStringList(writer, _dependencies);
+
+	writer.writeUInt(static_cast<UINT32>(_versionMap.size()));
+	for (map<tstring, PluginVersion>::iterator it = _versionMap.begin(); it != _versionMap.end(); ++it)
+	{
+		writer.writeString(it->first);
+		writer.writeVersion(it->second);
+	}
+
+	writer.writeUInt(static_cast<UINT32>(_badVersionMap.size()));
+	for (map<PluginVersion, tstring>::iterator it = _badVersionMap.begin(); it != _badVersionMap.end(); ++it)
+	{
+		writer.writeVersion(it->first);
+		writer.writeString(it->second);
+	}
+
+	writer.writeUInt(_installStepCount);
+	writeStringList(writer, _installStepSources);
+	writer.writeUInt(_removeStepCount);
+	writeStringList(writer, _removeStepSources);
+}
+
+BOOL Plugin::readFrom(CatalogCacheReader& reader)
+{
+	UINT32 isLibrary;
+	if (!readPooledString(reader, _name)
+		|| !reader.readVersion(_version)
+		|| !readPooledString(reader, _description)
+		|| !readPooledString(reader, _filename)
+		|| !readPooledString(reader, _author)
+		|| !readPooledString(reader, _category)
+		|| !readPooledString(reader, _homepage)
+		|| !readPooledString(reader, _sourceUrl)
+		|| !readPooledString(reader, _latestUpdate)
+		|| !readPooledString(reader, _stability)
+		|| !reader.readUInt(isLibrary))
+		return FALSE;
+
+	_isLibrary = isLibrary ? TRUE : FALSE;
+
+	if (!readStringList(reader, _dependencies))
+		return FALSE;
+
+	UINT32 count;
+	if (!reader.readUInt(count))
+		return FALSE;
+	for (UINT32 index = 0; index < count; ++index)
+	{
+		tstring hash;
+		PluginVersion version;
+		if (!reader.readString(hash) || !reader.readVersion(version))
+			return FALSE;
+		_versionMap[hash] = version;
+	}
+
+	if (!reader.readUInt(count))
+		return FALSE;
+	for (UINT32 index = 0; index < count; ++index)
+	{
+		PluginVersion version;
+		tstring report;
+		if (!reader.readVersion(version) || !reader.readString(report))
+			return FALSE;
+		_badVersionMap[version] = report;
+	}
+
+	return reader.readUInt(_installStepCount)
+		&& readStringList(reader, _installStepSources)
+		&& reader.readUInt(_removeStepCount)
+		&& readStringList(reader, _removeStepSources);
+}
+
+BOOL Plugin::readPooledString(CatalogCacheReader& reader, const tstring*& str)
+{
+	tstring value;
+	if (!reader.readString(value))
+		return FALSE;
+
+	str = _stringPool->intern(value);
+	return TRUE;
+}
+
 void Plugin::replaceNewlines(tstring &str)
 {
 	tstring::size_type pos = 0;
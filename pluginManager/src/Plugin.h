@@ -26,6 +26,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 class VariableHandler;
 class ModuleInfo;
+class CatalogCacheWriter;
+class CatalogCacheReader;
+class StringPool;
 
 enum InstallStatus {
         INSTALL_SUCCESS,
@@ -36,7 +39,8 @@ enum InstallStatus {
 class Plugin
 {
 public:
-    Plugin(void);
+    /* The metadata strings are held in stringPool, which must outlive the plugin */
+    Plugin(StringPool* stringPool);
     ~Plugin(void);
 
     
@@ -59,15 +63,15 @@ public:
     void    setInstalledForAllUsers(BOOL installedForAllUsers);
     void    setIsLibrary(BOOL isLibrary) { _isLibrary = isLibrary; }
     /* Getters */
-    tstring&		getName();
+    const tstring&	getName();
     PluginVersion&	getVersion();
-    tstring&		getDescription();
-    tstring&		getFilename();
+    const tstring&	getDescription();
+    const tstring&	getFilename();
     PluginVersion&	getInstalledVersion();
-    tstring&		getAuthor();
-    tstring&		getCategory();
-    tstring&		getLatestUpdate();
-    tstring&		getStability();
+    const tstring&	getAuthor();
+    const tstring&	getCategory();
+    const tstring&	getLatestUpdate();
+    const tstring&	getStability();
     tstring&        getUpdateDescription();
     BOOL			getInstalledForAllUsers();
     BOOL            getIsLibrary() { return _isLibrary; }
@@ -80,7 +84,6 @@ public:
     void			addBadVersion(const PluginVersion &version, const TCHAR* report);
 
     /* installation */
-    void			addInstallStep(std::shared_ptr<InstallStep> step);
     size_t				getInstallStepCount();
     InstallStatus   install(tstring& basePath, TiXmlElement* forGpup, 
         std::function<void(const TCHAR*)> setStatus,
@@ -90,9 +93,16 @@ public:
         VariableHandler* variableHandler,
         CancelToken& cancelToken);
 
+    /* Queues the downloads of the install steps with prefetcher (building the steps
+     * if need be), or with NULL, stops the steps using it */
+    void                setDownloadPrefetcher(DownloadPrefetcher* prefetcher, VariableHandler* variableHandler);
+
+    /* Shares validationBatch between the install steps (and those of the other plugins in the
+     * install), or with NULL, stops them using it */
+    void                setValidationBatch(ValidationBatch* validationBatch, VariableHandler* variableHandler);
+
     /* removal */
     size_t getRemoveStepCount();
-    void addRemoveStep(std::shared_ptr<InstallStep> step);
     InstallStatus remove(tstring& basePath, TiXmlElement* forGpup, 
                                       std::function<void(const TCHAR*)> setStatus,
                                       std::function<void(const int)> stepProgress,
@@ -106,20 +116,37 @@ public:
     BOOL				hasDependencies();
     const std::list<tstring>& getDependencies();
 
+    /* Step sources - the XML of each install / remove step.  The steps are only built
+     * from the sources when the plugin is installed or removed.  isStep says whether the
+     * element creates a step (e.g. setVariable does not), so the steps can be counted
+     * before they are built */
+    void				addInstallStepSource(const tstring& source, BOOL isStep);
+    void				addRemoveStepSource(const tstring& source, BOOL isStep);
+    const std::list<tstring>& getInstallStepSources();
+    const std::list<tstring>& getRemoveStepSources();
+
+    /* catalog cache */
+    void				writeTo(CatalogCacheWriter& writer);
+    BOOL				readFrom(CatalogCacheReader& reader);
+
 private:
-    tstring					_name;
-    tstring					_unicodeUrl;
-    tstring					_ansiUrl;
+    StringPool*				_stringPool;
+
+    /* Pooled strings, shared with the other plugins in the list */
+    const tstring*			_name;
     PluginVersion			_version;      
-    tstring					_description;
-    tstring					_filename;
+    const tstring*			_description;
+    const tstring*			_filename;
     PluginVersion			_installedVersion;
-    tstring					_author;
-    tstring					_category;
-    tstring					_homepage;
-    tstring					_sourceUrl;
-    tstring					_latestUpdate;
-    tstring					_stability;
+    const tstring*			_author;
+    const tstring*			_category;
+    const tstring*			_homepage;
+    const tstring*			_sourceUrl;
+    const tstring*			_latestUpdate;
+    const tstring*			_stability;
+
+    /* Built when first displayed */
+    tstring					_fullDescription;
     tstring					_updateDescription;
     
     BOOL					_isInstalled;
@@ -139,8 +166,17 @@ private:
     InstallStepContainer	_installSteps;
     InstallStepContainer	_removeSteps;
 
+    std::list<tstring>		_installStepSources;
+    std::list<tstring>		_removeStepSources;
+    UINT32					_installStepCount;
+    UINT32					_removeStepCount;
+    BOOL					_installStepsBuilt;
+    BOOL					_removeStepsBuilt;
+
     /* Private methods */
     void replaceNewlines(tstring &str);
+    BOOL readPooledString(CatalogCacheReader& reader, const tstring*& str);
+    void buildSteps(const std::list<tstring>& sources, InstallStepContainer& steps, VariableHandler* variableHandler);
     
     /* Step Runner for install/remove */
     InstallStatus runSteps(InstallStepContainer steps, tstring& basePath, TiXmlElement* forGpup, 
@@ -0,0 +1,156 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "PluginIndex.h"
+#include "StringPool.h"
+
+using namespace std;
+
+#define PLUGININDEX_MIN_CAPACITY   16
+
+
+PluginIndex::PluginIndex()
+	: _mask(0),
+	  _entryCount(0)
+{
+}
+
+void PluginIndex::build(const PluginContainer& plugins,
+						const PluginContainer& libraries,
+						const map<tstring, tstring>& aliases,
+						const map<tstring, tstring>& realNames,
+						StringPool& stringPool)
+{
+	clear();
+
+	// Size the table so it is never more than half full, even if no keys are shared
+	size_t keyCount = plugins.size() + libraries.size() + aliases.size() + realNames.size();
+	size_t capacity = PLUGININDEX_MIN_CAPACITY;
+	while (capacity < keyCount * 2)
+		capacity *= 2;
+
+	PluginIndexEntry empty;
+	memset(&empty, 0, sizeof(empty));
+	_entries.assign(capacity, empty);
+	_mask = capacity - 1;
+
+	for (PluginContainer::const_iterator it = plugins.begin(); it != plugins.end(); ++it)
+		insert(INDEXKEY_NAME, it->first, stringPool)->plugin = it->second;
+
+	for (PluginContainer::const_iterator it = libraries.begin(); it != libraries.end(); ++it)
+		insert(INDEXKEY_NAME, it->first, stringPool)->library = it->second;
+
+	// Aliases and real names only ever resolve to available plugins, as before
+	for (map<tstring, tstring>::const_iterator it = aliases.begin(); it != aliases.end(); ++it)
+	{
+		Plugin* plugin = findIn(plugins, it->second);
+		if (plugin)
+			insert(INDEXKEY_NAME, it->first, stringPool)->aliasOf = plugin;
+	}
+
+	for (map<tstring, tstring>::const_iterator it = realNames.begin(); it != realNames.end(); ++it)
+	{
+		Plugin* plugin = findIn(plugins, it->second);
+		if (plugin)
+			insert(INDEXKEY_HASH, it->first, stringPool)->plugin = plugin;
+	}
+}
+
+void PluginIndex::clear()
+{
+	_entries.clear();
+	_mask = 0;
+	_entryCount = 0;
+}
+
+const PluginIndexEntry* PluginIndex::lookup(PluginIndexKeyType type, const tstring& key) const
+{
+	if (_entries.empty())
+		return NULL;
+
+	UINT32 hash = hashKey(type, key);
+	size_t slot = hash & _mask;
+
+	// The table always has empty slots, so this finishes
+	while (_entries[slot].key)
+	{
+		const PluginIndexEntry& entry = _entries[slot];
+		if (entry.hash == hash && entry.type == type && *entry.key == key)
+			return &entry;
+
+		slot = (slot + 1) & _mask;
+	}
+
+	return NULL;
+}
+
+Plugin* PluginIndex::findPlugin(const tstring& name) const
+{
+	const PluginIndexEntry* entry = lookup(INDEXKEY_NAME, name);
+	if (!entry)
+		return NULL;
+
+	return entry->plugin ? entry->plugin : entry->library;
+}
+
+PluginIndexEntry* PluginIndex::insert(PluginIndexKeyType type, const tstring& key, StringPool& stringPool)
+{
+	UINT32 hash = hashKey(type, key);
+	size_t slot = hash & _mask;
+
+	while (_entries[slot].key)
+	{
+		PluginIndexEntry& entry = _entries[slot];
+		if (entry.hash == hash && entry.type == type && *entry.key == key)
+			return &entry;
+
+		slot = (slot + 1) & _mask;
+	}
+
+	PluginIndexEntry& entry = _entries[slot];
+	entry.key  = stringPool.intern(key);
+	entry.hash = hash;
+	entry.type = type;
+	++_entryCount;
+	return &entry;
+}
+
+/* FNV-1a over the characters of the key, seeded with the key type */
+UINT32 PluginIndex::hashKey(PluginIndexKeyType type, const tstring& key)
+{
+	UINT32 hash = 2166136261U ^ static_cast<UINT32>(type);
+	for (tstring::const_iterator it = key.begin(); it != key.end(); ++it)
+	{
+		hash ^= static_cast<UINT32>(*it);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+Plugin* PluginIndex::findIn(const PluginContainer& plugins, const tstring& name)
+{
+	PluginContainer::const_iterator it = plugins.find(name);
+	if (it == plugins.end())
+		return NULL;
+
+	return it->second;
+}
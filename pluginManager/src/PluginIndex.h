@@ -0,0 +1,86 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _PLUGININDEX_H
+#define _PLUGININDEX_H
+
+#include <vector>
+#include "PluginManager.h"
+
+class Plugin;
+class StringPool;
+
+enum PluginIndexKeyType
+{
+	INDEXKEY_NAME = 1,		// plugin name, or alias
+	INDEXKEY_HASH = 2		// MD5 of a plugin that reports a different name (_pluginRealNames)
+};
+
+/* One key of the index, with everything it resolves to */
+struct PluginIndexEntry
+{
+	const tstring*		key;
+	UINT32				hash;
+	PluginIndexKeyType	type;
+
+	Plugin*				plugin;		// available plugin with this name / hash
+	Plugin*				library;	// library with this name
+	Plugin*				aliasOf;	// available plugin this name is an alias of
+};
+
+/* Hash index of the plugin list, resolving a name, alias or MD5 with a single probe.
+ *
+ * The index is built once the list has been parsed, and is not changed until the list is
+ * cleared.  Lookups never modify it, so it can be read from several threads at once.
+ * It uses open addressing with linear probing, and is kept at most half full.
+ */
+class PluginIndex
+{
+public:
+	PluginIndex();
+
+	/* Builds the index from the parsed list.  The keys are held in stringPool */
+	void build(const PluginContainer& plugins,
+			   const PluginContainer& libraries,
+			   const std::map<tstring, tstring>& aliases,
+			   const std::map<tstring, tstring>& realNames,
+			   StringPool& stringPool);
+
+	void clear();
+
+	/* Returns the entry for the key, or NULL if the key is not in the list */
+	const PluginIndexEntry* lookup(PluginIndexKeyType type, const tstring& key) const;
+
+	/* Returns the available plugin with this name, or the library if there is none */
+	Plugin* findPlugin(const tstring& name) const;
+
+	size_t getEntryCount() const { return _entryCount; }
+
+private:
+	PluginIndexEntry* insert(PluginIndexKeyType type, const tstring& key, StringPool& stringPool);
+
+	static UINT32 hashKey(PluginIndexKeyType type, const tstring& key);
+	static Plugin* findIn(const PluginContainer& plugins, const tstring& name);
+
+	std::vector<PluginIndexEntry>	_entries;
+	size_t							_mask;
+	size_t							_entryCount;
+};
+
+#endif
@@ -30,15 +30,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "libinstall/DownloadManager.h"
 #include "libinstall/Decompress.h"
 #include "libinstall/DirectoryUtil.h"
+#include "libinstall/CatalogPatcher.h"
+#include "libinstall/FileFingerprint.h"
+#include "libinstall/ProbePool.h"
+#include "libinstall/DirectoryWatcher.h"
+#include "libinstall/DownloadPrefetcher.h"
+#include "libinstall/Validate.h"
 #include "Utility.h"
 #include "WcharMbcsConverter.h"
+#include "CatalogCache.h"
 
 
 
 using namespace std;
 using namespace std::placeholders;
 
-typedef BOOL (__cdecl * PFUNCISUNICODE)();
+/* Plugins are probed for their names in gpupprobe.exe processes - see ProbePool */
+#define PROBE_MAX_WORKERS		4
+#define PROBE_TIMEOUT			5000	// ms for a single dll
+#define PROBE_BATCH_SIZE		8
 
 
 PluginList::PluginList(void)
@@ -95,7 +105,7 @@ void PluginList::init(NppData *nppData)
 	_variableHandler = new VariableHandler();
 	_variableHandler->setVariable(_T("NPPDIR"), nppDir);
 	_variableHandler->setVariable(_T("ALLUSERSPLUGINDIR"), allUsersPluginDir);
-	_variableHandler->setVariable(VALIDATE_BASE_URL_VAR, getValidateUrl());
+	_variableHandler->setVariable(VALIDATE_BASE_URL_VAR, getMirrors(getValidateUrl()).toString());
 
 	ITEMIDLIST *pidl;
 	HRESULT result = SHGetSpecialFolderLocation(NULL, CSIDL_APPDATA, &pidl);
@@ -150,238 +160,611 @@ void PluginList::addPluginNames(TiXmlElement* pluginNamesElement)
 
 BOOL PluginList::parsePluginFile(CONST TCHAR *filename)
 {
+	// ParseThreads=1 (the default) keeps the streaming parse, 0 uses a thread per processor
+	int threadCount = g_options.parseThreads;
+	if (threadCount <= 0)
+	{
+		SYSTEM_INFO systemInfo;
+		::GetSystemInfo(&systemInfo);
+		threadCount = static_cast<int>(systemInfo.dwNumberOfProcessors);
+	}
+
+	if (threadCount > 1)
+		return parsePluginFileParallel(filename, threadCount);
+
 	clearPluginList();
 
-	TiXmlDocument doc(filename);
+	// The list is read one child of <plugins> at a time, so only a single
+	// plugin element is held in memory, rather than the whole document
+	TiXmlStreamReader reader;
 
-	doc.LoadFile();
-	if (doc.Error())
+	if (reader.Open(filename) && !_tcscmp(reader.RootValue(), _T("plugins")))
 	{
+		TiXmlElement *pluginNode;
+		while ((pluginNode = reader.NextChild()) != NULL)
+		{
+			parsePluginElement(pluginNode);
+		}
+	}
+
+	if (reader.Error())
+	{
+		reportParseError(reader.ErrorDesc(), reader.ErrorRow(), reader.ErrorCol());
+
+		// Don't leave a partial list behind
+		clearPluginList();
+		return FALSE;
+	}
+
+	buildIndex();
+	return TRUE;
+}
+
+
+void PluginList::reportParseError(const TCHAR* errorDesc, int row, int col)
+{
 #ifdef ALLOW_OVERRIDE_XML_URL
-		tstring error = doc.ErrorDesc();
-		error += _T(" at row ");
-		TCHAR tmp[10];
-		tmp[0] = '\0';
-		if (!_itot_s(doc.ErrorRow(), tmp, 10, 10))
-			error += tmp;
+	tstring error = errorDesc;
+	error += _T(" at row ");
+	TCHAR tmp[10];
+	tmp[0] = '\0';
+	if (!_itot_s(row, tmp, 10, 10))
+		error += tmp;
 
-		error += _T(", col ");
+	error += _T(", col ");
 
-		if (!_itot_s(doc.ErrorCol(), tmp, 10, 10))
-			error += tmp;
+	if (!_itot_s(col, tmp, 10, 10))
+		error += tmp;
 
 
-		::MessageBox(_nppData->_nppHandle, error.c_str(), _T("Error parsing XML File"), 0);
+	::MessageBox(_nppData->_nppHandle, error.c_str(), _T("Error parsing XML File"), 0);
+#else
+	UNREFERENCED_PARAMETER(errorDesc);
+	UNREFERENCED_PARAMETER(row);
+	UNREFERENCED_PARAMETER(col);
 #endif
+}
+
+
+/* A child of <plugins> parsed by a worker thread, waiting to be merged into the list */
+struct ParsedPluginElement
+{
+	TiXmlDocument* document;
+	Plugin*        plugin;
+	BOOL           available;
+};
+
+struct ParseWorkerParam
+{
+	PluginList*                        pluginList;
+	const vector<tstring>*             sources;
+	vector<ParsedPluginElement>*       results;
+	size_t                             begin;
+	size_t                             end;
+};
+
+
+BOOL PluginList::parsePluginFileParallel(CONST TCHAR *filename, int threadCount)
+{
+	clearPluginList();
+
+	// Reading the file is sequential, so the reader only splits it into the
+	// source of each child of <plugins>, which is cheap compared to parsing it
+	TiXmlStreamReader reader;
+	vector<tstring> sources;
+	vector<int> sourceRows;
+	size_t totalLength = 0;
+
+	if (reader.Open(filename) && !_tcscmp(reader.RootValue(), _T("plugins")))
+	{
+		tstring source;
+		while (reader.NextChildSource(&source))
+		{
+			totalLength += source.size();
+			sourceRows.push_back(reader.ChildRow());
+			sources.push_back(tstring());
+			sources.back().swap(source);
+		}
+	}
+
+	if (reader.Error())
+	{
+		reportParseError(reader.ErrorDesc(), reader.ErrorRow(), reader.ErrorCol());
+		return FALSE;
+	}
+
+	if (threadCount > MAXIMUM_WAIT_OBJECTS)
+		threadCount = MAXIMUM_WAIT_OBJECTS;
+
+	if (static_cast<size_t>(threadCount) > sources.size())
+		threadCount = static_cast<int>(sources.size());
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	vector<ParsedPluginElement> results(sources.size());
+	vector<ParseWorkerParam> params(threadCount);
+
+	// Split the children into contiguous ranges holding roughly the same number of
+	// characters, as the plugin elements vary a lot in size
+	size_t begin = 0;
+	size_t assignedLength = 0;
+	for (int thread = 0; thread < threadCount; ++thread)
+	{
+		size_t target = (totalLength * (thread + 1)) / threadCount;
+		size_t end = begin;
+		while (end < sources.size() && (thread == threadCount - 1 || assignedLength < target))
+		{
+			assignedLength += sources[end].size();
+			++end;
+		}
+
+		params[thread].pluginList = this;
+		params[thread].sources    = &sources;
+		params[thread].results    = &results;
+		params[thread].begin      = begin;
+		params[thread].end        = end;
+		begin = end;
+	}
+
+	// The first range is parsed on this thread
+	vector<HANDLE> threads;
+	for (int thread = 1; thread < threadCount; ++thread)
+	{
+		HANDLE hThread = ::CreateThread(0, 0, (LPTHREAD_START_ROUTINE)PluginList::parseWorkerThreadProc,
+			(LPVOID)&params[thread], 0, 0);
+
+		if (hThread)
+			threads.push_back(hThread);
+		else
+			parseWorkerThreadProc(&params[thread]);
+	}
+
+	parseWorkerThreadProc(&params[0]);
+
+	if (!threads.empty())
+	{
+		::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
+		for (vector<HANDLE>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+			::CloseHandle(*iter);
+	}
+
+	// Merge in document order, so later entries replace earlier ones exactly as they
+	// do when parsing sequentially.  The steps are created here rather than on the
+	// workers, as setVariable elements update the shared variable handler.
+	BOOL success = TRUE;
+	for (size_t index = 0; index < results.size(); ++index)
+	{
+		ParsedPluginElement& result = results[index];
+
+		if (success && result.document->Error())
+		{
+			reportParseError(result.document->ErrorDesc(),
+							 sourceRows[index] + result.document->ErrorRow(),
+							 result.document->ErrorCol());
+			success = FALSE;
+		}
+
+		if (success)
+		{
+			TiXmlElement* pluginNode = result.document->RootElement();
+			if (result.plugin)
+				addPlugin(result.plugin, result.available, pluginNode);
+			else if (pluginNode && !_tcscmp(pluginNode->Value(), _T("pluginNames")))
+				addPluginNames(pluginNode);
+		}
+		else if (result.plugin)
+		{
+			delete result.plugin;
+		}
+
+		delete result.document;
+	}
+
+	if (!success)
+	{
+		clearPluginList();
 		return FALSE;
 	}
 
-	TiXmlNode *pluginsDoc = doc.FirstChildElement(_T("plugins"));
-	if (pluginsDoc)
+	buildIndex();
+	return TRUE;
+}
+
+
+UINT PluginList::parseWorkerThreadProc(LPVOID param)
+{
+	ParseWorkerParam *pp = reinterpret_cast<ParseWorkerParam*>(param);
+
+	for (size_t index = pp->begin; index < pp->end; ++index)
+	{
+		ParsedPluginElement& result = (*pp->results)[index];
+		result.document  = new TiXmlDocument();
+		result.plugin    = NULL;
+		result.available = FALSE;
+
+		result.document->Parse((*pp->sources)[index].c_str(), 0);
+
+		TiXmlElement* pluginNode = result.document->RootElement();
+		if (!result.document->Error() && pluginNode && !_tcscmp(pluginNode->Value(), _T("plugin")))
+			result.plugin = pp->pluginList->createPlugin(pluginNode, result.available);
+	}
+
+	return 0;
+}
+
+
+void PluginList::parsePluginElement(TiXmlElement* pluginNode)
+{
+	if (!_tcscmp(pluginNode->Value(), _T("pluginNames")))
+	{
+		addPluginNames(pluginNode);
+	}
+	else if (!_tcscmp(pluginNode->Value(), _T("plugin")))
 	{
-		TiXmlElement *pluginNode = pluginsDoc->FirstChildElement();
-		Plugin *plugin;
+		BOOL available;
+		Plugin* plugin = createPlugin(pluginNode, available);
+		addPlugin(plugin, available, pluginNode);
+	}
+}
+
+
+/* Creates the plugin from the element, without touching the list itself,
+ * so this can be called from several threads at once
+ */
+Plugin* PluginList::createPlugin(TiXmlElement* pluginNode, BOOL& available)
+{
+	Plugin* plugin = new Plugin(&_stringPool);
 
-		while(pluginNode)
+	plugin->setName(pluginNode->Attribute(_T("name")));
+
+	available = FALSE;
+
+	if (g_isUnicode)
+	{
+		if (g_isX64)
 		{
-			if (!_tcscmp(pluginNode->Value(), _T("pluginNames")))
+			TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("x64Version"));
+			if (versionUrlElement && versionUrlElement->FirstChild())
 			{
-				addPluginNames(pluginNode);
+				plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
+				available = TRUE;
 			}
-			else if (!_tcscmp(pluginNode->Value(), _T("plugin")))
+		}
+		else
+		{
+			TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("unicodeVersion"));
+			if (versionUrlElement && versionUrlElement->FirstChild())
 			{
-				plugin = new Plugin();
+				plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
+				available = TRUE;
+			}
+		}
+	}
+	else
+	{
+		TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("ansiVersion"));
+		if (versionUrlElement && versionUrlElement->FirstChild())
+		{
+			plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
+			available = TRUE;
+		}
 
-				plugin->setName(pluginNode->Attribute(_T("name")));
+	}
 
-				BOOL available = FALSE;
+	/* Notepad++ Version checks */
+	TiXmlElement *minVersionElement = pluginNode->FirstChildElement(_T("minNotepadVersion"));
+	if (minVersionElement && minVersionElement->FirstChild())
+	{
+		if (_nppVersion < PluginVersion(minVersionElement->FirstChild()->Value()))
+			available = FALSE;
+	}
 
-				if (g_isUnicode)
-				{
-					if (g_isX64)
-					{
-						TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("x64Version"));
-						if (versionUrlElement && versionUrlElement->FirstChild())
-						{
-							plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
-							available = TRUE;
-						}
-					}
-					else
-					{
-						TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("unicodeVersion"));
-						if (versionUrlElement && versionUrlElement->FirstChild())
-						{
-							plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
-							available = TRUE;
-						}
-					}
-				}
-				else
-				{
-					TiXmlElement *versionUrlElement = pluginNode->FirstChildElement(_T("ansiVersion"));
-					if (versionUrlElement && versionUrlElement->FirstChild())
-					{
-						plugin->setVersion(PluginVersion(versionUrlElement->FirstChild()->Value()));
-						available = TRUE;
-					}
 
-				}
+	TiXmlElement *maxVersionElement = pluginNode->FirstChildElement(_T("maxNotepadVersion"));
+	if (maxVersionElement && maxVersionElement->FirstChild())
+	{
+		if (_nppVersion > PluginVersion(maxVersionElement->FirstChild()->Value()))
+			available = FALSE;
+	}
 
-				/* Notepad++ Version checks */
-				TiXmlElement *minVersionElement = pluginNode->FirstChildElement(_T("minNotepadVersion"));
-				if (minVersionElement && minVersionElement->FirstChild())
-				{
-					if (_nppVersion < PluginVersion(minVersionElement->FirstChild()->Value()))
-						available = FALSE;
-				}
+	/* Plugin attributes - description, author etc */
+	TiXmlElement *descriptionUrlElement = pluginNode->FirstChildElement(_T("description"));
+	if (descriptionUrlElement && descriptionUrlElement->FirstChild())
+		plugin->setDescription(descriptionUrlElement->FirstChild()->Value());
 
+	TiXmlElement *filenameUrlElement = pluginNode->FirstChildElement(_T("filename"));
+	if (filenameUrlElement && filenameUrlElement->FirstChild())
+		plugin->setFilename(filenameUrlElement->FirstChild()->Value());
 
-				TiXmlElement *maxVersionElement = pluginNode->FirstChildElement(_T("maxNotepadVersion"));
-				if (maxVersionElement && maxVersionElement->FirstChild())
-				{
-					if (_nppVersion > PluginVersion(maxVersionElement->FirstChild()->Value()))
-						available = FALSE;
-				}
+	TiXmlElement *versionsUrlElement = pluginNode->FirstChildElement(_T("versions"));
 
-				/* Plugin attributes - description, author etc */
-				TiXmlElement *descriptionUrlElement = pluginNode->FirstChildElement(_T("description"));
-				if (descriptionUrlElement && descriptionUrlElement->FirstChild())
-					plugin->setDescription(descriptionUrlElement->FirstChild()->Value());
+	if (versionsUrlElement)
+	{
+		TiXmlElement *versionUrlElement = versionsUrlElement->FirstChildElement(_T("version"));
+		while(versionUrlElement)
+		{
+			plugin->addVersion(versionUrlElement->Attribute(_T("md5")), PluginVersion(versionUrlElement->Attribute(_T("number"))));
+			versionUrlElement = (TiXmlElement *)versionsUrlElement->IterateChildren(versionUrlElement);
+		}
+	}
 
-				TiXmlElement *filenameUrlElement = pluginNode->FirstChildElement(_T("filename"));
-				if (filenameUrlElement && filenameUrlElement->FirstChild())
-					plugin->setFilename(filenameUrlElement->FirstChild()->Value());
+	TiXmlElement *badVersionsElement = pluginNode->FirstChildElement(_T("badVersions"));
 
-				TiXmlElement *versionsUrlElement = pluginNode->FirstChildElement(_T("versions"));
+	if (badVersionsElement)
+	{
+		TiXmlElement *versionElement = badVersionsElement->FirstChildElement(_T("version"));
+		while(versionElement)
+		{
+			plugin->addBadVersion(PluginVersion(versionElement->Attribute(_T("number"))), versionElement->Attribute(_T("report")));
+			versionElement = (TiXmlElement *)badVersionsElement->IterateChildren(versionElement);
+		}
+	}
 
-				if (versionsUrlElement)
-				{
-					TiXmlElement *versionUrlElement = versionsUrlElement->FirstChildElement(_T("version"));
-					while(versionUrlElement)
-					{
-						plugin->addVersion(versionUrlElement->Attribute(_T("md5")), PluginVersion(versionUrlElement->Attribute(_T("number"))));
-						versionUrlElement = (TiXmlElement *)versionsUrlElement->IterateChildren(versionUrlElement);
-					}
-				}
 
-				TiXmlElement *badVersionsElement = pluginNode->FirstChildElement(_T("badVersions"));
 
-				if (badVersionsElement)
-				{
-					TiXmlElement *versionElement = badVersionsElement->FirstChildElement(_T("version"));
-					while(versionElement)
-					{
-						plugin->addBadVersion(PluginVersion(versionElement->Attribute(_T("number"))), versionElement->Attribute(_T("report")));
-						versionElement = (TiXmlElement *)badVersionsElement->IterateChildren(versionElement);
-					}
-				}
+	TiXmlElement *dependencies = pluginNode->FirstChildElement(_T("dependencies"));
+	if (dependencies && !dependencies->NoChildren())
+	{
+		TiXmlElement *dependency = dependencies->FirstChildElement();
+		while (dependency)
+		{
+			// If dependency is another plugin (currently the only supported dependency)
+			if (!_tcscmp(dependency->Value(), _T("plugin")))
+			{
+				const TCHAR* dependencyName = dependency->Attribute(_T("name"));
+				if (dependencyName)
+					plugin->addDependency(dependencyName);
+			}
 
+			dependency = reinterpret_cast<TiXmlElement*>(dependencies->IterateChildren(dependency));
+		}
+	}
 
 
-				TiXmlElement *aliasesElement = pluginNode->FirstChildElement(_T("aliases"));
+	TiXmlElement *authorElement = pluginNode->FirstChildElement(_T("author"));
+	if (authorElement && authorElement->FirstChild())
+		plugin->setAuthor(authorElement->FirstChild()->Value());
 
-				if (aliasesElement)
-				{
-					TiXmlElement *aliasElement = aliasesElement->FirstChildElement(_T("alias"));
-					while(aliasElement)
-					{
-						_aliases[tstring(aliasElement->Attribute(_T("name")))] = plugin->getName();
-						aliasElement = (TiXmlElement *)aliasesElement->IterateChildren(aliasElement);
-					}
-				}
+	TiXmlElement *sourceElement = pluginNode->FirstChildElement(_T("sourceUrl"));
+	if (sourceElement && sourceElement->FirstChild())
+		plugin->setSourceUrl(sourceElement->FirstChild()->Value());
 
-				/* Installation / Removal */
-				TiXmlElement *installElement = pluginNode->FirstChildElement(_T("install"));
 
-				addSteps(plugin, installElement, INSTALL);
+	TiXmlElement *homepageElement = pluginNode->FirstChildElement(_T("homepage"));
+	if (homepageElement && homepageElement->FirstChild())
+		plugin->setHomepage(homepageElement->FirstChild()->Value());
 
-				TiXmlElement *removeElement = pluginNode->FirstChildElement(_T("remove"));
 
-				if (NULL != removeElement)
-				{
-					addSteps(plugin, removeElement, REMOVE);
-				}
+	TiXmlElement *categoryElement = pluginNode->FirstChildElement(_T("category"));
+	if (categoryElement && categoryElement->FirstChild())
+		plugin->setCategory(categoryElement->FirstChild()->Value());
+	else
+		plugin->setCategory(_T("Others"));
 
+	TiXmlElement *latestUpdateElement = pluginNode->FirstChildElement(_T("latestUpdate"));
+	if (latestUpdateElement && latestUpdateElement->FirstChild())
+		plugin->setLatestUpdate(latestUpdateElement->FirstChild()->Value());
 
+	// Check stability, default to "Good"
+	TiXmlElement *stabilityElement = pluginNode->FirstChildElement(_T("stability"));
+	if (stabilityElement && stabilityElement->FirstChild())
+		plugin->setStability(stabilityElement->FirstChild()->Value());
+	else
+		plugin->setStability(_T("Good"));
 
-				TiXmlElement *dependencies = pluginNode->FirstChildElement(_T("dependencies"));
-				if (dependencies && !dependencies->NoChildren())
-				{
-					TiXmlElement *dependency = dependencies->FirstChildElement();
-					while (dependency)
-					{
-						// If dependency is another plugin (currently the only supported dependency)
-						if (!_tcscmp(dependency->Value(), _T("plugin")))
-						{
-							const TCHAR* dependencyName = dependency->Attribute(_T("name"));
-							if (dependencyName)
-								plugin->addDependency(dependencyName);
-						}
+	TiXmlElement *isLibraryElement = pluginNode->FirstChildElement(_T("isLibrary"));
+	if (isLibraryElement && isLibraryElement->FirstChild())
+	{
+		tstring isLibrary(isLibraryElement->FirstChild()->Value());
+		if (isLibrary == _T("true"))
+			plugin->setIsLibrary(true);
+	}
 
-						dependency = reinterpret_cast<TiXmlElement*>(dependencies->IterateChildren(dependency));
-					}
-				}
+	return plugin;
+}
 
 
-				TiXmlElement *authorElement = pluginNode->FirstChildElement(_T("author"));
-				if (authorElement && authorElement->FirstChild())
-					plugin->setAuthor(authorElement->FirstChild()->Value());
+/* Adds a plugin created by createPlugin to the list, along with its aliases and
+ * install / remove steps.  Elements must be added in document order, as later
+ * entries replace earlier ones with the same name.
+ */
+void PluginList::addPlugin(Plugin* plugin, BOOL available, TiXmlElement* pluginNode)
+{
+	TiXmlElement *aliasesElement = pluginNode->FirstChildElement(_T("aliases"));
 
-				TiXmlElement *sourceElement = pluginNode->FirstChildElement(_T("sourceUrl"));
-				if (sourceElement && sourceElement->FirstChild())
-					plugin->setSourceUrl(sourceElement->FirstChild()->Value());
+	if (aliasesElement)
+	{
+		TiXmlElement *aliasElement = aliasesElement->FirstChildElement(_T("alias"));
+		while(aliasElement)
+		{
+			_aliases[tstring(aliasElement->Attribute(_T("name")))] = plugin->getName();
+			aliasElement = (TiXmlElement *)aliasesElement->IterateChildren(aliasElement);
+		}
+	}
 
+	/* Installation / Removal */
+	TiXmlElement *installElement = pluginNode->FirstChildElement(_T("install"));
 
-				TiXmlElement *homepageElement = pluginNode->FirstChildElement(_T("homepage"));
-				if (homepageElement && homepageElement->FirstChild())
-					plugin->setHomepage(homepageElement->FirstChild()->Value());
+	addSteps(plugin, installElement, INSTALL);
 
+	TiXmlElement *removeElement = pluginNode->FirstChildElement(_T("remove"));
 
-				TiXmlElement *categoryElement = pluginNode->FirstChildElement(_T("category"));
-				if (categoryElement && categoryElement->FirstChild())
-					plugin->setCategory(categoryElement->FirstChild()->Value());
-				else
-					plugin->setCategory(_T("Others"));
+	if (NULL != removeElement)
+	{
+		addSteps(plugin, removeElement, REMOVE);
+	}
 
-				TiXmlElement *latestUpdateElement = pluginNode->FirstChildElement(_T("latestUpdate"));
-				if (latestUpdateElement && latestUpdateElement->FirstChild())
-					plugin->setLatestUpdate(latestUpdateElement->FirstChild()->Value());
+	if (plugin->getIsLibrary())
+		_libraries[plugin->getName()] = plugin;
 
-				// Check stability, default to "Good"
-				TiXmlElement *stabilityElement = pluginNode->FirstChildElement(_T("stability"));
-				if (stabilityElement && stabilityElement->FirstChild())
-					plugin->setStability(stabilityElement->FirstChild()->Value());
-				else
-					plugin->setStability(_T("Good"));
+	if (available)
+		_plugins[plugin->getName()] = plugin;
+	else if (!plugin->getIsLibrary())
+		delete plugin;
+}
 
 
-				TiXmlElement *isLibraryElement = pluginNode->FirstChildElement(_T("isLibrary"));
-				if (isLibraryElement && isLibraryElement->FirstChild())
-				{
-					tstring isLibrary(isLibraryElement->FirstChild()->Value());
-					if (isLibrary == _T("true"))
-					{
-						_libraries[plugin->getName()] = plugin;
-						plugin->setIsLibrary(true);
-					}
-				}
 
+UINT32 PluginList::getCatalogCacheFlags()
+{
+	UINT32 flags = 0;
+	if (g_isUnicode)
+		flags |= CATALOGCACHE_UNICODE;
+	if (g_isX64)
+		flags |= CATALOGCACHE_X64;
+	return flags;
+}
 
 
+BOOL PluginList::saveCatalogCache(const TCHAR* filename, const tstring& xmlHash)
+{
+	CatalogCacheWriter writer;
+
+	writer.writeUInt(CATALOGCACHE_MAGIC);
+	writer.writeUInt(CATALOGCACHE_VERSION);
+	writer.writeUInt(sizeof(TCHAR));
+	writer.writeUInt(getCatalogCacheFlags());
+	writer.writeVersion(_nppVersion);
+	writer.writeString(xmlHash);
+
+	// Libraries that are also available are written once, with both flags set
+	list< pair<UINT32, Plugin*> > entries;
+	for (PluginContainer::iterator it = _plugins.begin(); it != _plugins.end(); ++it)
+	{
+		UINT32 entryFlags = CATALOGCACHE_ENTRY_AVAILABLE;
+		PluginContainer::iterator library = _libraries.find(it->first);
+		if (library != _libraries.end() && library->second == it->second)
+			entryFlags |= CATALOGCACHE_ENTRY_LIBRARY;
+
+		entries.push_back(pair<UINT32, Plugin*>(entryFlags, it->second));
+	}
 
-				if (available)
-					_plugins[plugin->getName()] = plugin;
+	for (PluginContainer::iterator it = _libraries.begin(); it != _libraries.end(); ++it)
+	{
+		PluginContainer::iterator available = _plugins.find(it->first);
+		if (available == _plugins.end() || available->second != it->second)
+			entries.push_back(pair<UINT32, Plugin*>(CATALOGCACHE_ENTRY_LIBRARY, it->second));
+	}
 
-			}
+	writer.writeUInt(static_cast<UINT32>(entries.size()));
+	for (list< pair<UINT32, Plugin*> >::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		writer.writeUInt(it->first);
+		it->second->writeTo(writer);
+	}
 
-			pluginNode = (TiXmlElement *)pluginsDoc->IterateChildren(pluginNode);
+	writer.writeUInt(static_cast<UINT32>(_aliases.size()));
+	for (map<tstring, tstring>::iterator it = _aliases.begin(); it != _aliases.end(); ++it)
+	{
+		writer.writeString(it->first);
+		writer.writeString(it->second);
+	}
+
+	writer.writeUInt(static_cast<UINT32>(_pluginRealNames.size()));
+	for (map<tstring, tstring>::iterator it = _pluginRealNames.begin(); it != _pluginRealNames.end(); ++it)
+	{
+		writer.writeString(it->first);
+		writer.writeString(it->second);
+	}
+
+	return writer.saveFile(filename);
+}
+
+
+BOOL PluginList::loadCatalogCache(const TCHAR* filename, const tstring& xmlHash)
+{
+	clearPluginList();
+
+	CatalogCacheReader reader;
+	if (!reader.open(filename))
+		return FALSE;
+
+	UINT32 magic, version, charSize, flags;
+	PluginVersion nppVersion;
+	tstring hash;
+
+	if (!reader.readUInt(magic) || magic != CATALOGCACHE_MAGIC
+		|| !reader.readUInt(version) || version != CATALOGCACHE_VERSION
+		|| !reader.readUInt(charSize) || charSize != sizeof(TCHAR)
+		|| !reader.readUInt(flags) || flags != getCatalogCacheFlags()
+		|| !reader.readVersion(nppVersion) || nppVersion != _nppVersion
+		|| !reader.readString(hash) || hash != xmlHash)
+	{
+		return FALSE;
+	}
+
+	UINT32 count;
+	BOOL success = reader.readUInt(count);
+
+	for (UINT32 index = 0; success && index < count; ++index)
+	{
+		UINT32 entryFlags;
+		Plugin* plugin = new Plugin(&_stringPool);
+		if (!reader.readUInt(entryFlags) || !plugin->readFrom(reader))
+		{
+			delete plugin;
+			success = FALSE;
+			break;
 		}
+
+		if (entryFlags & CATALOGCACHE_ENTRY_AVAILABLE)
+			_plugins[plugin->getName()] = plugin;
+
+		if (entryFlags & CATALOGCACHE_ENTRY_LIBRARY)
+			_libraries[plugin->getName()] = plugin;
+	}
+
+	success = success && reader.readUInt(count);
+	for (UINT32 index = 0; success && index < count; ++index)
+	{
+		tstring alias, name;
+		success = reader.readString(alias) && reader.readString(name);
+		if (success)
+			_aliases[alias] = name;
+	}
+
+	success = success && reader.readUInt(count);
+	for (UINT32 index = 0; success && index < count; ++index)
+	{
+		tstring pluginHash, realName;
+		success = reader.readString(pluginHash) && reader.readString(realName);
+		if (success)
+			_pluginRealNames[pluginHash] = realName;
+	}
+
+	if (!success || !reader.atEnd())
+	{
+		clearPluginList();
+		return FALSE;
 	}
+
+	buildIndex();
 	return TRUE;
 }
 
 
+/* Builds the lookup index once the lists are complete.  The lists are not changed
+ * again until they are cleared, so the index stays valid until then. */
+void PluginList::buildIndex()
+{
+	_index.build(_plugins, _libraries, _aliases, _pluginRealNames, _stringPool);
+}
+
+
+BOOL PluginList::parsePluginFile(const TCHAR* filename, const TCHAR* cacheFilename, const tstring& xmlHash)
+{
+	if (loadCatalogCache(cacheFilename, xmlHash))
+		return TRUE;
+
+	if (!parsePluginFile(filename))
+		return FALSE;
+
+	// Failing to write the cache just means the XML gets parsed again next time
+	saveCatalogCache(cacheFilename, xmlHash);
+	return TRUE;
+}
+
 
 void PluginList::addSteps(Plugin* plugin, TiXmlElement* installElement, InstallOrRemove ior)
 {
@@ -390,8 +773,6 @@ void PluginList::addSteps(Plugin* plugin, TiXmlElement* installElement, InstallO
 
 	TiXmlElement *installStepElement = installElement->FirstChildElement();
 
-	InstallStepFactory installStepFactory(_variableHandler);
-
 	while (installStepElement)
 	{
 		// If it is a unicode tag and build for x64, then only process the contents if it's a x64 N++, which is just available for unicode
@@ -414,14 +795,16 @@ void PluginList::addSteps(Plugin* plugin, TiXmlElement* installElement, InstallO
 		else
 		{
 
-			std::shared_ptr<InstallStep> installStep = installStepFactory.create(installStepElement);
-			if (installStep.get())
-			{
-				if (INSTALL == ior)
-					plugin->addInstallStep(installStep);
-				else if (REMOVE == ior)
-					plugin->addRemoveStep(installStep);
-			}
+			// Keep the source of every element, including those that don't create a step
+			// (e.g. setVariable).  The steps are only built if the plugin is installed or removed.
+			tstring stepSource;
+			stepSource << *installStepElement;
+			BOOL isStep = InstallStepFactory::createsStep(installStepElement);
+
+			if (INSTALL == ior)
+				plugin->addInstallStepSource(stepSource, isStep);
+			else if (REMOVE == ior)
+				plugin->addRemoveStepSource(stepSource, isStep);
 
 		}
 
@@ -433,325 +816,387 @@ void PluginList::addSteps(Plugin* plugin, TiXmlElement* installElement, InstallO
 
 BOOL PluginList::checkInstalledPlugins()
 {
-	const tstring& nppDirectory = _variableHandler->getVariable(_T("ALLUSERSPLUGINDIR"));
 	_installedPlugins.clear();
 	_availablePlugins.clear();
 	_updateablePlugins.clear();
-	// Check in the default location
-	checkInstalledPlugins(nppDirectory.c_str(), TRUE);
+
+	// The all users plugins come first, as a user's own plugin replaces the all users one
+	vector<tstring> directoryPaths;
+	directoryPaths.push_back(_variableHandler->getVariable(_T("ALLUSERSPLUGINDIR")));
 
 	if (g_options.appDataPluginsSupported)
 	{
 		const tstring& appDataPluginDir = _variableHandler->getVariable(_T("USERPLUGINDIR"));
 
+		// Create it, so that it can be watched for plugins being added
 		if (!::PathFileExists(appDataPluginDir.c_str()))
 		{
 			DirectoryUtil::createDirectories(appDataPluginDir.c_str());
 		}
-		else
-		{
-			// No point checking what's installed if we've just created the directory!
-			checkInstalledPlugins(appDataPluginDir.c_str(), FALSE);
-		}
-	}
-	addAvailablePlugins();
-	return TRUE;
-}
-
 
-BOOL PluginList::checkInstalledPlugins(const TCHAR *pluginPath, BOOL allUsers)
-{
-	tstring pluginsFullPathFilter(pluginPath);
+		directoryPaths.push_back(appDataPluginDir);
+	}
 
-	pluginsFullPathFilter += _T("\\*.dll");
-
-	WIN32_FIND_DATA foundData;
-	HANDLE hFindFile = ::FindFirstFile(pluginsFullPathFilter.c_str(), &foundData);
+	// Find out what has changed since the last refresh.  A directory is read in full on the
+	// first refresh, or if its watcher couldn't keep up.
+	vector< set<tstring> > changedFilenames(directoryPaths.size());
+	vector<BOOL> fullScans(directoryPaths.size(), FALSE);
+	BOOL anyChanges = FALSE;
+	BOOL allFullScans = TRUE;
 
+	for (size_t index = 0; index < directoryPaths.size(); ++index)
+	{
+		InstalledDirectory& directory = _installedDirectories[directoryPaths[index]];
+		directory.allUsers = (0 == index);
+
+		fullScans[index] = !directory.watcher || !directory.watcher->getChanges(changedFilenames[index], 0);
+		if (fullScans[index] || !changedFilenames[index].empty())
+			anyChanges = TRUE;
+		if (!fullScans[index])
+			allFullScans = FALSE;
+	}
 
-	if (hFindFile != INVALID_HANDLE_VALUE)
+	if (anyChanges)
 	{
-		do
+		// Unchanged dlls are matched using what was read from them last time
+		Win32FileSystem fileSystem;
+		FingerprintCache fingerprintCache(fileSystem);
+		tstring fingerprintCacheFilename(_variableHandler->getVariable(_T("CONFIGDIR")));
+		fingerprintCacheFilename.append(_T("\\PluginManagerInstalled.cache"));
+		fingerprintCache.load(fingerprintCacheFilename);
+
+		for (size_t index = 0; index < directoryPaths.size(); ++index)
 		{
-
-			tstring pluginFilename(pluginPath);
-			pluginFilename += _T("\\");
-			pluginFilename += foundData.cFileName;
-			BOOL pluginOK = false;
-			tstring pluginName;
-			try
+			InstalledDirectory& directory = _installedDirectories[directoryPaths[index]];
+			if (fullScans[index])
 			{
-				pluginName = getPluginName(pluginFilename);
-				pluginOK = true;
+				scanInstalledDirectory(directoryPaths[index], directory, fingerprintCache);
 			}
-			catch (...)
+			else if (!changedFilenames[index].empty())
 			{
-				pluginOK = false;
+				vector<tstring> changedDlls;
+				for (set<tstring>::const_iterator it = changedFilenames[index].begin(); it != changedFilenames[index].end(); ++it)
+				{
+					if (it->size() > 4 && 0 == _tcsicmp(it->c_str() + it->size() - 4, _T(".dll")))
+						changedDlls.push_back(*it);
+				}
+
+				readInstalledFiles(directoryPaths[index], changedDlls, fingerprintCache, directory.pluginFiles);
 			}
+		}
 
+		// Entries can only be known to be unused once every dll has been looked up
+		if (allFullScans)
+			fingerprintCache.removeUnused();
 
+		fingerprintCache.save(fingerprintCacheFilename);
+	}
 
-			if (pluginOK)
-			{
-				PluginContainer::iterator knownPlugin = _plugins.find(pluginName);
+	for (size_t index = 0; index < directoryPaths.size(); ++index)
+	{
+		const InstalledDirectory& directory = _installedDirectories[directoryPaths[index]];
+		for (map<tstring, InstalledPluginFile>::const_iterator it = directory.pluginFiles.begin(); it != directory.pluginFiles.end(); ++it)
+			classifyInstalledPlugin(it->second, directory.allUsers);
+	}
 
-				if (knownPlugin == _plugins.end())
-				{
-					// plugin name is not known, so see if we recognise the hash
-					// i.e. is it export plugin which renames itself
-					// (or some other plugin that does the same thing)
-					TCHAR hash[(MD5::HASH_LENGTH * 2) + 1];
-					if (MD5::hash(pluginFilename.c_str(), hash, (MD5::HASH_LENGTH * 2) + 1))
-					{
-						tstring hashString(hash);
-						map<tstring, tstring>::iterator realNameIter = _pluginRealNames.find(hashString);
-						if (realNameIter != _pluginRealNames.end())
-						{
-							knownPlugin = _plugins.find(realNameIter->second);
-						}
-					}
-				}
+	addAvailablePlugins();
+	return TRUE;
+}
 
-				// If still unknown, check the aliases
-				if (knownPlugin == _plugins.end())
-				{
-					map<tstring, tstring>::iterator aliasIter = _aliases.find(pluginName);
-					if (aliasIter != _aliases.end())
-					{
-						knownPlugin = _plugins.find(aliasIter->second);
-					}
-				}
 
-				// Check if plugin known now
-				if (knownPlugin != _plugins.end())
-				{
-					Plugin* plugin = knownPlugin->second;
+void PluginList::scanInstalledDirectory(const tstring& pluginPath, InstalledDirectory& directory, FingerprintCache& fingerprintCache)
+{
+	// Start watching before reading, so that nothing that changes during the scan is missed
+	directory.watcher.reset(new Win32DirectoryWatcher());
+	if (!directory.watcher->start(pluginPath))
+		directory.watcher.reset();
 
-					// If the plugin is already installed, then make a copy for the list
-					if (plugin->isInstalled())
-					{
-						plugin = new Plugin(*plugin);
-					}
+	directory.pluginFiles.clear();
 
+	tstring pluginsFullPathFilter(pluginPath);
+	pluginsFullPathFilter += _T("\\*.dll");
 
-					plugin->setFilename(foundData.cFileName);
+	vector<tstring> filenames;
+	WIN32_FIND_DATA foundData;
+	HANDLE hFindFile = ::FindFirstFile(pluginsFullPathFilter.c_str(), &foundData);
 
-					setInstalledVersion(pluginFilename, plugin);
+	if (hFindFile != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			filenames.push_back(foundData.cFileName);
+		} while(::FindNextFile(hFindFile, &foundData));
 
-					plugin->setInstalledForAllUsers(allUsers);
+		::FindClose(hFindFile);
+	}
 
-					TCHAR hashBuffer[(MD5LEN * 2) + 1];
+	readInstalledFiles(pluginPath, filenames, fingerprintCache, directory.pluginFiles);
+}
 
-					if (MD5::hash(pluginFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1))
-					{
-						tstring hash = hashBuffer;
-						plugin->setInstalledVersionFromHash(hash);
-					}
 
-					// If this is a user's plugin (in AppData), and there's already a version
-					// for all users, and AppData plugins are supported, then remove the
-					// allusers version of the plugin, as the appdata one will take precedence
-					if (g_options.appDataPluginsSupported && FALSE == allUsers)
-					{
-						list<Plugin*>::iterator it = _installedPlugins.begin();
-						while (it != _installedPlugins.end())
-						{
-							if (plugin->getName() == (*it)->getName()
-								&& (*it)->getInstalledForAllUsers())
-							{
-								it = _installedPlugins.erase(it);
-							}
-							else
-							{
-								++it;
-							}
-						}
+void PluginList::readInstalledFiles(const tstring& pluginPath, const vector<tstring>& filenames,
+									FingerprintCache& fingerprintCache, map<tstring, InstalledPluginFile>& pluginFiles)
+{
+	vector<tstring> foundFilenames;
+	vector<FileStat> fileStats;
+	vector<Fingerprint> fingerprints;
 
-						// Remove the plugin from updateable plugins too, as whether or not it can be
-						// updated depends on THIS version, not the all users version
-						it = _updateablePlugins.begin();
-						while (it != _updateablePlugins.end())
-						{
-							if (plugin->getName() == (*it)->getName()
-								&& (*it)->getInstalledForAllUsers())
-							{
-								it = _updateablePlugins.erase(it);
-							}
-							else
-							{
-								++it;
-							}
-						}
+	// The dlls that aren't in the cache are all probed together
+	vector<size_t> missIndexes;
+	vector<tstring> missFilenames;
 
-						// Also update the registered plugin version to the installed version
-						Plugin* registeredPlugin = getPlugin(plugin->getName());
-						if (registeredPlugin) {
-							registeredPlugin->setInstalledVersion(plugin->getInstalledVersion());
-						}
-					}
+	for (vector<tstring>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename)
+	{
+		tstring pluginFilename(pluginPath);
+		pluginFilename += _T("\\");
+		pluginFilename += *filename;
 
+		// A dll that has been removed or renamed is no longer installed
+		if (INVALID_FILE_ATTRIBUTES == ::GetFileAttributes(pluginFilename.c_str()))
+		{
+			pluginFiles.erase(*filename);
+			continue;
+		}
 
-					if (plugin->getInstalledVersion().getIsBad()
-						|| plugin->getVersion() > plugin->getInstalledVersion())
-						_updateablePlugins.push_back(plugin);
-					else
-						_installedPlugins.push_back(plugin);
-				}
-				else
-				{
-					// Plugin is still not known, so create an empty stub for it
-					Plugin* plugin = new Plugin();
-					plugin->setName(pluginName);
-					plugin->setFilename(foundData.cFileName);
-					setInstalledVersion(pluginFilename, plugin);
+		FileStat fileStat;
+		Fingerprint fingerprint;
+		if (!fingerprintCache.lookup(pluginFilename, fileStat, fingerprint))
+		{
+			missIndexes.push_back(foundFilenames.size());
+			missFilenames.push_back(pluginFilename);
+		}
 
-					plugin->setDescription(_T("Unknown plugin - please let us know about this plugin on the forums"));
+		foundFilenames.push_back(*filename);
+		fileStats.push_back(fileStat);
+		fingerprints.push_back(fingerprint);
+	}
 
-					_installedPlugins.push_back(plugin);
-				}
+	vector<BOOL> probeFailed(foundFilenames.size(), FALSE);
+	if (!missFilenames.empty())
+	{
+		vector<ProbeResult> probeResults;
+		probePlugins(missFilenames, probeResults);
 
-			}
+		for (size_t miss = 0; miss < missIndexes.size(); ++miss)
+		{
+			size_t index = missIndexes[miss];
 
-		} while(::FindNextFile(hFindFile, &foundData));
+			// The host couldn't load it, but Notepad++ may already have done
+			if (PROBE_FAILED == probeResults[miss].status)
+				probeResults[miss] = probeLoadedPlugin(missFilenames[miss]);
 
+			fingerprints[index] = readFingerprint(missFilenames[miss], probeResults[miss]);
 
-		FindClose(hFindFile);
+			// A probe that timed out or crashed is tried again next time
+			if (PROBE_FAILED != probeResults[miss].status)
+				fingerprintCache.add(missFilenames[miss], fileStats[index], fingerprints[index]);
+			else
+				probeFailed[index] = TRUE;
+		}
 	}
 
-
-	return TRUE;
-}
-
-void PluginList::addAvailablePlugins()
-{
-	PluginContainer::iterator iter = _plugins.begin();
-	while (iter != _plugins.end())
+	for (size_t index = 0; index < foundFilenames.size(); ++index)
 	{
-		if (!iter->second->isInstalled())
+		const Fingerprint& fingerprint = fingerprints[index];
+		if (!fingerprint.isPlugin)
 		{
-			if (g_options.showUnstable || iter->second->getStability() == _T("Good"))
-				_availablePlugins.push_back(iter->second);
+			// A failed probe says nothing about the dll, so a plugin already listed stays listed
+			if (!probeFailed[index])
+				pluginFiles.erase(foundFilenames[index]);
+			continue;
 		}
-		++iter;
+
+		InstalledPluginFile& pluginFile = pluginFiles[foundFilenames[index]];
+		pluginFile.filename = foundFilenames[index];
+		pluginFile.name = fingerprint.name;
+		pluginFile.hash = fingerprint.hash;
+		pluginFile.hasVersion = fingerprint.hasVersion;
+		pluginFile.version = PluginVersion((fingerprint.fileVersionMS & 0xFFFF0000) >> 16,
+										   fingerprint.fileVersionMS & 0x0000FFFF,
+										   (fingerprint.fileVersionLS & 0xFFFF0000) >> 16,
+										   fingerprint.fileVersionLS & 0x0000FFFF);
 	}
 }
 
-tstring PluginList::getPluginName(tstring pluginFilename)
+/* Asks the dlls for their plugin names, in gpupprobe.exe processes if possible.  Without
+ * gpupprobe.exe, the plugins are loaded here instead. */
+BOOL PluginList::probePlugins(const vector<tstring>& filenames, vector<ProbeResult>& results)
 {
-	HINSTANCE pluginInstance = ::LoadLibrary(pluginFilename.c_str());
-	if (pluginInstance)
+	tstring probeExe(_variableHandler->getVariable(_T("NPPDIR")));
+	probeExe.append(_T("\\updater\\gpupprobe.exe"));
+
+	if (::PathFileExists(probeExe.c_str()))
 	{
-		PFUNCISUNICODE pFuncIsUnicode = (PFUNCISUNICODE)GetProcAddress(pluginInstance, "isUnicode");
-		BOOL isUnicode;
-		if (!pFuncIsUnicode || !pFuncIsUnicode())
-			isUnicode = FALSE;
-		else
-			isUnicode = TRUE;
+		SYSTEM_INFO systemInfo;
+		::GetSystemInfo(&systemInfo);
+		size_t workerCount = min(static_cast<size_t>(systemInfo.dwNumberOfProcessors), static_cast<size_t>(PROBE_MAX_WORKERS));
+
+		ProcessProbeWorkerFactory workerFactory(probeExe);
+		ProbePool probePool(workerFactory, workerCount, PROBE_TIMEOUT, PROBE_BATCH_SIZE);
+		if (probePool.probe(filenames, results))
+			return TRUE;
+	}
 
-		PFUNCGETNAME pFuncGetName = (PFUNCGETNAME)GetProcAddress(pluginInstance, "getName");
-		if (pFuncGetName)
-		{
-			CONST TCHAR* pluginName = pFuncGetName();
-			if (pluginName)
-			{
-				tstring tpluginName = pluginName;
-				tstring::size_type ampPosition = tpluginName.find(_T("&"));
-				while(ampPosition != tstring::npos)
-				{
-					tpluginName.replace(ampPosition, 1, _T(""));
-					ampPosition = tpluginName.find(_T("&"));
-				}
+	Win32PluginLoader loader;
+	InProcessProbeWorkerFactory workerFactory(loader);
+	ProbePool probePool(workerFactory, 1, PROBE_TIMEOUT, filenames.size());
+	return probePool.probe(filenames, results);
+}
 
-				::FreeLibrary(pluginInstance);
+/* Asks a dll that Notepad++ has already loaded for its name.  Its DllMain has already run,
+ * so this is as safe here as in a probe host. */
+ProbeResult PluginList::probeLoadedPlugin(const tstring& filename)
+{
+	if (NULL == ::GetModuleHandle(filename.c_str()))
+		return ProbeResult();
 
-				return tpluginName;
-			}
-			else
-			{
-				::FreeLibrary(pluginInstance);
-				return _T("");
-			}
+	Win32PluginLoader loader;
+	return loader.probe(filename);
+}
 
-		}
-		else
-		{
-			::FreeLibrary(pluginInstance);
-			throw tstring(_T("Plugin name call not defined"));
-		}
-	}
-	else
+/* Reads the hash and version of the dll in one go, if the probe found it is a plugin */
+Fingerprint PluginList::readFingerprint(const tstring& pluginFilename, const ProbeResult& probeResult)
+{
+	Fingerprint fingerprint;
+	fingerprint.isPlugin = (PROBE_PLUGIN == probeResult.status);
+	fingerprint.name = probeResult.name;
+
+	FileFingerprint fileFingerprint;
+	if (fingerprint.isPlugin && fileFingerprint.read(pluginFilename.c_str()))
 	{
-		throw tstring(_T("Load library failed"));
+		fingerprint.hash = fileFingerprint.getHash();
+		fingerprint.hasVersion = fileFingerprint.hasVersion();
+		fingerprint.fileVersionMS = fileFingerprint.getFileVersionMS();
+		fingerprint.fileVersionLS = fileFingerprint.getFileVersionLS();
 	}
 
+	return fingerprint;
 }
 
-BOOL PluginList::setInstalledVersion(tstring pluginFilename, Plugin* plugin)
+void PluginList::classifyInstalledPlugin(const InstalledPluginFile& pluginFile, BOOL allUsers)
 {
-	DWORD handle;
-	DWORD bufferSize = ::GetFileVersionInfoSize(pluginFilename.c_str(), &handle);
+	// The name entry also holds the plugin the name is an alias of
+	const PluginIndexEntry* nameEntry = _index.lookup(INDEXKEY_NAME, pluginFile.name);
+	Plugin* knownPlugin = nameEntry ? nameEntry->plugin : NULL;
 
-	if (bufferSize <= 0)
-		return FALSE;
+	if (!knownPlugin && !pluginFile.hash.empty())
+	{
+		// plugin name is not known, so see if we recognise the hash
+		// i.e. is it export plugin which renames itself
+		// (or some other plugin that does the same thing)
+		const PluginIndexEntry* hashEntry = _index.lookup(INDEXKEY_HASH, pluginFile.hash);
+		if (hashEntry)
+		{
+			knownPlugin = hashEntry->plugin;
+		}
+	}
 
-	unsigned char* buffer = new unsigned char[bufferSize];
-	::GetFileVersionInfo(pluginFilename.c_str(), handle, bufferSize, buffer);
+	// If still unknown, check the aliases
+	if (!knownPlugin && nameEntry)
+	{
+		knownPlugin = nameEntry->aliasOf;
+	}
+
+	// Check if plugin known now
+	if (knownPlugin)
+	{
+		Plugin* plugin = knownPlugin;
 
-	/*struct LANGANDCODEPAGE {
-		WORD wLanguage;
-		WORD wCodePage;
-	} *lpTranslate;*/
+		// If the plugin is already installed, then make a copy for the list
+		if (plugin->isInstalled())
+		{
+			plugin = new Plugin(*plugin);
+		}
 
-	VS_FIXEDFILEINFO* lpFileInfo;
 
-	UINT cbFileInfo;
+		plugin->setFilename(pluginFile.filename);
 
-	VerQueryValue(buffer,
-              _T("\\"),
-              (LPVOID*)&lpFileInfo,
-              &cbFileInfo);
+		if (pluginFile.hasVersion)
+			plugin->setInstalledVersion(pluginFile.version);
 
-	if (cbFileInfo)
-	{
-		plugin->setInstalledVersion(PluginVersion((lpFileInfo->dwFileVersionMS & 0xFFFF0000) >> 16,
-												  lpFileInfo->dwFileVersionMS & 0x0000FFFF,
-												  (lpFileInfo->dwFileVersionLS & 0xFFFF0000) >> 16,
-												  lpFileInfo->dwFileVersionLS & 0x0000FFFF));
-		/*
-		HRESULT hr;
-		TCHAR subBlock[50];
-		hr = StringCchPrintf(subBlock, 50,
-				_T("\\StringFileInfo\\%04x%04x\\FileVersion"),
-				lpTranslate[0].wLanguage,
-				lpTranslate[0].wCodePage);
+		plugin->setInstalledForAllUsers(allUsers);
 
-		if (FAILED(hr))
+		if (!pluginFile.hash.empty())
 		{
-			return FALSE;
+			plugin->setInstalledVersionFromHash(pluginFile.hash);
 		}
-		else
+
+		// If this is a user's plugin (in AppData), and there's already a version
+		// for all users, and AppData plugins are supported, then remove the
+		// allusers version of the plugin, as the appdata one will take precedence
+		if (g_options.appDataPluginsSupported && FALSE == allUsers)
 		{
-			TCHAR *fileVersion;
-			UINT fileVersionLength;
-			if(::VerQueryValue(buffer, subBlock, reinterpret_cast<LPVOID *>(&fileVersion), &fileVersionLength))
+			list<Plugin*>::iterator it = _installedPlugins.begin();
+			while (it != _installedPlugins.end())
 			{
-				if (fileVersion)
-					plugin->setInstalledVersion(PluginVersion(fileVersion));
+				if (plugin->getName() == (*it)->getName()
+					&& (*it)->getInstalledForAllUsers())
+				{
+					it = _installedPlugins.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			// Remove the plugin from updateable plugins too, as whether or not it can be
+			// updated depends on THIS version, not the all users version
+			it = _updateablePlugins.begin();
+			while (it != _updateablePlugins.end())
+			{
+				if (plugin->getName() == (*it)->getName()
+					&& (*it)->getInstalledForAllUsers())
+				{
+					it = _updateablePlugins.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			// Also update the registered plugin version to the installed version
+			Plugin* registeredPlugin = getPlugin(plugin->getName());
+			if (registeredPlugin) {
+				registeredPlugin->setInstalledVersion(plugin->getInstalledVersion());
 			}
 		}
-		*/
 
+
+		if (plugin->getInstalledVersion().getIsBad()
+			|| plugin->getVersion() > plugin->getInstalledVersion())
+			_updateablePlugins.push_back(plugin);
+		else
+			_installedPlugins.push_back(plugin);
 	}
 	else
 	{
-		delete[] buffer;
-		return FALSE;
-	}
+		// Plugin is still not known, so create an empty stub for it
+		Plugin* plugin = new Plugin(&_stringPool);
+		plugin->setName(pluginFile.name);
+		plugin->setFilename(pluginFile.filename);
+		if (pluginFile.hasVersion)
+			plugin->setInstalledVersion(pluginFile.version);
 
-	delete[] buffer;
-	return TRUE;
+		plugin->setDescription(_T("Unknown plugin - please let us know about this plugin on the forums"));
 
+		_installedPlugins.push_back(plugin);
+	}
+}
 
+void PluginList::addAvailablePlugins()
+{
+	PluginContainer::iterator iter = _plugins.begin();
+	while (iter != _plugins.end())
+	{
+		if (!iter->second->isInstalled())
+		{
+			if (g_options.showUnstable || iter->second->getStability() == _T("Good"))
+				_availablePlugins.push_back(iter->second);
+		}
+		++iter;
+	}
 }
 
 void PluginList::waitForListsAvailable()
@@ -789,23 +1234,19 @@ VariableHandler* PluginList::getVariableHandler()
 	return _variableHandler;
 }
 
+StringPool& PluginList::getStringPool()
+{
+	return _stringPool;
+}
+
 Plugin* PluginList::getPlugin(tstring name)
 {
-	Plugin* plugin = _plugins[name];
-	if (NULL == plugin)
-	{
-		plugin = _libraries[name];
-	}
-	return plugin;
+	return _index.findPlugin(name);
 }
 
 BOOL PluginList::isInstallOrUpgrade(const tstring& name)
 {
-	Plugin* plugin = _plugins[name];
-	if (NULL == plugin)
-	{
-		plugin = _libraries[name];
-	}
+	Plugin* plugin = _index.findPlugin(name);
 
 	if (!plugin || (plugin->isInstalled() && plugin->getVersion() <= plugin->getInstalledVersion()))
 		return FALSE;
@@ -883,9 +1324,13 @@ void PluginList::downloadList()
 
 	tstring pluginsListFilename(pluginConfig);
 	tstring pluginsListZipFilename(pluginConfig);
+	tstring pluginsListCacheFilename(pluginConfig);
+	tstring pluginsListVersionFilename(pluginConfig);
 
 	pluginsListFilename.append(_T("\\PluginManagerPlugins.xml"));
 	pluginsListZipFilename.append(_T("\\PluginManagerPlugins.zip"));
+	pluginsListCacheFilename.append(_T("\\PluginManagerPlugins.cache"));
+	pluginsListVersionFilename.append(_T("\\PluginManagerPlugins.version"));
 
 
 	// Download the plugins.xml from the repository
@@ -893,6 +1338,7 @@ void PluginList::downloadList()
 	DownloadManager downloadManager(cancelToken);
 	tstring contentType;
 	TCHAR hashBuffer[(MD5LEN * 2) + 1];
+	hashBuffer[0] = _T('\0');
 	MD5::hash(pluginsListFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1);
 	string serverMD5;
 	BOOL downloadSuccess = FALSE;
@@ -906,15 +1352,17 @@ void PluginList::downloadList()
 	}
 	else
 	{
-		TCHAR *md5Url = getPluginsMd5Url();
-		downloadResult = downloadManager.getUrl(md5Url, serverMD5, &g_options.moduleInfo);
+		downloadResult = downloadManager.getUrl(getMirrors(getPluginsMd5Url()), serverMD5, &g_options.moduleInfo);
 	}
 #else
-	TCHAR *md5Url = getPluginsMd5Url();
-	BOOL downloadResult = downloadManager.getUrl(md5Url, serverMD5, &g_options.moduleInfo);
+	BOOL downloadResult = downloadManager.getUrl(getMirrors(getPluginsMd5Url()), serverMD5, &g_options.moduleInfo);
 #endif
 
-	std::shared_ptr<char> cHashBuffer = WcharMbcsConverter::tchar2char(hashBuffer);
+	// A list that has been patched is a different file to the server's, so compare the
+	// server's hash with the version the list was patched to
+	tstring catalogVersion = CatalogPatcher::getCatalogVersion(pluginsListVersionFilename.c_str(), hashBuffer);
+	std::shared_ptr<char> cHashBuffer = WcharMbcsConverter::tchar2char(catalogVersion.c_str());
+	BOOL listChanged = FALSE;
 
 	if (downloadResult && serverMD5 == cHashBuffer.get()) {
 		// Server hash matches local hash, so we're ok to continue
@@ -922,6 +1370,8 @@ void PluginList::downloadList()
 	}
 	else if (downloadResult && serverMD5 != cHashBuffer.get())
 	{
+		listChanged = TRUE;
+
 		// If the build is allowing to override the download URL, then use the one from options
 		// Also, don't unzip it - assume if it's overridden, it's a test version and hence easier to treat it
 		// as a plain xml file
@@ -938,24 +1388,41 @@ void PluginList::downloadList()
 	else
 #endif
 	{
-        // OSes less than vista don't support SNI, which cloudflare uses to support HTTPS, so we have to use HTTP on old OSes
-        TCHAR *pluginsUrl = getPluginsUrl();
-		downloadSuccess = downloadManager.getUrl(pluginsUrl, pluginsListZipFilename, contentType, &g_options.moduleInfo);
-
-        if (downloadSuccess) {
-			// Unzip the plugins.zip to PluginManagerPlugins.xml
-			tstring unzipPath(pluginConfig);
-			unzipPath.append(_T("\\"));
-			Decompress::unzip(pluginsListZipFilename, unzipPath);
+		// Try patching the list we have first, and only download the whole list if
+		// there is no chain of patches from our version to the server's
+		std::shared_ptr<TCHAR> tServerMD5 = WcharMbcsConverter::char2tchar(serverMD5.c_str());
+		CatalogPatcher catalogPatcher(downloadManager, &g_options.moduleInfo);
+		downloadSuccess = catalogPatcher.update(pluginsListFilename.c_str(), pluginsListVersionFilename.c_str(),
+			hashBuffer, getPluginsPatchUrl(), tServerMD5.get());
+
+		if (!downloadSuccess) {
+			// OSes less than vista don't support SNI, which cloudflare uses to support HTTPS, so we have to use HTTP on old OSes
+			downloadSuccess = downloadManager.getUrl(getMirrors(getPluginsUrl()), pluginsListZipFilename, contentType, &g_options.moduleInfo);
+
+			if (downloadSuccess) {
+				// Unzip the plugins.zip to PluginManagerPlugins.xml
+				tstring unzipPath(pluginConfig);
+				unzipPath.append(_T("\\"));
+				Decompress::unzip(pluginsListZipFilename, unzipPath);
+
+				// The list is now the server's own file
+				::DeleteFile(pluginsListVersionFilename.c_str());
+			}
 		}
-
 	}
 
 	}
 
 	if (downloadSuccess) {
-		// Parse it
-		parsePluginFile(pluginsListFilename.c_str());
+		// If a new list was downloaded or patched, the cache needs to be keyed on the new hash
+		if (listChanged)
+		{
+			hashBuffer[0] = _T('\0');
+			MD5::hash(pluginsListFilename.c_str(), hashBuffer, (MD5LEN * 2) + 1);
+		}
+
+		// Parse it, or load the compiled version of it if it's already been parsed
+		parsePluginFile(pluginsListFilename.c_str(), pluginsListCacheFilename.c_str(), hashBuffer);
 
 		// Check for what is installed
 		checkInstalledPlugins();
@@ -980,6 +1447,18 @@ TCHAR* PluginList::getPluginsMd5Url() {
 	return PLUGINS_MD5_URL;
 }
 
+TCHAR* PluginList::getPluginsPatchUrl() {
+    if (g_options.useDevPluginList) {
+        return DEV_PLUGINS_PATCH_URL;
+	}
+
+    if (g_options.forceHttp || g_winVer < WV_VISTA) {
+        return PLUGINS_HTTP_PATCH_URL;
+	}
+
+	return PLUGINS_PATCH_URL;
+}
+
 TCHAR* PluginList::getPluginsUrl() {
     if (g_options.useDevPluginList) {
         return DEV_PLUGINS_URL;
@@ -1004,6 +1483,17 @@ TCHAR* PluginList::getValidateUrl() {
 	return VALIDATE_BASE_URL;
 }
 
+MirrorList PluginList::getMirrors(const TCHAR* url) {
+	MirrorList mirrors(url);
+
+	// The dev list is only on its own server
+	if (!g_options.useDevPluginList) {
+		mirrors.addServers(url, g_options.catalogMirrors.c_str());
+	}
+
+	return mirrors;
+}
+
 void PluginList::reparseFile(const tstring& pluginsListFilename)
 {
 	// Parse it
@@ -1156,6 +1646,27 @@ void PluginList::installPlugins(HWND hMessageBoxParent, ProgressDialog* progress
 
 	progressDialog->setStepCount(installSteps);
 
+	// Start all the downloads now, rather than as each plugin's steps get to them, so the
+	// downloads run alongside each other and alongside the copying
+	tstring prefetchPath(configDir);
+	prefetchPath.append(_T("\\plugin_install_temp\\prefetch"));
+
+	// The steps are always given the prefetcher (or NULL), so none are left with one from a previous install
+	std::shared_ptr<DownloadPrefetcher> prefetcher;
+	if (g_options.downloadThreads > 0)
+		prefetcher.reset(new DownloadPrefetcher(prefetchPath, g_options.downloadThreads, &g_options.moduleInfo, cancelToken));
+
+	for (pluginIter = selectedPlugins->begin(); pluginIter != selectedPlugins->end(); ++pluginIter)
+		(*pluginIter)->setDownloadPrefetcher(prefetcher.get(), _variableHandler);
+
+	if (prefetcher)
+		prefetcher->start();
+
+	// The files of all the plugins are validated with one batch, so each hash is only sent once
+	ValidationBatch validationBatch;
+	for (pluginIter = selectedPlugins->begin(); pluginIter != selectedPlugins->end(); ++pluginIter)
+		(*pluginIter)->setValidationBatch(&validationBatch, _variableHandler);
+
 	pluginIter = selectedPlugins->begin();
 
 	tstring pluginDir = _variableHandler->getVariable(_T("PLUGINDIR"));
@@ -1293,6 +1804,19 @@ void PluginList::installPlugins(HWND hMessageBoxParent, ProgressDialog* progress
 		++pluginIter;
 	}
 
+	for (pluginIter = selectedPlugins->begin(); pluginIter != selectedPlugins->end(); ++pluginIter)
+		(*pluginIter)->setValidationBatch(NULL, _variableHandler);
+
+	if (prefetcher)
+	{
+		for (pluginIter = selectedPlugins->begin(); pluginIter != selectedPlugins->end(); ++pluginIter)
+			(*pluginIter)->setDownloadPrefetcher(NULL, _variableHandler);
+
+		// Deletes anything that was downloaded but not used (e.g. after a failed install)
+		prefetcher.reset();
+		Utility::removeDirectory(prefetchPath.c_str());
+	}
+
 
 	progressDialog->close();
 
@@ -1507,12 +2031,25 @@ void PluginList::clearPluginList()
 {
 	PluginContainer::iterator iter = _plugins.begin();
 	while (iter != _plugins.end())
+	{
+		// Libraries that are also available are deleted with the libraries below
+		PluginContainer::iterator library = _libraries.find(iter->first);
+		if (library == _libraries.end() || library->second != iter->second)
+			delete iter->second;
+		++iter;
+	}
+
+	iter = _libraries.begin();
+	while (iter != _libraries.end())
 	{
 		delete iter->second;
 		++iter;
 	}
 
+	_index.clear();
 	_plugins.clear();
+	_libraries.clear();
+	_aliases.clear();
 	_installedPlugins.clear();
 	_updateablePlugins.clear();
 	_availablePlugins.clear();
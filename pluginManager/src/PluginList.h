@@ -24,6 +24,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "Plugin.h"
 #include "ProgressDialog.h"
 #include "PluginListView.h"
+#include "StringPool.h"
+#include "PluginIndex.h"
+#include "libinstall/FingerprintCache.h"
+#include "libinstall/PluginProbe.h"
+#include "libinstall/DirectoryWatcher.h"
+#include "libinstall/MirrorList.h"
 
 enum InstallOrRemove
 {
@@ -31,6 +37,29 @@ enum InstallOrRemove
 	REMOVE
 };
 
+/* What is read from an installed plugin dll, to match it to the plugin list */
+struct InstalledPluginFile
+{
+	tstring			filename;		// without the path
+	tstring			name;			// as reported by the plugin's getName()
+	tstring			hash;			// MD5 of the dll, or empty if it could not be read
+	PluginVersion	version;		// file version from the version resource
+	BOOL			hasVersion;
+
+	InstalledPluginFile() : hasVersion(FALSE) {}
+};
+
+/* The plugins found in one plugins directory.  Kept between refreshes, with a watcher on
+ * the directory, so that only the dlls that have changed since need to be read again */
+struct InstalledDirectory
+{
+	BOOL									allUsers;
+	std::shared_ptr<DirectoryWatcher>		watcher;		// NULL until the directory has been read
+	std::map<tstring, InstalledPluginFile>	pluginFiles;	// by filename - only the dlls that are plugins
+
+	InstalledDirectory() : allUsers(FALSE) {}
+};
+
 class PluginList
 {
 public:
@@ -42,15 +71,42 @@ public:
 	void reparseFile(const tstring& pluginsListFilename);
 
 	BOOL parsePluginFile(CONST TCHAR *filename);
+
+	/* Parses the children of <plugins> on threadCount threads, then merges them into
+	 * the list in document order, so the result is the same as parsePluginFile */
+	BOOL parsePluginFileParallel(CONST TCHAR *filename, int threadCount);
+
+	/* Loads the list from the catalog cache if it was built from an XML with the given hash,
+	 * otherwise parses the XML and writes a new cache */
+	BOOL parsePluginFile(const TCHAR* filename, const TCHAR* cacheFilename, const tstring& xmlHash);
+
+	BOOL loadCatalogCache(const TCHAR* filename, const tstring& xmlHash);
+	BOOL saveCatalogCache(const TCHAR* filename, const tstring& xmlHash);
+
+	/* Refreshes the installed, updateable and available plugins.  Only the dlls added,
+	 * changed or removed since the last call are read again */
 	BOOL checkInstalledPlugins();
+
+	/* Matches an installed plugin to the list, and adds it to the installed or updateable
+	 * plugins.  Called by checkInstalledPlugins for each dll found */
+	void classifyInstalledPlugin(const InstalledPluginFile& pluginFile, BOOL allUsers);
+
+	/* Fills the available plugins with the plugins that aren't installed - called after
+	 * all the installed plugins have been classified */
+	void addAvailablePlugins();
 	
 	PluginListContainer& getInstalledPlugins();
 	PluginListContainer& getUpdateablePlugins();
 	PluginListContainer& getAvailablePlugins();
 	
+	/* Looks up an available plugin or library by name.  This only reads the index, so
+	 * is safe to call whilst the install thread is running */
 	Plugin*				 getPlugin(tstring name);
 	VariableHandler*     getVariableHandler();
 
+	/* Pool holding the metadata strings of every plugin in the list */
+	StringPool&          getStringPool();
+
 	// Returns true if the plugin is installable or upgradable 
     BOOL				 isInstallOrUpgrade(const tstring& pluginName);
 
@@ -94,11 +150,21 @@ private:
 	/* Aliases of plugins with different names for different versions */
 	std::map<tstring, tstring> _aliases;
 
+	/* Metadata strings for the plugins - kept until the list is destroyed, as the
+	 * installed plugins can outlive a reparse of the list */
+	StringPool				_stringPool;
+
+	/* Index of the names, aliases and real name hashes above, built after parsing */
+	PluginIndex				_index;
+
 	/* Lists of plugins */
 	PluginListContainer		_installedPlugins;
 	PluginListContainer	    _updateablePlugins;
 	PluginListContainer		_availablePlugins;
 
+	/* What was found in the plugins directories, by path */
+	std::map<tstring, InstalledDirectory>	_installedDirectories;
+
 
 	/* Event for list being available */
 	HANDLE		_hListsAvailableEvent;
@@ -113,28 +179,42 @@ private:
 	PluginVersion _nppVersion;
 
     void        addInstallSteps(Plugin* plugin, TiXmlElement* installElement);
-	BOOL		setInstalledVersion(tstring filename, Plugin* plugin);
-	tstring		getPluginName(tstring filename);
+	Fingerprint	readFingerprint(const tstring& filename, const ProbeResult& probeResult);
+	BOOL		probePlugins(const std::vector<tstring>& filenames, std::vector<ProbeResult>& results);
+	static ProbeResult probeLoadedPlugin(const tstring& filename);
 	
 
 	TiXmlDocument* getGpupDocument(const TCHAR* filename);
 
-	BOOL checkInstalledPlugins(const TCHAR *nppDirectory, BOOL allUsers);
-	void addAvailablePlugins();
+	void scanInstalledDirectory(const tstring& pluginPath, InstalledDirectory& directory, FingerprintCache& fingerprintCache);
+	void readInstalledFiles(const tstring& pluginPath, const std::vector<tstring>& filenames,
+							FingerprintCache& fingerprintCache, std::map<tstring, InstalledPluginFile>& pluginFiles);
 
 	void installPlugins(HWND hMessageBoxParent, ProgressDialog* progressDialog, PluginListView* pluginListView, BOOL isUpgrade, CancelToken& cancelToken);
 	void removePlugins(HWND hMessageBoxParent, ProgressDialog* progressDialog, PluginListView* pluginListView, CancelToken& cancelToken);
 	void addPluginNames(TiXmlElement* pluginNamesElement);
+	void parsePluginElement(TiXmlElement* pluginNode);
+	Plugin* createPlugin(TiXmlElement* pluginNode, BOOL& available);
+	void addPlugin(Plugin* plugin, BOOL available, TiXmlElement* pluginNode);
+	void reportParseError(const TCHAR* errorDesc, int row, int col);
 
 	static UINT installThreadProc(LPVOID param);
 	static UINT removeThreadProc(LPVOID param);
+	static UINT parseWorkerThreadProc(LPVOID param);
 
 	void clearPluginList();
 
 
 	void addSteps(Plugin* plugin, TiXmlElement* installElement, InstallOrRemove ior);
+	void buildIndex();
+
+	static UINT32 getCatalogCacheFlags();
 
     TCHAR *getPluginsUrl();
 	TCHAR *getPluginsMd5Url();
+	TCHAR *getPluginsPatchUrl();
     TCHAR *getValidateUrl();
+
+	/* url, and the same on each of the catalog mirrors */
+	MirrorList getMirrors(const TCHAR* url);
 };
@@ -29,6 +29,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "Utility.h"
 #include "WcharMbcsConverter.h"
 #include "libinstall/DownloadManager.h"
+#include "libinstall/DownloadCache.h"
+#include "libinstall/DownloadMetrics.h"
+#include "libinstall/MirrorList.h"
+#include "libinstall/PartialDownload.h"
+#include "libinstall/Validate.h"
+#include "libinstall/ValidationDatabase.h"
+#include "libinstall/ValidationCache.h"
 
 /* information for notepad */
 
@@ -139,6 +146,9 @@ extern "C" __declspec(dllexport) void setInfo(NppData notpadPlusData)
     /* load data of plugin */
     loadSettings();
 
+    /* all downloads share one session, so connections to the server are reused */
+    DownloadManager::useSharedTransport();
+
     /* initial dialogs */
     //TemplateDlg.init((HINSTANCE)g_hModule, nppData, &pluginProp);
     aboutDlg.init((HINSTANCE)g_hModule, nppData);
@@ -184,6 +194,11 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *notifyCode)
             (void)::CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)startupChecks, NULL, 0, 0);
             break;
 
+        case NPPN_SHUTDOWN:
+            /* WinINet handles mustn't be closed from DllMain, so close the session now */
+            DownloadManager::setTransport(std::shared_ptr<HttpTransport>());
+            break;
+
     }
 }
 
@@ -238,6 +253,25 @@ void loadSettings(void)
     g_options.forceHttp = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_FORCEHTTP, 0, iniFilePath);
     g_options.useDevPluginList = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_USEDEVPLUGINLIST, 0, iniFilePath);
 
+    // Number of threads used to parse the plugin list - 1 reads it a plugin at a time, in little memory.
+    // More (or 0 for one per processor) is quicker on a big list, but holds all of it in memory.
+    g_options.parseThreads = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_PARSETHREADS, PARSETHREADS_DEFAULT, iniFilePath);
+
+    // Number of downloads run at once when installing, 0 to download each file as it is needed
+    g_options.downloadThreads = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_DOWNLOADTHREADS, DOWNLOADTHREADS_DEFAULT, iniFilePath);
+
+    // Size of the download cache in MB, 0 to not keep downloaded files
+    g_options.downloadCacheSize = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_DOWNLOADCACHESIZE, DOWNLOADCACHESIZE_DEFAULT, iniFilePath);
+
+    // Record the timings of each download - 0 not to, or a DOWNLOADMETRICS_FORMAT (1 log, 2 JSON)
+    g_options.downloadMetrics = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_DOWNLOADMETRICS, 0, iniFilePath);
+
+    // Other servers with a copy of the plugin list and validation, e.g. "https://mirror.example.org",
+    // separated by spaces - the fastest is used
+    TCHAR tmpMirrors[1024];
+    ::GetPrivateProfileString(SETTINGS_GROUP, KEY_CATALOGMIRRORS, _T(""), tmpMirrors, 1024, iniFilePath);
+    g_options.catalogMirrors = tmpMirrors;
+
 
     g_options.daysToCheck = ::GetPrivateProfileInt(SETTINGS_GROUP, KEY_DAYSTOCHECK, DAYSCHECK_DEFAULT, iniFilePath);
     if (g_options.daysToCheck < DAYSCHECK_MIN)
@@ -350,6 +384,44 @@ UINT startupChecks(LPVOID /*param*/)
     ::SendMessage(nppData._nppHandle, NPPM_GETNPPDIRECTORY, MAX_PATH, reinterpret_cast<LPARAM>(tNppPath));
 
 
+    // Downloads that fail part way through are continued by a later install, even after a
+    // restart, unless they are left for longer than PARTIALDOWNLOAD_MAX_AGE days
+    tstring partialDir = tConfigPath;
+    partialDir.append(_T("\\") PARTIALDOWNLOAD_DIRECTORY);
+    PartialDownload::removeExpired(partialDir, PARTIALDOWNLOAD_MAX_AGE);
+    DownloadManager::setPartialDirectory(partialDir);
+
+    if (g_options.downloadCacheSize > 0)
+    {
+        tstring cacheDir = tConfigPath;
+        cacheDir.append(_T("\\") DOWNLOADCACHE_DIRECTORY);
+        DownloadManager::setCacheDirectory(cacheDir, static_cast<UINT64>(g_options.downloadCacheSize) * 1024 * 1024);
+    }
+
+    if (DOWNLOADMETRICS_FORMAT_LOG == g_options.downloadMetrics || DOWNLOADMETRICS_FORMAT_JSON == g_options.downloadMetrics)
+    {
+        DOWNLOADMETRICS_FORMAT format = static_cast<DOWNLOADMETRICS_FORMAT>(g_options.downloadMetrics);
+        tstring metricsFile = tConfigPath;
+        metricsFile.append(_T("\\"));
+        metricsFile.append(DOWNLOADMETRICS_FORMAT_JSON == format ? DOWNLOADMETRICS_JSON_FILENAME : DOWNLOADMETRICS_LOG_FILENAME);
+        DownloadManager::setMetricsSink(std::shared_ptr<DownloadMetricsSink>(new DownloadMetricsFile(metricsFile, format)));
+    }
+
+    // The mirrors are scored by every download, so the fastest is known the next time
+    tstring mirrorScoresFile = tConfigPath;
+    mirrorScoresFile.append(_T("\\") MIRRORSCORES_FILENAME);
+    DownloadManager::setMirrorScores(std::shared_ptr<MirrorScores>(new MirrorScores(mirrorScoresFile)));
+
+    // Extracted from plugins.zip with the plugin list
+    tstring validationDatabaseFile = tConfigPath;
+    validationDatabaseFile.append(_T("\\") VALIDATIONDB_FILENAME);
+    Validator::setDatabaseFilename(validationDatabaseFile);
+
+    // Shared with gpup, so it doesn't ask about the files again
+    tstring validationCacheFile = tConfigPath;
+    validationCacheFile.append(_T("\\") VALIDATIONCACHE_FILENAME);
+    Validator::setCacheFilename(validationCacheFile);
+
     tstring configPathVar = tConfigPath;
     configPathVar.append(_T("\\PluginManagerGpup.xml"));
     TiXmlDocument gpupDoc(configPathVar);
@@ -34,6 +34,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #define DEV_PLUGINS_MD5_URL     _T("https://nppxmldev.bruderste.in/pm/xml/plugins64.md5.txt")
 #define DEV_PLUGINS_URL         _T("https://nppxmldev.bruderste.in/pm/xml/plugins64.zip")
+
+/* Patches are at <url><md5 of old list>.xml */
+#define PLUGINS_PATCH_URL       _T("https://nppxml.bruderste.in/pm/xml/patches64/")
+#define PLUGINS_HTTP_PATCH_URL  _T("http://nppxml.bruderste.in/pm/xml/patches64/")
+#define DEV_PLUGINS_PATCH_URL   _T("https://nppxmldev.bruderste.in/pm/xml/patches64/")
 #else
 #define PLUGINS_MD5_URL     _T("https://nppxml.bruderste.in/pm/xml/plugins2.md5.txt")
 #define PLUGINS_HTTP_MD5_URL     _T("http://nppxml.bruderste.in/pm/xml/plugins2.md5.txt")
@@ -42,6 +47,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #define DEV_PLUGINS_MD5_URL     _T("https://nppxmldev.bruderste.in/pm/xml/plugins2.md5.txt")
 #define DEV_PLUGINS_URL         _T("https://nppxmldev.bruderste.in/pm/xml/plugins.zip")
+
+/* Patches are at <url><md5 of old list>.xml */
+#define PLUGINS_PATCH_URL       _T("https://nppxml.bruderste.in/pm/xml/patches/")
+#define PLUGINS_HTTP_PATCH_URL  _T("http://nppxml.bruderste.in/pm/xml/patches/")
+#define DEV_PLUGINS_PATCH_URL   _T("https://nppxmldev.bruderste.in/pm/xml/patches/")
 #endif
 
 #ifdef ALLOW_OVERRIDE_XML_URL
@@ -70,6 +80,11 @@ CONST TCHAR PLUGINMANAGER_INI[]	= _T("\\PluginManager.ini");
 #define KEY_SAVECRED	   _T("SaveCredentials")
 #define KEY_DAYSTOCHECK	   _T("DaysToCheck")
 #define KEY_KEY            _T("Key")
+#define KEY_PARSETHREADS   _T("ParseThreads")
+#define KEY_DOWNLOADTHREADS _T("DownloadThreads")
+#define KEY_DOWNLOADCACHESIZE _T("DownloadCacheSize")
+#define KEY_DOWNLOADMETRICS _T("DownloadMetrics")
+#define KEY_CATALOGMIRRORS  _T("CatalogMirrors")
 #ifdef ALLOW_OVERRIDE_XML_URL
 #define KEY_OVERRIDEMD5URL  _T("md5url")
 #define KEY_OVERRIDEURL     _T("xmlurl")
@@ -78,6 +93,10 @@ CONST TCHAR PLUGINMANAGER_INI[]	= _T("\\PluginManager.ini");
 #define DAYSCHECK_MIN       5
 #define DAYSCHECK_DEFAULT   14
 
+#define PARSETHREADS_DEFAULT     1   // the streaming parse
+#define DOWNLOADTHREADS_DEFAULT  4
+#define DOWNLOADCACHESIZE_DEFAULT 100   // MB
+
 
 
 
@@ -116,6 +135,11 @@ struct Options
 	int daysToCheck;
     BOOL forceHttp;
     BOOL useDevPluginList;
+    int parseThreads;
+    int downloadThreads;
+    int downloadCacheSize;
+    int downloadMetrics;
+    tstring catalogMirrors;
 #ifdef ALLOW_OVERRIDE_XML_URL
 	tstring downloadMD5Url;
 	tstring downloadUrl;
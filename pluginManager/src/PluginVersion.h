@@ -54,6 +54,10 @@ public:
 	bool		operator!=  (const PluginVersion &rhs);
 
 	TCHAR* getDisplayString();
+	int			getMajor() const	{ return _major; }
+	int			getMinor() const	{ return _minor; }
+	int			getRevision() const	{ return _revision; }
+	int			getBuild() const	{ return _build; }
 	bool		getIsBad();
 	void		setIsBad(bool isBad);
 	int compare(const PluginVersion &lhs, const PluginVersion &rhs) const;
@@ -0,0 +1,114 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "precompiled_headers.h"
+#include "StringPool.h"
+
+using namespace std;
+
+/* Strings up to this many bytes (including the terminator) are held inside the
+ * string object itself, without a heap allocation */
+#define SMALL_STRING_BYTES  16
+
+/* Approximate overhead of each entry in the set - the node's links and cached hash */
+#define POOL_ENTRY_OVERHEAD (3 * sizeof(void*))
+
+
+StringPool::StringPool()
+	: _internCount(0),
+	  _unpooledBytes(0),
+	  _pooledBytes(0)
+{
+	::InitializeCriticalSection(&_lock);
+}
+
+StringPool::~StringPool()
+{
+	::DeleteCriticalSection(&_lock);
+}
+
+const tstring* StringPool::intern(const TCHAR* str)
+{
+	if (str)
+		return intern(tstring(str));
+	else
+		return intern(tstring());
+}
+
+const tstring* StringPool::intern(const tstring& str)
+{
+	::EnterCriticalSection(&_lock);
+
+	pair<unordered_set<tstring>::iterator, bool> inserted = _strings.insert(str);
+
+	++_internCount;
+	_unpooledBytes += stringBytes(str);
+	_pooledBytes += sizeof(const tstring*);
+	if (inserted.second)
+		_pooledBytes += stringBytes(*inserted.first) + POOL_ENTRY_OVERHEAD;
+
+	const tstring* pooled = &(*inserted.first);
+
+	::LeaveCriticalSection(&_lock);
+
+	return pooled;
+}
+
+size_t StringPool::getStringCount()
+{
+	::EnterCriticalSection(&_lock);
+	size_t count = _strings.size();
+	::LeaveCriticalSection(&_lock);
+	return count;
+}
+
+size_t StringPool::getInternCount()
+{
+	::EnterCriticalSection(&_lock);
+	size_t count = _internCount;
+	::LeaveCriticalSection(&_lock);
+	return count;
+}
+
+size_t StringPool::getUnpooledBytes()
+{
+	::EnterCriticalSection(&_lock);
+	size_t bytes = _unpooledBytes;
+	::LeaveCriticalSection(&_lock);
+	return bytes;
+}
+
+size_t StringPool::getPooledBytes()
+{
+	::EnterCriticalSection(&_lock);
+	size_t bytes = _pooledBytes + (_strings.bucket_count() * sizeof(void*));
+	::LeaveCriticalSection(&_lock);
+	return bytes;
+}
+
+size_t StringPool::stringBytes(const tstring& str)
+{
+	size_t bytes = sizeof(tstring);
+	size_t dataBytes = (str.size() + 1) * sizeof(TCHAR);
+	if (dataBytes > SMALL_STRING_BYTES)
+		bytes += dataBytes;
+
+	return bytes;
+}
@@ -0,0 +1,68 @@
+/*
+This file is part of Plugin Manager Plugin for Notepad++
+
+Copyright (C)2009-2010 Dave Brotherstone <davegb@pobox.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#ifndef _STRINGPOOL_H
+#define _STRINGPOOL_H
+
+#include <unordered_set>
+
+/* Holds a single copy of each string given to it.  Plugins keep a pointer to the
+ * pooled copy of their metadata, so values such as "Others", "Good" and the
+ * common authors and hosts are only stored once for the whole catalog.
+ *
+ * Pooled strings are never removed, and stay valid until the pool is destroyed.
+ * intern() can be called from several threads at once.
+ */
+class StringPool
+{
+public:
+	StringPool();
+	~StringPool();
+
+	const tstring* intern(const TCHAR* str);
+	const tstring* intern(const tstring& str);
+
+	/* Counters */
+	size_t getStringCount();
+
+	size_t getInternCount();
+
+	/* Memory the strings would have used if every owner kept its own copy */
+	size_t getUnpooledBytes();
+
+	/* Memory used by the pool, plus the pointer each owner keeps */
+	size_t getPooledBytes();
+
+private:
+	StringPool(const StringPool&);				// not implemented
+	StringPool& operator=(const StringPool&);	// not implemented
+
+	static size_t stringBytes(const tstring& str);
+
+	CRITICAL_SECTION			_lock;
+
+	/* Node based, so the pointers handed out stay valid as the set grows */
+	std::unordered_set<tstring>	_strings;
+
+	size_t						_internCount;
+	size_t						_unpooledBytes;
+	size_t						_pooledBytes;
+};
+
+#endif
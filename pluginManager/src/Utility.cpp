@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "PluginManager.h"
 #include "PluginVersion.h"
 #include "PluginManagerVersion.h"
+#include "libinstall/DownloadMetrics.h"
 
 BOOL Utility::removeDirectory(const TCHAR* directory)
 {
@@ -120,6 +121,17 @@ void Utility::startGpup(HWND errorParent, const TCHAR *nppDir, const TCHAR *argu
 
 	
 
+	// gpup records the timings of its downloads in the same way
+	if (g_options.downloadMetrics == DOWNLOADMETRICS_FORMAT_LOG)
+		gpupArguments.append(_T("-m log "));
+	else if (g_options.downloadMetrics == DOWNLOADMETRICS_FORMAT_JSON)
+		gpupArguments.append(_T("-m json "));
+
+	// and uses the same download cache, with the same limit
+	TCHAR cacheSizeArgument[30];
+	_stprintf_s(cacheSizeArgument, 30, _T("-s %d "), g_options.downloadCacheSize > 0 ? g_options.downloadCacheSize : 0);
+	gpupArguments.append(cacheSizeArgument);
+
 	gpupArguments.append(_T("-w \"Notepad++\" -e \""));
 	gpupArguments.append(notepadExe);
 	gpupArguments.append(_T("\""));
@@ -14,6 +14,34 @@ else
 		exit;
 	}
 
+    // A comma separated list of hashes is answered with a "<md5> <status>" line for each
+    $md5s = explode(",", $_GET["md5"]);
+    if (count($md5s) > 1)
+    {
+        if (count($md5s) > 500)
+        {
+            echo "param_error";
+            exit;
+        }
+
+        $query = $conn->prepare("select status from FileHash where md5sum=:md5");
+        foreach ($md5s as $md5)
+        {
+            if (!preg_match('/^[0-9a-fA-F]{32}$/', $md5))
+                continue;
+
+            $query->execute(array(':md5' => $md5));
+            $row = $query->fetch();
+            $query->closeCursor();
+
+            if ($row != FALSE && ($row['status'] == "ok" || $row['status'] == "banned"))
+                echo $md5 . " " . $row['status'] . "\n";
+            else
+                echo $md5 . " unknown\n";
+        }
+        exit;
+    }
+
     $md5 = str_replace("'", "\\'", $_GET["md5"]);
     $sql = "select status from FileHash where md5sum='" . $md5 . "'";
     $query = $conn->query($sql);
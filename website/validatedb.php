@@ -0,0 +1,28 @@
+<?
+// Writes the validation database (PluginManagerValidate.db) that is shipped in plugins.zip,
+// so the plugin manager can validate known files without asking validate.php.
+//   php validatedb.php > PluginManagerValidate.db
+// The format is read by libinstall's ValidationDatabase: "PMVD", version 1, the record count,
+// then for each hash, sorted, the 16 bytes of the MD5 and 1 (ok) or 2 (banned).
+
+$db = substr(__FILE__, 0, strlen(__FILE__) - strlen(strrchr(__FILE__, '/')))
+	. '/hidden/files.db3';
+$conn = new PDO("sqlite:$db");
+
+$records = array();
+$query = $conn->query("select md5sum, status from FileHash where status='ok' or status='banned'");
+while ($row = $query->fetch())
+{
+	if (!preg_match('/^[0-9a-fA-F]{32}$/', $row['md5sum']))
+		continue;
+
+	$records[pack('H*', strtolower($row['md5sum']))] = ($row['status'] == "ok") ? 1 : 2;
+}
+
+// Sorted by the bytes of the hash, for the binary search
+ksort($records, SORT_STRING);
+
+echo pack('VVV', 0x44564D50, 1, count($records));
+foreach ($records as $md5 => $status)
+	echo $md5 . chr($status);
+?>